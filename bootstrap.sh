@@ -8,6 +8,7 @@ CARES_VERSION=1.18.1
 CURL_VERSION=7.86.0
 PACPARSER_VERSION=1.3.8
 ZLIB_VERSION=1.2.8
+ZSTD_VERSION=1.5.7
 SPARSEHASH_VERSION=1.12
 LEVELDB_VERSION=1.18
 GOOGLETEST_VERSION=1.8.0
@@ -183,6 +184,10 @@ build_lib() {
       do_extract "zlib"         "zlib-${ZLIB_VERSION}.tar.gz"
       do_build "zlib"
       ;;
+    zstd)
+      do_extract "zstd"         "zstd-${ZSTD_VERSION}.tar.gz"
+      do_build "zstd"
+      ;;
     sparsehash)
       do_extract "sparsehash"   "sparsehash-${SPARSEHASH_VERSION}.tar.gz"
       patch_external "sparsehash"  "fix_sl4_compilation.patch"          \
@@ -266,7 +271,7 @@ build_lib() {
 # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # # #
 
 # Build a list of libs that need to be built
-missing_libs="libcurl libcrypto pacparser zlib sparsehash leveldb googletest ipaddress maxminddb protobuf googlebench sqlite3 vjson sha3 libarchive go"
+missing_libs="libcurl libcrypto pacparser zlib zstd sparsehash leveldb googletest ipaddress maxminddb protobuf googlebench sqlite3 vjson sha3 libarchive go"
 if [ x"$BUILD_QC_TESTS" != x"" ]; then
     missing_libs="$missing_libs rapidcheck"
 fi
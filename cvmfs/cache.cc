@@ -32,6 +32,18 @@ CacheManager::~CacheManager() {
 }
 
 
+int CacheManager::PreadV(ReadRange *ranges, unsigned nranges) {
+  int result = 0;
+  for (unsigned i = 0; i < nranges; ++i) {
+    ranges[i].result = Pread(ranges[i].fd, ranges[i].buf, ranges[i].size,
+                             ranges[i].offset);
+    if ((ranges[i].result < 0) && (result == 0))
+      result = ranges[i].result;
+  }
+  return result;
+}
+
+
 /**
  * Compresses and checksums the file pointed to by fd.  The hash algorithm needs
  * to be set in id.
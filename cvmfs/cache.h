@@ -9,6 +9,7 @@
 #define __STDC_FORMAT_MACROS
 #endif
 
+#include <errno.h>
 #include <stdint.h>
 
 #include <string>
@@ -168,8 +169,48 @@ class CacheManager : SingleCopy {
   virtual int64_t GetSize(int fd) = 0;
   virtual int Close(int fd) = 0;
   virtual int64_t Pread(int fd, void *buf, uint64_t size, uint64_t offset) = 0;
+  /**
+   * One part of a vectored read: size bytes at offset of the object opened as
+   * fd.  PreadV() sets result to the number of bytes read or to -errno.
+   */
+  struct ReadRange {
+    ReadRange() : fd(-1), buf(NULL), size(0), offset(0), result(0) { }
+    int fd;
+    void *buf;
+    uint64_t size;
+    uint64_t offset;
+    int64_t result;
+  };
+  /**
+   * Reads several ranges, possibly of different objects.  Returns 0 if all
+   * ranges have been read and the first error otherwise.  Cache managers that
+   * pay a round trip per read, such as the external cache manager, fetch the
+   * ranges together.
+   */
+  virtual int PreadV(ReadRange *ranges, unsigned nranges);
   virtual int Dup(int fd) = 0;
   virtual int Readahead(int fd) = 0;
+  /**
+   * Returns a read-only memory mapping of the first size bytes of the object
+   * behind fd or NULL if the cache manager cannot provide one.  The mapping
+   * stays valid until Munmap(), even after fd is closed.  Used by the SQlite
+   * VFS to read file catalogs without copying pages.
+   */
+  virtual void *Mmap(int /*fd*/, uint64_t /*size*/) { return NULL; }
+  virtual void Munmap(void * /*addr*/, uint64_t /*size*/) { }
+  /**
+   * Like Pread() but instead of copying, *data points to the cache manager's
+   * own memory.  The object stays pinned in place until ReleaseZeroCopy() is
+   * called for the same fd and data; no lock is held in between.  Returns
+   * -ENOTSUP if the cache manager does not hold its objects in memory; the
+   * caller then falls back to Pread().
+   */
+  virtual int64_t PreadZeroCopy(int /*fd*/, uint64_t /*size*/,
+                                uint64_t /*offset*/, const void ** /*data*/)
+  {
+    return -ENOTSUP;
+  }
+  virtual void ReleaseZeroCopy(int /*fd*/, const void * /*data*/) { }
 
   virtual uint32_t SizeOfTxn() = 0;
   virtual int StartTxn(const shash::Any &id, uint64_t size, void *txn) = 0;
@@ -8,14 +8,13 @@
 #include <fcntl.h>
 #include <inttypes.h>
 #include <stdint.h>
+#include <sys/mman.h>
 #include <sys/socket.h>
 #include <unistd.h>
 
 #include <algorithm>
 #include <cassert>
-#ifdef __APPLE__
 #include <cstdlib>
-#endif
 #include <cstring>
 #include <map>
 #include <new>
@@ -30,9 +29,7 @@
 #include "util/logging.h"
 #include "util/pointer.h"
 #include "util/posix.h"
-#ifdef __APPLE__
 #include "util/smalloc.h"
-#endif
 #include "util/string.h"
 
 using namespace std;  // NOLINT
@@ -68,6 +65,34 @@ int Ack2Errno(cvmfs::EnumStatus status_code) {
   }
 }
 
+/**
+ * File descriptors can only be passed over unix domain sockets
+ */
+bool IsUnixSocket(int fd) {
+  struct sockaddr_storage addr;
+  socklen_t addr_len = sizeof(addr);
+  if (getsockname(fd, reinterpret_cast<struct sockaddr *>(&addr), &addr_len)
+      != 0)
+  {
+    return false;
+  }
+  return addr.ss_family == AF_UNIX;
+}
+
+/**
+ * The shared memory area is only ever passed from the client to the plugin.
+ * Any file descriptor that arrives with a reply is closed right away so that a
+ * misbehaving plugin cannot exhaust the client's descriptor table.
+ */
+void DiscardFdPassed(CacheTransport::Frame *frame) {
+  if (frame->fd_passed() < 0)
+    return;
+  LogCvmfs(kLogCache, kLogDebug | kLogSyslogWarn,
+           "unexpected file descriptor from cache plugin, closing");
+  close(frame->fd_passed());
+  frame->set_fd_passed(-1);
+}
+
 }  // anonymous namespace
 
 const shash::Any ExternalCacheManager::kInvalidHandle;
@@ -82,6 +107,22 @@ int ExternalCacheManager::AbortTxn(void *txn) {
 }
 
 
+/**
+ * Returns -1 if the shared memory area is not in use or if all of its slots
+ * are taken by concurrent requests.
+ */
+int ExternalCacheManager::AcquireShmSlot() {
+  if (shm_slots_ == 0)
+    return -1;
+  MutexLockGuard guard(lock_shm_slots_);
+  if (shm_free_slots_.empty())
+    return -1;
+  int slot = shm_free_slots_.back();
+  shm_free_slots_.pop_back();
+  return slot;
+}
+
+
 bool ExternalCacheManager::AcquireQuotaManager(QuotaManager *quota_mgr) {
   assert(quota_mgr != NULL);
   quota_mgr_ = quota_mgr;
@@ -99,6 +140,7 @@ void ExternalCacheManager::CallRemotely(ExternalCacheManager::RpcJob *rpc_job) {
       again = false;
       bool retval = transport_.RecvFrame(rpc_job->frame_recv());
       assert(retval);
+      DiscardFdPassed(rpc_job->frame_recv());
       if (rpc_job->frame_recv()->IsMsgOutOfBand()) {
         google::protobuf::MessageLite *msg_typed =
           rpc_job->frame_recv()->GetMsgTyped();
@@ -110,14 +152,7 @@ void ExternalCacheManager::CallRemotely(ExternalCacheManager::RpcJob *rpc_job) {
     } while (again);
   } else {
     Signal signal;
-    {
-      MutexLockGuard guard(lock_inflight_rpcs_);
-      inflight_rpcs_.push_back(RpcInFlight(rpc_job, &signal));
-    }
-    {
-      MutexLockGuard guard(lock_send_fd_);
-      transport_.SendFrame(rpc_job->frame_send());
-    }
+    SendRemotely(rpc_job, &signal);
     signal.Wait();
   }
 }
@@ -219,18 +254,38 @@ ExternalCacheManager *ExternalCacheManager::Create(
   msg_handshake.set_protocol_version(kPbProtocolVersion);
   msg_handshake.set_name(ident);
   CacheTransport::Frame frame_send(&msg_handshake);
+  // Offer the shared memory area; the plugin maps it or ignores it
+  int fd_shm = -1;
+  if (IsUnixSocket(fd_connection)) {
+    const uint64_t shm_size =
+      static_cast<uint64_t>(kNumShmSlots) * kMaxSupportedObjectSize;
+    fd_shm = CacheTransport::CreateShmArea(shm_size);
+    if (fd_shm >= 0) {
+      cache_mgr->shm_area_ = CacheTransport::MapShmArea(fd_shm, shm_size);
+      if (cache_mgr->shm_area_ != NULL) {
+        cache_mgr->shm_size_ = shm_size;
+        msg_handshake.set_shm_slots(kNumShmSlots);
+        frame_send.set_fd_passed(fd_shm);
+      }
+    }
+  }
   cache_mgr->transport_.SendFrame(&frame_send);
+  if (fd_shm >= 0)
+    close(fd_shm);
 
   CacheTransport::Frame frame_recv;
   bool retval = cache_mgr->transport_.RecvFrame(&frame_recv);
   if (!retval)
     return NULL;
+  DiscardFdPassed(&frame_recv);
   google::protobuf::MessageLite *msg_typed = frame_recv.GetMsgTyped();
   if (msg_typed->GetTypeName() != "cvmfs.MsgHandshakeAck")
     return NULL;
   cvmfs::MsgHandshakeAck *msg_ack =
     reinterpret_cast<cvmfs::MsgHandshakeAck *>(msg_typed);
   cache_mgr->session_id_ = msg_ack->session_id();
+  cache_mgr->protocol_version_ =
+    std::min(kPbProtocolVersion, msg_ack->protocol_version());
   cache_mgr->capabilities_ = msg_ack->capabilities();
   cache_mgr->max_object_size_ = msg_ack->max_object_size();
   assert(cache_mgr->max_object_size_ > 0);
@@ -248,6 +303,14 @@ ExternalCacheManager *ExternalCacheManager::Create(
   }
   if (msg_ack->has_pid())
     cache_mgr->pid_plugin_ = msg_ack->pid();
+  if ((cache_mgr->shm_area_ != NULL) &&
+      (msg_ack->shm_slots() == kNumShmSlots))
+  {
+    cache_mgr->shm_slots_ = kNumShmSlots;
+    for (int i = kNumShmSlots - 1; i >= 0; --i)
+      cache_mgr->shm_free_slots_.push_back(i);
+    LogCvmfs(kLogCache, kLogDebug, "using shared memory data plane");
+  }
   return cache_mgr.Release();
 }
 
@@ -396,9 +459,13 @@ ExternalCacheManager::ExternalCacheManager(
   , transport_(fd_connection)
   , session_id_(-1)
   , max_object_size_(0)
+  , protocol_version_(0)
   , spawned_(false)
   , terminated_(false)
   , capabilities_(cvmfs::CAP_NONE)
+  , shm_area_(NULL)
+  , shm_size_(0)
+  , shm_slots_(0)
 {
   int retval = pthread_rwlock_init(&rwlock_fd_table_, NULL);
   assert(retval == 0);
@@ -406,6 +473,8 @@ ExternalCacheManager::ExternalCacheManager(
   assert(retval == 0);
   retval = pthread_mutex_init(&lock_inflight_rpcs_, NULL);
   assert(retval == 0);
+  retval = pthread_mutex_init(&lock_shm_slots_, NULL);
+  assert(retval == 0);
   memset(&thread_read_, 0, sizeof(thread_read_));
   atomic_init64(&next_request_id_);
 }
@@ -424,9 +493,12 @@ ExternalCacheManager::~ExternalCacheManager() {
   if (spawned_)
     pthread_join(thread_read_, NULL);
   close(transport_.fd_connection());
+  if (shm_area_ != NULL)
+    munmap(shm_area_, shm_size_);
   pthread_rwlock_destroy(&rwlock_fd_table_);
   pthread_mutex_destroy(&lock_send_fd_);
   pthread_mutex_destroy(&lock_inflight_rpcs_);
+  pthread_mutex_destroy(&lock_shm_slots_);
 }
 
 
@@ -453,10 +525,19 @@ int ExternalCacheManager::Flush(bool do_commit, Transaction *transaction) {
   }
 
   RpcJob rpc_job(&msg_store);
-  rpc_job.set_attachment_send(transaction->buffer, transaction->buf_pos);
+  int shm_slot = (transaction->buf_pos > 0) ? AcquireShmSlot() : -1;
+  if (shm_slot >= 0) {
+    memcpy(GetShmSlot(shm_slot), transaction->buffer, transaction->buf_pos);
+    msg_store.set_shm_slot(shm_slot);
+    msg_store.set_shm_size(transaction->buf_pos);
+  } else {
+    rpc_job.set_attachment_send(transaction->buffer, transaction->buf_pos);
+  }
   // TODO(jblomer): allow for out of order chunk upload
   CallRemotely(&rpc_job);
   msg_store.release_object_id();
+  if (shm_slot >= 0)
+    ReleaseShmSlot(shm_slot);
 
   cvmfs::MsgStoreReply *msg_reply = rpc_job.msg_store_reply();
   if (msg_reply->status() == cvmfs::STATUS_OK) {
@@ -511,6 +592,7 @@ void *ExternalCacheManager::MainRead(void *data) {
     bool retval = cache_mgr->transport_.RecvFrame(&frame_recv);
     if (!retval)
       break;
+    DiscardFdPassed(&frame_recv);
 
     uint64_t req_id;
     uint64_t part_nr = 0;
@@ -600,6 +682,11 @@ int ExternalCacheManager::OpenFromTxn(void *txn) {
 }
 
 
+/**
+ * Large reads are split in several requests that are in flight at the same
+ * time.  The reader thread matches the replies by request id, so they can
+ * arrive in any order.
+ */
 int64_t ExternalCacheManager::Pread(
   int fd,
   void *buf,
@@ -610,38 +697,145 @@ int64_t ExternalCacheManager::Pread(
   if (id == kInvalidHandle)
     return -EBADF;
 
-  cvmfs::MsgHash object_id;
-  transport_.FillMsgHash(id, &object_id);
+  // Without the reader thread, replies can only be received one by one
+  const unsigned max_inflight = spawned_ ? kMaxReadsInFlight : 1;
   uint64_t nbytes = 0;
   while (nbytes < size) {
-    uint64_t batch_size =
-      std::min(size - nbytes, static_cast<uint64_t>(max_object_size_));
-    cvmfs::MsgReadReq msg_read;
-    msg_read.set_session_id(session_id_);
-    msg_read.set_req_id(NextRequestId());
-    msg_read.set_allocated_object_id(&object_id);
-    msg_read.set_offset(offset + nbytes);
-    msg_read.set_size(batch_size);
-    RpcJob rpc_job(&msg_read);
-    rpc_job.set_attachment_recv(reinterpret_cast<char *>(buf) + nbytes,
-                                batch_size);
-    CallRemotely(&rpc_job);
-    msg_read.release_object_id();
-
-    cvmfs::MsgReadReply *msg_reply = rpc_job.msg_read_reply();
-    if (msg_reply->status() == cvmfs::STATUS_OK) {
-      nbytes += rpc_job.frame_recv()->att_size();
+    ReadBatch batches[kMaxReadsInFlight];
+    unsigned nbatches = 0;
+    for (uint64_t pos = nbytes; (pos < size) && (nbatches < max_inflight);
+         ++nbatches)
+    {
+      ReadBatch *batch = &batches[nbatches];
+      batch->buf = reinterpret_cast<char *>(buf) + pos;
+      batch->size =
+        std::min(size - pos, static_cast<uint64_t>(max_object_size_));
+      batch->msg_read.set_session_id(session_id_);
+      batch->msg_read.set_req_id(NextRequestId());
+      transport_.FillMsgHash(id, batch->msg_read.mutable_object_id());
+      batch->msg_read.set_offset(offset + pos);
+      batch->msg_read.set_size(batch->size);
+      SendRead(batch);
+      pos += batch->size;
+    }
+
+    // All replies need to be collected, even after an error or a short read
+    int64_t result = 0;
+    bool is_done = false;
+    for (unsigned i = 0; i < nbatches; ++i) {
+      int64_t nbytes_batch = ReceiveRead(&batches[i]);
+      if (is_done)
+        continue;
+      if (nbytes_batch < 0) {
+        result = nbytes_batch;
+        is_done = true;
+        continue;
+      }
+      nbytes += nbytes_batch;
       // Fuse sends in rounded up buffers, so short reads are expected
-      if (rpc_job.frame_recv()->att_size() < batch_size)
-        return nbytes;
-    } else {
-      return Ack2Errno(msg_reply->status());
+      if (static_cast<uint64_t>(nbytes_batch) < batches[i].size) {
+        result = nbytes;
+        is_done = true;
+      }
     }
+    if (is_done)
+      return result;
   }
   return size;
 }
 
 
+/**
+ * Reads several ranges, possibly of different objects.  Consecutive ranges
+ * that fit together into max_object_size_ bytes are fetched with a single
+ * vectored read request.  Returns 0 if all ranges have been read and the first
+ * error otherwise.
+ */
+int ExternalCacheManager::PreadV(ReadRange *ranges, unsigned nranges) {
+  unsigned i = 0;
+  while (i < nranges) {
+    // Plugins speaking protocol version 1 do not understand vectored reads
+    if ((protocol_version_ < 2) || (ranges[i].size > max_object_size_)) {
+      ranges[i].result = Pread(ranges[i].fd, ranges[i].buf, ranges[i].size,
+                               ranges[i].offset);
+      i++;
+      continue;
+    }
+
+    ReadBatch batch;
+    vector<ReadRange *> packed;
+    while ((i < nranges) && (ranges[i].size <= max_object_size_ - batch.size))
+    {
+      shash::Any id = GetHandle(ranges[i].fd);
+      if (id == kInvalidHandle) {
+        ranges[i].result = -EBADF;
+        i++;
+        continue;
+      }
+      cvmfs::MsgReadRange *range = batch.msg_read.add_ranges();
+      transport_.FillMsgHash(id, range->mutable_object_id());
+      range->set_offset(ranges[i].offset);
+      range->set_size(ranges[i].size);
+      packed.push_back(&ranges[i]);
+      batch.size += ranges[i].size;
+      i++;
+    }
+    if (packed.empty())
+      continue;
+
+    // The first range goes into the regular fields of the request
+    cvmfs::MsgReadRange *first = batch.msg_read.mutable_ranges(0);
+    batch.msg_read.set_allocated_object_id(first->release_object_id());
+    batch.msg_read.set_offset(first->offset());
+    batch.msg_read.set_size(first->size());
+    batch.msg_read.mutable_ranges()->DeleteSubrange(0, 1);
+    batch.msg_read.set_session_id(session_id_);
+    batch.msg_read.set_req_id(NextRequestId());
+    batch.buf = smalloc(std::max(batch.size, static_cast<uint64_t>(1)));
+    SendRead(&batch);
+    int64_t nbytes = ReceiveRead(&batch);
+
+    cvmfs::MsgReadReply *msg_reply = batch.rpc_job->msg_read_reply();
+    if ((nbytes >= 0) && (packed.size() == 1)) {
+      memcpy(packed[0]->buf, batch.buf, nbytes);
+      packed[0]->result = nbytes;
+    } else if ((nbytes < 0) ||
+               (msg_reply->range_results_size() !=
+                static_cast<int>(packed.size())))
+    {
+      for (unsigned j = 0; j < packed.size(); ++j)
+        packed[j]->result = (nbytes < 0) ? nbytes : -EIO;
+    } else {
+      uint64_t pos = 0;
+      for (unsigned j = 0; j < packed.size(); ++j) {
+        const cvmfs::MsgReadRangeResult &result = msg_reply->range_results(j);
+        if (result.status() != cvmfs::STATUS_OK) {
+          packed[j]->result = Ack2Errno(result.status());
+          continue;
+        }
+        if ((result.size() > packed[j]->size) ||
+            (pos + result.size() > static_cast<uint64_t>(nbytes)))
+        {
+          packed[j]->result = -EIO;
+          continue;
+        }
+        memcpy(packed[j]->buf, reinterpret_cast<char *>(batch.buf) + pos,
+               result.size());
+        packed[j]->result = result.size();
+        pos += result.size();
+      }
+    }
+    free(batch.buf);
+  }
+
+  for (i = 0; i < nranges; ++i) {
+    if (ranges[i].result < 0)
+      return ranges[i].result;
+  }
+  return 0;
+}
+
+
 int ExternalCacheManager::Readahead(int fd) {
   shash::Any id = GetHandle(fd);
   if (id == kInvalidHandle)
@@ -651,6 +845,38 @@ int ExternalCacheManager::Readahead(int fd) {
 }
 
 
+/**
+ * Waits for the reply to a SendRead() and copies the payload into batch->buf.
+ * Returns the payload size or -errno.
+ */
+int64_t ExternalCacheManager::ReceiveRead(ReadBatch *batch) {
+  if (spawned_)
+    batch->signal.Wait();
+  cvmfs::MsgReadReply *msg_reply = batch->rpc_job->msg_read_reply();
+  int64_t result;
+  if (msg_reply->status() != cvmfs::STATUS_OK) {
+    result = Ack2Errno(msg_reply->status());
+  } else if (batch->shm_slot >= 0) {
+    result = std::min(static_cast<uint64_t>(msg_reply->shm_size()),
+                      batch->size);
+    memcpy(batch->buf, GetShmSlot(batch->shm_slot), result);
+  } else {
+    result = batch->rpc_job->frame_recv()->att_size();
+  }
+  if (batch->shm_slot >= 0) {
+    ReleaseShmSlot(batch->shm_slot);
+    batch->shm_slot = -1;
+  }
+  return result;
+}
+
+
+void ExternalCacheManager::ReleaseShmSlot(int slot) {
+  MutexLockGuard guard(lock_shm_slots_);
+  shm_free_slots_.push_back(slot);
+}
+
+
 int ExternalCacheManager::Reset(void *txn) {
   Transaction *transaction = reinterpret_cast<Transaction *>(txn);
   transaction->buf_pos = 0;
@@ -730,6 +956,37 @@ bool ExternalCacheManager::StoreBreadcrumb(const manifest::Manifest &manifest) {
 }
 
 
+/**
+ * Sends a fully prepared read request.  With the reader thread running, the
+ * call returns immediately and ReceiveRead() waits for the reply.
+ */
+void ExternalCacheManager::SendRead(ReadBatch *batch) {
+  batch->rpc_job = new RpcJob(&batch->msg_read);
+  batch->shm_slot = AcquireShmSlot();
+  if (batch->shm_slot >= 0)
+    batch->msg_read.set_shm_slot(batch->shm_slot);
+  else
+    batch->rpc_job->set_attachment_recv(batch->buf, batch->size);
+  if (spawned_)
+    SendRemotely(batch->rpc_job, &batch->signal);
+  else
+    CallRemotely(batch->rpc_job);
+}
+
+
+void ExternalCacheManager::SendRemotely(RpcJob *rpc_job, Signal *signal) {
+  assert(spawned_);
+  {
+    MutexLockGuard guard(lock_inflight_rpcs_);
+    inflight_rpcs_.push_back(RpcInFlight(rpc_job, signal));
+  }
+  {
+    MutexLockGuard guard(lock_send_fd_);
+    transport_.SendFrame(rpc_job->frame_send());
+  }
+}
+
+
 void ExternalCacheManager::Spawn() {
   int retval = pthread_create(&thread_read_, NULL, MainRead, this);
   assert(retval == 0);
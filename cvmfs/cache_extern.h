@@ -32,7 +32,7 @@ class ExternalCacheManager : public CacheManager {
   friend class ExternalQuotaManager;
 
  public:
-  static const unsigned kPbProtocolVersion = 1;
+  static const unsigned kPbProtocolVersion = 2;
   /**
    * Used for race-free startup of an external cache plugin.
    */
@@ -70,6 +70,7 @@ class ExternalCacheManager : public CacheManager {
   virtual int64_t GetSize(int fd);
   virtual int Close(int fd);
   virtual int64_t Pread(int fd, void *buf, uint64_t size, uint64_t offset);
+  virtual int PreadV(ReadRange *ranges, unsigned nranges);
   virtual int Dup(int fd);
   virtual int Readahead(int fd);
 
@@ -99,6 +100,7 @@ class ExternalCacheManager : public CacheManager {
   uint32_t max_object_size() const { return max_object_size_; }
   uint64_t capabilities() const { return capabilities_; }
   pid_t pid_plugin() const { return pid_plugin_; }
+  unsigned shm_slots() const { return shm_slots_; }
 
  protected:
   virtual void *DoSaveState();
@@ -120,6 +122,17 @@ class ExternalCacheManager : public CacheManager {
    * Statistically, at least half of our objects should not be further chunked.
    */
   static const unsigned kMinSupportedObjectSize = 4 * 1024;
+  /**
+   * Number of max_object_size slots of the shared memory area that is offered
+   * to plugins on local connections.  Requests that find all slots in use
+   * fall back to sending their payload through the socket.
+   */
+  static const unsigned kNumShmSlots = 16;
+  /**
+   * Reads larger than max_object_size_ are split in requests, of which up to
+   * kMaxReadsInFlight are sent before waiting for the replies.
+   */
+  static const unsigned kMaxReadsInFlight = 8;
 
   struct Transaction {
     explicit Transaction(const shash::Any &id)
@@ -273,6 +286,22 @@ class ExternalCacheManager : public CacheManager {
     Signal *signal;
   };
 
+  /**
+   * A read request of a pipelined Pread() or a PreadV().  The reply is copied
+   * into buf, which has room for size bytes.
+   */
+  struct ReadBatch : ::SingleCopy {
+    ReadBatch() : rpc_job(NULL), shm_slot(-1), buf(NULL), size(0) { }
+    ~ReadBatch() { delete rpc_job; }
+
+    cvmfs::MsgReadReq msg_read;
+    RpcJob *rpc_job;
+    Signal signal;
+    int shm_slot;
+    void *buf;
+    uint64_t size;
+  };
+
   static void *MainRead(void *data);
   static int ConnectLocator(const std::string &locator, bool print_error);
   static bool SpawnPlugin(const std::vector<std::string> &cmd_line);
@@ -280,16 +309,28 @@ class ExternalCacheManager : public CacheManager {
   explicit ExternalCacheManager(int fd_connection, unsigned max_open_fds);
   int64_t NextRequestId() { return atomic_xadd64(&next_request_id_, 1); }
   void CallRemotely(RpcJob *rpc_job);
+  void SendRemotely(RpcJob *rpc_job, Signal *signal);
+  void SendRead(ReadBatch *batch);
+  int64_t ReceiveRead(ReadBatch *batch);
   int ChangeRefcount(const shash::Any &id, int change_by);
   int DoOpen(const shash::Any &id);
   shash::Any GetHandle(int fd);
   int Flush(bool do_commit, Transaction *transaction);
+  int AcquireShmSlot();
+  void ReleaseShmSlot(int slot);
+  unsigned char *GetShmSlot(int slot) {
+    return shm_area_ + static_cast<uint64_t>(slot) * max_object_size_;
+  }
 
   pid_t pid_plugin_;
   FdTable<ReadOnlyHandle> fd_table_;
   CacheTransport transport_;
   int64_t session_id_;
   uint32_t max_object_size_;
+  /**
+   * The lower of the client's and the plugin's protocol version
+   */
+  uint32_t protocol_version_;
   bool spawned_;
   bool terminated_;
   pthread_rwlock_t rwlock_fd_table_;
@@ -303,6 +344,16 @@ class ExternalCacheManager : public CacheManager {
   pthread_mutex_t lock_inflight_rpcs_;
   pthread_t thread_read_;
   uint64_t capabilities_;
+
+  /**
+   * Shared memory data plane, only used if the plugin accepted the area
+   * during the handshake (shm_slots_ > 0)
+   */
+  unsigned char *shm_area_;
+  uint64_t shm_size_;
+  unsigned shm_slots_;
+  std::vector<int> shm_free_slots_;
+  pthread_mutex_t lock_shm_slots_;
 };  // class ExternalCacheManager
 
 
@@ -7,6 +7,7 @@
 #include <errno.h>
 #include <poll.h>
 #include <signal.h>
+#include <sys/mman.h>
 #include <sys/socket.h>
 #include <sys/un.h>
 #include <unistd.h>
@@ -148,6 +149,8 @@ void SessionCtx::Unset() {
 CachePlugin::SessionInfo::SessionInfo(uint64_t id, const std::string &name)
   : id(id)
   , name(name)
+  , shm_area(NULL)
+  , shm_slots(0)
 {
   vector<string> tokens = SplitString(name, ':');
   reponame = strdup(tokens[0].c_str());
@@ -250,8 +253,21 @@ void CachePlugin::HandleBreadcrumbLoad(
 }
 
 
+/**
+ * Returns NULL if the session has no shared memory area or if the slot number
+ * is out of range.
+ */
+unsigned char *CachePlugin::GetShmSlot(uint64_t session_id, uint32_t slot) {
+  map<uint64_t, SessionInfo>::const_iterator iter = sessions_.find(session_id);
+  if ((iter == sessions_.end()) || (slot >= iter->second.shm_slots))
+    return NULL;
+  return iter->second.shm_area + static_cast<uint64_t>(slot) * max_object_size_;
+}
+
+
 void CachePlugin::HandleHandshake(
   cvmfs::MsgHandshake *msg_req,
+  CacheTransport::Frame *frame,
   CacheTransport *transport)
 {
   uint64_t session_id = NextSessionId();
@@ -261,6 +277,17 @@ void CachePlugin::HandleHandshake(
     sessions_[session_id] = SessionInfo(session_id,
       "anonymous client (" + StringifyInt(session_id) + ")");
   }
+  if (frame->fd_passed() >= 0) {
+    if (msg_req->shm_slots() > 0) {
+      SessionInfo *session = &sessions_[session_id];
+      session->shm_area = CacheTransport::MapShmArea(frame->fd_passed(),
+        static_cast<uint64_t>(msg_req->shm_slots()) * max_object_size_);
+      if (session->shm_area != NULL)
+        session->shm_slots = msg_req->shm_slots();
+    }
+    // The mapping stays valid after closing the memfd
+    close(frame->fd_passed());
+  }
   cvmfs::MsgHandshakeAck msg_ack;
   CacheTransport::Frame frame_send(&msg_ack);
 
@@ -272,6 +299,8 @@ void CachePlugin::HandleHandshake(
   msg_ack.set_capabilities(capabilities_);
   if (is_local_)
     msg_ack.set_pid(getpid());
+  if (sessions_[session_id].shm_slots > 0)
+    msg_ack.set_shm_slots(sessions_[session_id].shm_slots);
   transport->SendFrame(&frame_send);
 }
 
@@ -416,26 +445,73 @@ void CachePlugin::HandleRead(
   msg_reply.set_req_id(msg_req->req_id());
   shash::Any object_id;
   bool retval = transport->ParseMsgHash(msg_req->object_id(), &object_id);
-  if (!retval || (msg_req->size() > max_object_size_)) {
+  // The ranges of a vectored read are sent back to back in a single payload
+  uint64_t total_size = msg_req->size();
+  for (int i = 0; i < msg_req->ranges_size(); ++i)
+    total_size += msg_req->ranges(i).size();
+  if (!retval || (total_size > max_object_size_)) {
     LogSessionError(msg_req->session_id(), cvmfs::STATUS_MALFORMED,
                     "malformed hash received from client");
     msg_reply.set_status(cvmfs::STATUS_MALFORMED);
     transport->SendFrame(&frame_send);
     return;
   }
-  unsigned size = msg_req->size();
+  unsigned char *shm_slot = NULL;
+  if (msg_req->has_shm_slot()) {
+    shm_slot = GetShmSlot(msg_req->session_id(), msg_req->shm_slot());
+    if (shm_slot == NULL) {
+      LogSessionError(msg_req->session_id(), cvmfs::STATUS_MALFORMED,
+                      "invalid shared memory slot received from client");
+      msg_reply.set_status(cvmfs::STATUS_MALFORMED);
+      transport->SendFrame(&frame_send);
+      return;
+    }
+  }
 #ifdef __APPLE__
-  unsigned char *buffer = reinterpret_cast<unsigned char *>(smalloc(size));
+  unsigned char *buffer =
+    reinterpret_cast<unsigned char *>(smalloc(total_size));
 #else
-  unsigned char buffer[size];
+  unsigned char buffer[total_size];
 #endif
-  cvmfs::EnumStatus status = Pread(object_id, msg_req->offset(), &size, buffer);
-  msg_reply.set_status(status);
-  if (status == cvmfs::STATUS_OK) {
-    frame_send.set_attachment(buffer, size);
+  // With a shared memory slot, the plugin reads directly into client memory
+  unsigned char *payload = (shm_slot != NULL) ? shm_slot : buffer;
+  uint32_t payload_size = 0;
+  unsigned size = msg_req->size();
+  cvmfs::EnumStatus status = Pread(object_id, msg_req->offset(), &size,
+                                   payload);
+  if (msg_req->ranges_size() == 0) {
+    msg_reply.set_status(status);
+    if (status == cvmfs::STATUS_OK) {
+      payload_size = size;
+    } else {
+      LogSessionError(msg_req->session_id(), status,
+                      "failed to read from object");
+    }
   } else {
-    LogSessionError(msg_req->session_id(), status,
-                    "failed to read from object");
+    // Vectored read, failures are reported per range
+    msg_reply.set_status(cvmfs::STATUS_OK);
+    cvmfs::MsgReadRangeResult *result = msg_reply.add_range_results();
+    result->set_status(status);
+    result->set_size((status == cvmfs::STATUS_OK) ? size : 0);
+    payload_size = result->size();
+    for (int i = 0; i < msg_req->ranges_size(); ++i) {
+      const cvmfs::MsgReadRange &range = msg_req->ranges(i);
+      shash::Any range_id;
+      size = range.size();
+      status = transport->ParseMsgHash(range.object_id(), &range_id)
+        ? Pread(range_id, range.offset(), &size, payload + payload_size)
+        : cvmfs::STATUS_MALFORMED;
+      result = msg_reply.add_range_results();
+      result->set_status(status);
+      result->set_size((status == cvmfs::STATUS_OK) ? size : 0);
+      payload_size += result->size();
+    }
+  }
+  if (msg_reply.status() == cvmfs::STATUS_OK) {
+    if (shm_slot != NULL)
+      msg_reply.set_shm_size(payload_size);
+    else
+      frame_send.set_attachment(buffer, payload_size);
   }
   transport->SendFrame(&frame_send);
 #ifdef __APPLE__
@@ -484,11 +560,17 @@ bool CachePlugin::HandleRequest(int fd_con) {
   }
 
   google::protobuf::MessageLite *msg_typed = frame_recv.GetMsgTyped();
+  // Only the handshake can carry a file descriptor (the shared memory area)
+  if ((frame_recv.fd_passed() >= 0) &&
+      (msg_typed->GetTypeName() != "cvmfs.MsgHandshake"))
+  {
+    close(frame_recv.fd_passed());
+  }
 
   if (msg_typed->GetTypeName() == "cvmfs.MsgHandshake") {
     cvmfs::MsgHandshake *msg_req =
       reinterpret_cast<cvmfs::MsgHandshake *>(msg_typed);
-    HandleHandshake(msg_req, &transport);
+    HandleHandshake(msg_req, &frame_recv, &transport);
   } else if (msg_typed->GetTypeName() == "cvmfs.MsgQuit") {
     cvmfs::MsgQuit *msg_req = reinterpret_cast<cvmfs::MsgQuit *>(msg_typed);
     map<uint64_t, SessionInfo>::const_iterator iter =
@@ -496,6 +578,11 @@ bool CachePlugin::HandleRequest(int fd_con) {
     if (iter != sessions_.end()) {
       free(iter->second.reponame);
       free(iter->second.client_instance);
+      if (iter->second.shm_area != NULL) {
+        munmap(iter->second.shm_area,
+               static_cast<uint64_t>(iter->second.shm_slots) *
+               max_object_size_);
+      }
     }
     sessions_.erase(msg_req->session_id());
     return false;
@@ -613,9 +700,17 @@ void CachePlugin::HandleStore(
   msg_reply.set_part_nr(msg_req->part_nr());
   shash::Any object_id;
   bool retval = transport->ParseMsgHash(msg_req->object_id(), &object_id);
+  unsigned char *payload = reinterpret_cast<unsigned char *>(
+    frame->attachment());
+  uint32_t payload_size = frame->att_size();
+  if (msg_req->has_shm_slot()) {
+    payload = GetShmSlot(msg_req->session_id(), msg_req->shm_slot());
+    payload_size = msg_req->shm_size();
+    retval = retval && (payload != NULL);
+  }
   if ( !retval ||
-       (frame->att_size() > max_object_size_) ||
-       ((frame->att_size() < max_object_size_) && !msg_req->last_part()) )
+       (payload_size > max_object_size_) ||
+       ((payload_size < max_object_size_) && !msg_req->last_part()) )
   {
     LogSessionError(msg_req->session_id(), cvmfs::STATUS_MALFORMED,
                     "malformed hash or bad object size received from client");
@@ -662,10 +757,8 @@ void CachePlugin::HandleStore(
   }
 
   // TODO(jblomer): check part number and send objects up in order
-  if (frame->att_size() > 0) {
-    status = WriteTxn(txn_id,
-                      reinterpret_cast<unsigned char *>(frame->attachment()),
-                      frame->att_size());
+  if (payload_size > 0) {
+    status = WriteTxn(txn_id, payload, payload_size);
     if (status != cvmfs::STATUS_OK) {
       LogSessionError(msg_req->session_id(), status, "failure writing object");
       msg_reply.set_status(status);
@@ -67,7 +67,7 @@ class SessionCtx : SingleCopy {
 
 class CachePlugin {
  public:
-  static const unsigned kPbProtocolVersion = 1;
+  static const unsigned kPbProtocolVersion = 2;
   static const uint64_t kSizeUnknown;
 
   struct ObjectInfo {
@@ -162,13 +162,21 @@ class CachePlugin {
    * closes.  They are created to be consumed by the cvmcache_get_session() API.
    */
   struct SessionInfo {
-    SessionInfo() : id(0), reponame(NULL), client_instance(NULL) { }
+    SessionInfo()
+      : id(0), reponame(NULL), client_instance(NULL), shm_area(NULL)
+      , shm_slots(0) { }
     SessionInfo(uint64_t id, const std::string &name);
 
     uint64_t id;
     std::string name;
     char *reponame;
     char *client_instance;
+    /**
+     * The shared memory area of local clients, shm_slots slots of
+     * max_object_size_ bytes each
+     */
+    unsigned char *shm_area;
+    uint32_t shm_slots;
   };
 
   /**
@@ -216,6 +224,7 @@ class CachePlugin {
 
   bool HandleRequest(int fd_con);
   void HandleHandshake(cvmfs::MsgHandshake *msg_req,
+                       CacheTransport::Frame *frame,
                        CacheTransport *transport);
   void HandleRefcount(cvmfs::MsgRefcountReq *msg_req,
                       CacheTransport *transport);
@@ -236,6 +245,7 @@ class CachePlugin {
   void HandleBreadcrumbLoad(cvmfs::MsgBreadcrumbLoadReq *msg_req,
                             CacheTransport *transport);
   void HandleIoctl(cvmfs::MsgIoctl *msg_req);
+  unsigned char *GetShmSlot(uint64_t session_id, uint32_t slot);
   void SendDetachRequests();
 
   void NotifySupervisor(char signal);
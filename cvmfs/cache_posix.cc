@@ -34,6 +34,7 @@
 #include <fcntl.h>
 #include <inttypes.h>
 #include <pthread.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #ifndef __APPLE__
@@ -440,6 +441,28 @@ int PosixCacheManager::Readahead(int fd) {
 }
 
 
+/**
+ * Objects in the cache directory are immutable, so the mapping remains
+ * consistent with the file descriptor it was created from.
+ */
+void *PosixCacheManager::Mmap(int fd, uint64_t size) {
+  if (size == 0)
+    return NULL;
+  void *mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (mapping == MAP_FAILED) {
+    LogCvmfs(kLogCache, kLogDebug, "failed to map fd %d (%d)", fd, errno);
+    return NULL;
+  }
+  return mapping;
+}
+
+
+void PosixCacheManager::Munmap(void *addr, uint64_t size) {
+  int retval = munmap(addr, size);
+  assert(retval == 0);
+}
+
+
 int PosixCacheManager::Reset(void *txn) {
   Transaction *transaction = reinterpret_cast<Transaction *>(txn);
   transaction->buf_pos = 0;
@@ -168,6 +168,32 @@ int64_t RamCacheManager::Pread(
 }
 
 
+int64_t RamCacheManager::PreadZeroCopy(
+  int fd,
+  uint64_t size,
+  uint64_t offset,
+  const void **data)
+{
+  ReadLockGuard guard(rwlock_);
+  ReadOnlyHandle generic_handle = fd_table_.GetHandle(fd);
+  if (generic_handle.handle == kInvalidHandle) {
+    LogCvmfs(kLogCache, kLogDebug, "bad fd %d on PreadZeroCopy", fd);
+    return -EBADF;
+  }
+  perf::Inc(counters_.n_pread);
+  return GetStore(generic_handle)->ReadZeroCopy(
+    generic_handle.handle, size, offset, data);
+}
+
+
+void RamCacheManager::ReleaseZeroCopy(int fd, const void *data) {
+  ReadLockGuard guard(rwlock_);
+  ReadOnlyHandle generic_handle = fd_table_.GetHandle(fd);
+  assert(generic_handle.handle != kInvalidHandle);
+  GetStore(generic_handle)->ReleaseZeroCopy(generic_handle.handle, data);
+}
+
+
 int RamCacheManager::Dup(int fd) {
   bool ok;
   int rc;
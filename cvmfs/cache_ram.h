@@ -149,6 +149,16 @@ class RamCacheManager : public CacheManager {
    */
   virtual int64_t Pread(int fd, void *buf, uint64_t size, uint64_t offset);
 
+  /**
+   * Zero-copy variant of Pread. The entry's memory stays in place until
+   * ReleaseZeroCopy(), see MemoryKvStore::ReadZeroCopy
+   * @returns The number of bytes available at *data
+   * @retval -EBADF @p fd is not valid
+   */
+  virtual int64_t PreadZeroCopy(int fd, uint64_t size, uint64_t offset,
+                                const void **data);
+  virtual void ReleaseZeroCopy(int fd, const void *data);
+
   /**
    * Duplicates the open file descriptor, allowing the original and the new one
    * to be used independently
@@ -47,8 +47,24 @@ class TieredCacheManager : public CacheManager {
   virtual int Close(int fd) {return upper_->Close(fd);}
   virtual int64_t Pread(int fd, void *buf, uint64_t size, uint64_t offset)
   { return upper_->Pread(fd, buf, size, offset); }
+  virtual int PreadV(ReadRange *ranges, unsigned nranges)
+  { return upper_->PreadV(ranges, nranges); }
   virtual int Dup(int fd) { return upper_->Dup(fd); }
   virtual int Readahead(int fd) { return upper_->Readahead(fd); }
+  virtual void *Mmap(int fd, uint64_t size) {
+    return upper_->Mmap(fd, size);
+  }
+  virtual void Munmap(void *addr, uint64_t size) {
+    upper_->Munmap(addr, size);
+  }
+  virtual int64_t PreadZeroCopy(int fd, uint64_t size, uint64_t offset,
+                                const void **data)
+  {
+    return upper_->PreadZeroCopy(fd, size, offset, data);
+  }
+  virtual void ReleaseZeroCopy(int fd, const void *data) {
+    upper_->ReleaseZeroCopy(fd, data);
+  }
 
   virtual uint32_t SizeOfTxn()
   { return upper_->SizeOfTxn() + lower_->SizeOfTxn(); }
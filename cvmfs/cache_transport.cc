@@ -6,7 +6,10 @@
 
 #include <alloca.h>
 #include <errno.h>
+#include <sys/mman.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include <cassert>
 #include <cstdlib>
@@ -15,6 +18,7 @@
 #include "crypto/hash.h"
 #include "util/exception.h"
 #include "util/logging.h"
+#include "util/platform.h"
 #include "util/posix.h"
 #include "util/smalloc.h"
 
@@ -55,6 +59,7 @@ CacheTransport::Frame::Frame()
   , msg_typed_(NULL)
   , attachment_(NULL)
   , att_size_(0)
+  , fd_passed_(-1)
   , is_wrapped_(false)
   , is_msg_out_of_band_(false)
 { }
@@ -65,6 +70,7 @@ CacheTransport::Frame::Frame(google::protobuf::MessageLite *m)
   , msg_typed_(m)
   , attachment_(NULL)
   , att_size_(0)
+  , fd_passed_(-1)
   , is_wrapped_(false)
   , is_msg_out_of_band_(false)
 { }
@@ -138,6 +144,7 @@ void CacheTransport::Frame::Release() {
 void CacheTransport::Frame::Reset(uint32_t original_att_size) {
   msg_typed_ = NULL;
   att_size_ = original_att_size;
+  fd_passed_ = -1;
   is_wrapped_ = false;
   is_msg_out_of_band_ = false;
   Release();
@@ -299,6 +306,23 @@ CacheTransport::CacheTransport(int fd_connection, uint32_t flags)
 }
 
 
+/**
+ * Creates the memfd that backs the shared memory data plane.  The file is
+ * sparse, so only slots that are actually used consume memory.  Returns -1 if
+ * the platform does not support it.
+ */
+int CacheTransport::CreateShmArea(uint64_t size) {
+  int fd = platform_memfd("cvmfs-cache-shm");
+  if (fd < 0)
+    return -1;
+  if (ftruncate(fd, size) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+
 void CacheTransport::FillMsgHash(
   const shash::Any &hash,
   cvmfs::MsgHash *msg_hash)
@@ -342,6 +366,24 @@ void CacheTransport::FillObjectType(
 }
 
 
+/**
+ * Maps the first size bytes of a shared memory area.  Fails if the file behind
+ * fd is smaller than that.
+ */
+unsigned char *CacheTransport::MapShmArea(int fd, uint64_t size) {
+  struct stat info;
+  if ((size == 0) || (fstat(fd, &info) != 0) ||
+      (static_cast<uint64_t>(info.st_size) < size))
+  {
+    return NULL;
+  }
+  void *area = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (area == MAP_FAILED)
+    return NULL;
+  return reinterpret_cast<unsigned char *>(area);
+}
+
+
 bool CacheTransport::ParseMsgHash(
   const cvmfs::MsgHash &msg_hash,
   shash::Any *hash)
@@ -390,10 +432,28 @@ bool CacheTransport::ParseObjectType(
 bool CacheTransport::RecvFrame(CacheTransport::Frame *frame) {
   uint32_t size;
   bool has_attachment;
-  bool retval = RecvHeader(&size, &has_attachment);
-  if (!retval)
+  int fd_passed = -1;
+  bool retval = RecvHeader(&size, &has_attachment, &fd_passed);
+  if (!retval) {
+    if (fd_passed >= 0) { close(fd_passed); }
     return false;
+  }
+  // Only a successfully received frame hands out the file descriptor
+  frame->set_fd_passed(fd_passed);
+  retval = RecvPayload(size, has_attachment, frame);
+  if (!retval && (fd_passed >= 0)) {
+    close(fd_passed);
+    frame->set_fd_passed(-1);
+  }
+  return retval;
+}
+
 
+bool CacheTransport::RecvPayload(
+  uint32_t size,
+  bool has_attachment,
+  CacheTransport::Frame *frame)
+{
   void *buffer;
   if (size <= kMaxStackAlloc)
     buffer = alloca(size);
@@ -424,7 +484,7 @@ bool CacheTransport::RecvFrame(CacheTransport::Frame *frame) {
   void *ptr_msg = has_attachment
     ? (reinterpret_cast<char *>(buffer) + kInnerHeaderSize)
     : buffer;
-  retval = frame->ParseMsgRpc(ptr_msg, msg_size);
+  bool retval = frame->ParseMsgRpc(ptr_msg, msg_size);
   if (!retval) {
     if (size > kMaxStackAlloc) { free(buffer); }
     return false;
@@ -448,11 +508,47 @@ bool CacheTransport::RecvFrame(CacheTransport::Frame *frame) {
 }
 
 
-bool CacheTransport::RecvHeader(uint32_t *size, bool *has_attachment) {
+/**
+ * A file descriptor passed by the peer arrives as ancillary data together with
+ * the first bytes of the header.
+ */
+bool CacheTransport::RecvHeader(
+  uint32_t *size,
+  bool *has_attachment,
+  int *fd_passed)
+{
   unsigned char header[kHeaderSize];
-  ssize_t nbytes = SafeRead(fd_connection_, header, kHeaderSize);
-  if ((nbytes < 0) || (static_cast<unsigned>(nbytes) != kHeaderSize))
+  struct iovec iov;
+  iov.iov_base = header;
+  iov.iov_len = kHeaderSize;
+  char control[CMSG_SPACE(sizeof(int))];
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+
+  ssize_t nbytes;
+  do {
+    nbytes = recvmsg(fd_connection_, &msg, 0);
+  } while ((nbytes < 0) && (errno == EINTR));
+  if (nbytes <= 0)
     return false;
+  for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL;
+       cmsg = CMSG_NXTHDR(&msg, cmsg))
+  {
+    if ((cmsg->cmsg_level == SOL_SOCKET) && (cmsg->cmsg_type == SCM_RIGHTS)) {
+      memcpy(fd_passed, CMSG_DATA(cmsg), sizeof(int));
+      break;
+    }
+  }
+  if (static_cast<unsigned>(nbytes) < kHeaderSize) {
+    const unsigned remaining = kHeaderSize - nbytes;
+    nbytes = SafeRead(fd_connection_, header + nbytes, remaining);
+    if ((nbytes < 0) || (static_cast<unsigned>(nbytes) != remaining))
+      return false;
+  }
   if ((header[0] & (~kFlagHasAttachment)) != kWireProtocolVersion)
     return false;
   *has_attachment = header[0] & kFlagHasAttachment;
@@ -465,7 +561,8 @@ void CacheTransport::SendData(
   void *message,
   uint32_t msg_size,
   void *attachment,
-  uint32_t att_size)
+  uint32_t att_size,
+  int fd_passed)
 {
   uint32_t total_size =
     msg_size + att_size + ((att_size > 0) ? kInnerHeaderSize : 0);
@@ -502,10 +599,13 @@ void CacheTransport::SendData(
     iov[1].iov_len = msg_size;
   }
   if (flags_ & kFlagSendNonBlocking) {
+    assert(fd_passed < 0);
     SendNonBlocking(iov, (att_size == 0) ? 2 : 4);
     return;
   }
-  bool retval = SafeWriteV(fd_connection_, iov, (att_size == 0) ? 2 : 4);
+  bool retval = (fd_passed < 0)
+    ? SafeWriteV(fd_connection_, iov, (att_size == 0) ? 2 : 4)
+    : SendWithFd(iov, (att_size == 0) ? 2 : 4, fd_passed);
 
   if (!retval && !(flags_ & kFlagSendIgnoreFailure)) {
     PANIC(kLogSyslogErr | kLogDebug,
@@ -513,6 +613,45 @@ void CacheTransport::SendData(
   }
 }
 
+/**
+ * Passes fd_passed as SCM_RIGHTS ancillary data along with the header, which
+ * is the first I/O vector.  Only works on unix domain sockets.
+ */
+bool CacheTransport::SendWithFd(
+  struct iovec *iov,
+  unsigned iovcnt,
+  int fd_passed)
+{
+  assert(iov[0].iov_len == kHeaderSize);
+  char control[CMSG_SPACE(sizeof(int))];
+  memset(control, 0, sizeof(control));
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+  struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+  memcpy(CMSG_DATA(cmsg), &fd_passed, sizeof(int));
+
+  ssize_t nbytes;
+  do {
+    nbytes = sendmsg(fd_connection_, &msg, 0);
+  } while ((nbytes < 0) && (errno == EINTR));
+  if (nbytes < 0)
+    return false;
+  if (static_cast<unsigned>(nbytes) < kHeaderSize) {
+    unsigned char *header = reinterpret_cast<unsigned char *>(iov[0].iov_base);
+    if (!SafeWrite(fd_connection_, header + nbytes, kHeaderSize - nbytes))
+      return false;
+  }
+  return SafeWriteV(fd_connection_, iov + 1, iovcnt - 1);
+}
+
+
 void CacheTransport::SendNonBlocking(struct iovec *iov, unsigned iovcnt) {
   assert(iovcnt > 0);
   unsigned total_size = 0;
@@ -549,7 +688,8 @@ void CacheTransport::SendFrame(CacheTransport::Frame *frame) {
 #endif
   bool retval = msg_rpc->SerializeToArray(buffer, size);
   assert(retval);
-  SendData(buffer, size, frame->attachment(), frame->att_size());
+  SendData(buffer, size, frame->attachment(), frame->att_size(),
+           frame->fd_passed());
 #ifdef __APPLE__
   free(buffer);
 #endif
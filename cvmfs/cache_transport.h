@@ -106,6 +106,12 @@ class CacheTransport {
       attachment_ = attachment;
       att_size_ = att_size;
     }
+    /**
+     * A file descriptor that travels along with the message (sender side) or
+     * that arrived with it (receiving end).  The frame does not take ownership.
+     */
+    int fd_passed() const { return fd_passed_; }
+    void set_fd_passed(int fd) { fd_passed_ = fd; }
 
     bool ParseMsgRpc(void *buffer, uint32_t size);
     cvmfs::MsgRpc *GetMsgRpc();
@@ -127,6 +133,7 @@ class CacheTransport {
     google::protobuf::MessageLite *msg_typed_;
     void *attachment_;
     uint32_t att_size_;
+    int fd_passed_;
     bool is_wrapped_;
     bool is_msg_out_of_band_;
   };  // class CacheTransport::Frame
@@ -146,6 +153,9 @@ class CacheTransport {
   bool ParseObjectType(cvmfs::EnumObjectType wire_type,
                        CacheManager::ObjectType *object_type);
 
+  static int CreateShmArea(uint64_t size);
+  static unsigned char *MapShmArea(int fd, uint64_t size);
+
   int fd_connection() const { return fd_connection_; }
 
  private:
@@ -154,9 +164,12 @@ class CacheTransport {
   void SendData(void *message,
                 uint32_t msg_size,
                 void *attachment = NULL,
-                uint32_t att_size = 0);
+                uint32_t att_size = 0,
+                int fd_passed = -1);
   void SendNonBlocking(struct iovec *iov, unsigned iovcnt);
-  bool RecvHeader(uint32_t *size, bool *has_attachment);
+  bool SendWithFd(struct iovec *iov, unsigned iovcnt, int fd_passed);
+  bool RecvHeader(uint32_t *size, bool *has_attachment, int *fd_passed);
+  bool RecvPayload(uint32_t size, bool has_attachment, Frame *frame);
 
   int fd_connection_;
   uint32_t flags_;
@@ -9,8 +9,10 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cstring>
 
 #include "catalog_mgr.h"
+#include "statistics.h"
 #include "util/concurrency.h"
 #include "util/logging.h"
 #include "util/platform.h"
@@ -78,6 +80,8 @@ Catalog::Catalog(const PathString &mountpoint,
   sql_all_chunks_ = NULL;
   sql_chunks_listing_ = NULL;
   sql_lookup_xattrs_ = NULL;
+  n_lookup_memo_hit_ = NULL;
+  n_lookup_memo_miss_ = NULL;
 }
 
 
@@ -306,18 +310,56 @@ bool Catalog::LookupEntry(const shash::Md5 &md5path, const bool expand_symlink,
   assert(IsInitialized());
 
   MutexLockGuard m(lock_);
+  LookupMemoEntry *memo = NULL;
+  if (expand_symlink && !lookup_memo_.empty()) {
+    uint32_t slot;
+    memcpy(&slot, md5path.digest + sizeof(slot), sizeof(slot));
+    memo = &lookup_memo_[slot % kLookupMemoSize];
+    if (memo->is_used && (memo->md5path == md5path)) {
+      perf::Inc(n_lookup_memo_hit_);
+      if (memo->found && (dirent != NULL))
+        *dirent = memo->dirent;
+      return memo->found;
+    }
+    perf::Inc(n_lookup_memo_miss_);
+  }
+
   sql_lookup_md5path_->BindPathHash(md5path);
   bool found = sql_lookup_md5path_->FetchRow();
-  if (found && (dirent != NULL)) {
-    *dirent = sql_lookup_md5path_->GetDirent(this, expand_symlink);
-    FixTransitionPoint(md5path, dirent);
+  if (found && ((dirent != NULL) || (memo != NULL))) {
+    DirectoryEntry result =
+      sql_lookup_md5path_->GetDirent(this, expand_symlink);
+    FixTransitionPoint(md5path, &result);
+    if (dirent != NULL)
+      *dirent = result;
+    if (memo != NULL)
+      memo->dirent = result;
   }
   sql_lookup_md5path_->Reset();
 
+  if (memo != NULL) {
+    memo->is_used = true;
+    memo->found = found;
+    memo->md5path = md5path;
+  }
   return found;
 }
 
 
+/**
+ * Puts a small memo of recent path lookups, including negative results, in
+ * front of the SQL lookup statement.  Only for catalogs that do not change,
+ * i.e. in the client.
+ */
+void Catalog::EnableLookupMemo(perf::Counter *n_hit, perf::Counter *n_miss) {
+  assert(!IsWritable());
+  MutexLockGuard m(lock_);
+  n_lookup_memo_hit_ = n_hit;
+  n_lookup_memo_miss_ = n_miss;
+  lookup_memo_.resize(kLookupMemoSize);
+}
+
+
 /**
  * Performs a lookup on this Catalog for a given MD5 path hash.
  * @param md5path the MD5 hash of the searched path
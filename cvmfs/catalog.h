@@ -24,6 +24,9 @@
 #include "uid_map.h"
 #include "xattr.h"
 
+namespace perf {
+class Counter;
+}
 namespace swissknife {
 class CommandMigrate;
 }
@@ -102,6 +105,10 @@ class Catalog : SingleCopy {
    * catalog refresh and we want to avoid thrashing that mountpoint.
    */
   static const uint64_t kDefaultTTL = 240;  /**< 4 minutes default TTL */
+  /**
+   * Number of slots of the lookup memo, see EnableLookupMemo()
+   */
+  static const unsigned kLookupMemoSize = 32;
 
   /**
    * Note: is_nested only has an effect if parent == NULL otherwise being
@@ -120,6 +127,7 @@ class Catalog : SingleCopy {
                                const bool          is_nested = false);
 
   bool OpenDatabase(const std::string &db_path);
+  void EnableLookupMemo(perf::Counter *n_hit, perf::Counter *n_miss);
 
   inline bool LookupPath(const PathString &path, DirectoryEntry *dirent) const {
     return LookupMd5Path(NormalizePath(path), dirent);
@@ -263,6 +271,17 @@ class Catalog : SingleCopy {
    */
   static const shash::Md5 kMd5PathEmpty;
 
+  /**
+   * A slot of the lookup memo.  Remembers positive and negative results.
+   */
+  struct LookupMemoEntry {
+    LookupMemoEntry() : is_used(false), found(false) { }
+    bool is_used;
+    bool found;
+    shash::Md5 md5path;
+    DirectoryEntry dirent;
+  };
+
   enum VomsAuthzStatus {
     kVomsUnknown,  // Not yet looked up
     kVomsNone,     // No voms_authz key in properties table
@@ -335,6 +354,15 @@ class Catalog : SingleCopy {
   SqlLookupXattrs             *sql_lookup_xattrs_;
 
   mutable HashVector        referenced_hashes_;
+
+  /**
+   * Direct-mapped memo of recent path lookups in front of sql_lookup_md5path_,
+   * empty unless enabled.  The catalog is immutable, so entries are valid for
+   * the lifetime of the object.  A catalog reload creates a new object.
+   */
+  mutable std::vector<LookupMemoEntry> lookup_memo_;
+  perf::Counter *n_lookup_memo_hit_;
+  perf::Counter *n_lookup_memo_miss_;
 };  // class Catalog
 
 }  // namespace catalog
@@ -72,6 +72,9 @@ struct Statistics {
   perf::Counter *n_listing;
   perf::Counter *n_nested_listing;
   perf::Counter *n_detach_siblings;
+  perf::Counter *n_prefetch;
+  perf::Counter *n_lookup_memo_hit;
+  perf::Counter *n_lookup_memo_miss;
 
   explicit Statistics(perf::Statistics *statistics) {
     n_lookup_inode = statistics->Register("catalog_mgr.n_lookup_inode",
@@ -89,6 +92,13 @@ struct Statistics {
         "Number of listings of nested catalogs");
     n_detach_siblings = statistics->Register("catalog_mgr.n_detach_siblings",
         "Number of times the CVMFS_CATALOG_WATERMARK was hit");
+    n_prefetch = statistics->Register("catalog_mgr.n_prefetch",
+        "Number of nested catalogs fetched outside the lock");
+    n_lookup_memo_hit = statistics->Register("catalog_mgr.n_lookup_memo_hit",
+        "Number of path lookups answered by the catalog lookup memos");
+    n_lookup_memo_miss = statistics->Register(
+        "catalog_mgr.n_lookup_memo_miss",
+        "Number of path lookups that missed the catalog lookup memos");
   }
 };
 
@@ -118,6 +128,8 @@ class AbstractCatalogManager : public SingleCopy {
  public:
   typedef std::vector<CatalogT*> CatalogList;
   typedef CatalogT catalog_t;
+  typedef typename CatalogT::NestedCatalog NestedCatalog;
+  typedef typename CatalogT::NestedCatalogList NestedCatalogList;
 
   static const inode_t kInodeOffset = 255;
   explicit AbstractCatalogManager(perf::Statistics *statistics);
@@ -230,6 +242,18 @@ class AbstractCatalogManager : public SingleCopy {
   virtual CatalogT* CreateCatalog(const PathString  &mountpoint,
                                   const shash::Any  &catalog_hash,
                                   CatalogT *parent_catalog) = 0;
+  /**
+   * Fetches a nested catalog ahead of mounting it and opens it as a free
+   * catalog, so that the hashes of its nested catalogs can be read.  Called
+   * without holding the lock, i.e. it must not change the state of the
+   * catalog manager.  The default implementation does not prefetch.
+   * @return a free catalog owned by the caller or NULL
+   */
+  virtual CatalogT* PrefetchCatalog(const PathString &mountpoint,
+                                    const shash::Any &hash)
+  {
+    return NULL;
+  }
 
   CatalogT *MountCatalog(const PathString &mountpoint, const shash::Any &hash,
                          CatalogT *parent_catalog);
@@ -237,6 +261,13 @@ class AbstractCatalogManager : public SingleCopy {
                     const CatalogT *entry_point,
                     bool can_listing,
                     CatalogT **leaf_catalog);
+  void PrefetchSubtree(const PathString &path,
+                       const CatalogT *entry_point,
+                       bool is_listable);
+  static const NestedCatalog *FindNestedOnPath(
+    const PathString &path,
+    const NestedCatalogList &nested_catalogs,
+    bool is_listable);
 
   CatalogT *LoadFreeCatalog(const PathString &mountpoint,
                             const shash::Any &hash);
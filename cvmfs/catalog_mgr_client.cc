@@ -72,7 +72,10 @@ Catalog *ClientCatalogManager::CreateCatalog(
 ) {
   mounted_catalogs_[mountpoint] = loaded_catalogs_[mountpoint];
   loaded_catalogs_.erase(mountpoint);
-  return new Catalog(mountpoint, catalog_hash, parent_catalog);
+  Catalog *catalog = new Catalog(mountpoint, catalog_hash, parent_catalog);
+  catalog->EnableLookupMemo(statistics().n_lookup_memo_hit,
+                            statistics().n_lookup_memo_miss);
+  return catalog;
 }
 
 
@@ -269,6 +272,39 @@ LoadError ClientCatalogManager::LoadCatalogCas(
 }
 
 
+/**
+ * Fetches the catalog into the cache without registering it as loaded.  The
+ * catalog is fetched as a regular object, so it is not left pinned if it is
+ * never mounted.  Mounting it later pins the cached copy.
+ */
+Catalog *ClientCatalogManager::PrefetchCatalog(
+  const PathString &mountpoint,
+  const shash::Any &hash)
+{
+  assert(hash.suffix == shash::kSuffixCatalog);
+  string name = "file catalog at " + repo_name_ + ":" +
+    string(mountpoint.GetChars(), mountpoint.GetLength()) +
+    " (" + hash.ToString() + ")";
+  int fd = fetcher_->Fetch(hash, CacheManager::kSizeUnknown, name,
+    zlib::kZlibDefault, CacheManager::kTypeRegular, "");
+  if (fd < 0) {
+    LogCvmfs(kLogCache, kLogDebug, "failed to prefetch %s (%d)",
+             name.c_str(), fd);
+    return NULL;
+  }
+  // The sqlite vfs takes over the file descriptor.  It closes it when the
+  // catalog is deleted or, if the catalog cannot be opened, on the failing
+  // open itself.
+  Catalog *catalog = Catalog::AttachFreely(mountpoint.ToString(),
+                                           "@" + StringifyInt(fd), hash);
+  if (catalog == NULL) {
+    LogCvmfs(kLogCache, kLogDebug,
+             "failed to open prefetched %s", name.c_str());
+  }
+  return catalog;
+}
+
+
 void ClientCatalogManager::UnloadCatalog(const Catalog *catalog) {
   LogCvmfs(kLogCache, kLogDebug, "unloading catalog %s",
            catalog->mountpoint().c_str());
@@ -14,6 +14,7 @@
 
 #include "backoff.h"
 #include "crypto/hash.h"
+#include "gtest/gtest_prod.h"
 #include "manifest_fetch.h"
 #include "shortstring.h"
 
@@ -49,6 +50,7 @@ namespace catalog {
 class ClientCatalogManager : public AbstractCatalogManager<Catalog> {
   // Maintains certificate hit/miss counters
   friend class CachedManifestEnsemble;
+  FRIEND_TEST(T_ClientCatalogManager, PrefetchCatalog);
 
  public:
   explicit ClientCatalogManager(MountPoint *mountpoint);
@@ -76,6 +78,8 @@ class ClientCatalogManager : public AbstractCatalogManager<Catalog> {
                                   const shash::Any  &catalog_hash,
                                   catalog::Catalog *parent_catalog);
   void ActivateCatalog(catalog::Catalog *catalog);
+  catalog::Catalog* PrefetchCatalog(const PathString &mountpoint,
+                                    const shash::Any &hash);
 
  private:
   LoadError LoadCatalogCas(const shash::Any &hash,
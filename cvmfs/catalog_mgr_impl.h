@@ -270,7 +270,7 @@ bool AbstractCatalogManager<CatalogT>::LookupPath(const PathString &path,
   if (!found && MountSubtree(path, best_fit, false /* is_listable */, NULL)) {
     LogCvmfs(kLogCatalog, kLogDebug, "looking up '%s' in a nested catalog",
              path.c_str());
-    Unlock();
+    PrefetchSubtree(path, best_fit, false /* is_listable */);
     WriteLock();
     // Check again to avoid race
     best_fit = FindCatalog(path);
@@ -371,7 +371,7 @@ bool AbstractCatalogManager<CatalogT>::LookupNested(
   CatalogT *best_fit = FindCatalog(catalog_path);
   CatalogT *catalog = best_fit;
   if (MountSubtree(catalog_path, best_fit, false /* is_listable */, NULL)) {
-    Unlock();
+    PrefetchSubtree(catalog_path, best_fit, false /* is_listable */);
     WriteLock();
     // Check again to avoid race
     best_fit = FindCatalog(catalog_path);
@@ -434,7 +434,7 @@ bool AbstractCatalogManager<CatalogT>::ListCatalogSkein(
   CatalogT *catalog = best_fit;
   // True if there is an available nested catalog
   if (MountSubtree(test, best_fit, false /* is_listable */, NULL)) {
-    Unlock();
+    PrefetchSubtree(test, best_fit, false /* is_listable */);
     WriteLock();
     // Check again to avoid race
     best_fit = FindCatalog(test);
@@ -490,7 +490,7 @@ bool AbstractCatalogManager<CatalogT>::LookupXattrs(
   CatalogT *best_fit = FindCatalog(path);
   CatalogT *catalog = best_fit;
   if (MountSubtree(path, best_fit, false /* is_listable */, NULL)) {
-    Unlock();
+    PrefetchSubtree(path, best_fit, false /* is_listable */);
     WriteLock();
     // Check again to avoid race
     best_fit = FindCatalog(path);
@@ -528,7 +528,7 @@ bool AbstractCatalogManager<CatalogT>::Listing(const PathString &path,
   CatalogT *best_fit = FindCatalog(path);
   CatalogT *catalog = best_fit;
   if (MountSubtree(path, best_fit, true /* is_listable */, NULL)) {
-    Unlock();
+    PrefetchSubtree(path, best_fit, true /* is_listable */);
     WriteLock();
     // Check again to avoid race
     best_fit = FindCatalog(path);
@@ -565,7 +565,7 @@ bool AbstractCatalogManager<CatalogT>::ListingStat(const PathString &path,
   CatalogT *best_fit = FindCatalog(path);
   CatalogT *catalog = best_fit;
   if (MountSubtree(path, best_fit, true /* is_listable */, NULL)) {
-    Unlock();
+    PrefetchSubtree(path, best_fit, true /* is_listable */);
     WriteLock();
     // Check again to avoid race
     best_fit = FindCatalog(path);
@@ -605,7 +605,7 @@ bool AbstractCatalogManager<CatalogT>::ListFileChunks(
   CatalogT *best_fit = FindCatalog(path);
   CatalogT *catalog = best_fit;
   if (MountSubtree(path, best_fit, false /* is_listable */, NULL)) {
-    Unlock();
+    PrefetchSubtree(path, best_fit, false /* is_listable */);
     WriteLock();
     // Check again to avoid race
     best_fit = FindCatalog(path);
@@ -641,7 +641,7 @@ catalog::Counters AbstractCatalogManager<CatalogT>::LookupCounters(
   CatalogT *best_fit = FindCatalog(catalog_path);
   CatalogT *catalog = best_fit;
   if (MountSubtree(catalog_path, best_fit, false /* is_listable */, NULL)) {
-    Unlock();
+    PrefetchSubtree(catalog_path, best_fit, false /* is_listable */);
     WriteLock();
     // Check again to avoid race
     best_fit = FindCatalog(catalog_path);
@@ -819,13 +819,47 @@ bool AbstractCatalogManager<CatalogT>::MountSubtree(
                      GetRootCatalog() : const_cast<CatalogT *>(entry_point);
   assert(path.StartsWith(parent->mountpoint()));
 
-  unsigned path_len = path.GetLength();
-
   // Try to find path as a super string of nested catalog mount points
   perf::Inc(statistics_.n_nested_listing);
-  typedef typename CatalogT::NestedCatalogList NestedCatalogList;
-  const NestedCatalogList& nested_catalogs =
-    parent->ListNestedCatalogs();
+  const NestedCatalog *nested =
+    FindNestedOnPath(path, parent->ListNestedCatalogs(), is_listable);
+  if (nested != NULL) {
+    if (leaf_catalog == NULL)
+      return true;
+    CatalogT *new_nested;
+    LogCvmfs(kLogCatalog, kLogDebug, "load nested catalog at %s",
+             nested->mountpoint.c_str());
+    // prevent endless recursion with corrupted catalogs
+    // (due to reloading root)
+    if (nested->hash.IsNull())
+      return false;
+    new_nested = MountCatalog(nested->mountpoint, nested->hash, parent);
+    if (!new_nested)
+      return false;
+
+    result = MountSubtree(path, new_nested, is_listable, &parent);
+  }
+
+  if (leaf_catalog == NULL)
+    return false;
+  *leaf_catalog = parent;
+  return result;
+}
+
+
+/**
+ * Finds the nested catalog that is the next step from the catalog with the
+ * given list of nested catalogs towards path.
+ * @return the nested catalog or NULL if path is in the catalog itself
+ */
+template <class CatalogT>
+const typename AbstractCatalogManager<CatalogT>::NestedCatalog *
+AbstractCatalogManager<CatalogT>::FindNestedOnPath(
+  const PathString &path,
+  const NestedCatalogList &nested_catalogs,
+  bool is_listable)
+{
+  unsigned path_len = path.GetLength();
   for (typename NestedCatalogList::const_iterator i = nested_catalogs.begin(),
        iEnd = nested_catalogs.end(); i != iEnd; ++i)
   {
@@ -840,30 +874,54 @@ bool AbstractCatalogManager<CatalogT>::MountSubtree(
 
       // Found a nested catalog transition point
       if (!is_listable && (path_len == mountpoint_len))
-        break;
+        return NULL;
 
-      if (leaf_catalog == NULL)
-        return true;
-      CatalogT *new_nested;
-      LogCvmfs(kLogCatalog, kLogDebug, "load nested catalog at %s",
-               i->mountpoint.c_str());
-      // prevent endless recursion with corrupted catalogs
-      // (due to reloading root)
-      if (i->hash.IsNull())
-        return false;
-      new_nested = MountCatalog(i->mountpoint, i->hash, parent);
-      if (!new_nested)
-        return false;
-
-      result = MountSubtree(path, new_nested, is_listable, &parent);
-      break;
+      return &(*i);
     }
   }
+  return NULL;
+}
 
-  if (leaf_catalog == NULL)
-    return false;
-  *leaf_catalog = parent;
-  return result;
+
+/**
+ * Called with the read lock held when path requires nested catalogs that are
+ * not yet mounted.  Releases the lock and fetches the missing nested catalogs
+ * on the way to path, so that the following MountSubtree() under the write
+ * lock finds them locally.  The hash of a nested catalog is only known from
+ * its parent, so the catalogs are fetched level by level and opened as free
+ * catalogs to read the next hash.  Other threads can use the catalog manager
+ * in the meantime.  Concurrent fetches of the same catalog are merged by the
+ * derived class (e.g. the fetcher of the client).
+ */
+template <class CatalogT>
+void AbstractCatalogManager<CatalogT>::PrefetchSubtree(
+  const PathString &path,
+  const CatalogT *entry_point,
+  bool is_listable)
+{
+  const NestedCatalog *next =
+    FindNestedOnPath(path, entry_point->ListNestedCatalogs(), is_listable);
+  if (next == NULL) {
+    Unlock();
+    return;
+  }
+  NestedCatalog nested = *next;
+  Unlock();
+
+  while (!nested.hash.IsNull()) {
+    CatalogT *catalog = PrefetchCatalog(nested.mountpoint, nested.hash);
+    if (catalog == NULL)
+      return;
+    perf::Inc(statistics_.n_prefetch);
+    LogCvmfs(kLogCatalog, kLogDebug, "prefetched nested catalog at %s",
+             nested.mountpoint.c_str());
+    next = FindNestedOnPath(path, catalog->ListNestedCatalogs(), is_listable);
+    if (next != NULL)
+      nested = *next;
+    delete catalog;
+    if (next == NULL)
+      return;
+  }
 }
 
 
@@ -21,6 +21,7 @@
 #include "upload.h"
 #include "util/exception.h"
 #include "util/logging.h"
+#include "util/platform.h"
 #include "util/posix.h"
 #include "util/smalloc.h"
 
@@ -49,6 +50,7 @@ WritableCatalogManager::WritableCatalogManager(
   , nested_kcatalog_limit_(nested_kcatalog_limit)
   , root_kcatalog_limit_(root_kcatalog_limit)
   , file_mbyte_limit_(file_mbyte_limit)
+  , has_zstd_files_(false)
   , is_balanceable_(is_balanceable)
   , max_weight_(max_weight)
   , min_weight_(min_weight)
@@ -543,6 +545,8 @@ void WritableCatalogManager::AddFile(
             file_path.c_str(), file_mbyte_limit_, mbytes);
   }
 
+  if (entry.compression_algorithm() == zlib::kZstdDefault)
+    has_zstd_files_ = true;
   catalog->AddEntry(entry, xattrs, file_path, parent_path);
   SyncUnlock();
 }
@@ -654,6 +658,8 @@ void WritableCatalogManager::AddHardlinkGroup(
     hardlink.set_linkcount(entries.size());
     hardlink.set_is_chunked_file(!file_chunks.IsEmpty());
 
+    if (hardlink.compression_algorithm() == zlib::kZstdDefault)
+      has_zstd_files_ = true;
     catalog->AddEntry(hardlink, xattrs, file_path, parent_path);
     if (hardlink.IsChunkedFile()) {
       for (unsigned i = 0; i < file_chunks.size(); ++i) {
@@ -1060,11 +1066,14 @@ bool WritableCatalogManager::Commit(const bool           stop_for_tweaks,
   }
 
   // do the actual catalog snapshotting and upload
+  const uint64_t start = platform_monotonic_time_ns();
   CatalogInfo root_catalog_info;
   if (getenv("_CVMFS_SERIALIZED_CATALOG_PROCESSING_") == NULL)
     root_catalog_info = SnapshotCatalogs(stop_for_tweaks);
   else
     root_catalog_info = SnapshotCatalogsSerialized(stop_for_tweaks);
+  LogCvmfs(kLogCatalog, kLogVerboseMsg, "catalog snapshot took %" PRIu64 " ms",
+           (platform_monotonic_time_ns() - start) / (1000 * 1000));
   if (spooler_->GetNumberOfErrors() > 0) {
     LogCvmfs(kLogCatalog, kLogStderr, "failed to commit catalogs");
     return false;
@@ -1079,6 +1088,8 @@ bool WritableCatalogManager::Commit(const bool           stop_for_tweaks,
   manifest->set_root_path("");
   manifest->set_ttl(root_catalog_info.ttl);
   manifest->set_revision(root_catalog_info.revision);
+  if (has_zstd_files_)
+    manifest->set_compression_algorithm(zlib::kZstdDefault);
 
   return true;
 }
@@ -1104,19 +1115,28 @@ bool WritableCatalogManager::Commit(const bool           stop_for_tweaks,
  *     --> done through a Future<> in WritableCatalogManager::SnapshotCatalogs
  *
  * Note: The catalog finalisation (see WritableCatalogManager::FinalizeCatalog)
- *       happens in a worker thread (i.e. the callback method) for non-leaf
- *       catalogs.
- *
- * TODO(rmeusel): since all leaf catalogs are finalized in the main thread, we
- *                sacrafice some potential concurrency for simplicity.
+ *       happens in a pool of TaskFinalizeCatalog workers for leaf and non-leaf
+ *       catalogs alike.  Independent subtrees are thus committed and vacuumed
+ *       concurrently while their siblings are compressed and uploaded; a parent
+ *       only waits for its own dirty children.  With stop_for_tweaks, a single
+ *       worker keeps the interactive prompts in order.
  */
 WritableCatalogManager::CatalogInfo WritableCatalogManager::SnapshotCatalogs(
                                                    const bool stop_for_tweaks) {
   // prepare environment for parallel processing
   Future<CatalogInfo>  root_catalog_info_future;
+  Tube<FinalizeJob>    tube_finalize;
   CatalogUploadContext upload_context;
   upload_context.root_catalog_info = &root_catalog_info_future;
-  upload_context.stop_for_tweaks   = stop_for_tweaks;
+  upload_context.tube_finalize     = &tube_finalize;
+
+  TubeConsumerGroup<FinalizeJob> tasks_finalize;
+  const unsigned num_tasks = stop_for_tweaks ? 1 : GetNumberOfCpuCores();
+  for (unsigned i = 0; i < num_tasks; ++i) {
+    tasks_finalize.TakeConsumer(
+      new TaskFinalizeCatalog(this, &tube_finalize, stop_for_tweaks));
+  }
+  tasks_finalize.Spawn();
 
   spooler_->RegisterListener(
     &WritableCatalogManager::CatalogUploadCallback, this, upload_context);
@@ -1130,8 +1150,7 @@ WritableCatalogManager::CatalogInfo WritableCatalogManager::SnapshotCatalogs(
         WritableCatalogList::const_iterator i    = leafs_to_snapshot.begin();
   const WritableCatalogList::const_iterator iend = leafs_to_snapshot.end();
   for (; i != iend; ++i) {
-    FinalizeCatalog(*i, stop_for_tweaks);
-    ScheduleCatalogProcessing(*i);
+    tube_finalize.EnqueueBack(new FinalizeJob(*i));
   }
 
   LogCvmfs(kLogCatalog, kLogVerboseMsg, "waiting for upload of catalogs");
@@ -1139,10 +1158,18 @@ WritableCatalogManager::CatalogInfo WritableCatalogManager::SnapshotCatalogs(
   spooler_->WaitForUpload();
 
   spooler_->UnregisterListeners();
+  tasks_finalize.Terminate();
   return root_catalog_info;
 }
 
 
+void TaskFinalizeCatalog::Process(WritableCatalogManager::FinalizeJob *job) {
+  catalog_mgr_->FinalizeCatalog(job->catalog, stop_for_tweaks_);
+  catalog_mgr_->ScheduleCatalogProcessing(job->catalog);
+  delete job;
+}
+
+
 void WritableCatalogManager::FinalizeCatalog(WritableCatalog *catalog,
                                              const bool stop_for_tweaks) {
   // update meta information of this catalog
@@ -1266,8 +1293,8 @@ void WritableCatalogManager::CatalogUploadCallback(
     // continuation of the dirty catalog tree traversal
     // see WritableCatalogManager::SnapshotCatalogs()
     if (remaining_dirty_children == 0) {
-      FinalizeCatalog(parent, catalog_upload_context.stop_for_tweaks);
-      ScheduleCatalogProcessing(parent);
+      catalog_upload_context.tube_finalize->EnqueueBack(
+        new FinalizeJob(parent));
     }
 
   } else if (catalog->IsRoot()) {
@@ -1411,7 +1438,7 @@ WritableCatalogManager::SnapshotCatalogsSerialized(
   GetModifiedCatalogs(&catalogs_to_snapshot);
   CatalogUploadContext unused;
   unused.root_catalog_info = NULL;
-  unused.stop_for_tweaks = false;
+  unused.tube_finalize = NULL;
   spooler_->RegisterListener(
     &WritableCatalogManager::CatalogUploadSerializedCallback, this, unused);
 
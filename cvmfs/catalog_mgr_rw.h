@@ -39,6 +39,8 @@
 #include "catalog_mgr_ro.h"
 #include "catalog_rw.h"
 #include "file_chunk.h"
+#include "ingestion/task.h"
+#include "ingestion/tube.h"
 #include "upload_spooler_result.h"
 #include "util/concurrency.h"
 #include "xattr.h"
@@ -184,9 +186,21 @@ class WritableCatalogManager : public SimpleCatalogManager {
     unsigned int revision;
   };
 
+  /**
+   * A dirty catalog whose dirty children are all uploaded.  It can be
+   * finalized independently of any other pending catalog.
+   */
+  struct FinalizeJob {
+    explicit FinalizeJob(WritableCatalog *c) : catalog(c) { }
+    static FinalizeJob *CreateQuitBeacon() { return new FinalizeJob(NULL); }
+    bool IsQuitBeacon() { return catalog == NULL; }
+
+    WritableCatalog *catalog;
+  };
+
   struct CatalogUploadContext {
     Future<CatalogInfo>* root_catalog_info;
-    bool                 stop_for_tweaks;
+    Tube<FinalizeJob>*   tube_finalize;
   };
 
   CatalogInfo SnapshotCatalogs(const bool stop_for_tweaks);
@@ -206,6 +220,8 @@ class WritableCatalogManager : public SimpleCatalogManager {
                              const CatalogUploadContext   clg_upload_context);
 
  private:
+  friend class TaskFinalizeCatalog;
+
   inline void SyncLock() { pthread_mutex_lock(sync_lock_); }
   inline void SyncUnlock() { pthread_mutex_unlock(sync_lock_); }
 
@@ -240,6 +256,13 @@ class WritableCatalogManager : public SimpleCatalogManager {
   unsigned root_kcatalog_limit_;
   unsigned file_mbyte_limit_;
 
+  /**
+   * Set once a zstd compressed file is added.  Commit() then announces the
+   * algorithm in the manifest, so that clients that cannot decompress the
+   * data refuse the repository instead of serving compressed bytes.
+   */
+  bool has_zstd_files_;
+
   /**
    * Directories don't have extended attributes at this point.
    */
@@ -275,6 +298,31 @@ class WritableCatalogManager : public SimpleCatalogManager {
   const unsigned balance_weight_;
 };  // class WritableCatalogManager
 
+
+/**
+ * Finalizes catalogs on behalf of WritableCatalogManager::SnapshotCatalogs()
+ * and hands them over to the spooler for compression and upload.
+ */
+class TaskFinalizeCatalog
+  : public TubeConsumer<WritableCatalogManager::FinalizeJob>
+{
+ public:
+  TaskFinalizeCatalog(WritableCatalogManager *catalog_mgr,
+                      Tube<WritableCatalogManager::FinalizeJob> *tube,
+                      const bool stop_for_tweaks)
+    : TubeConsumer<WritableCatalogManager::FinalizeJob>(tube)
+    , catalog_mgr_(catalog_mgr)
+    , stop_for_tweaks_(stop_for_tweaks)
+  { }
+
+ protected:
+  virtual void Process(WritableCatalogManager::FinalizeJob *job);
+
+ private:
+  WritableCatalogManager *catalog_mgr_;
+  bool stop_for_tweaks_;
+};
+
 }  // namespace catalog
 
 #endif  // CVMFS_CATALOG_MGR_RW_H_
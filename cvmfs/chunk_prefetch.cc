@@ -0,0 +1,227 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#include "cvmfs_config.h"
+#include "chunk_prefetch.h"
+
+#include <algorithm>
+#include <cassert>
+
+#include "clientctx.h"
+#include "fetch.h"
+#include "quota.h"
+#include "util/concurrency.h"
+#include "util/logging.h"
+#include "util/platform.h"
+
+using namespace std;  // NOLINT
+
+namespace cvmfs {
+
+ChunkPrefetcher::ChunkPrefetcher(
+  const unsigned num_chunks,
+  const unsigned num_threads,
+  perf::StatisticsTemplate statistics)
+  : num_chunks_(num_chunks)
+  , num_threads_(num_threads)
+  , spawned_(false)
+  , terminate_(false)
+  , timestamp_pressure_check_(0)
+{
+  if (num_chunks_ > kMaxNumChunks)
+    num_chunks_ = kMaxNumChunks;
+  if (num_threads_ == 0)
+    num_threads_ = 1;
+  atomic_init32(&under_pressure_);
+  int retval = pthread_mutex_init(&lock_, NULL);
+  assert(retval == 0);
+  retval = pthread_cond_init(&cond_job_, NULL);
+  assert(retval == 0);
+
+  n_scheduled_ = statistics.RegisterTemplated("n_scheduled",
+    "Number of chunks scheduled for prefetching");
+  n_fetched_ = statistics.RegisterTemplated("n_fetched",
+    "Number of prefetched chunks");
+  n_failed_ = statistics.RegisterTemplated("n_failed",
+    "Number of chunks that failed to prefetch");
+  n_dropped_ = statistics.RegisterTemplated("n_dropped",
+    "Number of chunks not prefetched due to a full queue");
+  n_skipped_pressure_ = statistics.RegisterTemplated("n_skipped_pressure",
+    "Number of chunks not prefetched due to cache pressure");
+}
+
+
+ChunkPrefetcher::~ChunkPrefetcher() {
+  if (spawned_) {
+    {
+      MutexLockGuard m(&lock_);
+      terminate_ = true;
+      pthread_cond_broadcast(&cond_job_);
+    }
+    for (unsigned i = 0; i < threads_.size(); ++i)
+      pthread_join(threads_[i], NULL);
+  }
+  pthread_cond_destroy(&cond_job_);
+  pthread_mutex_destroy(&lock_);
+}
+
+
+void ChunkPrefetcher::Spawn() {
+  assert(!spawned_);
+  threads_.resize(num_threads_);
+  for (unsigned i = 0; i < num_threads_; ++i) {
+    int retval = pthread_create(&threads_[i], NULL, MainPrefetch, this);
+    assert(retval == 0);
+  }
+  spawned_ = true;
+}
+
+
+/**
+ * Queues the chunks following chunk_idx for download.  Called from the read
+ * path when a chunked file is read sequentially, i.e. when chunk_idx is the
+ * first chunk or the successor of the previously read chunk.  Must not block.
+ */
+void ChunkPrefetcher::Prefetch(
+  Fetcher *fetcher,
+  const FileChunkReflist &chunks,
+  const unsigned chunk_idx,
+  const CacheManager::ObjectType object_type)
+{
+  if (!spawned_ || (num_chunks_ == 0))
+    return;
+  const unsigned first_idx = chunk_idx + 1;
+  if (first_idx >= chunks.list->size())
+    return;
+  const unsigned last_idx = std::min(
+    first_idx + num_chunks_, static_cast<unsigned>(chunks.list->size()));
+  Job job;
+  job.fetcher = fetcher;
+  job.path = chunks.path.ToString();
+  job.compression_alg = chunks.compression_alg;
+  job.object_type = object_type;
+  job.external_data = chunks.external_data;
+  ClientCtx *ctx = ClientCtx::GetInstance();
+  if (ctx->IsSet()) {
+    InterruptCue *ic;
+    ctx->Get(&job.uid, &job.gid, &job.pid, &ic);
+  }
+
+  MutexLockGuard m(&lock_);
+  for (unsigned i = first_idx; i < last_idx; ++i) {
+    const FileChunk *chunk = chunks.list->AtPtr(i);
+    if (inflight_.count(chunk->content_hash()) > 0)
+      continue;
+    if (queue_.size() >= kMaxQueueLength) {
+      perf::Xadd(n_dropped_, last_idx - i);
+      break;
+    }
+    job.hash = chunk->content_hash();
+    job.size = chunk->size();
+    job.offset = chunk->offset();
+    queue_.push_back(job);
+    inflight_.insert(job.hash);
+    perf::Inc(n_scheduled_);
+  }
+  // Several jobs may have been queued, wake up all idle workers
+  pthread_cond_broadcast(&cond_job_);
+}
+
+
+/**
+ * The result of the check is cached for kPressureCheckIntervalSec because the
+ * quota manager needs to be asked through its command pipe.
+ */
+bool ChunkPrefetcher::IsCacheUnderPressure(CacheManager *cache_mgr) {
+  const uint64_t now = platform_monotonic_time();
+  {
+    MutexLockGuard m(&lock_);
+    if ((timestamp_pressure_check_ > 0) &&
+        (now < timestamp_pressure_check_ + kPressureCheckIntervalSec))
+    {
+      return atomic_read32(&under_pressure_);
+    }
+    timestamp_pressure_check_ = now;
+  }
+
+  bool under_pressure = false;
+  QuotaManager *quota_mgr = cache_mgr->quota_mgr();
+  if (quota_mgr->HasCapability(QuotaManager::kCapIntrospectCleanupRate)) {
+    if (quota_mgr->GetCleanupRate(kPressureCleanupPeriodSec) > 0)
+      under_pressure = true;
+  }
+  if (!under_pressure &&
+      quota_mgr->HasCapability(QuotaManager::kCapIntrospectSize))
+  {
+    // Pinned objects cannot be evicted to make room for prefetched chunks
+    const uint64_t capacity = quota_mgr->GetCapacity();
+    if ((capacity > 0) && (quota_mgr->GetSizePinned() > capacity / 2))
+      under_pressure = true;
+  }
+
+  if (under_pressure != static_cast<bool>(atomic_read32(&under_pressure_))) {
+    LogCvmfs(kLogCvmfs, kLogDebug, "%s chunk prefetching (cache pressure)",
+             under_pressure ? "pausing" : "resuming");
+  }
+  atomic_write32(&under_pressure_, under_pressure ? 1 : 0);
+  return under_pressure;
+}
+
+
+void ChunkPrefetcher::FetchChunk(const Job &job) {
+  if (IsCacheUnderPressure(job.fetcher->cache_mgr())) {
+    perf::Inc(n_skipped_pressure_);
+    return;
+  }
+
+  // Needed for the authz helper and for the access logs
+  ClientCtxGuard ctx_guard(job.uid, job.gid, job.pid, NULL);
+  const string verbose_path = "Part of " + job.path;
+  int fd;
+  if (job.external_data) {
+    fd = job.fetcher->Fetch(job.hash, job.size, verbose_path,
+                            job.compression_alg, job.object_type,
+                            job.path, job.offset);
+  } else {
+    fd = job.fetcher->Fetch(job.hash, job.size, verbose_path,
+                            job.compression_alg, job.object_type);
+  }
+  if (fd < 0) {
+    perf::Inc(n_failed_);
+    LogCvmfs(kLogCvmfs, kLogDebug, "failed to prefetch chunk %s of %s (%d)",
+             job.hash.ToString().c_str(), job.path.c_str(), fd);
+    return;
+  }
+  job.fetcher->cache_mgr()->Close(fd);
+  perf::Inc(n_fetched_);
+}
+
+
+void *ChunkPrefetcher::MainPrefetch(void *data) {
+  ChunkPrefetcher *prefetcher = static_cast<ChunkPrefetcher *>(data);
+  LogCvmfs(kLogCvmfs, kLogDebug, "starting chunk prefetch thread");
+
+  while (true) {
+    Job job;
+    {
+      MutexLockGuard m(&prefetcher->lock_);
+      while (prefetcher->queue_.empty() && !prefetcher->terminate_)
+        pthread_cond_wait(&prefetcher->cond_job_, &prefetcher->lock_);
+      if (prefetcher->terminate_)
+        break;
+      job = prefetcher->queue_.front();
+      prefetcher->queue_.pop_front();
+    }
+
+    prefetcher->FetchChunk(job);
+
+    MutexLockGuard m(&prefetcher->lock_);
+    prefetcher->inflight_.erase(job.hash);
+  }
+
+  LogCvmfs(kLogCvmfs, kLogDebug, "stopping chunk prefetch thread");
+  return NULL;
+}
+
+}  // namespace cvmfs
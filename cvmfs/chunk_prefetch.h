@@ -0,0 +1,124 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#ifndef CVMFS_CHUNK_PREFETCH_H_
+#define CVMFS_CHUNK_PREFETCH_H_
+
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <deque>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "cache.h"
+#include "compression.h"
+#include "crypto/hash.h"
+#include "file_chunk.h"
+#include "statistics.h"
+#include "util/atomic.h"
+#include "util/single_copy.h"
+
+namespace cvmfs {
+
+class Fetcher;
+
+/**
+ * Fetches the next chunks of a chunked file in the background while the file
+ * is read sequentially.  The chunks are downloaded through the Fetcher, so that
+ * a read() that arrives at a chunk that is still being prefetched waits for the
+ * running download instead of starting another one.
+ *
+ * Prefetching is best effort: jobs are dropped if the queue is full and
+ * prefetching pauses as long as the cache is under pressure, i.e. if the
+ * cache manager had to clean up recently or if pinned objects take up a large
+ * fraction of the cache.
+ */
+class ChunkPrefetcher : SingleCopy {
+ public:
+  static const unsigned kDefaultNumThreads = 4;
+  static const unsigned kMaxNumChunks = 64;
+  static const unsigned kMaxQueueLength = 512;
+  /**
+   * How often the prefetcher asks the quota manager about the cache state
+   */
+  static const unsigned kPressureCheckIntervalSec = 10;
+  /**
+   * A cache cleanup within this period of time pauses prefetching
+   */
+  static const unsigned kPressureCleanupPeriodSec = 60;
+
+  ChunkPrefetcher(const unsigned num_chunks,
+                  const unsigned num_threads,
+                  perf::StatisticsTemplate statistics);
+  ~ChunkPrefetcher();
+  void Spawn();
+  void Prefetch(Fetcher *fetcher,
+                const FileChunkReflist &chunks,
+                const unsigned chunk_idx,
+                const CacheManager::ObjectType object_type);
+  bool IsCacheUnderPressure(CacheManager *cache_mgr);
+
+  unsigned num_chunks() const { return num_chunks_; }
+
+ private:
+  struct Job {
+    Job()
+      : fetcher(NULL)
+      , size(0)
+      , offset(0)
+      , compression_alg(zlib::kZlibDefault)
+      , object_type(CacheManager::kTypeRegular)
+      , external_data(false)
+      , uid(-1)
+      , gid(-1)
+      , pid(-1)
+    { }
+    Fetcher *fetcher;
+    shash::Any hash;
+    uint64_t size;
+    off_t offset;
+    std::string path;
+    zlib::Algorithms compression_alg;
+    CacheManager::ObjectType object_type;
+    bool external_data;
+    uid_t uid;
+    gid_t gid;
+    pid_t pid;
+  };
+
+  static void *MainPrefetch(void *data);
+  void FetchChunk(const Job &job);
+
+  unsigned num_chunks_;
+  unsigned num_threads_;
+  bool spawned_;
+  bool terminate_;
+  std::vector<pthread_t> threads_;
+  /**
+   * Protects queue_, inflight_, terminate_, and the pressure check timestamp
+   */
+  pthread_mutex_t lock_;
+  pthread_cond_t cond_job_;
+  std::deque<Job> queue_;
+  /**
+   * Chunks that are queued or being downloaded by a prefetch thread
+   */
+  std::set<shash::Any> inflight_;
+  uint64_t timestamp_pressure_check_;
+  atomic_int32 under_pressure_;
+
+  perf::Counter *n_scheduled_;
+  perf::Counter *n_fetched_;
+  perf::Counter *n_failed_;
+  perf::Counter *n_dropped_;
+  perf::Counter *n_skipped_pressure_;
+};
+
+}  // namespace cvmfs
+
+#endif  // CVMFS_CHUNK_PREFETCH_H_
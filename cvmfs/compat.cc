@@ -168,6 +168,38 @@ void Migrate(InodeTracker *old_tracker, glue::InodeTracker *new_tracker) {
 //------------------------------------------------------------------------------
 
 
+namespace inode_tracker_v4 {
+
+void Migrate(InodeTracker *old_tracker, glue::InodeTracker *new_tracker) {
+  old_tracker->inode_ex_map_.map_.SetHasher(glue::hasher_inode_ex);
+  old_tracker->inode_references_.map_.SetHasher(glue::hasher_inode);
+  old_tracker->path_map_.map_.SetHasher(glue::hasher_md5);
+  old_tracker->path_map_.path_store_.map_.SetHasher(glue::hasher_md5);
+
+  // Iterate the inode map rather than the references to keep the file types
+  SmallHashDynamic<glue::InodeEx, shash::Md5> *old_inodes =
+    &old_tracker->inode_ex_map_.map_;
+  for (unsigned i = 0; i < old_inodes->capacity(); ++i) {
+    glue::InodeEx inode_ex = old_inodes->keys()[i];
+    if (inode_ex.GetInode() == 0) continue;
+
+    uint32_t references = 0;
+    bool retval = old_tracker->inode_references_.map_.Lookup(
+      inode_ex.GetInode(), &references);
+    assert(retval);
+    PathString path;
+    retval = old_tracker->FindPath(&inode_ex, &path);
+    assert(retval);
+    new_tracker->VfsGetBy(inode_ex, references, path);
+  }
+}
+
+}  // namespace inode_tracker_v4
+
+
+//------------------------------------------------------------------------------
+
+
 namespace chunk_tables {
 
 ChunkTables::~ChunkTables() {
@@ -835,6 +835,231 @@ void Migrate(InodeTracker *old_tracker, glue::InodeTracker *new_tracker);
 //------------------------------------------------------------------------------
 
 
+namespace inode_tracker_v4 {
+
+class StringRef {
+ public:
+  StringRef() { length_ = NULL; }
+  uint16_t length() const { return *length_; }
+  uint16_t size() const { return sizeof(uint16_t) + *length_; }
+  static uint16_t size(const uint16_t length) {
+    return sizeof(uint16_t) + length;
+  }
+  char *data() const { return reinterpret_cast<char *>(length_ + 1); }
+  static StringRef Place(const uint16_t length, const char *str,
+                         void *addr)
+  {
+    assert(false);
+  }
+ private:
+  uint16_t *length_;
+};
+
+class StringHeap : public SingleCopy {
+ public:
+  StringHeap() { assert(false); }
+  explicit StringHeap(const uint32_t minimum_size) { assert(false); }
+  void Init(const uint32_t minimum_size) { assert(false); }
+
+  ~StringHeap() {
+    for (unsigned i = 0; i < bins_.size(); ++i) {
+      smunmap(bins_.At(i));
+    }
+  }
+
+  StringRef AddString(const uint16_t length, const char *str) {
+    assert(false);
+  }
+  void RemoveString(const StringRef str_ref) { assert(false); }
+  double GetUsage() const { assert(false); }
+  uint64_t used() const { assert(false); }
+
+ private:
+  void AddBin(const uint64_t size) { assert(false); }
+
+  uint64_t size_;
+  uint64_t used_;
+  uint64_t bin_size_;
+  uint64_t bin_used_;
+  BigVector<void *> bins_;
+};
+
+
+class PathStore {
+ public:
+  PathStore() { assert(false); }
+  ~PathStore() {
+    delete string_heap_;
+  }
+  explicit PathStore(const PathStore &other) { assert(false); }
+  PathStore &operator= (const PathStore &other) { assert(false); }
+
+  void Insert(const shash::Md5 &md5path, const PathString &path) {
+    assert(false);
+  }
+
+  bool Lookup(const shash::Md5 &md5path, PathString *path) {
+    PathInfo info;
+    bool retval = map_.Lookup(md5path, &info);
+    if (!retval)
+      return false;
+
+    if (info.parent.IsNull())
+      return true;
+
+    retval = Lookup(info.parent, path);
+    assert(retval);
+    path->Append("/", 1);
+    path->Append(info.name.data(), info.name.length());
+    return true;
+  }
+
+  void Erase(const shash::Md5 &md5path) { assert(false); }
+  void Clear() { assert(false); }
+
+// private:
+  struct PathInfo {
+    PathInfo() {
+      refcnt = 1;
+    }
+    shash::Md5 parent;
+    uint32_t refcnt;
+    StringRef name;
+  };
+  void CopyFrom(const PathStore &other) { assert(false); }
+  SmallHashDynamic<shash::Md5, PathInfo> map_;
+  StringHeap *string_heap_;
+};
+
+
+class PathMap {
+ public:
+  PathMap() {
+    assert(false);
+  }
+  bool LookupPath(const shash::Md5 &md5path, PathString *path) {
+    bool found = path_store_.Lookup(md5path, path);
+    return found;
+  }
+  uint64_t LookupInodeByPath(const PathString &path) { assert(false); }
+  shash::Md5 Insert(const PathString &path, const uint64_t inode) {
+    assert(false);
+  }
+  void Erase(const shash::Md5 &md5path) {
+    assert(false);
+  }
+  void Clear() { assert(false); }
+ public:
+  SmallHashDynamic<shash::Md5, uint64_t> map_;
+  PathStore path_store_;
+};
+
+class InodeExMap {
+ public:
+  InodeExMap() {
+    assert(false);
+  }
+  bool LookupMd5Path(glue::InodeEx *inode_ex, shash::Md5 *md5path) {
+    bool found = map_.LookupEx(inode_ex, md5path);
+    return found;
+  }
+  void Insert(const glue::InodeEx inode_ex, const shash::Md5 &md5path) {
+    assert(false);
+  }
+  void Erase(const uint64_t inode) {
+    assert(false);
+  }
+  void Clear() { assert(false); }
+// private:
+  SmallHashDynamic<glue::InodeEx, shash::Md5> map_;
+};
+
+
+class InodeReferences {
+ public:
+  InodeReferences() {
+    assert(false);
+  }
+  bool Get(const uint64_t inode, const uint32_t by) {
+    assert(false);
+  }
+  bool Put(const uint64_t inode, const uint32_t by) {
+    assert(false);
+  }
+  void Clear() { assert(false); }
+// private:
+  SmallHashDynamic<uint64_t, uint32_t> map_;
+};
+
+class InodeTracker {
+ public:
+  struct Statistics {
+    Statistics() { assert(false); }
+    std::string Print() { assert(false); }
+    atomic_int64 num_inserts;
+    atomic_int64 num_removes;
+    atomic_int64 num_references;
+    atomic_int64 num_hits_inode;
+    atomic_int64 num_hits_path;
+    atomic_int64 num_misses_path;
+  };
+  Statistics GetStatistics() { assert(false); }
+
+  InodeTracker() { assert(false); }
+  explicit InodeTracker(const InodeTracker &other) { assert(false); }
+  InodeTracker &operator= (const InodeTracker &other) { assert(false); }
+  ~InodeTracker() {
+    pthread_mutex_destroy(lock_);
+    free(lock_);
+  }
+  void VfsGetBy(const glue::InodeEx inode_ex, const uint32_t by,
+                const PathString &path)
+  {
+    assert(false);
+  }
+  void VfsGet(const glue::InodeEx inode_ex, const PathString &path) {
+    assert(false);
+  }
+  bool FindPath(glue::InodeEx *inode_ex, PathString *path) {
+    // Lock();
+    shash::Md5 md5path;
+    bool found = inode_ex_map_.LookupMd5Path(inode_ex, &md5path);
+    if (found) {
+      found = path_map_.LookupPath(md5path, path);
+      assert(found);
+    }
+    // Unlock();
+    return found;
+  }
+
+  uint64_t FindInode(const PathString &path) {
+    assert(false);
+  }
+
+// private:
+  static const unsigned kVersion = 4;
+
+  void InitLock() { assert(false); }
+  void CopyFrom(const InodeTracker &other) { assert(false); }
+  inline void Lock() const { assert(false); }
+  inline void Unlock() const { assert(false); }
+
+  unsigned version_;
+  pthread_mutex_t *lock_;
+  PathMap path_map_;
+  InodeExMap inode_ex_map_;
+  InodeReferences inode_references_;
+  Statistics statistics_;
+};
+
+void Migrate(InodeTracker *old_tracker, glue::InodeTracker *new_tracker);
+
+}  // namespace inode_tracker_v4
+
+
+//------------------------------------------------------------------------------
+
+
 namespace chunk_tables {
 
 class FileChunk {
@@ -1,7 +1,7 @@
 /**
  * This file is part of the CernVM File System.
  *
- * This is a wrapper around zlib.  It provides
+ * This is a wrapper around zlib and zstd.  It provides
  * a set of functions to conveniently compress and decompress stuff.
  * Allmost all of the functions return true on success, otherwise false.
  *
@@ -14,6 +14,7 @@
 #include <alloca.h>
 #include <stdlib.h>
 #include <sys/stat.h>
+#include <zstd.h>
 
 #include <algorithm>
 #include <cassert>
@@ -142,16 +143,38 @@ namespace zlib {
 
 const unsigned kBufferSize = 32768;
 
+/**
+ * Returns false if string doesn't match any of the algorithms.
+ */
+bool LookupCompressionAlgorithm(const std::string &algorithm_option,
+                                Algorithms *algorithm)
+{
+  if ((algorithm_option == "default") || (algorithm_option == "zlib")) {
+    *algorithm = kZlibDefault;
+    return true;
+  }
+  if (algorithm_option == "none") {
+    *algorithm = kNoCompression;
+    return true;
+  }
+  if (algorithm_option == "zstd") {
+    *algorithm = kZstdDefault;
+    return true;
+  }
+  return false;
+}
+
+
 /**
  * Aborts if string doesn't match any of the algorithms.
  */
 Algorithms ParseCompressionAlgorithm(const std::string &algorithm_option) {
-  if ((algorithm_option == "default") || (algorithm_option == "zlib"))
-    return kZlibDefault;
-  if (algorithm_option == "none")
-    return kNoCompression;
-  PANIC(kLogStderr, "unknown compression algorithms: %s",
-        algorithm_option.c_str());
+  Algorithms algorithm;
+  if (!LookupCompressionAlgorithm(algorithm_option, &algorithm)) {
+    PANIC(kLogStderr, "unknown compression algorithms: %s",
+          algorithm_option.c_str());
+  }
+  return algorithm;
 }
 
 
@@ -163,6 +186,9 @@ std::string AlgorithmName(const zlib::Algorithms alg) {
     case kNoCompression:
       return "none";
       break;
+    case kZstdDefault:
+      return "zstd";
+      break;
     // Purposely did not add a 'default' statement here: this will
     // cause the compiler to generate a warning if a new algorithm
     // is added but this function is not updated.
@@ -315,6 +341,90 @@ StreamStates DecompressZStream2File(
 }
 
 
+ZSTD_DStream *ZstdDecompressInit() {
+  ZSTD_DStream *strm = ZSTD_createDStream();
+  assert(strm != NULL);
+  size_t retval = ZSTD_initDStream(strm);
+  assert(!ZSTD_isError(retval));
+  return strm;
+}
+
+
+/**
+ * Prepares the stream for a new frame, e.g. when a download is retried
+ */
+void ZstdDecompressReset(ZSTD_DStream *strm) {
+  size_t retval = ZSTD_DCtx_reset(strm, ZSTD_reset_session_only);
+  assert(!ZSTD_isError(retval));
+}
+
+
+void ZstdDecompressFini(ZSTD_DStream *strm) {
+  (void)ZSTD_freeDStream(strm);
+}
+
+
+StreamStates DecompressZstdStream2Sink(
+  const void *buf,
+  const int64_t size,
+  ZSTD_DStream *strm,
+  cvmfs::Sink *sink)
+{
+  unsigned char out[kZChunk];
+  ZSTD_inBuffer input = {buf, static_cast<size_t>(size), 0};
+  ZSTD_outBuffer output;
+  size_t z_ret;
+
+  // Run the decompression until the input is consumed and the output flushed.
+  // Stop at the end of the frame, another call would start a new frame.
+  do {
+    output.dst = out;
+    output.size = kZChunk;
+    output.pos = 0;
+    z_ret = ZSTD_decompressStream(strm, &output, &input);
+    if (ZSTD_isError(z_ret))
+      return kStreamDataError;
+    int64_t written = sink->Write(out, output.pos);
+    if ((written < 0) || (static_cast<uint64_t>(written) != output.pos))
+      return kStreamIOError;
+  } while ((z_ret != 0) &&
+           ((input.pos < input.size) || (output.pos == output.size)));
+
+  // A return value of zero indicates a completely decoded and flushed frame
+  return (z_ret == 0) ? kStreamEnd : kStreamContinue;
+}
+
+
+StreamStates DecompressZstdStream2File(
+  const void *buf,
+  const int64_t size,
+  ZSTD_DStream *strm,
+  FILE *f)
+{
+  unsigned char out[kZChunk];
+  ZSTD_inBuffer input = {buf, static_cast<size_t>(size), 0};
+  ZSTD_outBuffer output;
+  size_t z_ret;
+
+  do {
+    output.dst = out;
+    output.size = kZChunk;
+    output.pos = 0;
+    z_ret = ZSTD_decompressStream(strm, &output, &input);
+    if (ZSTD_isError(z_ret))
+      return kStreamDataError;
+    if (fwrite(out, 1, output.pos, f) != output.pos || ferror(f)) {
+      LogCvmfs(kLogCompress, kLogDebug, "Zstd decompression to file failed "
+               "with %s (errno=%d)", strerror(errno), errno);
+      return kStreamIOError;
+    }
+  } while ((z_ret != 0) &&
+           ((input.pos < input.size) || (output.pos == output.size)));
+
+  return (z_ret == 0) ? kStreamEnd : kStreamContinue;
+}
+
+
 bool CompressPath2Path(const string &src, const string &dest) {
   FILE *fsrc = fopen(src.c_str(), "r");
   if (!fsrc) {
@@ -852,12 +962,58 @@ bool DecompressMem2Mem(const void *buf, const int64_t size,
 }
 
 
+/**
+ * User of this function has to free out_buf.
+ */
+bool DecompressZstdMem2Mem(const void *buf, const int64_t size,
+                           void **out_buf, uint64_t *out_size)
+{
+  unsigned char out[kZChunk];
+  ZSTD_DStream *strm = ZstdDecompressInit();
+  ZSTD_inBuffer input = {buf, static_cast<size_t>(size), 0};
+  ZSTD_outBuffer output;
+  size_t z_ret;
+  uint64_t alloc_size = kZChunk;
+
+  *out_buf = smalloc(alloc_size);
+  *out_size = 0;
+
+  do {
+    output.dst = out;
+    output.size = kZChunk;
+    output.pos = 0;
+    z_ret = ZSTD_decompressStream(strm, &output, &input);
+    if (ZSTD_isError(z_ret))
+      break;
+    if (*out_size + output.pos > alloc_size) {
+      alloc_size *= 2;
+      *out_buf = srealloc(*out_buf, alloc_size);
+    }
+    memcpy(static_cast<unsigned char *>(*out_buf) + *out_size, out,
+           output.pos);
+    *out_size += output.pos;
+  } while ((z_ret != 0) &&
+           ((input.pos < input.size) || (output.pos == output.size)));
+
+  ZstdDecompressFini(strm);
+  if (z_ret != 0) {
+    free(*out_buf);
+    *out_buf = NULL;
+    *out_size = 0;
+    return false;
+  }
+
+  return true;
+}
+
+
 //------------------------------------------------------------------------------
 
 
 void Compressor::RegisterPlugins() {
   RegisterPlugin<ZlibCompressor>();
   RegisterPlugin<EchoCompressor>();
+  RegisterPlugin<ZstdCompressor>();
 }
 
 
@@ -939,6 +1095,63 @@ size_t ZlibCompressor::DeflateBound(const size_t bytes) {
 //------------------------------------------------------------------------------
 
 
+bool ZstdCompressor::WillHandle(const zlib::Algorithms &alg) {
+  return alg == kZstdDefault;
+}
+
+
+ZstdCompressor::ZstdCompressor(const Algorithms &alg)
+  : Compressor(alg)
+  , stream_(ZSTD_createCCtx())
+  , is_pristine_(true)
+{
+  assert(stream_ != NULL);
+  const size_t retval = ZSTD_CCtx_setParameter(
+    stream_, ZSTD_c_compressionLevel, kCompressionLevel);
+  assert(!ZSTD_isError(retval));
+}
+
+
+Compressor* ZstdCompressor::Clone() {
+  assert(is_pristine_);
+  return new ZstdCompressor(zlib::kZstdDefault);
+}
+
+
+bool ZstdCompressor::Deflate(
+  const bool flush,
+  unsigned char **inbuf, size_t *inbufsize,
+  unsigned char **outbuf, size_t *outbufsize)
+{
+  ZSTD_inBuffer input = {*inbuf, *inbufsize, 0};
+  ZSTD_outBuffer output = {*outbuf, *outbufsize, 0};
+  const size_t remaining = ZSTD_compressStream2(
+    stream_, &output, &input, flush ? ZSTD_e_end : ZSTD_e_continue);
+  assert(!ZSTD_isError(remaining));
+  is_pristine_ = false;
+
+  *outbufsize = output.pos;
+  *inbuf += input.pos;
+  *inbufsize -= input.pos;
+
+  // With ZSTD_e_end, zero bytes remaining to be flushed mark the end of frame
+  return flush ? (remaining == 0) : (*inbufsize == 0);
+}
+
+
+ZstdCompressor::~ZstdCompressor() {
+  (void)ZSTD_freeCCtx(stream_);
+}
+
+
+size_t ZstdCompressor::DeflateBound(const size_t bytes) {
+  return ZSTD_compressBound(bytes);
+}
+
+
+//------------------------------------------------------------------------------
+
+
 EchoCompressor::EchoCompressor(const zlib::Algorithms &alg):
   Compressor(alg)
 {
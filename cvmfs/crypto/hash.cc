@@ -14,6 +14,11 @@
 #include <openssl/sha.h>
 #include <unistd.h>
 
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <cpuid.h>
+#endif
+
+#include <algorithm>
 #include <cstdio>
 #include <cstring>
 
@@ -271,6 +276,298 @@ void HashString(const std::string &content, Any *any_digest) {
 }
 
 
+//------------------------------------------------------------------------------
+
+
+namespace {
+
+const unsigned kSha1BlockSize = 64;
+const unsigned kMaxLanes = 16;
+
+/**
+ * A SHA-1 context of UpdateMulti() and the whole blocks that go through the
+ * SIMD kernel.  The bytes before and after are hashed by OpenSSL.
+ */
+struct Sha1Job {
+  SHA_CTX *ctx;
+  const unsigned char *blocks;
+  unsigned num_blocks;
+  const unsigned char *tail;
+  unsigned tail_size;
+};
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define CVMFS_HASH_MULTI_BUFFER
+
+typedef uint32_t Sha1Vec8 __attribute__((vector_size(32)));
+typedef uint32_t Sha1Vec16 __attribute__((vector_size(64)));
+
+/**
+ * Runs the SHA-1 compression function on num_blocks blocks of kLanes buffers
+ * in parallel.  Every vector element corresponds to one buffer.  Inlined into
+ * the kernels below, which are compiled for the respective instruction set.
+ */
+template <typename VecT, unsigned kLanes>
+inline __attribute__((always_inline)) void Sha1Lanes(
+  uint32_t (*state)[5],
+  const unsigned char **data,
+  const unsigned num_blocks)
+{
+  VecT h[5];
+  for (unsigned i = 0; i < 5; ++i) {
+    for (unsigned l = 0; l < kLanes; ++l)
+      h[i][l] = state[l][i];
+  }
+
+  for (unsigned n = 0; n < num_blocks; ++n) {
+    VecT w[16];
+    for (unsigned i = 0; i < 16; ++i) {
+      for (unsigned l = 0; l < kLanes; ++l) {
+        uint32_t word;
+        memcpy(&word, data[l] + n * kSha1BlockSize + 4 * i, 4);
+        w[i][l] = __builtin_bswap32(word);
+      }
+    }
+
+    VecT a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+    // The message schedule is kept in a ring buffer of 16 words
+#define CVMFS_SHA1_ROL(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+#define CVMFS_SHA1_ROUND(i, f, k) { \
+      if ((i) >= 16) { \
+        w[(i) & 15] = CVMFS_SHA1_ROL(w[((i) - 3) & 15] ^ w[((i) - 8) & 15] ^ \
+                                     w[((i) - 14) & 15] ^ w[(i) & 15], 1); \
+      } \
+      VecT t = CVMFS_SHA1_ROL(a, 5) + (f) + e + static_cast<uint32_t>(k) + \
+               w[(i) & 15]; \
+      e = d; d = c; c = CVMFS_SHA1_ROL(b, 30); b = a; a = t; \
+    }
+    for (unsigned i = 0; i < 20; ++i)
+      CVMFS_SHA1_ROUND(i, d ^ (b & (c ^ d)), 0x5A827999)
+    for (unsigned i = 20; i < 40; ++i)
+      CVMFS_SHA1_ROUND(i, b ^ c ^ d, 0x6ED9EBA1)
+    for (unsigned i = 40; i < 60; ++i)
+      CVMFS_SHA1_ROUND(i, (b & c) | (d & (b | c)), 0x8F1BBCDC)
+    for (unsigned i = 60; i < 80; ++i)
+      CVMFS_SHA1_ROUND(i, b ^ c ^ d, 0xCA62C1D6)
+#undef CVMFS_SHA1_ROUND
+#undef CVMFS_SHA1_ROL
+
+    h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e;
+  }
+
+  for (unsigned i = 0; i < 5; ++i) {
+    for (unsigned l = 0; l < kLanes; ++l)
+      state[l][i] = h[i][l];
+  }
+}
+
+__attribute__((target("avx2"))) void Sha1LanesAvx2(
+  uint32_t (*state)[5], const unsigned char **data, const unsigned num_blocks)
+{
+  Sha1Lanes<Sha1Vec8, 8>(state, data, num_blocks);
+}
+
+__attribute__((target("avx512f"))) void Sha1LanesAvx512(
+  uint32_t (*state)[5], const unsigned char **data, const unsigned num_blocks)
+{
+  Sha1Lanes<Sha1Vec16, 16>(state, data, num_blocks);
+}
+
+unsigned DetectMultiBufferLanes() {
+  unsigned eax, ebx, ecx, edx;
+  if (__get_cpuid_max(0, NULL) < 7)
+    return 1;
+  __cpuid(1, eax, ebx, ecx, edx);
+  // The OS must save the AVX registers on context switches
+  if ((ecx & bit_OSXSAVE) == 0)
+    return 1;
+  uint32_t xcr0_lo, xcr0_hi;
+  __asm__ __volatile__("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+  const bool has_ymm = (xcr0_lo & 0x06) == 0x06;
+  const bool has_zmm = (xcr0_lo & 0xe6) == 0xe6;
+
+  __cpuid_count(7, 0, eax, ebx, ecx, edx);
+  const bool has_avx2 = (ebx & (1 << 5)) != 0;
+  const bool has_avx512f = (ebx & (1 << 16)) != 0;
+  const bool has_sha = (ebx & (1 << 29)) != 0;
+
+  if (has_avx512f && has_zmm)
+    return 16;
+  // SHA-NI beats 8 lanes
+  if (has_sha)
+    return 1;
+  if (has_avx2 && has_ymm)
+    return 8;
+  return 1;
+}
+
+#else
+
+unsigned DetectMultiBufferLanes() { return 1; }
+
+#endif  // x86_64
+
+/**
+ * Adds the bits of num_blocks blocks to the message length of the context,
+ * like SHA1_Update() does
+ */
+void AddSha1Length(SHA_CTX *ctx, const uint64_t num_blocks) {
+  const uint64_t num_bytes = num_blocks * kSha1BlockSize;
+  const uint32_t lo = ctx->Nl + static_cast<uint32_t>(num_bytes << 3);
+  if (lo < ctx->Nl)
+    ctx->Nh++;
+  ctx->Nh += static_cast<uint32_t>(num_bytes >> 29);
+  ctx->Nl = lo;
+}
+
+void LoadSha1State(const SHA_CTX *ctx, uint32_t *state) {
+  state[0] = ctx->h0; state[1] = ctx->h1; state[2] = ctx->h2;
+  state[3] = ctx->h3; state[4] = ctx->h4;
+}
+
+void StoreSha1State(const uint32_t *state, SHA_CTX *ctx) {
+  ctx->h0 = state[0]; ctx->h1 = state[1]; ctx->h2 = state[2];
+  ctx->h3 = state[3]; ctx->h4 = state[4];
+}
+
+/**
+ * Feeds the whole blocks of the jobs through the SIMD kernel.  A lane that
+ * finishes its job picks up the next one.  Once there are no new jobs and less
+ * than half of the lanes are busy, the rest is cheaper to do one by one.
+ */
+void RunSha1Jobs(Sha1Job *jobs, const unsigned num_jobs, const unsigned lanes) {
+#ifdef CVMFS_HASH_MULTI_BUFFER
+  uint32_t state[kMaxLanes][5];
+  const unsigned char *data[kMaxLanes];
+  unsigned remaining[kMaxLanes];
+  int lane_job[kMaxLanes];
+  for (unsigned l = 0; l < lanes; ++l)
+    lane_job[l] = -1;
+  unsigned next_job = 0;
+
+  while (true) {
+    unsigned num_active = 0;
+    unsigned first_active = 0;
+    for (unsigned l = 0; l < lanes; ++l) {
+      if ((lane_job[l] < 0) && (next_job < num_jobs)) {
+        lane_job[l] = next_job;
+        LoadSha1State(jobs[next_job].ctx, state[l]);
+        data[l] = jobs[next_job].blocks;
+        remaining[l] = jobs[next_job].num_blocks;
+        next_job++;
+      }
+      if (lane_job[l] >= 0) {
+        if (num_active == 0)
+          first_active = l;
+        num_active++;
+      }
+    }
+    if (num_active == 0)
+      return;
+
+    if (2 * num_active < lanes) {
+      for (unsigned l = 0; l < lanes; ++l) {
+        if (lane_job[l] < 0)
+          continue;
+        SHA_CTX *ctx = jobs[lane_job[l]].ctx;
+        StoreSha1State(state[l], ctx);
+        AddSha1Length(ctx, jobs[lane_job[l]].num_blocks - remaining[l]);
+        SHA1_Update(ctx, data[l], remaining[l] * kSha1BlockSize);
+      }
+      return;
+    }
+
+    // Idle lanes duplicate the work of an active lane, the result is dropped
+    unsigned num_blocks = remaining[first_active];
+    for (unsigned l = 0; l < lanes; ++l) {
+      if (lane_job[l] >= 0) {
+        num_blocks = std::min(num_blocks, remaining[l]);
+      } else {
+        data[l] = data[first_active];
+        memcpy(state[l], state[first_active], sizeof(state[l]));
+      }
+    }
+
+    if (lanes == 16)
+      Sha1LanesAvx512(state, data, num_blocks);
+    else
+      Sha1LanesAvx2(state, data, num_blocks);
+
+    for (unsigned l = 0; l < lanes; ++l) {
+      if (lane_job[l] < 0)
+        continue;
+      data[l] += num_blocks * kSha1BlockSize;
+      remaining[l] -= num_blocks;
+      if (remaining[l] == 0) {
+        StoreSha1State(state[l], jobs[lane_job[l]].ctx);
+        AddSha1Length(jobs[lane_job[l]].ctx, jobs[lane_job[l]].num_blocks);
+        lane_job[l] = -1;
+      }
+    }
+  }
+#else
+  PANIC(NULL);
+#endif
+}
+
+}  // anonymous namespace
+
+
+unsigned GetMultiBufferLanes() {
+  static unsigned lanes = DetectMultiBufferLanes();
+  return lanes;
+}
+
+
+void UpdateMulti(
+  const unsigned char **buffers,
+  const unsigned *buffer_sizes,
+  ContextPtr *contexts,
+  const unsigned num)
+{
+  const unsigned lanes = GetMultiBufferLanes();
+  if ((lanes == 1) || (num < 2)) {
+    for (unsigned i = 0; i < num; ++i)
+      Update(buffers[i], buffer_sizes[i], contexts[i]);
+    return;
+  }
+
+  Sha1Job *jobs = reinterpret_cast<Sha1Job *>(alloca(num * sizeof(Sha1Job)));
+  unsigned num_jobs = 0;
+  for (unsigned i = 0; i < num; ++i) {
+    if (contexts[i].algorithm != kSha1) {
+      Update(buffers[i], buffer_sizes[i], contexts[i]);
+      continue;
+    }
+    assert(contexts[i].size == sizeof(SHA_CTX));
+    SHA_CTX *ctx = reinterpret_cast<SHA_CTX *>(contexts[i].buffer);
+    const unsigned char *buffer = buffers[i];
+    unsigned size = buffer_sizes[i];
+    // Complete a partial block that is buffered in the context
+    if (ctx->num != 0) {
+      const unsigned nbytes = std::min(size, kSha1BlockSize - ctx->num);
+      SHA1_Update(ctx, buffer, nbytes);
+      buffer += nbytes;
+      size -= nbytes;
+    }
+    if (size < kSha1BlockSize) {
+      SHA1_Update(ctx, buffer, size);
+      continue;
+    }
+    jobs[num_jobs].ctx = ctx;
+    jobs[num_jobs].blocks = buffer;
+    jobs[num_jobs].num_blocks = size / kSha1BlockSize;
+    jobs[num_jobs].tail = buffer + (size - size % kSha1BlockSize);
+    jobs[num_jobs].tail_size = size % kSha1BlockSize;
+    num_jobs++;
+  }
+
+  RunSha1Jobs(jobs, num_jobs, lanes);
+  for (unsigned i = 0; i < num_jobs; ++i)
+    SHA1_Update(jobs[i].ctx, jobs[i].tail, jobs[i].tail_size);
+}
+
+
 void Hmac(
   const string &key,
   const unsigned char *buffer,
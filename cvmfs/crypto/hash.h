@@ -520,6 +520,24 @@ CVMFS_EXPORT void HashMem(const unsigned char *buffer,
                           const unsigned buffer_size,
                           Any *any_digest);
 CVMFS_EXPORT void HashString(const std::string &content, Any *any_digest);
+
+/**
+ * Number of independent buffers that are hashed in parallel by UpdateMulti().
+ * Determined once from the CPU features.  A value of 1 means that there is no
+ * multi-buffer implementation for this CPU, either because the CPU lacks the
+ * SIMD instructions or because it has dedicated SHA instructions that make
+ * OpenSSL faster on a single buffer.
+ */
+CVMFS_EXPORT unsigned GetMultiBufferLanes();
+/**
+ * Same as calling Update(buffers[i], buffer_sizes[i], contexts[i]) for all i,
+ * but SHA-1 contexts are processed in parallel lanes of a SIMD register
+ * where the CPU supports it.  The contexts must be distinct.
+ */
+CVMFS_EXPORT void UpdateMulti(const unsigned char **buffers,
+                              const unsigned *buffer_sizes,
+                              ContextPtr *contexts,
+                              const unsigned num);
 CVMFS_EXPORT void Hmac(const std::string &key,
                        const unsigned char *buffer,
                        const unsigned buffer_size,
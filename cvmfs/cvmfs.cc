@@ -69,6 +69,7 @@
 #include "backoff.h"
 #include "cache.h"
 #include "catalog_mgr_client.h"
+#include "chunk_prefetch.h"
 #include "clientctx.h"
 #include "compat.h"
 #include "compression.h"
@@ -86,6 +87,7 @@
 #include "globals.h"
 #include "glue_buffer.h"
 #include "history_sqlite.h"
+#include "hotset.h"
 #include "interrupt.h"
 #include "loader.h"
 #include "lru_md.h"
@@ -156,6 +158,11 @@ typedef google::dense_hash_map<uint64_t, DirectoryListing,
 DirectoryHandles *directory_handles_ = NULL;
 pthread_mutex_t lock_directory_handles_ = PTHREAD_MUTEX_INITIALIZER;
 uint64_t next_directory_handle_ = 0;
+/**
+ * Answer readdirplus requests if the kernel supports them
+ * (CVMFS_FUSE_READDIRPLUS)
+ */
+bool enable_readdirplus_ = false;
 
 unsigned max_open_files_; /**< maximum allowed number of open files */
 /**
@@ -375,6 +382,10 @@ static uint64_t GetDirentForPath(const PathString &path,
       dirent->set_inode(live_inode);
     return 1;
   }
+  if (mount_point_->negative_cache()->Lookup(md5path)) {
+    *dirent = catalog::DirectoryEntry(catalog::kDirentNegative);
+    return 0;
+  }
 
   catalog::ClientCatalogManager *catalog_mgr = mount_point_->catalog_mgr();
 
@@ -404,7 +415,7 @@ static uint64_t GetDirentForPath(const PathString &path,
   // Only insert ENOENT results into negative cache.  Otherwise it was an
   // error loading nested catalogs
   if (dirent->GetSpecial() == catalog::kDirentNegative)
-    mount_point_->md5path_cache()->InsertNegative(md5path);
+    mount_point_->negative_cache()->Insert(md5path);
   return 0;
 }
 
@@ -435,6 +446,68 @@ static bool GetPathForInode(const fuse_ino_t ino, PathString *path) {
   return true;
 }
 
+/**
+ * Lists a directory with a single catalog query and fills the meta-data caches
+ * with the entries on the way, so that the lookup() and getattr() calls that
+ * usually follow opendir() (ls -l, import scans) are served from memory.  At
+ * most dir_prefetch_limit() entries are prefetched.  The inodes in the
+ * returned listing are already fixed.
+ */
+static bool ListingPrefetch(const PathString &path,
+                            catalog::StatEntryList *listing)
+{
+  catalog::DirectoryEntryList dirents;
+  if (!mount_point_->catalog_mgr()->Listing(path, &dirents))
+    return false;
+
+  const unsigned limit = mount_point_->dir_prefetch_limit();
+  unsigned num_prefetched = 0;
+  for (unsigned i = 0; i < dirents.size(); ++i) {
+    catalog::DirectoryEntry *dirent = &dirents[i];
+    if (dirent->IsHidden())
+      continue;
+    struct stat info = dirent->GetStatStructure();
+
+    PathString entry_path;
+    entry_path.Assign(path);
+    entry_path.Append("/", 1);
+    entry_path.Append(dirent->name().GetChars(), dirent->name().GetLength());
+
+    uint64_t live_inode = 0;
+    if (file_system_->IsNfsSource()) {
+      dirent->set_inode(file_system_->nfs_maps()->GetInode(entry_path));
+    } else {
+      live_inode = mount_point_->inode_tracker()->FindInode(entry_path);
+      if (live_inode != 0)
+        dirent->set_inode(live_inode);
+    }
+
+    // Transition points to nested catalogs and possibly open files with
+    // changed content take the regular path
+    if (dirent->IsNestedCatalogMountpoint() ||
+        ((live_inode != 0) && MayBeInPageCacheTracker(*dirent)))
+    {
+      if (!GetDirentForPath(entry_path, dirent)) {
+        LogCvmfs(kLogCvmfs, kLogDebug, "listing entry %s vanished, skipping",
+                 entry_path.c_str());
+        continue;
+      }
+    } else if (num_prefetched < limit) {
+      shash::Md5 md5path(entry_path.GetChars(), entry_path.GetLength());
+      mount_point_->md5path_cache()->InsertPrefetched(md5path, *dirent);
+      mount_point_->inode_cache()->InsertPrefetched(dirent->inode(), *dirent);
+      mount_point_->path_cache()->InsertPrefetched(dirent->inode(), entry_path);
+      num_prefetched++;
+    }
+
+    info.st_ino = dirent->inode();
+    listing->PushBack(catalog::StatEntry(dirent->name(), info));
+  }
+  LogCvmfs(kLogCvmfs, kLogDebug, "prefetched %u entries of %s",
+           num_prefetched, path.c_str());
+  return true;
+}
+
 static void DoTraceInode(const int event,
                           fuse_ino_t ino,
                           const std::string &msg)
@@ -457,6 +530,32 @@ static void inline TraceInode(const int event,
   if (mount_point_->tracer()->IsActive()) DoTraceInode(event, ino, msg);
 }
 
+/**
+ * Registers a positive lookup reply, i.e. the kernel's reference to the inode,
+ * with the inode tracker.  The live inode is the return value of
+ * GetDirentForPath().
+ */
+static void TrackLookup(const PathString &path,
+                        const uint64_t live_inode,
+                        const catalog::DirectoryEntry &dirent)
+{
+  if (file_system_->IsNfsSource())
+    return;
+
+  if (live_inode > 1) {
+    // live inode is stale (open file), we replace it
+    assert(dirent.IsRegular());
+    assert(dirent.inode() != live_inode);
+    // The new inode is put in the tracker with refcounter == 0
+    bool replaced = mount_point_->inode_tracker()->ReplaceInode(
+      live_inode, glue::InodeEx(dirent.inode(), dirent.mode()));
+    if (replaced)
+      perf::Inc(file_system_->n_fs_inode_replace());
+  }
+  mount_point_->inode_tracker()->VfsGet(
+    glue::InodeEx(dirent.inode(), dirent.mode()), path);
+}
+
 /**
  * Find the inode number of a file name in a directory given by inode.
  * This or getattr is called as kind of prerequisit to every operation.
@@ -534,20 +633,7 @@ static void cvmfs_lookup(fuse_req_t req, fuse_ino_t parent, const char *name) {
   }
 
  lookup_reply_positive:
-  if (!file_system_->IsNfsSource()) {
-    if (live_inode > 1) {
-      // live inode is stale (open file), we replace it
-      assert(dirent.IsRegular());
-      assert(dirent.inode() != live_inode);
-      // The new inode is put in the tracker with refcounter == 0
-      bool replaced = mount_point_->inode_tracker()->ReplaceInode(
-        live_inode, glue::InodeEx(dirent.inode(), dirent.mode()));
-      if (replaced)
-        perf::Inc(file_system_->n_fs_inode_replace());
-    }
-    mount_point_->inode_tracker()->VfsGet(
-      glue::InodeEx(dirent.inode(), dirent.mode()), path);
-  }
+  TrackLookup(path, live_inode, dirent);
   // We do _not_ track (and evict) positive replies; among other things, test
   // 076 fails with the following line uncommented
   // mount_point_->dentry_tracker()->Add(parent_fuse, name, uint64_t(timeout));
@@ -606,8 +692,7 @@ static void cvmfs_forget(
            uint64_t(ino), nlookup);
 #endif
   if (!file_system_->IsNfsSource()) {
-    bool removed =
-      mount_point_->inode_tracker()->GetVfsPutRaii().VfsPut(ino, nlookup);
+    bool removed = mount_point_->inode_tracker()->VfsPut(ino, nlookup);
     if (removed)
       mount_point_->page_cache_tracker()->GetEvictRaii().Evict(ino);
   }
@@ -632,10 +717,8 @@ static void cvmfs_forget_multi(
 
   fuse_remounter_->fence()->Enter();
   {
-    glue::InodeTracker::VfsPutRaii vfs_put_raii =
-      mount_point_->inode_tracker()->GetVfsPutRaii();
-    glue::PageCacheTracker::EvictRaii evict_raii =
-      mount_point_->page_cache_tracker()->GetEvictRaii();
+    glue::InodeTracker::VfsPutBatch vfs_put_batch(
+      mount_point_->inode_tracker());
     for (size_t i = 0; i < count; ++i) {
       if (forgets[i].ino == FUSE_ROOT_ID) {
         continue;
@@ -644,10 +727,16 @@ static void cvmfs_forget_multi(
       uint64_t ino = mount_point_->catalog_mgr()->MangleInode(forgets[i].ino);
       LogCvmfs(kLogCvmfs, kLogDebug, "forget on inode %" PRIu64 " by %" PRIu64,
                ino, forgets[i].nlookup);
+      vfs_put_batch.Add(ino, forgets[i].nlookup);
+    }
 
-      bool removed = vfs_put_raii.VfsPut(ino, forgets[i].nlookup);
-      if (removed)
-        evict_raii.Evict(ino);
+    vector<uint64_t> removed;
+    vfs_put_batch.Commit(&removed);
+    if (!removed.empty()) {
+      glue::PageCacheTracker::EvictRaii evict_raii =
+        mount_point_->page_cache_tracker()->GetEvictRaii();
+      for (unsigned i = 0; i < removed.size(); ++i)
+        evict_raii.Evict(removed[i]);
     }
   }
   fuse_remounter_->fence()->Leave();
@@ -869,7 +958,10 @@ static void cvmfs_opendir(fuse_req_t req, fuse_ino_t ino,
 
   // Add all names
   catalog::StatEntryList listing_from_catalog;
-  bool retval = catalog_mgr->ListingStat(path, &listing_from_catalog);
+  const bool prefetch = (mount_point_->dir_prefetch_limit() > 0);
+  bool retval = prefetch
+                ? ListingPrefetch(path, &listing_from_catalog)
+                : catalog_mgr->ListingStat(path, &listing_from_catalog);
 
   if (!retval) {
     fuse_remounter_->fence()->Leave();
@@ -878,6 +970,12 @@ static void cvmfs_opendir(fuse_req_t req, fuse_ino_t ino,
     return;
   }
   for (unsigned i = 0; i < listing_from_catalog.size(); ++i) {
+    if (prefetch) {
+      AddToDirListing(req, listing_from_catalog.AtPtr(i)->name.c_str(),
+                      &listing_from_catalog.AtPtr(i)->info, &fuse_listing);
+      continue;
+    }
+
     // Fix inodes
     PathString entry_path;
     entry_path.Assign(path);
@@ -1008,6 +1106,143 @@ static void cvmfs_readdir(fuse_req_t req, fuse_ino_t ino, size_t size,
   fuse_reply_err(req, EINVAL);
 }
 
+#if (FUSE_VERSION >= 30)
+/**
+ * Reads the entries that fuse_add_direntry() wrote into a directory listing
+ * buffer.  The layout is struct fuse_dirent of the kernel protocol: inode,
+ * offset of the next entry, name length, type, and the name, padded to 8 bytes.
+ */
+class FuseDirentReader {
+ public:
+  FuseDirentReader(const char *buffer, const size_t size)
+    : buffer_(buffer), size_(size), pos_(0) { }
+
+  bool Next(uint64_t *ino, uint64_t *next_off, unsigned *type,
+            std::string *name)
+  {
+    if (pos_ + kNameOffset > size_)
+      return false;
+    uint32_t namelen;
+    uint32_t type32;
+    memcpy(ino, buffer_ + pos_, sizeof(uint64_t));
+    memcpy(next_off, buffer_ + pos_ + 8, sizeof(uint64_t));
+    memcpy(&namelen, buffer_ + pos_ + 16, sizeof(uint32_t));
+    memcpy(&type32, buffer_ + pos_ + 20, sizeof(uint32_t));
+    const size_t entry_size = (kNameOffset + namelen + 7) & ~size_t(7);
+    if (pos_ + entry_size > size_)
+      return false;
+    *type = type32;
+    name->assign(buffer_ + pos_ + kNameOffset, namelen);
+    pos_ += entry_size;
+    return true;
+  }
+
+ private:
+  static const size_t kNameOffset = 24;
+  const char *buffer_;
+  size_t size_;
+  size_t pos_;
+};
+
+
+/**
+ * Like cvmfs_readdir() but with the attributes of the entries.  The reply is
+ * built from the readdir listing of the directory handle, so both operations
+ * use the same offsets and the kernel can mix them on the same handle.  The
+ * attributes come from the meta-data caches that opendir() has filled.  Apart
+ * from "." and "..", the kernel takes every entry of the reply as a lookup.
+ */
+static void cvmfs_readdirplus(fuse_req_t req, fuse_ino_t ino, size_t size,
+                              off_t off, struct fuse_file_info *fi)
+{
+  HighPrecisionTimer guard_timer(file_system_->hist_fs_readdir());
+
+  const struct fuse_ctx *fuse_ctx = fuse_req_ctx(req);
+  FuseInterruptCue ic(&req);
+  ClientCtxGuard ctx_guard(fuse_ctx->uid, fuse_ctx->gid, fuse_ctx->pid, &ic);
+  fuse_remounter_->TryFinish();
+
+  ino = mount_point_->catalog_mgr()->MangleInode(ino);
+  LogCvmfs(kLogCvmfs, kLogDebug,
+           "cvmfs_readdirplus on inode %" PRIu64 " reading %d bytes from "
+           "offset %d", uint64_t(ino), size, off);
+
+  // A readdirplus entry is larger than the corresponding readdir entry, so
+  // size bytes of the listing are sufficient for the reply
+  std::string slice;
+  {
+    MutexLockGuard m(&lock_directory_handles_);
+    DirectoryHandles::const_iterator iter_handle =
+      directory_handles_->find(fi->fh);
+    if (iter_handle == directory_handles_->end()) {
+      fuse_reply_err(req, EINVAL);
+      return;
+    }
+    const DirectoryListing &listing = iter_handle->second;
+    if (off < static_cast<off_t>(listing.size)) {
+      slice.assign(listing.buffer + off,
+                   std::min(static_cast<size_t>(listing.size - off), size));
+    }
+  }
+
+  fuse_remounter_->fence()->Enter();
+  PathString path;
+  if (!slice.empty() && !GetPathForInode(ino, &path)) {
+    fuse_remounter_->fence()->Leave();
+    fuse_reply_err(req, ENOENT);
+    return;
+  }
+
+  char *reply = static_cast<char *>(smalloc(std::max(size, size_t(1))));
+  size_t reply_size = 0;
+  const double timeout = GetKcacheTimeout();
+  FuseDirentReader reader(slice.data(), slice.size());
+  uint64_t entry_ino;
+  uint64_t next_off;
+  unsigned type;
+  std::string name;
+  while (reader.Next(&entry_ino, &next_off, &type, &name)) {
+    struct fuse_entry_param entry;
+    memset(&entry, 0, sizeof(entry));
+    // Without a node id, the entry is listed but not looked up
+    entry.attr.st_ino = entry_ino;
+    entry.attr.st_mode = type << 12;
+
+    PathString entry_path;
+    catalog::DirectoryEntry dirent;
+    uint64_t live_inode = 0;
+    if ((name != ".") && (name != "..")) {
+      entry_path.Assign(path);
+      entry_path.Append("/", 1);
+      entry_path.Append(name.data(), name.length());
+      live_inode = GetDirentForPath(entry_path, &dirent);
+      if (live_inode > 0) {
+        entry.ino = dirent.inode();
+        entry.attr = dirent.GetStatStructure();
+        entry.attr_timeout = timeout;
+        entry.entry_timeout = timeout;
+      }
+    }
+
+    const size_t entry_size =
+      fuse_add_direntry_plus(req, NULL, 0, name.c_str(), &entry, 0);
+    if (reply_size + entry_size > size)
+      break;
+    fuse_add_direntry_plus(req, reply + reply_size, size - reply_size,
+                           name.c_str(), &entry, next_off);
+    reply_size += entry_size;
+    if (entry.ino != 0) {
+      TrackLookup(entry_path, live_inode, dirent);
+      perf::Inc(file_system_->n_fs_readdirplus_entry());
+    }
+  }
+  fuse_remounter_->fence()->Leave();
+
+  fuse_reply_buf(req, reply, reply_size);
+  free(reply);
+}
+#endif  // FUSE_VERSION >= 30
+
 static void FillOpenFlags(const glue::PageCacheTracker::OpenDirectives od,
                           struct fuse_file_info *fi)
 {
@@ -1244,6 +1479,68 @@ static void cvmfs_open(fuse_req_t req, fuse_ino_t ino,
 }
 
 
+/**
+ * Replies to a read directly from the memory of cache managers that support
+ * it (RAM cache), saving the copy into the reply buffer.  Returns -ENOTSUP if
+ * the data needs to be read by Pread() instead.
+ */
+static int64_t ReplyZeroCopy(fuse_req_t req, int fd, size_t size,
+                             off_t off)
+{
+  CacheManager *cache_mgr = file_system_->cache_mgr();
+  const void *data;
+  const int64_t nbytes = cache_mgr->PreadZeroCopy(fd, size, off, &data);
+  if (nbytes < 0)
+    return nbytes;
+  // The object is pinned but not locked while the reply is written
+  fuse_reply_buf(req, static_cast<const char *>(data), nbytes);
+  cache_mgr->ReleaseZeroCopy(fd, data);
+  LogCvmfs(kLogCvmfs, kLogDebug, "pushed %" PRId64 " bytes to user from cache "
+           "memory", nbytes);
+  return nbytes;
+}
+
+
+/**
+ * Opens the chunk chunk_idx of a chunked file, downloading it if necessary.
+ * If the chunk is read sequentially, the following chunks are prefetched.
+ * Returns a file descriptor of the cache manager or -errno.
+ */
+static int FetchChunk(const FileChunkReflist &chunks, unsigned chunk_idx,
+                      bool is_sequential)
+{
+  const CacheManager::ObjectType object_type =
+    mount_point_->catalog_mgr()->volatile_flag()
+      ? CacheManager::kTypeVolatile
+      : CacheManager::kTypeRegular;
+  // Schedule the following chunks before blocking on the current one
+  cvmfs::ChunkPrefetcher *prefetcher = mount_point_->chunk_prefetcher();
+  if (is_sequential && (prefetcher != NULL)) {
+    prefetcher->Prefetch(
+      chunks.external_data ? mount_point_->external_fetcher()
+                           : mount_point_->fetcher(),
+      chunks, chunk_idx, object_type);
+  }
+  string verbose_path = "Part of " + chunks.path.ToString();
+  if (chunks.external_data) {
+    return mount_point_->external_fetcher()->Fetch(
+      chunks.list->AtPtr(chunk_idx)->content_hash(),
+      chunks.list->AtPtr(chunk_idx)->size(),
+      verbose_path,
+      chunks.compression_alg,
+      object_type,
+      chunks.path.ToString(),
+      chunks.list->AtPtr(chunk_idx)->offset());
+  }
+  return mount_point_->fetcher()->Fetch(
+    chunks.list->AtPtr(chunk_idx)->content_hash(),
+    chunks.list->AtPtr(chunk_idx)->size(),
+    verbose_path,
+    chunks.compression_alg,
+    object_type);
+}
+
+
 /**
  * Redirected to pread into cache.
  */
@@ -1305,29 +1602,11 @@ static void cvmfs_read(fuse_req_t req, fuse_ino_t ino, size_t size, off_t off,
     do {
       // Open file descriptor to chunk
       if ((chunk_fd.fd == -1) || (chunk_fd.chunk_idx != chunk_idx)) {
+        const bool is_sequential = (chunk_fd.fd == -1)
+                                   ? (chunk_idx == 0)
+                                   : (chunk_idx == chunk_fd.chunk_idx + 1);
         if (chunk_fd.fd != -1) file_system_->cache_mgr()->Close(chunk_fd.fd);
-        string verbose_path = "Part of " + chunks.path.ToString();
-        if (chunks.external_data) {
-          chunk_fd.fd = mount_point_->external_fetcher()->Fetch(
-            chunks.list->AtPtr(chunk_idx)->content_hash(),
-            chunks.list->AtPtr(chunk_idx)->size(),
-            verbose_path,
-            chunks.compression_alg,
-            mount_point_->catalog_mgr()->volatile_flag()
-              ? CacheManager::kTypeVolatile
-              : CacheManager::kTypeRegular,
-            chunks.path.ToString(),
-            chunks.list->AtPtr(chunk_idx)->offset());
-        } else {
-          chunk_fd.fd = mount_point_->fetcher()->Fetch(
-            chunks.list->AtPtr(chunk_idx)->content_hash(),
-            chunks.list->AtPtr(chunk_idx)->size(),
-            verbose_path,
-            chunks.compression_alg,
-            mount_point_->catalog_mgr()->volatile_flag()
-              ? CacheManager::kTypeVolatile
-              : CacheManager::kTypeRegular);
-        }
+        chunk_fd.fd = FetchChunk(chunks, chunk_idx, is_sequential);
         if (chunk_fd.fd < 0) {
           chunk_fd.fd = -1;
           chunk_tables->Lock();
@@ -1347,22 +1626,65 @@ static void cvmfs_read(fuse_req_t req, fuse_ino_t ino, size_t size, off_t off,
         chunks.list->AtPtr(chunk_idx)->size() - offset_in_chunk;
       size_t bytes_to_read_in_chunk =
         std::min(bytes_to_read, remaining_bytes_in_chunk);
-      const int64_t bytes_fetched = file_system_->cache_mgr()->Pread(
-        chunk_fd.fd,
-        data + overall_bytes_fetched,
-        bytes_to_read_in_chunk,
-        offset_in_chunk);
-
-      if (bytes_fetched < 0) {
-        LogCvmfs(kLogCvmfs, kLogSyslogErr, "read err no %" PRId64 " (%s)",
-                 bytes_fetched, chunks.path.ToString().c_str());
+      if (bytes_to_read_in_chunk == size) {
+        // The entire read falls into this chunk
+        const int64_t nbytes =
+          ReplyZeroCopy(req, chunk_fd.fd, size, offset_in_chunk);
+        if (nbytes != -ENOTSUP) {
+          chunk_tables->Lock();
+          chunk_tables->handle2fd.Insert(chunk_handle, chunk_fd);
+          chunk_tables->Unlock();
+          if (nbytes < 0) {
+            LogCvmfs(kLogCvmfs, kLogSyslogErr, "read err no %" PRId64 " (%s)",
+                     nbytes, chunks.path.ToString().c_str());
+            fuse_reply_err(req, -nbytes);
+          }
+          return;
+        }
+      }
+      CacheManager::ReadRange ranges[2];
+      ranges[0].fd = chunk_fd.fd;
+      ranges[0].buf = data + overall_bytes_fetched;
+      ranges[0].size = bytes_to_read_in_chunk;
+      ranges[0].offset = offset_in_chunk;
+      unsigned nranges = 1;
+      // If the read continues in the next chunk, both parts are read
+      // together, which saves a round trip to external cache plugins
+      if ((bytes_to_read_in_chunk < bytes_to_read) &&
+          (chunk_idx + 1 < chunks.list->size()))
+      {
+        const int next_fd = FetchChunk(chunks, chunk_idx + 1, true);
+        // On failure, the next iteration retries and reports the error
+        if (next_fd >= 0) {
+          ranges[1].fd = next_fd;
+          ranges[1].buf = data + overall_bytes_fetched + bytes_to_read_in_chunk;
+          ranges[1].size = std::min(
+            static_cast<uint64_t>(bytes_to_read - bytes_to_read_in_chunk),
+            static_cast<uint64_t>(chunks.list->AtPtr(chunk_idx + 1)->size()));
+          ranges[1].offset = 0;
+          nranges = 2;
+        }
+      }
+      const int retval_read =
+        file_system_->cache_mgr()->PreadV(ranges, nranges);
+      if (nranges == 2) {
+        // Keep the descriptor of the chunk read last
+        file_system_->cache_mgr()->Close(chunk_fd.fd);
+        chunk_fd.fd = ranges[1].fd;
+        chunk_fd.chunk_idx = ++chunk_idx;
+      }
+
+      if (retval_read < 0) {
+        LogCvmfs(kLogCvmfs, kLogSyslogErr, "read err no %d (%s)",
+                 retval_read, chunks.path.ToString().c_str());
         chunk_tables->Lock();
         chunk_tables->handle2fd.Insert(chunk_handle, chunk_fd);
         chunk_tables->Unlock();
-        fuse_reply_err(req, -bytes_fetched);
+        fuse_reply_err(req, -retval_read);
         return;
       }
-      overall_bytes_fetched += bytes_fetched;
+      for (unsigned i = 0; i < nranges; ++i)
+        overall_bytes_fetched += ranges[i].result;
 
       // Proceed to the next chunk to keep on reading data
       ++chunk_idx;
@@ -1377,7 +1699,11 @@ static void cvmfs_read(fuse_req_t req, fuse_ino_t ino, size_t size, off_t off,
     LogCvmfs(kLogCvmfs, kLogDebug, "released chunk file descriptor %d",
              chunk_fd.fd);
   } else {
-    int64_t nbytes = file_system_->cache_mgr()->Pread(abs_fd, data, size, off);
+    int64_t nbytes = ReplyZeroCopy(req, abs_fd, size, off);
+    if (nbytes >= 0)
+      return;
+    if (nbytes == -ENOTSUP)
+      nbytes = file_system_->cache_mgr()->Pread(abs_fd, data, size, off);
     if (nbytes < 0) {
       fuse_reply_err(req, -nbytes);
       return;
@@ -1759,6 +2085,16 @@ static void cvmfs_init(void *userdata, struct fuse_conn_info *conn) {
   conn->want |= FUSE_CAP_EXPORT_SUPPORT;
 #endif
 
+#if (FUSE_VERSION >= 30)
+  // libfuse enables readdirplus by default if the kernel supports it
+  if (enable_readdirplus_ && (conn->capable & FUSE_CAP_READDIRPLUS)) {
+    conn->want |= FUSE_CAP_READDIRPLUS | FUSE_CAP_READDIRPLUS_AUTO;
+    LogCvmfs(kLogCvmfs, kLogDebug, "using readdirplus");
+  } else {
+    conn->want &= ~(FUSE_CAP_READDIRPLUS | FUSE_CAP_READDIRPLUS_AUTO);
+  }
+#endif
+
   if (mount_point_->enforce_acls()) {
 #ifdef FUSE_CAP_POSIX_ACL
     if ((conn->capable & FUSE_CAP_POSIX_ACL) == 0) {
@@ -1799,6 +2135,9 @@ static void SetCvmfsOperations(struct fuse_lowlevel_ops *cvmfs_operations) {
   cvmfs_operations->release      = cvmfs_release;
   cvmfs_operations->opendir      = cvmfs_opendir;
   cvmfs_operations->readdir      = cvmfs_readdir;
+#if (FUSE_VERSION >= 30)
+  cvmfs_operations->readdirplus  = cvmfs_readdirplus;
+#endif
   cvmfs_operations->releasedir   = cvmfs_releasedir;
   cvmfs_operations->statfs       = cvmfs_statfs;
   cvmfs_operations->getxattr     = cvmfs_getxattr;
@@ -2034,6 +2373,9 @@ static int Init(const loader::LoaderExports *loader_exports) {
       new FuseRemounter(cvmfs::mount_point_, &cvmfs::inode_generation_info_,
                         channel_or_session, fuse_notify_invalidation);
 
+  if (cvmfs::options_mgr_->GetValue("CVMFS_FUSE_READDIRPLUS", &buf))
+    cvmfs::enable_readdirplus_ = cvmfs::options_mgr_->IsOn(buf);
+
   // Monitor, check for maximum number of open files
   if (cvmfs::UseWatchdog()) {
     cvmfs::watchdog_ = Watchdog::Create("./stacktrace." +
@@ -2111,6 +2453,10 @@ static void Spawn() {
 
   cvmfs::mount_point_->download_mgr()->Spawn();
   cvmfs::mount_point_->external_download_mgr()->Spawn();
+  if (cvmfs::mount_point_->chunk_prefetcher() != NULL)
+    cvmfs::mount_point_->chunk_prefetcher()->Spawn();
+  if (cvmfs::mount_point_->hotset() != NULL)
+    cvmfs::mount_point_->hotset()->Spawn(cvmfs::fuse_remounter_->fence());
   if (cvmfs::mount_point_->resolv_conf_watcher() != NULL)
     cvmfs::mount_point_->resolv_conf_watcher()->Spawn();
   QuotaManager *quota_mgr = cvmfs::file_system_->cache_mgr()->quota_mgr();
@@ -2151,6 +2497,14 @@ static string GetErrorMsg() {
  * from file catalogs are active.
  */
 static void ShutdownMountpoint() {
+  // The replay runs inside the fence of the remounter, which is deleted below.
+  // The snapshot is taken while the path cache still reflects the working set.
+  if ((cvmfs::mount_point_ != NULL) && (cvmfs::mount_point_->hotset() != NULL))
+  {
+    cvmfs::mount_point_->hotset()->Terminate();
+    cvmfs::mount_point_->hotset()->Save();
+  }
+
   delete cvmfs::talk_mgr_;
   cvmfs::talk_mgr_ = NULL;
 
@@ -2256,7 +2610,7 @@ static bool SaveState(const int fd_progress, loader::StateList *saved_states) {
     glue::InodeTracker *saved_inode_tracker =
       new glue::InodeTracker(*cvmfs::mount_point_->inode_tracker());
     loader::SavedState *state_glue_buffer = new loader::SavedState();
-    state_glue_buffer->state_id = loader::kStateGlueBufferV4;
+    state_glue_buffer->state_id = loader::kStateGlueBufferV5;
     state_glue_buffer->state = saved_inode_tracker;
     saved_states->push_back(state_glue_buffer);
   }
@@ -2349,7 +2703,7 @@ static bool RestoreState(const int fd_progress,
     }
 
     if (saved_states[i]->state_id == loader::kStateGlueBuffer) {
-      SendMsg2Socket(fd_progress, "Migrating inode tracker (v1 to v4)... ");
+      SendMsg2Socket(fd_progress, "Migrating inode tracker (v1 to v5)... ");
       compat::inode_tracker::InodeTracker *saved_inode_tracker =
         (compat::inode_tracker::InodeTracker *)saved_states[i]->state;
       compat::inode_tracker::Migrate(
@@ -2358,7 +2712,7 @@ static bool RestoreState(const int fd_progress,
     }
 
     if (saved_states[i]->state_id == loader::kStateGlueBufferV2) {
-      SendMsg2Socket(fd_progress, "Migrating inode tracker (v2 to v4)... ");
+      SendMsg2Socket(fd_progress, "Migrating inode tracker (v2 to v5)... ");
       compat::inode_tracker_v2::InodeTracker *saved_inode_tracker =
         (compat::inode_tracker_v2::InodeTracker *)saved_states[i]->state;
       compat::inode_tracker_v2::Migrate(saved_inode_tracker,
@@ -2367,7 +2721,7 @@ static bool RestoreState(const int fd_progress,
     }
 
     if (saved_states[i]->state_id == loader::kStateGlueBufferV3) {
-      SendMsg2Socket(fd_progress, "Migrating inode tracker (v3 to v4)... ");
+      SendMsg2Socket(fd_progress, "Migrating inode tracker (v3 to v5)... ");
       compat::inode_tracker_v3::InodeTracker *saved_inode_tracker =
         (compat::inode_tracker_v3::InodeTracker *)saved_states[i]->state;
       compat::inode_tracker_v3::Migrate(saved_inode_tracker,
@@ -2376,6 +2730,15 @@ static bool RestoreState(const int fd_progress,
     }
 
     if (saved_states[i]->state_id == loader::kStateGlueBufferV4) {
+      SendMsg2Socket(fd_progress, "Migrating inode tracker (v4 to v5)... ");
+      compat::inode_tracker_v4::InodeTracker *saved_inode_tracker =
+        (compat::inode_tracker_v4::InodeTracker *)saved_states[i]->state;
+      compat::inode_tracker_v4::Migrate(saved_inode_tracker,
+                                        cvmfs::mount_point_->inode_tracker());
+      SendMsg2Socket(fd_progress, " done\n");
+    }
+
+    if (saved_states[i]->state_id == loader::kStateGlueBufferV5) {
       SendMsg2Socket(fd_progress, "Restoring inode tracker... ");
       cvmfs::mount_point_->inode_tracker()->~InodeTracker();
       glue::InodeTracker *saved_inode_tracker =
@@ -2515,6 +2878,12 @@ static void FreeSavedState(const int fd_progress,
           saved_states[i]->state);
         break;
       case loader::kStateGlueBufferV4:
+        SendMsg2Socket(
+          fd_progress, "Releasing saved glue buffer (version 4)\n");
+        delete static_cast<compat::inode_tracker_v4::InodeTracker *>(
+          saved_states[i]->state);
+        break;
+      case loader::kStateGlueBufferV5:
         SendMsg2Socket(fd_progress, "Releasing saved glue buffer\n");
         delete static_cast<glue::InodeTracker *>(saved_states[i]->state);
         break;
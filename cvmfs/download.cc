@@ -11,7 +11,9 @@
  * blocks but there is a separate I/O thread using asynchronous I/O, which
  * maintains all concurrent connections simultaneously.  As there might be more
  * than 1024 file descriptors for the CernVM-FS process, the I/O thread uses
- * poll and the libcurl multi socket interface.
+ * poll and the libcurl multi socket interface.  With SetNumThreads(), the
+ * transfers are sharded by object hash across several I/O threads, each with
+ * its own libcurl multi handle and connection pool.
  *
  * While downloading, files can be decompressed and the secure hash can be
  * calculated on the fly.
@@ -61,6 +63,7 @@
 #include "util/concurrency.h"
 #include "util/exception.h"
 #include "util/logging.h"
+#include "util/murmur.hxx"
 #include "util/posix.h"
 #include "util/prng.h"
 #include "util/smalloc.h"
@@ -281,6 +284,32 @@ static size_t CallbackCurlHeader(void *ptr, size_t size, size_t nmemb,
 }
 
 
+/**
+ * Sets up the decompression stream of a compressed download.  Called again
+ * when the download is retried.
+ */
+static void InitDecompression(JobInfo *info) {
+  if (info->compression_alg == zlib::kZstdDefault) {
+    if (info->zstd_stream == NULL)
+      info->zstd_stream = zlib::ZstdDecompressInit();
+    else
+      zlib::ZstdDecompressReset(info->zstd_stream);
+  } else {
+    zlib::DecompressInit(&info->zstream);
+  }
+}
+
+
+static void FiniDecompression(JobInfo *info) {
+  if (info->compression_alg == zlib::kZstdDefault) {
+    zlib::ZstdDecompressFini(info->zstd_stream);
+    info->zstd_stream = NULL;
+  } else {
+    zlib::DecompressFini(&info->zstream);
+  }
+}
+
+
 /**
  * Called by curl for every received data chunk.
  */
@@ -303,8 +332,12 @@ static size_t CallbackCurlData(void *ptr, size_t size, size_t nmemb,
   if (info->destination == kDestinationSink) {
     if (info->compressed) {
       zlib::StreamStates retval =
-        zlib::DecompressZStream2Sink(ptr, static_cast<int64_t>(num_bytes),
-                                     &info->zstream, info->destination_sink);
+        (info->compression_alg == zlib::kZstdDefault)
+        ? zlib::DecompressZstdStream2Sink(ptr, static_cast<int64_t>(num_bytes),
+                                          info->zstd_stream,
+                                          info->destination_sink)
+        : zlib::DecompressZStream2Sink(ptr, static_cast<int64_t>(num_bytes),
+                                       &info->zstream, info->destination_sink);
       if (retval == zlib::kStreamDataError) {
         LogCvmfs(kLogDownload, kLogSyslogErr, "failed to decompress %s",
                  info->url->c_str());
@@ -351,8 +384,12 @@ static size_t CallbackCurlData(void *ptr, size_t size, size_t nmemb,
       // LogCvmfs(kLogDownload, kLogDebug, "REMOVE-ME: writing %d bytes for %s",
       //          num_bytes, info->url->c_str());
       zlib::StreamStates retval =
-        zlib::DecompressZStream2File(ptr, static_cast<int64_t>(num_bytes),
-                                     &info->zstream, info->destination_file);
+        (info->compression_alg == zlib::kZstdDefault)
+        ? zlib::DecompressZstdStream2File(ptr, static_cast<int64_t>(num_bytes),
+                                          info->zstd_stream,
+                                          info->destination_file)
+        : zlib::DecompressZStream2File(ptr, static_cast<int64_t>(num_bytes),
+                                       &info->zstream, info->destination_file);
       if (retval == zlib::kStreamDataError) {
         LogCvmfs(kLogDownload, kLogSyslogErr, "failed to decompress %s",
                  info->url->c_str());
@@ -426,60 +463,59 @@ int DownloadManager::CallbackCurlSocket(CURL * /* easy */,
 {
   // LogCvmfs(kLogDownload, kLogDebug, "CallbackCurlSocket called with easy "
   //          "handle %p, socket %d, action %d", easy, s, action);
-  DownloadManager *download_mgr = static_cast<DownloadManager *>(userp);
+  DownloadShard *shard = static_cast<DownloadShard *>(userp);
   if (action == CURL_POLL_NONE)
     return 0;
 
   // Find s in watch_fds_
   unsigned index;
-  for (index = 0; index < download_mgr->watch_fds_inuse_; ++index) {
-    if (download_mgr->watch_fds_[index].fd == s)
+  for (index = 0; index < shard->watch_fds_inuse; ++index) {
+    if (shard->watch_fds[index].fd == s)
       break;
   }
   // Or create newly
-  if (index == download_mgr->watch_fds_inuse_) {
+  if (index == shard->watch_fds_inuse) {
     // Extend array if necessary
-    if (download_mgr->watch_fds_inuse_ == download_mgr->watch_fds_size_)
-    {
-      assert(download_mgr->watch_fds_size_ > 0);
-      download_mgr->watch_fds_size_ *= 2;
-      download_mgr->watch_fds_ = static_cast<struct pollfd *>(
-        srealloc(download_mgr->watch_fds_,
-                 download_mgr->watch_fds_size_ * sizeof(struct pollfd)));
+    if (shard->watch_fds_inuse == shard->watch_fds_size) {
+      assert(shard->watch_fds_size > 0);
+      shard->watch_fds_size *= 2;
+      shard->watch_fds = static_cast<struct pollfd *>(
+        srealloc(shard->watch_fds,
+                 shard->watch_fds_size * sizeof(struct pollfd)));
     }
-    download_mgr->watch_fds_[download_mgr->watch_fds_inuse_].fd = s;
-    download_mgr->watch_fds_[download_mgr->watch_fds_inuse_].events = 0;
-    download_mgr->watch_fds_[download_mgr->watch_fds_inuse_].revents = 0;
-    download_mgr->watch_fds_inuse_++;
+    shard->watch_fds[shard->watch_fds_inuse].fd = s;
+    shard->watch_fds[shard->watch_fds_inuse].events = 0;
+    shard->watch_fds[shard->watch_fds_inuse].revents = 0;
+    shard->watch_fds_inuse++;
   }
 
   switch (action) {
     case CURL_POLL_IN:
-      download_mgr->watch_fds_[index].events = POLLIN | POLLPRI;
+      shard->watch_fds[index].events = POLLIN | POLLPRI;
       break;
     case CURL_POLL_OUT:
-      download_mgr->watch_fds_[index].events = POLLOUT | POLLWRBAND;
+      shard->watch_fds[index].events = POLLOUT | POLLWRBAND;
       break;
     case CURL_POLL_INOUT:
-      download_mgr->watch_fds_[index].events =
+      shard->watch_fds[index].events =
         POLLIN | POLLPRI | POLLOUT | POLLWRBAND;
       break;
     case CURL_POLL_REMOVE:
-      if (index < download_mgr->watch_fds_inuse_-1) {
-        download_mgr->watch_fds_[index] =
-          download_mgr->watch_fds_[download_mgr->watch_fds_inuse_-1];
+      if (index < shard->watch_fds_inuse-1) {
+        shard->watch_fds[index] =
+          shard->watch_fds[shard->watch_fds_inuse-1];
       }
-      download_mgr->watch_fds_inuse_--;
+      shard->watch_fds_inuse--;
       // Shrink array if necessary
-      if ((download_mgr->watch_fds_inuse_ > download_mgr->watch_fds_max_) &&
-          (download_mgr->watch_fds_inuse_ < download_mgr->watch_fds_size_/2))
+      if ((shard->watch_fds_inuse > shard->watch_fds_max) &&
+          (shard->watch_fds_inuse < shard->watch_fds_size/2))
       {
-        download_mgr->watch_fds_size_ /= 2;
+        shard->watch_fds_size /= 2;
         // LogCvmfs(kLogDownload, kLogDebug, "shrinking watch_fds_ (%d)",
         //          watch_fds_size_);
-        download_mgr->watch_fds_ = static_cast<struct pollfd *>(
-          srealloc(download_mgr->watch_fds_,
-                   download_mgr->watch_fds_size_*sizeof(struct pollfd)));
+        shard->watch_fds = static_cast<struct pollfd *>(
+          srealloc(shard->watch_fds,
+                   shard->watch_fds_size*sizeof(struct pollfd)));
         // LogCvmfs(kLogDownload, kLogDebug, "shrinking watch_fds_ done",
         //          watch_fds_size_);
       }
@@ -496,19 +532,21 @@ int DownloadManager::CallbackCurlSocket(CURL * /* easy */,
  * Worker thread event loop.  Waits on new JobInfo structs on a pipe.
  */
 void *DownloadManager::MainDownload(void *data) {
-  LogCvmfs(kLogDownload, kLogDebug, "download I/O thread started");
-  DownloadManager *download_mgr = static_cast<DownloadManager *>(data);
+  DownloadShard *shard = static_cast<DownloadShard *>(data);
+  DownloadManager *download_mgr = shard->download_mgr;
+  LogCvmfs(kLogDownload, kLogDebug, "download I/O thread %u started",
+           shard->index);
 
-  download_mgr->watch_fds_ =
+  shard->watch_fds =
     static_cast<struct pollfd *>(smalloc(2 * sizeof(struct pollfd)));
-  download_mgr->watch_fds_size_ = 2;
-  download_mgr->watch_fds_[0].fd = download_mgr->pipe_terminate_[0];
-  download_mgr->watch_fds_[0].events = POLLIN | POLLPRI;
-  download_mgr->watch_fds_[0].revents = 0;
-  download_mgr->watch_fds_[1].fd = download_mgr->pipe_jobs_[0];
-  download_mgr->watch_fds_[1].events = POLLIN | POLLPRI;
-  download_mgr->watch_fds_[1].revents = 0;
-  download_mgr->watch_fds_inuse_ = 2;
+  shard->watch_fds_size = 2;
+  shard->watch_fds[0].fd = shard->pipe_terminate[0];
+  shard->watch_fds[0].events = POLLIN | POLLPRI;
+  shard->watch_fds[0].revents = 0;
+  shard->watch_fds[1].fd = shard->pipe_jobs[0];
+  shard->watch_fds[1].events = POLLIN | POLLPRI;
+  shard->watch_fds[1].revents = 0;
+  shard->watch_fds_inuse = 2;
 
   int still_running = 0;
   struct timeval timeval_start, timeval_stop;
@@ -532,38 +570,39 @@ void *DownloadManager::MainDownload(void *data) {
       int64_t delta = static_cast<int64_t>(
         1000 * DiffTimeSeconds(timeval_start, timeval_stop));
       perf::Xadd(download_mgr->counters_->sz_transfer_time, delta);
+      if (shard->counters)
+        perf::Xadd(shard->counters->sz_transfer_time, delta);
     }
-    int retval = poll(download_mgr->watch_fds_, download_mgr->watch_fds_inuse_,
-                      timeout);
+    int retval = poll(shard->watch_fds, shard->watch_fds_inuse, timeout);
     if (retval < 0) {
       continue;
     }
 
     // Handle timeout
     if (retval == 0) {
-      curl_multi_socket_action(download_mgr->curl_multi_,
+      curl_multi_socket_action(shard->curl_multi,
                                CURL_SOCKET_TIMEOUT,
                                0,
                                &still_running);
     }
 
     // Terminate I/O thread
-    if (download_mgr->watch_fds_[0].revents)
+    if (shard->watch_fds[0].revents)
       break;
 
     // New job arrives
-    if (download_mgr->watch_fds_[1].revents) {
-      download_mgr->watch_fds_[1].revents = 0;
+    if (shard->watch_fds[1].revents) {
+      shard->watch_fds[1].revents = 0;
       JobInfo *info;
       // NOLINTNEXTLINE(bugprone-sizeof-expression)
-      ReadPipe(download_mgr->pipe_jobs_[0], &info, sizeof(info));
+      ReadPipe(shard->pipe_jobs[0], &info, sizeof(info));
       if (!still_running)
         gettimeofday(&timeval_start, NULL);
-      CURL *handle = download_mgr->AcquireCurlHandle();
+      CURL *handle = download_mgr->AcquireCurlHandle(shard);
       download_mgr->InitializeRequest(info, handle);
       download_mgr->SetUrlOptions(info);
-      curl_multi_add_handle(download_mgr->curl_multi_, handle);
-      curl_multi_socket_action(download_mgr->curl_multi_,
+      curl_multi_add_handle(shard->curl_multi, handle);
+      curl_multi_socket_action(shard->curl_multi,
                                CURL_SOCKET_TIMEOUT,
                                0,
                                &still_running);
@@ -574,25 +613,25 @@ void *DownloadManager::MainDownload(void *data) {
     // to be removed from watch_fds_. If a socket is removed it is replaced
     // by the socket at the end of the array and the inuse count is decreased.
     // Therefore loop over the array in reverse order.
-    for (int64_t i = download_mgr->watch_fds_inuse_-1; i >= 2; --i) {
-      if (i >= download_mgr->watch_fds_inuse_) {
+    for (int64_t i = shard->watch_fds_inuse-1; i >= 2; --i) {
+      if (i >= shard->watch_fds_inuse) {
         continue;
       }
-      if (download_mgr->watch_fds_[i].revents) {
+      if (shard->watch_fds[i].revents) {
         int ev_bitmask = 0;
-        if (download_mgr->watch_fds_[i].revents & (POLLIN | POLLPRI))
+        if (shard->watch_fds[i].revents & (POLLIN | POLLPRI))
           ev_bitmask |= CURL_CSELECT_IN;
-        if (download_mgr->watch_fds_[i].revents & (POLLOUT | POLLWRBAND))
+        if (shard->watch_fds[i].revents & (POLLOUT | POLLWRBAND))
           ev_bitmask |= CURL_CSELECT_OUT;
-        if (download_mgr->watch_fds_[i].revents &
+        if (shard->watch_fds[i].revents &
             (POLLERR | POLLHUP | POLLNVAL))
         {
           ev_bitmask |= CURL_CSELECT_ERR;
         }
-        download_mgr->watch_fds_[i].revents = 0;
+        shard->watch_fds[i].revents = 0;
 
-        curl_multi_socket_action(download_mgr->curl_multi_,
-                                 download_mgr->watch_fds_[i].fd,
+        curl_multi_socket_action(shard->curl_multi,
+                                 shard->watch_fds[i].fd,
                                  ev_bitmask,
                                  &still_running);
       }
@@ -601,26 +640,28 @@ void *DownloadManager::MainDownload(void *data) {
     // Check if transfers are completed
     CURLMsg *curl_msg;
     int msgs_in_queue;
-    while ((curl_msg = curl_multi_info_read(download_mgr->curl_multi_,
+    while ((curl_msg = curl_multi_info_read(shard->curl_multi,
                                             &msgs_in_queue)))
     {
       if (curl_msg->msg == CURLMSG_DONE) {
         perf::Inc(download_mgr->counters_->n_requests);
+        if (shard->counters)
+          perf::Inc(shard->counters->n_requests);
         JobInfo *info;
         CURL *easy_handle = curl_msg->easy_handle;
         int curl_error = curl_msg->data.result;
         curl_easy_getinfo(easy_handle, CURLINFO_PRIVATE, &info);
 
-        curl_multi_remove_handle(download_mgr->curl_multi_, easy_handle);
+        curl_multi_remove_handle(shard->curl_multi, easy_handle);
         if (download_mgr->VerifyAndFinalize(curl_error, info)) {
-          curl_multi_add_handle(download_mgr->curl_multi_, easy_handle);
-          curl_multi_socket_action(download_mgr->curl_multi_,
+          curl_multi_add_handle(shard->curl_multi, easy_handle);
+          curl_multi_socket_action(shard->curl_multi,
                                    CURL_SOCKET_TIMEOUT,
                                    0,
                                    &still_running);
         } else {
           // Return easy handle into pool and write result back
-          download_mgr->ReleaseCurlHandle(easy_handle);
+          download_mgr->ReleaseCurlHandle(shard, easy_handle);
 
           WritePipe(info->wait_at[1], &info->error_code,
                     sizeof(info->error_code));
@@ -629,16 +670,17 @@ void *DownloadManager::MainDownload(void *data) {
     }
   }
 
-  for (set<CURL *>::iterator i = download_mgr->pool_handles_inuse_->begin(),
-       iEnd = download_mgr->pool_handles_inuse_->end(); i != iEnd; ++i)
+  for (set<CURL *>::iterator i = shard->pool_handles_inuse->begin(),
+       iEnd = shard->pool_handles_inuse->end(); i != iEnd; ++i)
   {
-    curl_multi_remove_handle(download_mgr->curl_multi_, *i);
+    curl_multi_remove_handle(shard->curl_multi, *i);
     curl_easy_cleanup(*i);
   }
-  download_mgr->pool_handles_inuse_->clear();
-  free(download_mgr->watch_fds_);
+  shard->pool_handles_inuse->clear();
+  free(shard->watch_fds);
 
-  LogCvmfs(kLogDownload, kLogDebug, "download I/O thread terminated");
+  LogCvmfs(kLogDownload, kLogDebug, "download I/O thread %u terminated",
+           shard->index);
   return NULL;
 }
 
@@ -793,10 +835,10 @@ string DownloadManager::ProxyInfo::Print() {
  * Gets an idle CURL handle from the pool. Creates a new one and adds it to
  * the pool if necessary.
  */
-CURL *DownloadManager::AcquireCurlHandle() {
+CURL *DownloadManager::AcquireCurlHandle(DownloadShard *shard) {
   CURL *handle;
 
-  if (pool_handles_idle_->empty()) {
+  if (shard->pool_handles_idle->empty()) {
     // Create a new handle
     handle = curl_easy_init();
     assert(handle != NULL);
@@ -806,27 +848,27 @@ CURL *DownloadManager::AcquireCurlHandle() {
     curl_easy_setopt(handle, CURLOPT_HEADERFUNCTION, CallbackCurlHeader);
     curl_easy_setopt(handle, CURLOPT_WRITEFUNCTION, CallbackCurlData);
   } else {
-    handle = *(pool_handles_idle_->begin());
-    pool_handles_idle_->erase(pool_handles_idle_->begin());
+    handle = *(shard->pool_handles_idle->begin());
+    shard->pool_handles_idle->erase(shard->pool_handles_idle->begin());
   }
 
-  pool_handles_inuse_->insert(handle);
+  shard->pool_handles_inuse->insert(handle);
 
   return handle;
 }
 
 
-void DownloadManager::ReleaseCurlHandle(CURL *handle) {
-  set<CURL *>::iterator elem = pool_handles_inuse_->find(handle);
-  assert(elem != pool_handles_inuse_->end());
+void DownloadManager::ReleaseCurlHandle(DownloadShard *shard, CURL *handle) {
+  set<CURL *>::iterator elem = shard->pool_handles_inuse->find(handle);
+  assert(elem != shard->pool_handles_inuse->end());
 
-  if (pool_handles_idle_->size() > pool_max_handles_) {
+  if (shard->pool_handles_idle->size() > pool_max_handles_) {
     curl_easy_cleanup(*elem);
   } else {
-    pool_handles_idle_->insert(*elem);
+    shard->pool_handles_idle->insert(*elem);
   }
 
-  pool_handles_inuse_->erase(elem);
+  shard->pool_handles_inuse->erase(elem);
 }
 
 
@@ -844,9 +886,10 @@ void DownloadManager::InitializeRequest(JobInfo *info, CURL *handle) {
   info->num_used_hosts = 1;
   info->num_retries = 0;
   info->backoff_ms = 0;
-  info->headers = header_lists_->DuplicateList(default_headers_);
+  HeaderLists *header_lists = info->shard->header_lists;
+  info->headers = header_lists->DuplicateList(info->shard->default_headers);
   if (info->info_header) {
-    header_lists_->AppendHeader(info->headers, info->info_header);
+    header_lists->AppendHeader(info->headers, info->info_header);
   }
   if (info->force_nocache) {
     SetNocache(info);
@@ -854,7 +897,7 @@ void DownloadManager::InitializeRequest(JobInfo *info, CURL *handle) {
     info->nocache = false;
   }
   if (info->compressed) {
-    zlib::DecompressInit(&(info->zstream));
+    InitDecompression(info);
   }
   if (info->expected_hash) {
     assert(info->hash_context.buffer != NULL);
@@ -1126,7 +1169,7 @@ bool DownloadManager::ValidateProxyIpsUnlocked(
 /**
  * Adds transfer time and downloaded bytes to the global counters.
  */
-void DownloadManager::UpdateStatistics(CURL *handle) {
+void DownloadManager::UpdateStatistics(DownloadShard *shard, CURL *handle) {
   double val;
   int retval;
   int64_t sum = 0;
@@ -1138,6 +1181,8 @@ void DownloadManager::UpdateStatistics(CURL *handle) {
   assert(retval == CURLE_OK);
   sum += static_cast<int64_t>(val);*/
   perf::Xadd(counters_->sz_transferred_bytes, sum);
+  if (shard->counters)
+    perf::Xadd(shard->counters->sz_transferred_bytes, sum);
 }
 
 
@@ -1171,8 +1216,11 @@ void DownloadManager::Backoff(JobInfo *info) {
 
   info->num_retries++;
   perf::Inc(counters_->n_retries);
+  if (info->shard->counters)
+    perf::Inc(info->shard->counters->n_retries);
   if (info->backoff_ms == 0) {
-    info->backoff_ms = prng_.Next(backoff_init_ms + 1);  // Must be != 0
+    // Must be != 0
+    info->backoff_ms = info->shard->prng.Next(backoff_init_ms + 1);
   } else {
     info->backoff_ms *= 2;
   }
@@ -1185,8 +1233,9 @@ void DownloadManager::Backoff(JobInfo *info) {
 void DownloadManager::SetNocache(JobInfo *info) {
   if (info->nocache)
     return;
-  header_lists_->AppendHeader(info->headers, "Pragma: no-cache");
-  header_lists_->AppendHeader(info->headers, "Cache-Control: no-cache");
+  HeaderLists *header_lists = info->shard->header_lists;
+  header_lists->AppendHeader(info->headers, "Pragma: no-cache");
+  header_lists->AppendHeader(info->headers, "Cache-Control: no-cache");
   curl_easy_setopt(info->curl_handle, CURLOPT_HTTPHEADER, info->headers);
   info->nocache = true;
 }
@@ -1199,8 +1248,9 @@ void DownloadManager::SetNocache(JobInfo *info) {
 void DownloadManager::SetRegularCache(JobInfo *info) {
   if (info->nocache == false)
     return;
-  header_lists_->CutHeader("Pragma: no-cache", &(info->headers));
-  header_lists_->CutHeader("Cache-Control: no-cache", &(info->headers));
+  HeaderLists *header_lists = info->shard->header_lists;
+  header_lists->CutHeader("Pragma: no-cache", &(info->headers));
+  header_lists->CutHeader("Cache-Control: no-cache", &(info->headers));
   curl_easy_setopt(info->curl_handle, CURLOPT_HTTPHEADER, info->headers);
   info->nocache = false;
 }
@@ -1229,7 +1279,7 @@ bool DownloadManager::VerifyAndFinalize(const int curl_error, JobInfo *info) {
   LogCvmfs(kLogDownload, kLogDebug,
            "Verify downloaded url %s, proxy %s (curl error %d)",
            info->url->c_str(), info->proxy.c_str(), curl_error);
-  UpdateStatistics(info->curl_handle);
+  UpdateStatistics(info->shard, info->curl_handle);
 
   // Verification and error classification
   switch (curl_error) {
@@ -1252,10 +1302,15 @@ bool DownloadManager::VerifyAndFinalize(const int curl_error, JobInfo *info) {
       if ((info->destination == kDestinationMem) && info->compressed) {
         void *buf;
         uint64_t size;
-        bool retval = zlib::DecompressMem2Mem(
-          info->destination_mem.data,
-          static_cast<int64_t>(info->destination_mem.pos),
-          &buf, &size);
+        bool retval = (info->compression_alg == zlib::kZstdDefault)
+          ? zlib::DecompressZstdMem2Mem(
+              info->destination_mem.data,
+              static_cast<int64_t>(info->destination_mem.pos),
+              &buf, &size)
+          : zlib::DecompressMem2Mem(
+              info->destination_mem.data,
+              static_cast<int64_t>(info->destination_mem.pos),
+              &buf, &size);
         if (retval) {
           free(info->destination_mem.data);
           info->destination_mem.data = static_cast<char *>(buf);
@@ -1436,7 +1491,7 @@ bool DownloadManager::VerifyAndFinalize(const int curl_error, JobInfo *info) {
     if (info->expected_hash)
       shash::Init(info->hash_context);
     if (info->compressed)
-      zlib::DecompressInit(&info->zstream);
+      InitDecompression(info);
     SetRegularCache(info);
 
     // Failure handling
@@ -1503,10 +1558,10 @@ bool DownloadManager::VerifyAndFinalize(const int curl_error, JobInfo *info) {
   }
 
   if (info->compressed)
-    zlib::DecompressFini(&info->zstream);
+    FiniDecompression(info);
 
   if (info->headers) {
-    header_lists_->PutList(info->headers);
+    info->shard->header_lists->PutList(info->headers);
     info->headers = NULL;
   }
 
@@ -1514,21 +1569,34 @@ bool DownloadManager::VerifyAndFinalize(const int curl_error, JobInfo *info) {
 }
 
 
+DownloadShard::DownloadShard(DownloadManager *m, const unsigned i)
+  : download_mgr(m)
+  , index(i)
+  , pool_handles_idle(NULL)
+  , pool_handles_inuse(NULL)
+  , curl_multi(NULL)
+  , header_lists(NULL)
+  , default_headers(NULL)
+  , watch_fds(NULL)
+  , watch_fds_size(0)
+  , watch_fds_inuse(0)
+  , watch_fds_max(0)
+  , counters(NULL)
+{
+  pipe_terminate[0] = pipe_terminate[1] = -1;
+  pipe_jobs[0] = pipe_jobs[1] = -1;
+}
+
+
+//------------------------------------------------------------------------------
+
+
 DownloadManager::DownloadManager() {
-  pool_handles_idle_ = NULL;
-  pool_handles_inuse_ = NULL;
   pool_max_handles_ = 0;
-  curl_multi_ = NULL;
-  default_headers_ = NULL;
+  user_agent_ = NULL;
+  statistics_ = NULL;
 
   atomic_init32(&multi_threaded_);
-  pipe_terminate_[0] = pipe_terminate_[1] = -1;
-
-  pipe_jobs_[0] = pipe_jobs_[1] = -1;
-  watch_fds_ = NULL;
-  watch_fds_size_ = 0;
-  watch_fds_inuse_ = 0;
-  watch_fds_max_ = 0;
 
   lock_options_ =
   reinterpret_cast<pthread_mutex_t *>(smalloc(sizeof(pthread_mutex_t)));
@@ -1558,6 +1626,7 @@ DownloadManager::DownloadManager() {
   enable_info_header_ = false;
   opt_ipv4_only_ = false;
   follow_redirects_ = false;
+  opt_num_threads_ = 1;
 
   resolver_ = NULL;
 
@@ -1594,19 +1663,91 @@ void DownloadManager::InitHeaders() {
     sanitizer::InputSanitizer("az AZ 09 -").Filter(getenv("CERNVM_UUID"));
   }
   user_agent_ = strdup(cernvm_id.c_str());
+}
 
-  header_lists_ = new HeaderLists();
 
-  default_headers_ = header_lists_->GetList("Connection: Keep-Alive");
-  header_lists_->AppendHeader(default_headers_, "Pragma:");
-  header_lists_->AppendHeader(default_headers_, user_agent_);
+void DownloadManager::FiniHeaders() {
+  if (user_agent_)
+    free(user_agent_);
+  user_agent_ = NULL;
 }
 
 
-void DownloadManager::FiniHeaders() {
-  delete header_lists_;
-  header_lists_ = NULL;
-  default_headers_ = NULL;
+/**
+ * Creates the connection pool, the curl multi handle, and the header lists of
+ * a new shard.  Requires InitHeaders() to have been called.
+ */
+DownloadShard *DownloadManager::CreateShard(const unsigned index) {
+  DownloadShard *shard = new DownloadShard(this, index);
+  shard->prng.InitLocaltime();
+  shard->pool_handles_idle = new set<CURL *>;
+  shard->pool_handles_inuse = new set<CURL *>;
+  shard->watch_fds_max = 4*pool_max_handles_;
+
+  shard->header_lists = new HeaderLists();
+  shard->default_headers =
+    shard->header_lists->GetList("Connection: Keep-Alive");
+  shard->header_lists->AppendHeader(shard->default_headers, "Pragma:");
+  shard->header_lists->AppendHeader(shard->default_headers, user_agent_);
+
+  shard->curl_multi = curl_multi_init();
+  assert(shard->curl_multi != NULL);
+  curl_multi_setopt(shard->curl_multi, CURLMOPT_SOCKETFUNCTION,
+                    CallbackCurlSocket);
+  curl_multi_setopt(shard->curl_multi, CURLMOPT_SOCKETDATA,
+                    static_cast<void *>(shard));
+  curl_multi_setopt(shard->curl_multi, CURLMOPT_MAXCONNECTS,
+                    shard->watch_fds_max);
+  curl_multi_setopt(shard->curl_multi, CURLMOPT_MAX_TOTAL_CONNECTIONS,
+                    pool_max_handles_);
+  return shard;
+}
+
+
+/**
+ * Stops the I/O thread of the shard, if any, and frees its resources.
+ */
+void DownloadManager::DestroyShard(DownloadShard *shard) {
+  if (shard->pipe_terminate[1] >= 0) {
+    char buf = 'T';
+    WritePipe(shard->pipe_terminate[1], &buf, 1);
+    pthread_join(shard->thread_download, NULL);
+    // All handles are removed from the multi stack
+    close(shard->pipe_terminate[1]);
+    close(shard->pipe_terminate[0]);
+    close(shard->pipe_jobs[1]);
+    close(shard->pipe_jobs[0]);
+  }
+
+  for (set<CURL *>::iterator i = shard->pool_handles_idle->begin(),
+       iEnd = shard->pool_handles_idle->end(); i != iEnd; ++i)
+  {
+    curl_easy_cleanup(*i);
+  }
+  delete shard->pool_handles_idle;
+  delete shard->pool_handles_inuse;
+  curl_multi_cleanup(shard->curl_multi);
+  delete shard->header_lists;
+  delete shard->counters;
+  delete shard;
+}
+
+
+/**
+ * Transfers of the same object always end up in the same shard.  Objects
+ * without a content hash (manifest, whitelist, ...) are distributed by URL.
+ */
+DownloadShard *DownloadManager::SelectShard(const JobInfo *info) {
+  if (shards_.size() == 1)
+    return shards_[0];
+
+  uint32_t key;
+  if (info->expected_hash) {
+    key = info->expected_hash->Partial32();
+  } else {
+    key = MurmurHash2(info->url->data(), info->url->length(), 0x9ce603);
+  }
+  return shards_[key % shards_.size()];
 }
 
 
@@ -1616,10 +1757,7 @@ void DownloadManager::Init(const unsigned max_pool_handles,
   atomic_init32(&multi_threaded_);
   int retval = curl_global_init(CURL_GLOBAL_ALL);
   assert(retval == CURLE_OK);
-  pool_handles_idle_ = new set<CURL *>;
-  pool_handles_inuse_ = new set<CURL *>;
   pool_max_handles_ = max_pool_handles;
-  watch_fds_max_ = 4*pool_max_handles_;
 
   opt_timeout_proxy_ = 5;
   opt_timeout_direct_ = 10;
@@ -1632,18 +1770,12 @@ void DownloadManager::Init(const unsigned max_pool_handles,
   opt_ip_preference_ = dns::kIpPreferSystem;
 
   counters_ = new Counters(statistics);
+  statistics_ = new perf::StatisticsTemplate(statistics);
 
   user_agent_ = NULL;
   InitHeaders();
 
-  curl_multi_ = curl_multi_init();
-  assert(curl_multi_ != NULL);
-  curl_multi_setopt(curl_multi_, CURLMOPT_SOCKETFUNCTION, CallbackCurlSocket);
-  curl_multi_setopt(curl_multi_, CURLMOPT_SOCKETDATA,
-                    static_cast<void *>(this));
-  curl_multi_setopt(curl_multi_, CURLMOPT_MAXCONNECTS, watch_fds_max_);
-  curl_multi_setopt(curl_multi_, CURLMOPT_MAX_TOTAL_CONNECTIONS,
-                    pool_max_handles_);
+  shards_.push_back(CreateShard(0));
 
   prng_.InitLocaltime();
 
@@ -1660,37 +1792,17 @@ void DownloadManager::Init(const unsigned max_pool_handles,
 
 
 void DownloadManager::Fini() {
-  if (atomic_xadd32(&multi_threaded_, 0) == 1) {
-    // Shutdown I/O thread
-    char buf = 'T';
-    WritePipe(pipe_terminate_[1], &buf, 1);
-    pthread_join(thread_download_, NULL);
-    // All handles are removed from the multi stack
-    close(pipe_terminate_[1]);
-    close(pipe_terminate_[0]);
-    close(pipe_jobs_[1]);
-    close(pipe_jobs_[0]);
-  }
-
-  for (set<CURL *>::iterator i = pool_handles_idle_->begin(),
-       iEnd = pool_handles_idle_->end(); i != iEnd; ++i)
-  {
-    curl_easy_cleanup(*i);
-  }
-  delete pool_handles_idle_;
-  delete pool_handles_inuse_;
-  curl_multi_cleanup(curl_multi_);
-  pool_handles_idle_ = NULL;
-  pool_handles_inuse_ = NULL;
-  curl_multi_ = NULL;
+  // Shutdown I/O threads
+  for (unsigned i = 0; i < shards_.size(); ++i)
+    DestroyShard(shards_[i]);
+  shards_.clear();
 
   FiniHeaders();
-  if (user_agent_)
-    free(user_agent_);
-  user_agent_ = NULL;
 
   delete counters_;
   counters_ = NULL;
+  delete statistics_;
+  statistics_ = NULL;
 
   delete opt_host_chain_;
   delete opt_host_chain_rtt_;
@@ -1708,16 +1820,28 @@ void DownloadManager::Fini() {
 
 
 /**
- * Spawns the I/O worker thread and switches the module in multi-threaded mode.
- * No way back except Fini(); Init();
+ * Spawns the I/O worker threads and switches the module in multi-threaded
+ * mode.  No way back except Fini(); Init();
  */
 void DownloadManager::Spawn() {
-  MakePipe(pipe_terminate_);
-  MakePipe(pipe_jobs_);
+  for (unsigned i = shards_.size(); i < opt_num_threads_; ++i)
+    shards_.push_back(CreateShard(i));
+  if (shards_.size() > 1) {
+    for (unsigned i = 0; i < shards_.size(); ++i) {
+      shards_[i]->counters = new Counters(
+        perf::StatisticsTemplate("shard" + StringifyInt(i), *statistics_));
+    }
+  }
 
-  int retval = pthread_create(&thread_download_, NULL, MainDownload,
-                              static_cast<void *>(this));
-  assert(retval == 0);
+  for (unsigned i = 0; i < shards_.size(); ++i) {
+    DownloadShard *shard = shards_[i];
+    MakePipe(shard->pipe_terminate);
+    MakePipe(shard->pipe_jobs);
+
+    int retval = pthread_create(&shard->thread_download, NULL, MainDownload,
+                                static_cast<void *>(shard));
+    assert(retval == 0);
+  }
 
   atomic_inc32(&multi_threaded_);
 }
@@ -1761,15 +1885,17 @@ Failures DownloadManager::Fetch(JobInfo *info) {
       MakePipe(info->wait_at);
     }
 
+    info->shard = SelectShard(info);
     // LogCvmfs(kLogDownload, kLogDebug, "send job to thread, pipe %d %d",
     //          info->wait_at[0], info->wait_at[1]);
     // NOLINTNEXTLINE(bugprone-sizeof-expression)
-    WritePipe(pipe_jobs_[1], &info, sizeof(info));
+    WritePipe(info->shard->pipe_jobs[1], &info, sizeof(info));
     ReadPipe(info->wait_at[0], &result, sizeof(result));
     // LogCvmfs(kLogDownload, kLogDebug, "got result %d", result);
   } else {
     MutexLockGuard l(lock_synchronous_mode_);
-    CURL *handle = AcquireCurlHandle();
+    info->shard = shards_[0];
+    CURL *handle = AcquireCurlHandle(info->shard);
     InitializeRequest(info, handle);
     SetUrlOptions(info);
     // curl_easy_setopt(handle, CURLOPT_VERBOSE, 1);
@@ -1785,7 +1911,7 @@ Failures DownloadManager::Fetch(JobInfo *info) {
       }
     } while (VerifyAndFinalize(retval, info));
     result = info->error_code;
-    ReleaseCurlHandle(info->curl_handle);
+    ReleaseCurlHandle(info->shard, info->curl_handle);
   }
 
   if (result != kFailOk) {
@@ -1988,6 +2114,8 @@ void DownloadManager::SwitchProxy(JobInfo *info) {
       swap((*group)[i],
            (*group)[group_size - opt_proxy_groups_current_burned_]);
       perf::Inc(counters_->n_proxy_failover);
+      if (info->shard && info->shard->counters)
+        perf::Inc(info->shard->counters->n_proxy_failover);
       failed++;
     }
   }
@@ -2062,6 +2190,8 @@ void DownloadManager::SwitchHost(JobInfo *info) {
   opt_host_chain_current_ =
       (opt_host_chain_current_ + 1) % opt_host_chain_->size();
   perf::Inc(counters_->n_host_failover);
+  if (info && info->shard && info->shard->counters)
+    perf::Inc(info->shard->counters->n_host_failover);
   LogCvmfs(kLogDownload, kLogDebug | kLogSyslogWarn,
            "switching host from %s to %s (%s)", old_host.c_str(),
            (*opt_host_chain_)[opt_host_chain_current_].c_str(),
@@ -2773,6 +2903,19 @@ void DownloadManager::UseSystemCertificatePath() {
   ssl_certificate_store_.UseSystemCertificatePath();
 }
 
+
+/**
+ * Number of I/O threads used in multi-threaded mode.  Every thread maintains
+ * its own connection pool of up to max_pool_handles connections.  Needs to be
+ * called before Spawn().
+ */
+void DownloadManager::SetNumThreads(const unsigned num_threads) {
+  assert(atomic_xadd32(&multi_threaded_, 0) == 0);
+  opt_num_threads_ = (num_threads == 0) ? 1 : num_threads;
+  if (opt_num_threads_ > kMaxNumThreads)
+    opt_num_threads_ = kMaxNumThreads;
+}
+
 /**
  * Creates a copy of the existing download manager.  Must only be called in
  * single-threaded stage because it calls curl_global_init().
@@ -2797,6 +2940,7 @@ DownloadManager *DownloadManager::Clone(
   clone->opt_backoff_max_ms_ = opt_backoff_max_ms_;
   clone->enable_info_header_ = enable_info_header_;
   clone->follow_redirects_ = follow_redirects_;
+  clone->opt_num_threads_ = opt_num_threads_;
   if (opt_host_chain_) {
     clone->opt_host_chain_ = new vector<string>(*opt_host_chain_);
     clone->opt_host_chain_rtt_ = new vector<int>(*opt_host_chain_rtt_);
@@ -32,6 +32,8 @@ class InterruptCue;
 
 namespace download {
 
+struct DownloadShard;
+
 /**
  * Possible return values.  Adjust ObjectFetcher error handling if new network
  * error conditions are added.
@@ -154,6 +156,10 @@ struct Counters {
 struct JobInfo {
   const std::string *url;
   bool compressed;
+  /**
+   * zlib or zstd, only relevant if compressed is set
+   */
+  zlib::Algorithms compression_alg;
   bool probe_hosts;
   bool head_request;
   bool follow_redirects;
@@ -183,6 +189,7 @@ struct JobInfo {
   void Init() {
     url = NULL;
     compressed = false;
+    compression_alg = zlib::kZlibDefault;
     probe_hosts = false;
     head_request = false;
     follow_redirects = false;
@@ -204,6 +211,7 @@ struct JobInfo {
     curl_handle = NULL;
     headers = NULL;
     memset(&zstream, 0, sizeof(zstream));
+    zstd_stream = NULL;
     info_header = NULL;
     wait_at[0] = wait_at[1] = -1;
     nocache = false;
@@ -211,6 +219,7 @@ struct JobInfo {
     num_used_proxies = num_used_hosts = num_retries = 0;
     backoff_ms = 0;
     current_host_chain_index = 0;
+    shard = NULL;
 
     range_offset = -1;
     range_size = -1;
@@ -287,6 +296,7 @@ struct JobInfo {
   curl_slist *headers;
   char *info_header;
   z_stream zstream;
+  ZSTD_DStream *zstd_stream;
   shash::ContextPtr hash_context;
   int wait_at[2];  /**< Pipe used for the return value */
   std::string proxy;
@@ -298,6 +308,7 @@ struct JobInfo {
   unsigned char num_retries;
   unsigned backoff_ms;
   unsigned int current_host_chain_index;
+  DownloadShard *shard;  /**< The I/O thread that processes the transfer */
 };  // JobInfo
 
 
@@ -348,6 +359,44 @@ class CredentialsAttachment {
 };
 
 
+class DownloadManager;
+
+/**
+ * State of a single download I/O thread.  By default, there is only one shard.
+ * With SetNumThreads(), the download manager spawns one I/O thread per shard.
+ * Every shard owns its curl multi handle, its connection pool, and its header
+ * lists so that transfers in different shards only share the download
+ * manager's options (which are protected by lock_options_).  In synchronous
+ * mode, shard 0 is used by all transfers.
+ */
+struct DownloadShard {
+  DownloadShard(DownloadManager *m, const unsigned i);
+
+  DownloadManager *download_mgr;
+  unsigned index;
+  Prng prng;
+  std::set<CURL *> *pool_handles_idle;
+  std::set<CURL *> *pool_handles_inuse;
+  CURLM *curl_multi;
+  HeaderLists *header_lists;
+  curl_slist *default_headers;
+
+  pthread_t thread_download;
+  int pipe_terminate[2];
+  int pipe_jobs[2];
+  struct pollfd *watch_fds;
+  uint32_t watch_fds_size;
+  uint32_t watch_fds_inuse;
+  uint32_t watch_fds_max;
+
+  /**
+   * Only registered if there is more than one shard.  The counters of the
+   * download manager always carry the sum over all the shards.
+   */
+  Counters *counters;
+};  // DownloadShard
+
+
 /**
  * Note when adding new fields: Clone() probably needs to be adjusted, too.
  * TODO(jblomer): improve ordering of members
@@ -397,6 +446,10 @@ class DownloadManager {  // NOLINT(clang-analyzer-optin.performance.Padding)
   static const unsigned kDnsDefaultRetries = 1;
   static const unsigned kDnsDefaultTimeoutMs = 3000;
   static const unsigned kProxyMapScale = 16;
+  /**
+   * Upper limit for the number of download I/O threads
+   */
+  static const unsigned kMaxNumThreads = 64;
 
   DownloadManager();
   ~DownloadManager();
@@ -453,7 +506,9 @@ class DownloadManager {  // NOLINT(clang-analyzer-optin.performance.Padding)
   void EnableInfoHeader();
   void EnableRedirects();
   void UseSystemCertificatePath();
+  void SetNumThreads(const unsigned num_threads);
 
+  unsigned num_threads() const { return opt_num_threads_; }
   unsigned num_hosts() {
     if (opt_host_chain_) return opt_host_chain_->size();
     return 0;
@@ -477,13 +532,16 @@ class DownloadManager {  // NOLINT(clang-analyzer-optin.performance.Padding)
   ProxyInfo *ChooseProxyUnlocked(const shash::Any *hash);
   void UpdateProxiesUnlocked(const std::string &reason);
   void RebalanceProxiesUnlocked(const std::string &reason);
-  CURL *AcquireCurlHandle();
-  void ReleaseCurlHandle(CURL *handle);
+  DownloadShard *CreateShard(const unsigned index);
+  void DestroyShard(DownloadShard *shard);
+  DownloadShard *SelectShard(const JobInfo *info);
+  CURL *AcquireCurlHandle(DownloadShard *shard);
+  void ReleaseCurlHandle(DownloadShard *shard, CURL *handle);
   void ReleaseCredential(JobInfo *info);
   void InitializeRequest(JobInfo *info, CURL *handle);
   void SetUrlOptions(JobInfo *info);
   bool ValidateProxyIpsUnlocked(const std::string &url, const dns::Host &host);
-  void UpdateStatistics(CURL *handle);
+  void UpdateStatistics(DownloadShard *shard, CURL *handle);
   bool CanRetry(const JobInfo *info);
   void Backoff(JobInfo *info);
   void SetNocache(JobInfo *info);
@@ -499,23 +557,18 @@ class DownloadManager {  // NOLINT(clang-analyzer-optin.performance.Padding)
   }
 
   Prng prng_;
-  std::set<CURL *> *pool_handles_idle_;
-  std::set<CURL *> *pool_handles_inuse_;
   uint32_t pool_max_handles_;
-  CURLM *curl_multi_;
-  HeaderLists *header_lists_;
-  curl_slist *default_headers_;
   char *user_agent_;
 
-  pthread_t thread_download_;
+  /**
+   * Shard 0 is created by Init(), further shards by Spawn().
+   */
+  std::vector<DownloadShard *> shards_;
   atomic_int32 multi_threaded_;
-  int pipe_terminate_[2];
-
-  int pipe_jobs_[2];
-  struct pollfd *watch_fds_;
-  uint32_t watch_fds_size_;
-  uint32_t watch_fds_inuse_;
-  uint32_t watch_fds_max_;
+  /**
+   * Used to register the per-shard counters
+   */
+  perf::StatisticsTemplate *statistics_;
 
   pthread_mutex_t *lock_options_;
   pthread_mutex_t *lock_synchronous_mode_;
@@ -529,6 +582,7 @@ class DownloadManager {  // NOLINT(clang-analyzer-optin.performance.Padding)
   bool enable_info_header_;
   bool opt_ipv4_only_;
   bool follow_redirects_;
+  unsigned opt_num_threads_;
 
   // Host list
   std::vector<std::string> *opt_host_chain_;
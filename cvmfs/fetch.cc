@@ -130,6 +130,18 @@ int Fetcher::Fetch(
 
   perf::Inc(n_downloads);
 
+  // Objects from a newer server version that this client cannot decompress
+  if ((compression_algorithm != zlib::kZlibDefault) &&
+      (compression_algorithm != zlib::kNoCompression) &&
+      (compression_algorithm != zlib::kZstdDefault))
+  {
+    LogCvmfs(kLogCache, kLogDebug | kLogSyslogErr,
+             "unsupported compression algorithm %d for %s",
+             compression_algorithm, name.c_str());
+    SignalWaitingThreads(-EIO, id, tls);
+    return -EIO;
+  }
+
   // Involve the download manager
   LogCvmfs(kLogCache, kLogDebug, "downloading %s", name.c_str());
   std::string url;
@@ -161,7 +173,9 @@ int Fetcher::Fetch(
              &tls->download_job.pid,
              &tls->download_job.interrupt_cue);
   }
-  tls->download_job.compressed = (compression_algorithm == zlib::kZlibDefault);
+  tls->download_job.compressed =
+    (compression_algorithm != zlib::kNoCompression);
+  tls->download_job.compression_alg = compression_algorithm;
   tls->download_job.range_offset = range_offset;
   tls->download_job.range_size = size;
   download_mgr_->Fetch(&tls->download_job);
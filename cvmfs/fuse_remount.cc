@@ -316,9 +316,11 @@ void FuseRemounter::TryFinish(const shash::Any &root_hash) {
   mountpoint_->inode_cache()->Pause();
   mountpoint_->path_cache()->Pause();
   mountpoint_->md5path_cache()->Pause();
+  mountpoint_->negative_cache()->Pause();
   mountpoint_->inode_cache()->Drop();
   mountpoint_->path_cache()->Drop();
   mountpoint_->md5path_cache()->Drop();
+  mountpoint_->negative_cache()->Drop();
 
   // Ensure that all Fuse callbacks left the catalog query code
   fence_->Drain();
@@ -338,6 +340,7 @@ void FuseRemounter::TryFinish(const shash::Any &root_hash) {
   mountpoint_->inode_cache()->Resume();
   mountpoint_->path_cache()->Resume();
   mountpoint_->md5path_cache()->Resume();
+  mountpoint_->negative_cache()->Resume();
 
   atomic_xadd32(&drainout_mode_, -2);  // 2 --> 0, end of drainout mode
 
@@ -34,6 +34,7 @@
 
 #include <inttypes.h>
 
+#include <string>
 #include <vector>
 
 #include "catalog_traversal_parallel.h"
@@ -43,6 +44,12 @@
 
 template<class CatalogTraversalT, class HashFilterT>
 class GarbageCollector {
+ public:
+  /**
+   * Condemned objects are handed to the uploader in batches of this size
+   */
+  static const unsigned kRemoveBatchSize = 1000;
+
  protected:
   typedef typename CatalogTraversalT::ObjectFetcherTN ObjectFetcherTN;
   typedef typename ObjectFetcherTN::HistoryTN         HistoryTN;
@@ -111,6 +118,7 @@ class GarbageCollector {
 
   void CheckAndSweep(const shash::Any &hash);
   void Sweep(const shash::Any &hash);
+  void FlushRemoveBatch();
   bool RemoveCatalogFromReflog(const shash::Any &catalog);
 
   void PrintCatalogTreeEntry(const unsigned int  tree_level,
@@ -175,6 +183,16 @@ class GarbageCollector {
 
   unsigned int          condemned_objects_;
   uint64_t              condemned_bytes_;
+
+  /**
+   * Paths of condemned objects that are not yet handed to the uploader
+   */
+  std::vector<std::string> remove_batch_;
+  unsigned int          remove_batches_;
+  /**
+   * Start of the sweep phase in ns, used to report the deletion rate
+   */
+  uint64_t              sweep_start_ns_;
 };
 
 #include "garbage_collector_impl.h"
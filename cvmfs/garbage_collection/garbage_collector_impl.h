@@ -11,6 +11,7 @@
 #include <vector>
 
 #include "util/logging.h"
+#include "util/platform.h"
 #include "util/string.h"
 
 template<class CatalogTraversalT, class HashFilterT>
@@ -46,6 +47,8 @@ GarbageCollector<CatalogTraversalT, HashFilterT>::GarbageCollector(
   , last_reported_status_(0.0)
   , condemned_objects_(0)
   , condemned_bytes_(0)
+  , remove_batches_(0)
+  , sweep_start_ns_(0)
 {
   assert(configuration_.uploader != NULL);
 }
@@ -153,9 +156,14 @@ void GarbageCollector<CatalogTraversalT, HashFilterT>::SweepDataObjects(
     static_cast<float>(condemned_trees_) /
     static_cast<float>(unreferenced_trees_);
   if (threshold > last_reported_status_ + 0.1) {
+    const double elapsed_s = static_cast<double>(
+      platform_monotonic_time_ns() - sweep_start_ns_) / 1e9;
     LogCvmfs(kLogGc, kLogStdout | kLogDebug,
-             "      - %02.0f%%    %u / %u unreferenced revisions removed [%s]",
+             "      - %02.0f%%    %u / %u unreferenced revisions removed, "
+             "%u objects (%.0f objects/s) [%s]",
              100.0 * threshold, condemned_trees_, unreferenced_trees_,
+             condemned_objects_,
+             (elapsed_s > 0.0) ? condemned_objects_ / elapsed_s : 0.0,
              RfcTimestamp().c_str());
     last_reported_status_ = threshold;
   }
@@ -189,7 +197,23 @@ void GarbageCollector<CatalogTraversalT, HashFilterT>::Sweep(
     return;
   }
 
-  configuration_.uploader->RemoveAsync(hash);
+  remove_batch_.push_back("data/" + hash.MakePath());
+  if (remove_batch_.size() >= kRemoveBatchSize)
+    FlushRemoveBatch();
+}
+
+
+/**
+ * Hands the collected condemned objects to the uploader, which deletes them
+ * asynchronously and, depending on the backend, concurrently or in bulk.
+ */
+template <class CatalogTraversalT, class HashFilterT>
+void GarbageCollector<CatalogTraversalT, HashFilterT>::FlushRemoveBatch() {
+  if (remove_batch_.empty())
+    return;
+  configuration_.uploader->RemoveAsync(remove_batch_);
+  remove_batch_.clear();
+  ++remove_batches_;
 }
 
 
@@ -276,9 +300,11 @@ bool GarbageCollector<CatalogTraversalT, HashFilterT>::SweepReflog() {
     }
   }
   unreferenced_trees_ = to_sweep.size();
+  sweep_start_ns_ = platform_monotonic_time_ns();
   bool success = traversal_.TraverseList(to_sweep,
                                          CatalogTraversalT::kDepthFirst);
   traversal_.UnregisterListener(callback);
+  FlushRemoveBatch();
 
   i = to_sweep.begin();
   iend = to_sweep.end();
@@ -300,13 +326,23 @@ bool GarbageCollector<CatalogTraversalT, HashFilterT>::SweepReflog() {
     perf::Counter *ctr_condemned_bytes =
       configuration_.statistics->Register(
         "gc.sz_condemned_bytes", "number of deleted bytes");
+    perf::Counter *ctr_remove_batches =
+      configuration_.statistics->Register(
+        "gc.n_remove_batches", "number of batches of deleted objects");
     ctr_preserved_catalogs->Set(preserved_catalog_count());
     ctr_condemned_catalogs->Set(condemned_catalog_count());
     ctr_condemned_objects->Set(condemned_objects_count());
     ctr_condemned_bytes->Set(condemned_bytes_count());
+    ctr_remove_batches->Set(remove_batches_);
   }
 
   configuration_.uploader->WaitForUpload();
+  const double elapsed_s = static_cast<double>(
+    platform_monotonic_time_ns() - sweep_start_ns_) / 1e9;
+  LogCvmfs(kLogGc, kLogStdout,
+           "  --> swept %u objects in %.1f seconds (%.0f objects/s)",
+           condemned_objects_, elapsed_s,
+           (elapsed_s > 0.0) ? condemned_objects_ / elapsed_s : 0.0);
   LogCvmfs(kLogGc, kLogStdout, "  --> done garbage collecting [%s]",
            RfcTimestamp().c_str());
   return success && (configuration_.uploader->GetNumberOfErrors() == 0);
@@ -9,10 +9,18 @@
 #ifndef CVMFS_GARBAGE_COLLECTION_HASH_FILTER_H_
 #define CVMFS_GARBAGE_COLLECTION_HASH_FILTER_H_
 
+#include <stdint.h>
+
+#include <cassert>
+#include <cmath>
+#include <cstring>
 #include <set>
+#include <vector>
 
 #include "crypto/hash.h"
 #include "smallhash.h"
+#include "util/single_copy.h"
+#include "util/smalloc.h"
 
 /**
  * Abstract base class of a HashFilter to define the common interface.
@@ -120,8 +128,208 @@ class SmallhashFilter : public AbstractHashFilter {
   size_t Count() const { return hashmap_.size(); }
 
  private:
-  SmallHashDynamic<shash::Any, bool>  hashmap_;
-  bool                                frozen_;
+  // Tagged probing, saves comparing the long keys along collision chains
+  SmallHashDynamic<shash::Any, bool, true>  hashmap_;
+  bool                                      frozen_;
+};
+
+
+
+//------------------------------------------------------------------------------
+
+
+/**
+ * A probabilistic implementation of AbstractHashFilter based on a cache-line
+ * blocked Bloom filter.  Instead of the full hash, every element only occupies
+ * a few dozen bits, so that the mark set of the garbage collector needs about
+ * an order of magnitude less memory than with the SmallhashFilter.
+ *
+ * Every element sets k bits within a single 64 byte block, so that Fill() and
+ * Contains() touch one cache line per stage and compare the block word by word
+ * with the bit pattern of the element.  As the number of elements is not
+ * known in advance, the filter starts with a stage for kInitialCapacity
+ * elements and adds stages of twice the size whenever the current stage is
+ * full (scalable Bloom filter).  The false positive rate of stage i is tightened
+ * to fp_rate / 2^(i+1), which keeps the overall false positive rate below
+ * fp_rate.
+ *
+ * False positives are safe for garbage collection: they only keep an
+ * unreferenced object alive.  Count() is exact unless a new element is a false
+ * positive of the elements inserted before.
+ */
+class BloomHashFilter : public AbstractHashFilter, SingleCopy {
+ public:
+  static const unsigned kInitialCapacity = 1048576;
+
+  /**
+   * @param fp_rate  upper bound of the false positive rate, by default about
+   *                 one in 10000 unreferenced objects survives a sweep
+   */
+  explicit BloomHashFilter(
+    const double fp_rate = 1e-4,
+    const unsigned initial_capacity = kInitialCapacity)
+    : fp_rate_(fp_rate)
+    , initial_capacity_(initial_capacity)
+    , count_(0)
+    , frozen_(false)
+  {
+    assert((fp_rate > 0.0) && (fp_rate < 1.0));
+    assert(initial_capacity > 0);
+  }
+
+  ~BloomHashFilter() {
+    for (unsigned i = 0; i < stages_.size(); ++i)
+      sxunmap(stages_[i].blocks, stages_[i].num_blocks * kBlockSize);
+  }
+
+  void Fill(const shash::Any &hash) {
+    assert(!frozen_);
+    uint64_t h1, h2;
+    Hash(hash, &h1, &h2);
+    if (ContainsHashes(h1, h2))
+      return;
+    if (stages_.empty() || (stages_.back().size >= stages_.back().capacity))
+      AddStage();
+    Stage *stage = &stages_.back();
+    uint64_t *block = stage->GetBlock(h1);
+    uint64_t pattern[kBlockWords];
+    MakePattern(h2, stage->num_probes, pattern);
+    for (unsigned i = 0; i < kBlockWords; ++i)
+      block[i] |= pattern[i];
+    stage->size++;
+    count_++;
+  }
+
+  bool Contains(const shash::Any &hash) const {
+    uint64_t h1, h2;
+    Hash(hash, &h1, &h2);
+    return ContainsHashes(h1, h2);
+  }
+
+  void   Freeze()      { frozen_ = true; }
+  size_t Count() const { return count_;  }
+
+  /**
+   * Number of bytes allocated for the bit arrays of all stages
+   */
+  size_t MemoryUsage() const {
+    size_t result = 0;
+    for (unsigned i = 0; i < stages_.size(); ++i)
+      result += stages_[i].num_blocks * kBlockSize;
+    return result;
+  }
+
+  unsigned GetNumStages() const { return stages_.size(); }
+
+ private:
+  static const unsigned kBlockSize = 64;  // bytes, one cache line
+  static const unsigned kBlockBits = kBlockSize * 8;
+  static const unsigned kBlockWords = kBlockSize / sizeof(uint64_t);
+
+  struct Stage {
+    uint64_t *GetBlock(const uint64_t h1) const {
+      // Maps the upper 32 bits of h1 uniformly onto [0, num_blocks)
+      return blocks + kBlockWords * (((h1 >> 32) * num_blocks) >> 32);
+    }
+
+    uint64_t *blocks;
+    uint64_t num_blocks;
+    uint64_t capacity;
+    uint64_t size;
+    unsigned num_probes;
+  };
+
+  /**
+   * Derives two independent 64 bit values from the digest.  The digest is
+   * already uniformly distributed but the hash algorithm needs to be mixed in
+   * because equal digests of different algorithms are different hashes.  Like
+   * the comparison operators, the suffix is ignored.
+   */
+  static void Hash(const shash::Any &hash, uint64_t *h1, uint64_t *h2) {
+    uint64_t w0, w1;
+    // All digests have at least 16 bytes
+    memcpy(&w0, hash.digest, sizeof(w0));
+    memcpy(&w1, hash.digest + sizeof(w0), sizeof(w1));
+    const uint64_t algorithm = static_cast<uint64_t>(hash.algorithm) + 1;
+    *h1 = Mix(w0 ^ (algorithm * 0x9e3779b97f4a7c15ULL));
+    *h2 = Mix(w1 ^ (algorithm * 0xc2b2ae3d27d4eb4fULL));
+  }
+
+  /**
+   * Finalizer of the SplitMix64 generator
+   */
+  static uint64_t Mix(uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+  }
+
+  /**
+   * Sets num_probes bits within a block.  Every bit position uses its own 9
+   * bits of the (re-mixed) hash; double hashing within the small block would
+   * correlate the positions and multiply the false positive rate.
+   */
+  static void MakePattern(const uint64_t h2, const unsigned num_probes,
+                          uint64_t pattern[kBlockWords])
+  {
+    memset(pattern, 0, kBlockSize);
+    const unsigned kProbesPerWord = 64 / 9;
+    uint64_t seed = h2;
+    uint64_t bits = h2;
+    for (unsigned i = 0; i < num_probes; ++i) {
+      if ((i > 0) && ((i % kProbesPerWord) == 0)) {
+        seed += 0x9e3779b97f4a7c15ULL;
+        bits = Mix(seed);
+      }
+      const unsigned bit = bits % kBlockBits;
+      bits /= kBlockBits;
+      pattern[bit / 64] |= uint64_t(1) << (bit % 64);
+    }
+  }
+
+  bool ContainsHashes(const uint64_t h1, const uint64_t h2) const {
+    uint64_t pattern[kBlockWords];
+    for (unsigned s = 0; s < stages_.size(); ++s) {
+      const Stage &stage = stages_[s];
+      const uint64_t *block = stage.GetBlock(h1);
+      if ((s == 0) || (stage.num_probes != stages_[s - 1].num_probes))
+        MakePattern(h2, stage.num_probes, pattern);
+      uint64_t missing = 0;
+      for (unsigned i = 0; i < kBlockWords; ++i)
+        missing |= pattern[i] & ~block[i];
+      if (missing == 0)
+        return true;
+    }
+    return false;
+  }
+
+  void AddStage() {
+    const unsigned n = stages_.size();
+    Stage stage;
+    stage.capacity = stages_.empty()
+                     ? initial_capacity_ : 2 * stages_.back().capacity;
+    stage.size = 0;
+    // The stages together stay below fp_rate_: sum of fp_rate_ / 2^(n+1)
+    const double stage_fp_rate = fp_rate_ / static_cast<double>(2ULL << n);
+    const double ln2 = std::log(2.0);
+    const double bits_per_item = -std::log(stage_fp_rate) / (ln2 * ln2);
+    stage.num_probes = static_cast<unsigned>(
+      std::ceil(-std::log(stage_fp_rate) / ln2));
+    // Blocking skews the load of the blocks; 20% more bits make up for it
+    const uint64_t num_bits = static_cast<uint64_t>(
+      std::ceil(1.2 * bits_per_item * static_cast<double>(stage.capacity)));
+    stage.num_blocks = (num_bits + kBlockBits - 1) / kBlockBits;
+    // Anonymous mappings are zeroed and only backed by pages once touched
+    stage.blocks = static_cast<uint64_t *>(
+      sxmmap(stage.num_blocks * kBlockSize));
+    stages_.push_back(stage);
+  }
+
+  std::vector<Stage>  stages_;
+  double              fp_rate_;
+  unsigned            initial_capacity_;
+  size_t              count_;
+  bool                frozen_;
 };
 
 #endif  // CVMFS_GARBAGE_COLLECTION_HASH_FILTER_H_
@@ -43,16 +43,34 @@ PathStore::PathStore(const PathStore &other) {
 }
 
 
+/**
+ * Moves the names that are stored in the heap to a new heap without garbage.
+ */
+void PathStore::Compact() {
+  StringHeap *new_string_heap = new StringHeap(string_heap_->used());
+  shash::Md5 empty_path = map_.empty_key();
+  for (unsigned i = 0; i < map_.capacity(); ++i) {
+    PathInfo *info = map_.values() + i;
+    if ((map_.keys()[i] != empty_path) && !info->IsInline()) {
+      info->SetRef(new_string_heap->AddString(info->name_length,
+                                              info->GetName()));
+    }
+  }
+  delete string_heap_;
+  string_heap_ = new_string_heap;
+}
+
+
 void PathStore::CopyFrom(const PathStore &other) {
   map_ = other.map_;
 
   string_heap_ = new StringHeap(other.string_heap_->used());
   shash::Md5 empty_path = map_.empty_key();
   for (unsigned i = 0; i < map_.capacity(); ++i) {
-    if (map_.keys()[i] != empty_path) {
-      (map_.values() + i)->name =
-      string_heap_->AddString(map_.values()[i].name.length(),
-                              map_.values()[i].name.data());
+    PathInfo *info = map_.values() + i;
+    if ((map_.keys()[i] != empty_path) && !info->IsInline()) {
+      info->SetRef(string_heap_->AddString(info->name_length,
+                                           info->GetName()));
     }
   }
 }
@@ -62,9 +80,15 @@ void PathStore::CopyFrom(const PathStore &other) {
 
 
 void InodeTracker::InitLock() {
-  lock_ =
-    reinterpret_cast<pthread_mutex_t *>(smalloc(sizeof(pthread_mutex_t)));
-  int retval = pthread_mutex_init(lock_, NULL);
+  shard_locks_ = reinterpret_cast<pthread_mutex_t *>(
+    smalloc(kNumShards * sizeof(pthread_mutex_t)));
+  for (unsigned i = 0; i < kNumShards; ++i) {
+    int retval = pthread_mutex_init(&shard_locks_[i], NULL);
+    assert(retval == 0);
+  }
+  path_lock_ =
+    reinterpret_cast<pthread_rwlock_t *>(smalloc(sizeof(pthread_rwlock_t)));
+  int retval = pthread_rwlock_init(path_lock_, NULL);
   assert(retval == 0);
 }
 
@@ -73,8 +97,10 @@ void InodeTracker::CopyFrom(const InodeTracker &other) {
   assert(other.version_ == kVersion);
   version_ = kVersion;
   path_map_ = other.path_map_;
-  inode_ex_map_ = other.inode_ex_map_;
-  inode_references_ = other.inode_references_;
+  for (unsigned i = 0; i < kNumShards; ++i) {
+    shards_[i].inode_ex_map = other.shards_[i].inode_ex_map;
+    shards_[i].inode_references = other.shards_[i].inode_references;
+  }
   statistics_ = other.statistics_;
 }
 
@@ -101,8 +127,39 @@ InodeTracker &InodeTracker::operator= (const InodeTracker &other) {
 
 
 InodeTracker::~InodeTracker() {
-  pthread_mutex_destroy(lock_);
-  free(lock_);
+  pthread_rwlock_destroy(path_lock_);
+  free(path_lock_);
+  for (unsigned i = 0; i < kNumShards; ++i)
+    pthread_mutex_destroy(&shard_locks_[i]);
+  free(shard_locks_);
+}
+
+
+void InodeTracker::VfsPutBatch::Commit(vector<uint64_t> *removed) {
+  vector<shash::Md5> md5paths;
+  for (unsigned idx = 0; idx < kNumShards; ++idx) {
+    if (items_[idx].empty())
+      continue;
+
+    md5paths.clear();
+    tracker_->LockShard(idx);
+    for (unsigned i = 0; i < items_[idx].size(); ++i) {
+      const Item &item = items_[idx][i];
+      shash::Md5 md5path;
+      if (tracker_->DoPut(idx, item.inode, item.by, &md5path)) {
+        md5paths.push_back(md5path);
+        removed->push_back(item.inode);
+      }
+    }
+    if (!md5paths.empty()) {
+      tracker_->WriteLockPaths();
+      for (unsigned i = 0; i < md5paths.size(); ++i)
+        tracker_->path_map_.Erase(md5paths[i]);
+      tracker_->UnlockPaths();
+    }
+    tracker_->UnlockShard(idx);
+    items_[idx].clear();
+  }
 }
 
 
@@ -13,6 +13,7 @@
 #include <sched.h>
 #include <stdint.h>
 
+#include <algorithm>
 #include <cassert>
 #include <cstring>
 #include <map>
@@ -200,6 +201,7 @@ class StringHeap : public SingleCopy {
   }
 
   uint64_t used() const { return used_; }
+  uint64_t size() const { return size_; }
 
   // mmap'd bytes, used for testing
   uint64_t GetSizeAlloc() const {
@@ -231,6 +233,13 @@ class StringHeap : public SingleCopy {
 //------------------------------------------------------------------------------
 
 
+/**
+ * Stores paths as a tree of path elements keyed by the md5 hash of the path.
+ * Each element refers to its parent by hash and stores only its own name.
+ * Most names in software trees are short and are kept inline in the map
+ * entry; longer names are kept in a StringHeap.  Lookups of short names thus
+ * stay within the map's contiguous value array.
+ */
 class PathStore {
  public:
   /**
@@ -265,19 +274,22 @@ class PathStore {
 
     PathInfo new_entry;
     if (path.IsEmpty()) {
-      new_entry.name = string_heap_->AddString(0, "");
       map_.Insert(md5path, new_entry);
       return;
     }
 
     PathString parent_path = GetParentPath(path);
-    new_entry.parent = shash::Md5(parent_path.GetChars(),
-                                  parent_path.GetLength());
-    Insert(new_entry.parent, parent_path);
+    shash::Md5 md5parent(parent_path.GetChars(), parent_path.GetLength());
+    new_entry.SetParent(md5parent);
+    Insert(md5parent, parent_path);
 
     const uint16_t name_length = path.GetLength() - parent_path.GetLength() - 1;
     const char *name_str = path.GetChars() + parent_path.GetLength() + 1;
-    new_entry.name = string_heap_->AddString(name_length, name_str);
+    new_entry.name_length = name_length;
+    if (new_entry.IsInline())
+      memcpy(new_entry.name, name_str, name_length);
+    else
+      new_entry.SetRef(string_heap_->AddString(name_length, name_str));
     map_.Insert(md5path, new_entry);
   }
 
@@ -287,13 +299,13 @@ class PathStore {
     if (!retval)
       return false;
 
-    if (info.parent.IsNull())
+    if (!info.HasParent())
       return true;
 
-    retval = Lookup(info.parent, path);
+    retval = Lookup(info.GetParent(), path);
     assert(retval);
     path->Append("/", 1);
-    path->Append(info.name.data(), info.name.length());
+    path->Append(info.GetName(), info.name_length);
     return true;
   }
 
@@ -306,21 +318,12 @@ class PathStore {
     info.refcnt--;
     if (info.refcnt == 0) {
       map_.Erase(md5path);
-      string_heap_->RemoveString(info.name);
-      if (string_heap_->GetUsage() < 0.75) {
-        StringHeap *new_string_heap = new StringHeap(string_heap_->used());
-        shash::Md5 empty_path = map_.empty_key();
-        for (unsigned i = 0; i < map_.capacity(); ++i) {
-          if (map_.keys()[i] != empty_path) {
-            (map_.values() + i)->name =
-              new_string_heap->AddString(map_.values()[i].name.length(),
-                                         map_.values()[i].name.data());
-          }
-        }
-        delete string_heap_;
-        string_heap_ = new_string_heap;
+      if (!info.IsInline()) {
+        string_heap_->RemoveString(info.GetRef());
+        if (NeedsCompaction())
+          Compact();
       }
-      Erase(info.parent);
+      Erase(info.GetParent());
     } else {
       map_.Insert(md5path, info);
     }
@@ -336,31 +339,90 @@ class PathStore {
     return Cursor();
   }
 
-  bool Next(Cursor *cursor, shash::Md5 *parent, StringRef *name) {
+  bool Next(Cursor *cursor, shash::Md5 *parent, NameString *name) {
     shash::Md5 empty_key = map_.empty_key();
     while (cursor->idx < map_.capacity()) {
       if (map_.keys()[cursor->idx] == empty_key) {
         cursor->idx++;
         continue;
       }
-      *parent = map_.values()[cursor->idx].parent;
-      *name = map_.values()[cursor->idx].name;
+      const PathInfo &info = map_.values()[cursor->idx];
+      *parent = info.GetParent();
+      name->Assign(info.GetName(), info.name_length);
       cursor->idx++;
       return true;
     }
     return false;
   }
 
+  /**
+   * Bytes taken by the hash table and the string heap, used for benchmarks
+   */
+  uint64_t GetMemoryUsage() const {
+    return static_cast<uint64_t>(map_.capacity()) *
+           (sizeof(shash::Md5) + sizeof(PathInfo)) +
+           string_heap_->GetSizeAlloc();
+  }
+
  private:
+  /**
+   * The parent is stored as a plain digest, which saves the algorithm and
+   * suffix fields of shash::Md5.  Names of up to kMaxInlineName characters
+   * are stored inline, longer names start with a StringRef into the heap.
+   * A PathInfo takes 40 bytes, no more than the former layout that stored
+   * every name in the heap.
+   */
   struct PathInfo {
-    PathInfo() {
-      refcnt = 1;
+    static const unsigned kMaxInlineName = 18;
+
+    PathInfo() : refcnt(1), name_length(0) {
+      memset(parent, 0, sizeof(parent));
+    }
+
+    shash::Md5 GetParent() const {
+      shash::Md5 result;
+      memcpy(result.digest, parent, sizeof(parent));
+      return result;
+    }
+    void SetParent(const shash::Md5 &md5parent) {
+      memcpy(parent, md5parent.digest, sizeof(parent));
+    }
+    bool HasParent() const {
+      for (unsigned i = 0; i < sizeof(parent); ++i) {
+        if (parent[i] != 0)
+          return true;
+      }
+      return false;
     }
-    shash::Md5 parent;
+
+    bool IsInline() const { return name_length <= kMaxInlineName; }
+    StringRef GetRef() const {
+      StringRef result;
+      memcpy(&result, name, sizeof(result));
+      return result;
+    }
+    void SetRef(const StringRef &ref) { memcpy(name, &ref, sizeof(ref)); }
+    const char *GetName() const {
+      return IsInline() ? name : GetRef().data();
+    }
+
+    unsigned char parent[16];
     uint32_t refcnt;
-    StringRef name;
+    uint16_t name_length;
+    char name[kMaxInlineName];
   };
 
+  /**
+   * Compaction visits the entire map.  With most names inline, the string heap
+   * can be small compared to the map, so the garbage must also outweigh the
+   * number of map slots.
+   */
+  bool NeedsCompaction() const {
+    return (string_heap_->GetUsage() < 0.75) &&
+           (string_heap_->size() - string_heap_->used() >= map_.capacity());
+  }
+
+  void Compact();
   void CopyFrom(const PathStore &other);
 
   SmallHashDynamic<shash::Md5, PathInfo> map_;
@@ -433,13 +495,23 @@ class PathMap {
     return 0;
   }
 
+  bool Contains(const shash::Md5 &md5path) const {
+    return map_.Contains(md5path);
+  }
+
   shash::Md5 Insert(const PathString &path, const uint64_t inode) {
     shash::Md5 md5path(path.GetChars(), path.GetLength());
+    Insert(md5path, path, inode);
+    return md5path;
+  }
+
+  void Insert(const shash::Md5 &md5path, const PathString &path,
+              const uint64_t inode)
+  {
     if (!map_.Contains(md5path)) {
       path_store_.Insert(md5path, path);
       map_.Insert(md5path, inode);
     }
-    return md5path;
   }
 
   void Erase(const shash::Md5 &md5path) {
@@ -546,9 +618,11 @@ class InodeReferences {
     return false;
   }
 
-  void Replace(const uint64_t old_inode, const uint64_t new_inode) {
-    map_.Erase(old_inode);
-    map_.Insert(new_inode, 0);
+  /**
+   * Drops the inode regardless of its reference counter
+   */
+  void Erase(const uint64_t inode) {
+    map_.Erase(inode);
   }
 
   void Clear() {
@@ -583,9 +657,18 @@ class InodeReferences {
 
 /**
  * Tracks inode reference counters as given by Fuse.
+ *
+ * The reference counters and the inode to path mapping are distributed by
+ * inode over kNumShards shards, each of them protected by its own mutex.  The
+ * path map is shared among the shards and protected by a read-write lock,
+ * which is always taken after the shard locks.  Operations on the same inode
+ * are serialized by the shard lock.  Operations on different inodes only need
+ * exclusive access to the path map if they add or remove a path.
  */
 class InodeTracker {
  public:
+  static const unsigned kNumShards = 16;
+
   /**
    * Used to actively evict all known paths from kernel caches
    */
@@ -594,43 +677,41 @@ class InodeTracker {
       const PathStore::Cursor &p,
       const InodeReferences::Cursor &i)
       : csr_paths(p)
+      , idx_shard(0)
       , csr_inos(i)
     { }
     PathStore::Cursor csr_paths;
+    unsigned idx_shard;
     InodeReferences::Cursor csr_inos;
   };
 
   /**
-   * To avoid taking the InodeTracker mutex multiple times, the fuse
-   * forget_multi callback releases inodes references through this RAII object.
-   * Copy and assign operator should be deleted but that would require
-   * all compilers to use RVO. TODO(jblomer): fix with C++11
+   * Collects the inode references released by the fuse forget_multi callback.
+   * Commit() applies them in one pass per shard, so that every shard lock and
+   * the path map lock are taken at most once per shard.
    */
-  class VfsPutRaii {
+  class VfsPutBatch {
    public:
-    explicit VfsPutRaii(InodeTracker *t) : tracker_(t) {
-      tracker_->Lock();
-    }
-    ~VfsPutRaii() { tracker_->Unlock(); }
-
-    bool VfsPut(const uint64_t inode, const uint32_t by) {
-      bool removed = tracker_->inode_references_.Put(inode, by);
-      if (removed) {
-        // TODO(jblomer): pop operation (Lookup+Erase)
-        shash::Md5 md5path;
-        InodeEx inode_ex(inode, InodeEx::kUnknownType);
-        bool found = tracker_->inode_ex_map_.LookupMd5Path(&inode_ex, &md5path);
-        assert(found);
-        tracker_->inode_ex_map_.Erase(inode);
-        tracker_->path_map_.Erase(md5path);
-        atomic_inc64(&tracker_->statistics_.num_removes);
-      }
-      atomic_xadd64(&tracker_->statistics_.num_references, -int32_t(by));
-      return removed;
+    explicit VfsPutBatch(InodeTracker *t) : tracker_(t) { }
+
+    void Add(const uint64_t inode, const uint32_t by) {
+      items_[tracker_->GetShardIdx(inode)].push_back(Item(inode, by));
     }
 
+    /**
+     * Appends the inodes whose last reference was released to removed
+     */
+    void Commit(std::vector<uint64_t> *removed);
+
    private:
+    struct Item {
+      Item(uint64_t i, uint32_t b) : inode(i), by(b) { }
+      uint64_t inode;
+      uint32_t by;
+    };
+
     InodeTracker *tracker_;
+    std::vector<Item> items_[kNumShards];
   };
 
   // Cannot be moved to the statistics manager because it has to survive
@@ -670,12 +751,23 @@ class InodeTracker {
   void VfsGetBy(const InodeEx inode_ex, const uint32_t by,
                 const PathString &path)
   {
-    uint64_t inode = inode_ex.GetInode();
-    Lock();
-    bool is_new_inode = inode_references_.Get(inode, by);
-    shash::Md5 md5path = path_map_.Insert(path, inode);
-    inode_ex_map_.Insert(inode_ex, md5path);
-    Unlock();
+    const uint64_t inode = inode_ex.GetInode();
+    const unsigned idx = GetShardIdx(inode);
+    const shash::Md5 md5path(path.GetChars(), path.GetLength());
+    LockShard(idx);
+    bool is_new_inode = shards_[idx].inode_references.Get(inode, by);
+    ReadLockPaths();
+    const bool has_path = path_map_.Contains(md5path);
+    UnlockPaths();
+    if (!has_path) {
+      // Another shard may have inserted the path after the read lock was
+      // released, in which case Insert() leaves its entry in place
+      WriteLockPaths();
+      path_map_.Insert(md5path, path, inode);
+      UnlockPaths();
+    }
+    shards_[idx].inode_ex_map.Insert(inode_ex, md5path);
+    UnlockShard(idx);
 
     atomic_xadd64(&statistics_.num_references, by);
     if (is_new_inode) atomic_inc64(&statistics_.num_inserts);
@@ -685,17 +777,32 @@ class InodeTracker {
     VfsGetBy(inode_ex, 1, path);
   }
 
-  VfsPutRaii GetVfsPutRaii() { return VfsPutRaii(this); }
+  bool VfsPut(const uint64_t inode, const uint32_t by) {
+    const unsigned idx = GetShardIdx(inode);
+    shash::Md5 md5path;
+    LockShard(idx);
+    const bool removed = DoPut(idx, inode, by, &md5path);
+    if (removed) {
+      WriteLockPaths();
+      path_map_.Erase(md5path);
+      UnlockPaths();
+    }
+    UnlockShard(idx);
+    return removed;
+  }
 
   bool FindPath(InodeEx *inode_ex, PathString *path) {
-    Lock();
+    const unsigned idx = GetShardIdx(inode_ex->GetInode());
     shash::Md5 md5path;
-    bool found = inode_ex_map_.LookupMd5Path(inode_ex, &md5path);
+    LockShard(idx);
+    bool found = shards_[idx].inode_ex_map.LookupMd5Path(inode_ex, &md5path);
     if (found) {
+      ReadLockPaths();
       found = path_map_.LookupPath(md5path, path);
+      UnlockPaths();
       assert(found);
     }
-    Unlock();
+    UnlockShard(idx);
 
     if (found) {
       atomic_inc64(&statistics_.num_hits_path);
@@ -706,9 +813,10 @@ class InodeTracker {
   }
 
   uint64_t FindInode(const PathString &path) {
-    Lock();
-    uint64_t inode = path_map_.LookupInodeByPath(path);
-    Unlock();
+    const shash::Md5 md5path(path.GetChars(), path.GetLength());
+    ReadLockPaths();
+    uint64_t inode = path_map_.LookupInodeByMd5Path(md5path);
+    UnlockPaths();
     atomic_inc64(&statistics_.num_hits_inode);
     return inode;
   }
@@ -717,17 +825,20 @@ class InodeTracker {
     PathString path;
     InodeEx inodex(ino, InodeEx::kUnknownType);
     shash::Md5 md5path;
+    const unsigned idx = GetShardIdx(ino);
 
-    Lock();
-    bool found = inode_ex_map_.LookupMd5Path(&inodex, &md5path);
+    LockShard(idx);
+    bool found = shards_[idx].inode_ex_map.LookupMd5Path(&inodex, &md5path);
     if (found) {
+      ReadLockPaths();
       found = path_map_.LookupPath(md5path, &path);
       assert(found);
       *name = GetFileName(path);
       path = GetParentPath(path);
       *parent_ino = path_map_.LookupInodeByPath(path);
+      UnlockPaths();
     }
-    Unlock();
+    UnlockShard(idx);
     return found;
   }
 
@@ -738,66 +849,133 @@ class InodeTracker {
   bool ReplaceInode(uint64_t old_inode, const InodeEx &new_inode) {
     shash::Md5 md5path;
     InodeEx old_inode_ex(old_inode, InodeEx::kUnknownType);
-    Lock();
-    bool found = inode_ex_map_.LookupMd5Path(&old_inode_ex, &md5path);
+    const unsigned idx_old = GetShardIdx(old_inode);
+    const unsigned idx_new = GetShardIdx(new_inode.GetInode());
+    // Shard locks are taken in ascending order
+    LockShard(std::min(idx_old, idx_new));
+    if (idx_old != idx_new)
+      LockShard(std::max(idx_old, idx_new));
+    bool found =
+      shards_[idx_old].inode_ex_map.LookupMd5Path(&old_inode_ex, &md5path);
     if (found) {
-      inode_references_.Replace(old_inode, new_inode.GetInode());
+      shards_[idx_old].inode_references.Erase(old_inode);
+      shards_[idx_new].inode_references.Get(new_inode.GetInode(), 0);
+      WriteLockPaths();
       path_map_.Replace(md5path, new_inode.GetInode());
-      inode_ex_map_.Erase(old_inode);
-      inode_ex_map_.Insert(new_inode, md5path);
+      UnlockPaths();
+      shards_[idx_old].inode_ex_map.Erase(old_inode);
+      shards_[idx_new].inode_ex_map.Insert(new_inode, md5path);
     }
-    Unlock();
+    if (idx_old != idx_new)
+      UnlockShard(std::max(idx_old, idx_new));
+    UnlockShard(std::min(idx_old, idx_new));
     return found;
   }
 
   Cursor BeginEnumerate() {
-    Lock();
+    for (unsigned i = 0; i < kNumShards; ++i)
+      LockShard(i);
+    ReadLockPaths();
     return Cursor(path_map_.path_store()->BeginEnumerate(),
-                  inode_references_.BeginEnumerate());
+                  shards_[0].inode_references.BeginEnumerate());
   }
 
   bool NextEntry(Cursor *cursor, uint64_t *inode_parent, NameString *name) {
     shash::Md5 parent_md5;
-    StringRef name_ref;
     bool result = path_map_.path_store()->Next(
-      &(cursor->csr_paths), &parent_md5, &name_ref);
+      &(cursor->csr_paths), &parent_md5, name);
     if (!result)
       return false;
     if (parent_md5.IsNull())
       *inode_parent = 0;
     else
       *inode_parent = path_map_.LookupInodeByMd5Path(parent_md5);
-    name->Assign(name_ref.data(), name_ref.length());
     return true;
   }
 
   bool NextInode(Cursor *cursor, uint64_t *inode) {
-    return inode_references_.Next(&(cursor->csr_inos), inode);
+    while (cursor->idx_shard < kNumShards) {
+      if (shards_[cursor->idx_shard].inode_references.Next(
+            &(cursor->csr_inos), inode))
+      {
+        return true;
+      }
+      cursor->idx_shard++;
+      cursor->csr_inos = InodeReferences::Cursor();
+    }
+    return false;
   }
 
   void EndEnumerate(Cursor *cursor) {
-    Unlock();
+    UnlockPaths();
+    for (unsigned i = kNumShards; i > 0; --i)
+      UnlockShard(i - 1);
   }
 
  private:
-  static const unsigned kVersion = 4;
+  static const unsigned kVersion = 5;
+
+  struct Shard {
+    InodeExMap inode_ex_map;
+    InodeReferences inode_references;
+  };
+
+  static inline unsigned GetShardIdx(const uint64_t inode) {
+    return hasher_inode(inode) % kNumShards;
+  }
+
+  /**
+   * Releases references of an inode; the caller holds the shard lock.  If the
+   * last reference is gone, the inode is removed from the shard and the path
+   * that needs to be erased from the path map is returned in md5path.
+   */
+  bool DoPut(const unsigned idx, const uint64_t inode, const uint32_t by,
+             shash::Md5 *md5path)
+  {
+    bool removed = shards_[idx].inode_references.Put(inode, by);
+    if (removed) {
+      // TODO(jblomer): pop operation (Lookup+Erase)
+      InodeEx inode_ex(inode, InodeEx::kUnknownType);
+      bool found = shards_[idx].inode_ex_map.LookupMd5Path(&inode_ex, md5path);
+      assert(found);
+      shards_[idx].inode_ex_map.Erase(inode);
+      atomic_inc64(&statistics_.num_removes);
+    }
+    atomic_xadd64(&statistics_.num_references, -int32_t(by));
+    return removed;
+  }
 
   void InitLock();
   void CopyFrom(const InodeTracker &other);
-  inline void Lock() const {
-    int retval = pthread_mutex_lock(lock_);
+  inline void LockShard(const unsigned idx) const {
+    int retval = pthread_mutex_lock(&shard_locks_[idx]);
     assert(retval == 0);
   }
-  inline void Unlock() const {
-    int retval = pthread_mutex_unlock(lock_);
+  inline void UnlockShard(const unsigned idx) const {
+    int retval = pthread_mutex_unlock(&shard_locks_[idx]);
+    assert(retval == 0);
+  }
+  inline void ReadLockPaths() const {
+    int retval = pthread_rwlock_rdlock(path_lock_);
+    assert(retval == 0);
+  }
+  inline void WriteLockPaths() const {
+    int retval = pthread_rwlock_wrlock(path_lock_);
+    assert(retval == 0);
+  }
+  inline void UnlockPaths() const {
+    int retval = pthread_rwlock_unlock(path_lock_);
     assert(retval == 0);
   }
 
   unsigned version_;
-  pthread_mutex_t *lock_;
+  /**
+   * Array of kNumShards mutexes
+   */
+  pthread_mutex_t *shard_locks_;
+  pthread_rwlock_t *path_lock_;
   PathMap path_map_;
-  InodeExMap inode_ex_map_;
-  InodeReferences inode_references_;
+  Shard shards_[kNumShards];
   Statistics statistics_;
 };  // class InodeTracker
 
@@ -0,0 +1,207 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#include "cvmfs_config.h"
+#include "hotset.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <unistd.h>
+
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "catalog_mgr_client.h"
+#include "crypto/hash.h"
+#include "directory_entry.h"
+#include "glue_buffer.h"
+#include "lru_md.h"
+#include "shortstring.h"
+#include "util/logging.h"
+#include "util/platform.h"
+#include "util/posix.h"
+#include "util/string.h"
+
+using namespace std;  // NOLINT
+
+namespace cvmfs {
+
+HotsetSnapshot::HotsetSnapshot(
+  const string &path,
+  const unsigned max_paths,
+  catalog::ClientCatalogManager *catalog_mgr,
+  glue::InodeTracker *inode_tracker,
+  lru::PathCache *path_cache,
+  lru::Md5PathCache *md5path_cache,
+  perf::StatisticsTemplate statistics)
+  : path_(path)
+  , max_paths_(max_paths)
+  , catalog_mgr_(catalog_mgr)
+  , inode_tracker_(inode_tracker)
+  , path_cache_(path_cache)
+  , md5path_cache_(md5path_cache)
+  , fence_(NULL)
+  , spawned_(false)
+{
+  atomic_init32(&terminate_);
+  memset(&thread_replay_, 0, sizeof(thread_replay_));
+
+  n_saved_ = statistics.RegisterTemplated("n_saved",
+    "Number of paths written to the hot-set snapshot");
+  n_replayed_ = statistics.RegisterTemplated("n_replayed",
+    "Number of snapshot paths looked up after mount");
+  n_missing_ = statistics.RegisterTemplated("n_missing",
+    "Number of snapshot paths that could not be looked up");
+  replay_time_ms_ = statistics.RegisterTemplated("replay_time_ms",
+    "Duration of the snapshot replay in milliseconds");
+}
+
+
+HotsetSnapshot::~HotsetSnapshot() {
+  Terminate();
+}
+
+
+/**
+ * Stops and joins the replay thread.  Needs to be called before the fence
+ * passed to Spawn() goes away.
+ */
+void HotsetSnapshot::Terminate() {
+  if (spawned_) {
+    atomic_cas32(&terminate_, 0, 1);
+    pthread_join(thread_replay_, NULL);
+    spawned_ = false;
+  }
+}
+
+
+/**
+ * Starts replaying the snapshot of the previous mount, if there is one.  The
+ * fence is the one of the fuse remounter.
+ */
+void HotsetSnapshot::Spawn(Fence *fence) {
+  assert(!spawned_);
+  fence_ = fence;
+  if (!FileExists(path_))
+    return;
+  int retval = pthread_create(&thread_replay_, NULL, MainReplay, this);
+  assert(retval == 0);
+  spawned_ = true;
+}
+
+
+void *HotsetSnapshot::MainReplay(void *data) {
+  HotsetSnapshot *hotset = reinterpret_cast<HotsetSnapshot *>(data);
+  LogCvmfs(kLogCvmfs, kLogDebug, "starting hot-set replay from %s",
+           hotset->path_.c_str());
+  hotset->Replay();
+  LogCvmfs(kLogCvmfs, kLogDebug, "stopping hot-set replay");
+  return NULL;
+}
+
+
+void HotsetSnapshot::Replay() {
+  FILE *f = fopen(path_.c_str(), "r");
+  if (f == NULL) {
+    LogCvmfs(kLogCvmfs, kLogDebug, "failed to open hot-set snapshot %s (%d)",
+             path_.c_str(), errno);
+    return;
+  }
+
+  const uint64_t start = platform_monotonic_time_ns();
+  const uint64_t revision = catalog_mgr_->GetRevision();
+  unsigned num_paths = 0;
+  string line;
+  while ((num_paths < max_paths_) && GetLineFile(f, &line)) {
+    if (atomic_read32(&terminate_))
+      break;
+    if (line.empty())
+      continue;
+    num_paths++;
+
+    PathString path(line);
+    FenceGuard fence_guard(fence_);
+    // Catalogs are only switched outside the fence, so that the lookup and
+    // the cache insert below see the same catalog revision
+    if (catalog_mgr_->GetRevision() != revision) {
+      LogCvmfs(kLogCvmfs, kLogDebug, "catalog revision changed, "
+               "stopping hot-set replay");
+      break;
+    }
+    catalog::DirectoryEntry dirent;
+    if (!catalog_mgr_->LookupPath(path, catalog::kLookupDefault, &dirent)) {
+      perf::Inc(n_missing_);
+      continue;
+    }
+    perf::Inc(n_replayed_);
+
+    // Same as for directory listings: keep the inode the kernel knows and
+    // leave possibly open files with changed content to the regular lookup
+    const uint64_t live_inode = inode_tracker_->FindInode(path);
+    if (live_inode != 0) {
+      dirent.set_inode(live_inode);
+      if (dirent.IsRegular() && (live_inode < catalog_mgr_->GetRootInode()))
+        continue;
+    }
+    shash::Md5 md5path(path.GetChars(), path.GetLength());
+    md5path_cache_->InsertPrefetched(md5path, dirent);
+  }
+  fclose(f);
+
+  replay_time_ms_->Set((platform_monotonic_time_ns() - start) / (1000 * 1000));
+  LogCvmfs(kLogCvmfs, kLogDebug, "replayed %" PRId64 " paths of the hot set "
+           "in %" PRId64 " ms", n_replayed_->Get(), replay_time_ms_->Get());
+}
+
+
+/**
+ * Writes the max_paths_ most recently used paths of the path cache to the
+ * snapshot file.  An empty path cache, e.g. of a mount point that was never
+ * used, leaves the previous snapshot in place.
+ */
+bool HotsetSnapshot::Save() {
+  vector<PathString> paths;
+  fuse_ino_t inode;
+  PathString path;
+  path_cache_->FilterBegin();
+  while (path_cache_->FilterNext()) {
+    path_cache_->FilterGet(&inode, &path);
+    paths.push_back(path);
+  }
+  path_cache_->FilterEnd();
+
+  // The filter runs from the least to the most recently used entry
+  string content;
+  unsigned num_paths = 0;
+  for (vector<PathString>::reverse_iterator i = paths.rbegin(),
+       iEnd = paths.rend(); (i != iEnd) && (num_paths < max_paths_); ++i)
+  {
+    // The root entry is always there, new lines would break the format
+    if (i->IsEmpty() || (memchr(i->GetChars(), '\n', i->GetLength()) != NULL))
+      continue;
+    content.append(i->GetChars(), i->GetLength());
+    content.push_back('\n');
+    num_paths++;
+  }
+  if (num_paths == 0)
+    return true;
+
+  const string path_tmp = path_ + ".tmp";
+  bool retval = SafeWriteToFile(content, path_tmp, 0600) &&
+                (rename(path_tmp.c_str(), path_.c_str()) == 0);
+  if (!retval) {
+    LogCvmfs(kLogCvmfs, kLogDebug | kLogSyslogWarn,
+             "failed to write hot-set snapshot %s (%d)", path_.c_str(), errno);
+    unlink(path_tmp.c_str());
+    return false;
+  }
+  n_saved_->Set(num_paths);
+  LogCvmfs(kLogCvmfs, kLogDebug, "saved %u paths of the hot set to %s",
+           num_paths, path_.c_str());
+  return true;
+}
+
+}  // namespace cvmfs
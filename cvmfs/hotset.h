@@ -0,0 +1,97 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#ifndef CVMFS_HOTSET_H_
+#define CVMFS_HOTSET_H_
+
+#include <pthread.h>
+
+#include <string>
+
+#include "fence.h"
+#include "gtest/gtest_prod.h"
+#include "statistics.h"
+#include "util/atomic.h"
+#include "util/single_copy.h"
+
+namespace catalog {
+class ClientCatalogManager;
+}
+
+namespace glue {
+class InodeTracker;
+}
+
+namespace lru {
+class Md5PathCache;
+class PathCache;
+}
+
+namespace cvmfs {
+
+/**
+ * Carries the hot meta-data working set of a mount point over a remount, a
+ * reload, or a reboot.  On shutdown, Save() writes the most recently used paths
+ * of the path cache to a small file in the cache workspace.  After the next
+ * mount, Spawn() replays the file in a background thread.  Looking up the paths
+ * attaches the nested catalogs they belong to, brings the catalog pages into
+ * the page cache, and fills the md5path cache, so that the first jobs after the
+ * mount find their meta-data in memory.
+ *
+ * The snapshot is a list of paths, one per line, most recently used first.  It
+ * is best effort: paths that disappeared in the meantime are skipped, and the
+ * replay stops when the catalog revision changes underneath it.  Like the fuse
+ * callbacks, every lookup runs inside the remount fence.  Entries whose inode
+ * is still in use by the kernel are inserted with that live inode; regular
+ * files of an older catalog generation are left to the regular lookup path,
+ * which checks them against the page cache tracker.
+ */
+class HotsetSnapshot : SingleCopy {
+  FRIEND_TEST(T_Hotset, SaveReplay);
+  FRIEND_TEST(T_Hotset, TerminateBeforeFence);
+
+ public:
+  HotsetSnapshot(const std::string &path,
+                 const unsigned max_paths,
+                 catalog::ClientCatalogManager *catalog_mgr,
+                 glue::InodeTracker *inode_tracker,
+                 lru::PathCache *path_cache,
+                 lru::Md5PathCache *md5path_cache,
+                 perf::StatisticsTemplate statistics);
+  ~HotsetSnapshot();
+  void Spawn(Fence *fence);
+  void Terminate();
+  bool Save();
+
+  std::string path() const { return path_; }
+  unsigned max_paths() const { return max_paths_; }
+
+ private:
+  static void *MainReplay(void *data);
+  void Replay();
+
+  std::string path_;
+  unsigned max_paths_;
+  catalog::ClientCatalogManager *catalog_mgr_;
+  glue::InodeTracker *inode_tracker_;
+  lru::PathCache *path_cache_;
+  lru::Md5PathCache *md5path_cache_;
+  /**
+   * The fence of the fuse remounter, catalogs are only switched while no
+   * thread is inside
+   */
+  Fence *fence_;
+  bool spawned_;
+  atomic_int32 terminate_;
+  pthread_t thread_replay_;
+
+  perf::Counter *n_saved_;
+  perf::Counter *n_replayed_;
+  perf::Counter *n_missing_;
+  perf::Counter *replay_time_ms_;
+};
+
+}  // namespace cvmfs
+
+#endif  // CVMFS_HOTSET_H_
@@ -8,10 +8,53 @@
 #include <algorithm>
 #include <cassert>
 #include <limits>
+#include <string>
 
 #include "ingestion/item.h"
 
 
+ChunkingAlgorithms ParseChunkingAlgorithm(const std::string &algorithm_option)
+{
+  if ((algorithm_option == "default") || (algorithm_option == "xor32"))
+    return kChunkingXor32;
+  if (algorithm_option == "fastcdc")
+    return kChunkingFastCdc;
+  return kChunkingUnknown;
+}
+
+
+std::string ChunkingAlgorithmName(const ChunkingAlgorithms alg) {
+  switch (alg) {
+    case kChunkingXor32:
+      return "xor32";
+    case kChunkingFastCdc:
+      return "fastcdc";
+    case kChunkingUnknown:
+      break;
+  }
+  return "unknown";
+}
+
+
+ChunkDetector *CreateChunkDetector(const ChunkingAlgorithms alg,
+                                   const uint64_t minimal_chunk_size,
+                                   const uint64_t average_chunk_size,
+                                   const uint64_t maximal_chunk_size)
+{
+  // Files that are not chunked use a disabled Xor32Detector (sizes are zero)
+  if ((alg == kChunkingFastCdc) && (minimal_chunk_size > 0)) {
+    return new FastCdcDetector(
+      minimal_chunk_size, average_chunk_size, maximal_chunk_size);
+  }
+  return new Xor32Detector(
+    minimal_chunk_size, average_chunk_size, maximal_chunk_size);
+}
+
+
+//------------------------------------------------------------------------------
+
+
+
 uint64_t ChunkDetector::FindNextCutMark(BlockItem *block) {
   uint64_t result = DoFindNextCutMark(block);
   if (result == 0)
@@ -135,3 +178,216 @@ uint64_t Xor32Detector::DoFindNextCutMark(BlockItem *buffer) {
     return NoCut(internal_offset + offset());
   }
 }
+
+
+//------------------------------------------------------------------------------
+
+
+// Random values that map the input bytes to the Gear fingerprint.  They have
+// been generated once by splitmix64.  You should never change these numbers,
+// since they affect the definition of cut marks.
+const uint64_t FastCdcDetector::kGearTable[256] = {
+  0x833baa1c104d3ff9ULL, 0xa8b9b75abffdc5b9ULL, 0x7711e10aed015e53ULL,
+  0x6dd1bf114eca8b14ULL, 0xa9033062067bc2b9ULL, 0x2f28638914f98523ULL,
+  0x2e49c93fc3ed408aULL, 0xd9f2dcdaaae19b9bULL, 0x3934991018af47ffULL,
+  0xbefff5f2c39120c8ULL, 0xa16abd072b667b73ULL, 0x7f3f7a114f6920b0ULL,
+  0x884ae6e28263e8dcULL, 0x4d70fcd86bf1422dULL, 0x2f7a61710b60f195ULL,
+  0xd753e44e34b0ea8eULL, 0x5095fb2557b9bbeaULL, 0x7880022effc21dbdULL,
+  0x9a430eb7a474d82aULL, 0x06dbe04ac94dfb94ULL, 0x8173c38390ddcf7fULL,
+  0xe2f0febad85db318ULL, 0x16ebadf650c4f7ddULL, 0x83cf6d27198f0a5aULL,
+  0xba09fc77dffd00b7ULL, 0x58040d49a90f2448ULL, 0x0700413ebad8c8a3ULL,
+  0xbadd61faed3632e2ULL, 0xa72a8f90dde4cb21ULL, 0x2594e006bd6f4daeULL,
+  0x37c2e1f22351f487ULL, 0xe5a8e02f55bb05e1ULL, 0x130c9207254911ccULL,
+  0xc56445135f4246b8ULL, 0x2916d63a883176ecULL, 0x6083d7321ede26e3ULL,
+  0xa42774ffcea14b8aULL, 0x1d4edca55716c090ULL, 0x6c711675e014361dULL,
+  0x79e57bbe1a1c32dbULL, 0xdb6382100a9ece9eULL, 0x95666d67effc1d54ULL,
+  0xf08d1101987ba7dfULL, 0x469c1627f0ec212fULL, 0x35c7e42ca95a006fULL,
+  0x325941d0bea65b93ULL, 0x3ea1fae2398ef8f7ULL, 0x8b4164c0e0cd8421ULL,
+  0xc7659eebb76dd741ULL, 0x5ce81efac60b0d84ULL, 0x1548f5b9bb4f9438ULL,
+  0xc1466d4d5a397197ULL, 0x41e6ce1c5d60f3c8ULL, 0x6202743605d37fc9ULL,
+  0xcd27b881443b25d7ULL, 0xb938ef56c5f692a5ULL, 0xcd72d6d16123f815ULL,
+  0x8113c85bc4f74c78ULL, 0x14100775ce006c61ULL, 0xc61f389b26992992ULL,
+  0x575f86e47938b9ecULL, 0x5c8145bbafd72a23ULL, 0x9e780d4b6ff1d276ULL,
+  0x32a19658230166afULL, 0x26c2cbee93b32e02ULL, 0x3b9b944163210913ULL,
+  0x8583f61105181051ULL, 0x5f87e72caea7fd4eULL, 0xd51f272fd50b0011ULL,
+  0x341796d1b5ced1f9ULL, 0xd18cb474e8d98367ULL, 0xc1445b3f27327fa5ULL,
+  0x45a6dd19f893eb03ULL, 0xba1a8f37d5e3684cULL, 0xd8afe03579e189e8ULL,
+  0x9ca91101a975580bULL, 0x318eb1000f55c699ULL, 0xa5e5e815d342f53eULL,
+  0xe5ea38b632da65a7ULL, 0x9d21dfa90e22e8edULL, 0xf3475f7b8fab1c50ULL,
+  0x79e0a70d420a0011ULL, 0x1b3cb3897af66f00ULL, 0x4e777b1e83c2728eULL,
+  0x84423c8a3c1d8b44ULL, 0xf4549d704625d750ULL, 0xbfc911a1fc648c7aULL,
+  0xd8bab9b7cffe09a5ULL, 0x1c5097b52d2d8b45ULL, 0x68b5ca640ae2d943ULL,
+  0x751a0f39ce728152ULL, 0x2319f3abbaa1a84aULL, 0x95b9a452adbb388eULL,
+  0x3c23b2ea9a852c34ULL, 0xb5a0f55f9d53366cULL, 0xd62928c45d9b443eULL,
+  0x4048dcfa3df7a922ULL, 0x84f6632c7cd0cc55ULL, 0xc6881594922ee6fcULL,
+  0xdd140e99e49e0dfbULL, 0x724fc8eaebd93516ULL, 0x1b0bfa9f0d517c48ULL,
+  0xd56b90f0bf39142dULL, 0x6b91518476cdf1baULL, 0x17f7516861fad1b9ULL,
+  0xb15e7b4db52c3fefULL, 0xe3048b28c1fcfbc9ULL, 0xb84a03271aa78f8eULL,
+  0xc7e4151e99ad5002ULL, 0x879d72143062955aULL, 0xba0776cb4cb783beULL,
+  0x5e025b7bf9474cfeULL, 0xdfa2e07196595861ULL, 0xf5cf4832a7eb57fbULL,
+  0xcc01a9983dc34023ULL, 0xc1b43b828bf94a4eULL, 0xbce64925be6d13b5ULL,
+  0x86307c6f04e1d345ULL, 0x31c1c48c96095a76ULL, 0xbaf864c749e469c4ULL,
+  0xed181d746a4cf5c0ULL, 0xc32f10642ccd0839ULL, 0xee06233dd2f7ad48ULL,
+  0x3549ea6c5a4dbea4ULL, 0x353e1d6167ab6e81ULL, 0xd289a2eb5836ce87ULL,
+  0x97ebdeab487d0f69ULL, 0x4e07523ad61dd363ULL, 0x325e43ed2362c4d6ULL,
+  0x91e26a8e8d3a85e2ULL, 0x74da1f1e21ff7b4dULL, 0x72b6d6ed012c808bULL,
+  0x99b392edd15bdde9ULL, 0xda7ed18765680f1eULL, 0x4069e5760c6eb58aULL,
+  0x6a64774ee5b21f80ULL, 0x48b033cf18cef67dULL, 0x6b1a1d74aa2af876ULL,
+  0x16f54d0eafe3e296ULL, 0x7532a715044b5cc2ULL, 0xc421e1e852ae41a0ULL,
+  0x06605df4167d93abULL, 0x9d683deaefa7733dULL, 0x56c9c0d9e6c2d4dfULL,
+  0x8f311f22ba50e32fULL, 0x92256ad2a215904bULL, 0x771593fa9650bdfeULL,
+  0xe4b9c083e5f00e03ULL, 0x974493a32f08f753ULL, 0x7e8a24e895b9fa47ULL,
+  0xfb58e55d0e685d47ULL, 0xa24462c84d191e14ULL, 0x8bbf4906cdb90d4bULL,
+  0x3c4f6d1818724d52ULL, 0x4938491f325bfbb9ULL, 0xcbe5d983df9b9a9dULL,
+  0x5dc8dc4b2671bba7ULL, 0x6a7d528732d959e8ULL, 0xb1dda2e4d3205521ULL,
+  0x06ad4e897d5e8ecfULL, 0x0ecf7cbfed67e33dULL, 0x5beb14bb7f493977ULL,
+  0x311451be7af3637eULL, 0x84e6f5db1c5a7fdcULL, 0xa8ffd8d57a43acd9ULL,
+  0x3b2d482c4add694bULL, 0xdb2cd6c024a9b548ULL, 0xa89cdf41eee332e4ULL,
+  0x40eb2cf6b9f04b17ULL, 0x45f9bcd03569d0efULL, 0xaf68972df8cb3df4ULL,
+  0xd99eb4b740e091b4ULL, 0x501587ebb209c17dULL, 0x80e449db0db6d7eaULL,
+  0x279caf1d6a158f83ULL, 0x1ccbf733833e5e8aULL, 0x9e21e77dc65ebed3ULL,
+  0xc1d2d6eaa9aba7fbULL, 0x4ceb4d15d1559d7fULL, 0xe19b2641517e93c7ULL,
+  0x70b1804e43037f3cULL, 0xdf3c0a4aa3cc5c2cULL, 0x955a678c0aa1578eULL,
+  0x02b89278ca643855ULL, 0x86c72603c210e5beULL, 0x677fb1b498d9587aULL,
+  0x5e6852195400a896ULL, 0x44538c02132c1be6ULL, 0x70b0931049386698ULL,
+  0x2d0ec62e618fab36ULL, 0x04a82cce9ddcf1f3ULL, 0x51b400019cca6ce1ULL,
+  0x8ad180bf5325a75bULL, 0xafd922dcfa45bfe2ULL, 0x8216260b2131c554ULL,
+  0x62a28faa3bca3c77ULL, 0x955a7aa8d1e3da7bULL, 0xbd2e4f618bd26410ULL,
+  0x6c694012108e04f8ULL, 0x95018e3caa1f7f90ULL, 0x68665c7bb06ea28eULL,
+  0xecab183c0dce4ac9ULL, 0x5ef250ecbdd285c1ULL, 0x2404480ba8fe95c1ULL,
+  0x8b27bfbfebd52ab4ULL, 0x9ac2059ec13672bdULL, 0x1350d4a717a3bd3fULL,
+  0x8eeeb61d6319f399ULL, 0x1c63b77560584925ULL, 0x660625bf18a50022ULL,
+  0xc9cb3ce2b401417fULL, 0x8d977c6b374754d4ULL, 0x4024d9f356e5bddcULL,
+  0xb539587db2d2a0e7ULL, 0x290f659f61ec6684ULL, 0x7352a85abcbb6b85ULL,
+  0x90e7c187f835f635ULL, 0xd0b08da6c86e7178ULL, 0xe44a0939aecc1e63ULL,
+  0xc08191e4c0a280f0ULL, 0xbd0868431ee6451fULL, 0x10f7efc5ea0315c0ULL,
+  0xea9f88798a666001ULL, 0x29a1044b2dfebd19ULL, 0x22f5692ef4ad5d13ULL,
+  0xd177d9d42a8e9373ULL, 0x7e21c3e9db851cadULL, 0xfe09620d759f82dfULL,
+  0x781b23558c648d01ULL, 0x9ba5de4684ed68f7ULL, 0x11adb85f39ce819eULL,
+  0x21b402fbb102b42aULL, 0x3da6465587a91e79ULL, 0x2adcbb0531ae1b81ULL,
+  0x62b128ab5ecd29cdULL, 0xe674e1959d5043abULL, 0x8e10f9702924b3c6ULL,
+  0x6d84dbf8c74177a6ULL, 0xaf0d0240a22b06f5ULL, 0xa85f0d9400da719fULL,
+  0xebb2fece9c78eca0ULL, 0x20e3de5dce415d6dULL, 0xf9ad50cd37564342ULL,
+  0x56ea6480c862bf63ULL, 0x4548c18ad3044734ULL, 0x93636c8acd2d013fULL,
+  0x490364331ef07598ULL, 0xbe5b0415f35e6354ULL, 0x0d3d57ee78f9853cULL,
+  0x7eb708d9151caa39ULL, 0xdf28d5d34983be01ULL, 0x0c74dc5b3ebcdcb8ULL,
+  0x6425063e2d264c3bULL, 0x68c374ee0b90dfe0ULL, 0x5ef75e6b9b8787d3ULL,
+  0x4354135df70a8a71ULL
+};
+
+
+/**
+ * Masks use the upper bits of the fingerprint because, due to the left shift,
+ * only those depend on the entire window of kGearWindow bytes.
+ */
+uint64_t FastCdcDetector::MakeMask(const unsigned nbits) {
+  assert((nbits > 0) && (nbits < 64));
+  return ((uint64_t(1) << nbits) - 1) << (64 - nbits);
+}
+
+
+FastCdcDetector::FastCdcDetector(const uint64_t minimal_chunk_size,
+                                 const uint64_t average_chunk_size,
+                                 const uint64_t maximal_chunk_size)
+  : minimal_chunk_size_(minimal_chunk_size)
+  , average_chunk_size_(average_chunk_size)
+  , maximal_chunk_size_(maximal_chunk_size)
+  , mask_small_(0)
+  , mask_large_(0)
+  , fingerprint_ptr_(0)
+  , fingerprint_(0)
+{
+  assert(minimal_chunk_size_ >= kGearWindow);
+  assert(minimal_chunk_size_ < average_chunk_size_);
+  assert(average_chunk_size_ < maximal_chunk_size_);
+
+  // Number of mask bits for a cut probability of 1 / average_chunk_size
+  unsigned nbits = 0;
+  while ((uint64_t(1) << (nbits + 1)) <= average_chunk_size_)
+    nbits++;
+  assert(nbits > kNormalizationLevel);
+  mask_small_ = MakeMask(nbits + kNormalizationLevel);
+  mask_large_ = MakeMask(nbits - kNormalizationLevel);
+}
+
+
+/**
+ * Rolls the fingerprint over data[begin, end) and returns the position after
+ * the first byte for which the fingerprint matches the mask, or 0 if there is
+ * none.  Two bytes are processed per step.  Both fingerprints are derived
+ * directly from the fingerprint before the step, which halves the chain of
+ * dependent instructions compared to the byte-by-byte update.  The cut marks
+ * are the same.
+ */
+uint64_t FastCdcDetector::Roll(
+  const unsigned char *data,
+  uint64_t begin,
+  const uint64_t end,
+  const uint64_t mask,
+  uint64_t *fingerprint)
+{
+  uint64_t fp = *fingerprint;
+  for (; begin + 1 < end; begin += 2) {
+    const uint64_t gear0 = kGearTable[data[begin]];
+    const uint64_t gear1 = kGearTable[data[begin + 1]];
+    const uint64_t fp0 = (fp << 1) + gear0;
+    fp = (fp << 2) + ((gear0 << 1) + gear1);
+    if ((fp0 & mask) == 0)
+      return begin + 1;
+    if ((fp & mask) == 0)
+      return begin + 2;
+  }
+  if (begin < end) {
+    fp = (fp << 1) + kGearTable[data[begin]];
+    if ((fp & mask) == 0)
+      return begin + 1;
+  }
+  *fingerprint = fp;
+  return 0;
+}
+
+
+uint64_t FastCdcDetector::DoFindNextCutMark(BlockItem *buffer) {
+  const unsigned char *data = buffer->data();
+  const uint64_t beginning = offset();
+  const uint64_t end = offset() + buffer->size();
+
+  // The fingerprint computation starts kGearWindow bytes before the minimal
+  // chunk size, so that the first candidate depends on a full window
+  uint64_t pos = std::max(
+    last_cut() + minimal_chunk_size_ - kGearWindow, fingerprint_ptr_);
+  if (pos >= end)
+    return NoCut(pos);
+  assert(pos >= beginning);
+
+  const uint64_t min_end = last_cut() + minimal_chunk_size_;
+  const uint64_t avg_end = last_cut() + average_chunk_size_;
+  const uint64_t max_end = last_cut() + maximal_chunk_size_;
+  uint64_t fp = fingerprint_;
+
+  // Fill the window, no cut marks before the minimal chunk size
+  uint64_t stop = std::min(min_end, end);
+  for (; pos < stop; ++pos)
+    fp = (fp << 1) + kGearTable[data[pos - beginning]];
+
+  // Normalized chunking: the stricter mask up to the average chunk size...
+  stop = std::max(pos, std::min(avg_end, end));
+  uint64_t cut = Roll(data, pos - beginning, stop - beginning, mask_small_,
+                      &fp);
+  if (cut > 0)
+    return DoCut(cut + beginning);
+  pos = stop;
+
+  // ...and the looser mask up to the maximal chunk size
+  stop = std::max(pos, std::min(max_end, end));
+  cut = Roll(data, pos - beginning, stop - beginning, mask_large_, &fp);
+  if (cut > 0)
+    return DoCut(cut + beginning);
+  pos = stop;
+
+  // Either hard cut at the maximal chunk size or continue with the next block
+  if (pos == max_end)
+    return DoCut(pos);
+  fingerprint_ = fp;
+  return NoCut(pos);
+}
@@ -11,9 +11,30 @@
 #include <cstdlib>
 
 #include <algorithm>
+#include <string>
 
 class BlockItem;
 
+/**
+ * Content-defined chunking algorithms that can be selected in the spooler
+ * definition.  The cut marks of an algorithm must never change, otherwise
+ * existing chunks would not be reused across repository revisions.
+ */
+enum ChunkingAlgorithms {
+  kChunkingXor32 = 0,
+  kChunkingFastCdc,
+  kChunkingUnknown,
+};
+
+ChunkingAlgorithms ParseChunkingAlgorithm(const std::string &algorithm_option);
+std::string ChunkingAlgorithmName(const ChunkingAlgorithms alg);
+
+class ChunkDetector;
+ChunkDetector *CreateChunkDetector(const ChunkingAlgorithms alg,
+                                   const uint64_t minimal_chunk_size,
+                                   const uint64_t average_chunk_size,
+                                   const uint64_t maximal_chunk_size);
+
 /**
  * Abstract base class for a cutmark detector. This decides on which file
  * positions a File should be chunked.
@@ -135,4 +156,74 @@ class Xor32Detector : public ChunkDetector {
   uint32_t xor32_;
 };
 
+
+/**
+ * Content-defined chunking based on the Gear rolling hash as used by
+ * FastCDC [1].  The Gear hash needs a single shift, add, and table lookup per
+ * byte, which is considerably cheaper than xor32 with its threshold check.
+ * The fingerprint only depends on the last 64 bytes of the stream.
+ *
+ * Cut mark candidates before the minimal chunk size are skipped.  In order to
+ * narrow the chunk size distribution ("normalized chunking"), a stricter mask
+ * with more bits is used until the average chunk size is reached and a looser
+ * mask with fewer bits is used afterwards.
+ *
+ * [1]     "FastCDC: a Fast and Efficient Content-Defined Chunking Approach
+ *          for Data Deduplication"
+ *     Wen Xia et al., USENIX ATC (2016)
+ */
+class FastCdcDetector : public ChunkDetector {
+  FRIEND_TEST(T_ChunkDetectors, FastCdcMasks);
+
+ public:
+  FastCdcDetector(const uint64_t minimal_chunk_size,
+                  const uint64_t average_chunk_size,
+                  const uint64_t maximal_chunk_size);
+
+  bool MightFindChunks(const uint64_t size) const {
+    return size > minimal_chunk_size_;
+  }
+
+ protected:
+  virtual uint64_t DoFindNextCutMark(BlockItem *buffer);
+
+  virtual uint64_t DoCut(const uint64_t offset) {
+    fingerprint_     = 0;
+    fingerprint_ptr_ = offset;
+    return ChunkDetector::DoCut(offset);
+  }
+
+  virtual uint64_t NoCut(const uint64_t offset) {
+    fingerprint_ptr_ = offset;
+    return ChunkDetector::NoCut(offset);
+  }
+
+ private:
+  // The Gear fingerprint only depends on a window of the last 64 bytes
+  static const unsigned kGearWindow = 64;
+  // Number of bits added to / removed from the mask for normalized chunking
+  static const unsigned kNormalizationLevel = 2;
+  static const uint64_t kGearTable[256];
+
+  static uint64_t MakeMask(const unsigned nbits);
+  static uint64_t Roll(const unsigned char *data, uint64_t begin,
+                       const uint64_t end, const uint64_t mask,
+                       uint64_t *fingerprint);
+
+  const uint64_t minimal_chunk_size_;
+  const uint64_t average_chunk_size_;
+  const uint64_t maximal_chunk_size_;
+  /**
+   * Used for candidates before the average chunk size is reached
+   */
+  uint64_t mask_small_;
+  /**
+   * Used for candidates after the average chunk size is reached
+   */
+  uint64_t mask_large_;
+
+  uint64_t fingerprint_ptr_;
+  uint64_t fingerprint_;
+};
+
 #endif  // CVMFS_INGESTION_CHUNK_DETECTOR_H_
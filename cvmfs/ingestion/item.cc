@@ -23,7 +23,8 @@ FileItem::FileItem(
   shash::Algorithms hash_algorithm,
   shash::Suffix hash_suffix,
   bool may_have_chunks,
-  bool has_legacy_bulk_chunk)
+  bool has_legacy_bulk_chunk,
+  ChunkingAlgorithms chunking_algorithm)
   : source_(source)
   , compression_algorithm_(compression_algorithm)
   , hash_algorithm_(hash_algorithm)
@@ -31,7 +32,8 @@ FileItem::FileItem(
   , has_legacy_bulk_chunk_(has_legacy_bulk_chunk)
   , size_(kSizeUnknown)
   , may_have_chunks_(may_have_chunks)
-  , chunk_detector_(min_chunk_size, avg_chunk_size, max_chunk_size)
+  , chunk_detector_(CreateChunkDetector(chunking_algorithm, min_chunk_size,
+                                        avg_chunk_size, max_chunk_size))
   , bulk_hash_(hash_algorithm)
   , chunks_(1)
 {
@@ -42,7 +42,8 @@ class FileItem : SingleCopy {
     shash::Algorithms hash_algorithm = shash::kSha1,
     shash::Suffix hash_suffix = shash::kSuffixNone,
     bool may_have_chunks = true,
-    bool has_legacy_bulk_chunk = false);
+    bool has_legacy_bulk_chunk = false,
+    ChunkingAlgorithms chunking_algorithm = kChunkingXor32);
   ~FileItem();
 
   static FileItem *CreateQuitBeacon() {
@@ -56,7 +57,7 @@ class FileItem : SingleCopy {
 
   std::string path() { return source_->GetPath(); }
   uint64_t size() { return size_; }
-  Xor32Detector *chunk_detector() { return &chunk_detector_; }
+  ChunkDetector *chunk_detector() { return chunk_detector_.weak_ref(); }
   shash::Any bulk_hash() { return bulk_hash_; }
   zlib::Algorithms compression_algorithm() { return compression_algorithm_; }
   shash::Algorithms hash_algorithm() { return hash_algorithm_; }
@@ -100,7 +101,7 @@ class FileItem : SingleCopy {
   uint64_t size_;
   bool may_have_chunks_;
 
-  Xor32Detector chunk_detector_;
+  UniquePtr<ChunkDetector> chunk_detector_;
   shash::Any bulk_hash_;
   FileChunkList chunks_;
   /**
@@ -33,6 +33,7 @@ IngestionPipeline::IngestionPipeline(
   , minimal_chunk_size_(spooler_definition.min_file_chunk_size)
   , average_chunk_size_(spooler_definition.avg_file_chunk_size)
   , maximal_chunk_size_(spooler_definition.max_file_chunk_size)
+  , chunking_algorithm_(spooler_definition.chunking_algorithm)
   , spawned_(false)
   , uploader_(uploader)
   , tube_counter_(kMaxFilesInFlight)
@@ -49,21 +50,21 @@ IngestionPipeline::IngestionPipeline(
   tubes_register_.Activate();
 
   for (unsigned i = 0; i < nfork_base * kNforkWrite; ++i) {
-    Tube<BlockItem> *t = new Tube<BlockItem>();
+    Tube<BlockItem> *t = new RingTube<BlockItem>(kBlockTubeCapacity);
     tubes_write_.TakeTube(t);
     tasks_write_.TakeConsumer(new TaskWrite(t, &tubes_register_, uploader_));
   }
   tubes_write_.Activate();
 
   for (unsigned i = 0; i < nfork_base * kNforkHash; ++i) {
-    Tube<BlockItem> *t = new Tube<BlockItem>();
+    Tube<BlockItem> *t = new RingTube<BlockItem>(kBlockTubeCapacity);
     tubes_hash_.TakeTube(t);
     tasks_hash_.TakeConsumer(new TaskHash(t, &tubes_write_));
   }
   tubes_hash_.Activate();
 
   for (unsigned i = 0; i < nfork_base * kNforkCompress; ++i) {
-    Tube<BlockItem> *t = new Tube<BlockItem>();
+    Tube<BlockItem> *t = new RingTube<BlockItem>(kBlockTubeCapacity);
     tubes_compress_.TakeTube(t);
     tasks_compress_.TakeConsumer(
       new TaskCompress(t, &tubes_hash_, &item_allocator_));
@@ -71,7 +72,7 @@ IngestionPipeline::IngestionPipeline(
   tubes_compress_.Activate();
 
   for (unsigned i = 0; i < nfork_base * kNforkChunk; ++i) {
-    Tube<BlockItem> *t = new Tube<BlockItem>();
+    Tube<BlockItem> *t = new RingTube<BlockItem>(kBlockTubeCapacity);
     tubes_chunk_.TakeTube(t);
     tasks_chunk_.TakeConsumer(
       new TaskChunk(t, &tubes_compress_, &item_allocator_));
@@ -130,7 +131,8 @@ void IngestionPipeline::Process(
     hash_algorithm_,
     hash_suffix,
     allow_chunking && chunking_enabled_,
-    generate_legacy_bulk_chunks_);
+    generate_legacy_bulk_chunks_,
+    chunking_algorithm_);
   tube_counter_.EnqueueBack(file_item);
   tube_input_.EnqueueBack(file_item);
 }
@@ -194,7 +196,8 @@ ScrubbingPipeline::ScrubbingPipeline()
   unsigned nfork_base = std::max(1U, GetNumberOfCpuCores() / 8);
 
   for (unsigned i = 0; i < nfork_base * kNforkScrubbingCallback; ++i) {
-    Tube<BlockItem> *tube = new Tube<BlockItem>();
+    Tube<BlockItem> *tube =
+      new RingTube<BlockItem>(kBlockTubeCapacity);
     tubes_scrubbing_callback_.TakeTube(tube);
     TaskScrubbingCallback *task =
       new TaskScrubbingCallback(tube, &tube_counter_);
@@ -204,14 +207,14 @@ ScrubbingPipeline::ScrubbingPipeline()
   tubes_scrubbing_callback_.Activate();
 
   for (unsigned i = 0; i < nfork_base * kNforkHash; ++i) {
-    Tube<BlockItem> *t = new Tube<BlockItem>();
+    Tube<BlockItem> *t = new RingTube<BlockItem>(kBlockTubeCapacity);
     tubes_hash_.TakeTube(t);
     tasks_hash_.TakeConsumer(new TaskHash(t, &tubes_scrubbing_callback_));
   }
   tubes_hash_.Activate();
 
   for (unsigned i = 0; i < nfork_base * kNforkChunk; ++i) {
-    Tube<BlockItem> *t = new Tube<BlockItem>();
+    Tube<BlockItem> *t = new RingTube<BlockItem>(kBlockTubeCapacity);
     tubes_chunk_.TakeTube(t);
     tasks_chunk_.TakeConsumer(
       new TaskChunk(t, &tubes_hash_, &item_allocator_));
@@ -38,6 +38,7 @@ class IngestionPipeline : public Observable<upload::SpoolerResult> {
  private:
   static const uint64_t kMaxPipelineMem;  // 1G
   static const unsigned kMaxFilesInFlight = 8000;
+  static const unsigned kBlockTubeCapacity = 1024;
   static const unsigned kNforkRegister = 1;
   static const unsigned kNforkWrite = 1;
   static const unsigned kNforkHash = 2;
@@ -52,6 +53,7 @@ class IngestionPipeline : public Observable<upload::SpoolerResult> {
   const size_t minimal_chunk_size_;
   const size_t average_chunk_size_;
   const size_t maximal_chunk_size_;
+  const ChunkingAlgorithms chunking_algorithm_;
 
   bool spawned_;
   upload::AbstractUploader *uploader_;
@@ -125,6 +127,7 @@ class ScrubbingPipeline : public Observable<ScrubbingResult> {
   static const uint64_t kMemLowWatermark = 384 * 1024 * 1024;
   static const uint64_t kMemHighWatermark = 512 * 1024 * 1024;
   static const unsigned kMaxFilesInFlight = 8000;
+  static const unsigned kBlockTubeCapacity = 1024;
   static const unsigned kNforkScrubbingCallback = 1;
   static const unsigned kNforkHash = 2;
   static const unsigned kNforkChunk = 1;
@@ -5,6 +5,7 @@
 #include "cvmfs_config.h"
 #include "task_hash.h"
 
+#include <algorithm>
 #include <cstdlib>
 
 #include "crypto/hash.h"
@@ -12,20 +13,69 @@
 
 
 void TaskHash::Process(BlockItem *input_block) {
-  ChunkItem *chunk = input_block->chunk_item();
-  assert(chunk != NULL);
-
-  switch (input_block->type()) {
-    case BlockItem::kBlockData:
-      shash::Update(input_block->data(), input_block->size(),
-                    chunk->hash_ctx());
+  batch_.push_back(input_block);
+  while (batch_.size() < kMaxBatchSize) {
+    BlockItem *next_block = tube_->TryPopFront();
+    if (next_block == NULL)
       break;
-    case BlockItem::kBlockStop:
-      shash::Final(chunk->hash_ctx(), chunk->hash_ptr());
+    if (next_block->IsQuitBeacon()) {
+      // The quit beacon is the last item in the tube, so putting it back at
+      // the end keeps it in place.  Ring tubes do not support EnqueueFront().
+      tube_->EnqueueBack(next_block);
       break;
-    default:
-      PANIC(NULL);
+    }
+    batch_.push_back(next_block);
   }
 
-  tubes_out_->Dispatch(input_block);
+  HashBatch();
+
+  for (unsigned i = 0; i < batch_.size(); ++i)
+    tubes_out_->Dispatch(batch_[i]);
+  batch_.clear();
+}
+
+
+/**
+ * Blocks of the same chunk need to be hashed in order.  Data blocks are
+ * collected until a chunk shows up a second time.
+ */
+void TaskHash::HashBatch() {
+  for (unsigned i = 0; i < batch_.size(); ++i) {
+    BlockItem *block = batch_[i];
+    ChunkItem *chunk = block->chunk_item();
+    assert(chunk != NULL);
+
+    if (std::find(pending_chunks_.begin(), pending_chunks_.end(), chunk) !=
+        pending_chunks_.end())
+    {
+      FlushPending();
+    }
+
+    switch (block->type()) {
+      case BlockItem::kBlockData:
+        pending_chunks_.push_back(chunk);
+        pending_buffers_.push_back(block->data());
+        pending_sizes_.push_back(block->size());
+        pending_contexts_.push_back(chunk->hash_ctx());
+        break;
+      case BlockItem::kBlockStop:
+        shash::Final(chunk->hash_ctx(), chunk->hash_ptr());
+        break;
+      default:
+        PANIC(NULL);
+    }
+  }
+  FlushPending();
+}
+
+
+void TaskHash::FlushPending() {
+  if (pending_chunks_.empty())
+    return;
+  shash::UpdateMulti(&pending_buffers_[0], &pending_sizes_[0],
+                     &pending_contexts_[0], pending_chunks_.size());
+  pending_chunks_.clear();
+  pending_buffers_.clear();
+  pending_sizes_.clear();
+  pending_contexts_.clear();
 }
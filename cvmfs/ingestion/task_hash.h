@@ -5,11 +5,24 @@
 #ifndef CVMFS_INGESTION_TASK_HASH_H_
 #define CVMFS_INGESTION_TASK_HASH_H_
 
+#include <vector>
+
+#include "crypto/hash.h"
 #include "ingestion/item.h"
 #include "ingestion/task.h"
 
+/**
+ * Blocks that are already waiting in the tube are taken in batches, so that
+ * the data blocks of different chunks can be hashed in parallel by
+ * shash::UpdateMulti().
+ */
 class TaskHash : public TubeConsumer<BlockItem> {
  public:
+  /**
+   * Enough to keep the widest SIMD lanes busy
+   */
+  static const unsigned kMaxBatchSize = 32;
+
   TaskHash(Tube<BlockItem> *tube_in, TubeGroup<BlockItem> *tubes_out)
     : TubeConsumer<BlockItem>(tube_in), tubes_out_(tubes_out) { }
 
@@ -17,7 +30,18 @@ class TaskHash : public TubeConsumer<BlockItem> {
   virtual void Process(BlockItem *input_block);
 
  private:
+  void HashBatch();
+  void FlushPending();
+
   TubeGroup<BlockItem> *tubes_out_;
+  std::vector<BlockItem *> batch_;
+  /**
+   * Data blocks of distinct chunks that are hashed together
+   */
+  std::vector<ChunkItem *> pending_chunks_;
+  std::vector<const unsigned char *> pending_buffers_;
+  std::vector<unsigned> pending_sizes_;
+  std::vector<shash::ContextPtr> pending_contexts_;
 };
 
 #endif  // CVMFS_INGESTION_TASK_HASH_H_
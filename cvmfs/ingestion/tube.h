@@ -13,6 +13,7 @@
 
 #include "util/atomic.h"
 #include "util/concurrency.h"
+#include "util/exception.h"
 #include "util/pointer.h"
 #include "util/single_copy.h"
 
@@ -54,7 +55,7 @@ class Tube : SingleCopy {
   explicit Tube(uint64_t limit) : limit_(limit), size_(0) {
     Init();
   }
-  ~Tube() {
+  virtual ~Tube() {
     Link *cursor = head_;
     do {
       Link *prev = cursor->prev_;
@@ -70,7 +71,7 @@ class Tube : SingleCopy {
   /**
    * Push an item to the back of the queue.  Block if queue is currently full.
    */
-  Link *EnqueueBack(ItemT *item) {
+  virtual Link *EnqueueBack(ItemT *item) {
     assert(item != NULL);
     MutexLockGuard lock_guard(&lock_);
     while (size_ == limit_)
@@ -90,7 +91,7 @@ class Tube : SingleCopy {
   /**
    * Push an item to the front of the queue. Block if queue currently full.
    */
-  Link *EnqueueFront(ItemT *item) {
+  virtual Link *EnqueueFront(ItemT *item) {
     assert(item != NULL);
     MutexLockGuard lock_guard(&lock_);
     while (size_ == limit_)
@@ -111,7 +112,7 @@ class Tube : SingleCopy {
    * Remove any link from the queue and return its item, including first/last
    * element.
    */
-  ItemT *Slice(Link *link) {
+  virtual ItemT *Slice(Link *link) {
     MutexLockGuard lock_guard(&lock_);
     return SliceUnlocked(link);
   }
@@ -120,18 +121,29 @@ class Tube : SingleCopy {
    * Remove and return the first element from the queue.  Block if tube is
    * empty.
    */
-  ItemT *PopFront() {
+  virtual ItemT *PopFront() {
     MutexLockGuard lock_guard(&lock_);
     while (size_ == 0)
       pthread_cond_wait(&cond_populated_, &lock_);
     return SliceUnlocked(head_->prev_);
   }
 
+  /**
+   * Remove and return the first element from the queue or NULL if the tube is
+   * empty.
+   */
+  virtual ItemT *TryPopFront() {
+    MutexLockGuard lock_guard(&lock_);
+    if (size_ == 0)
+      return NULL;
+    return SliceUnlocked(head_->prev_);
+  }
+
   /**
    * Remove and return the last element from the queue.  Block if tube is
    * empty.
    */
-  ItemT *PopBack() {
+  virtual ItemT *PopBack() {
     MutexLockGuard lock_guard(&lock_);
     while (size_ == 0)
       pthread_cond_wait(&cond_populated_, &lock_);
@@ -141,18 +153,18 @@ class Tube : SingleCopy {
   /**
    * Blocks until the tube is empty
    */
-  void Wait() {
+  virtual void Wait() {
     MutexLockGuard lock_guard(&lock_);
     while (size_ > 0)
       pthread_cond_wait(&cond_empty_, &lock_);
   }
 
-  bool IsEmpty() {
+  virtual bool IsEmpty() {
     MutexLockGuard lock_guard(&lock_);
     return size_ == 0;
   }
 
-  uint64_t size() {
+  virtual uint64_t size() {
     MutexLockGuard lock_guard(&lock_);
     return size_;
   }
@@ -203,6 +215,8 @@ class Tube : SingleCopy {
    * Sentinel element in front of the first (front) element
    */
   Link *head_;
+
+ protected:
   /**
    * Protects all internal state
    */
@@ -222,6 +236,261 @@ class Tube : SingleCopy {
 };
 
 
+/**
+ * A bounded, lock-free variant of the Tube for the hot paths of the ingestion
+ * pipeline.  Items are kept in a ring buffer of (rounded up) power-of-two
+ * capacity.  Every cell carries a sequence number that tells producers and
+ * consumers whose turn it is, so that enqueue and dequeue are a single
+ * compare-and-swap on the respective position counter in the common case
+ * (D. Vyukov's bounded MPMC queue).
+ *
+ * Threads that find the ring empty (or full) first spin for a while and only
+ * then park on the condition variables of the base class.  The number of spin
+ * rounds adapts: it grows when spinning was successful and shrinks when the
+ * thread had to park anyway.  The mutex is only taken on the parking slow path
+ * and by the thread that wakes parked threads up.
+ *
+ * Only the FIFO part of the Tube interface is supported: EnqueueBack() returns
+ * NULL instead of a link, and EnqueueFront(), Slice(), and PopBack() panic.
+ * The size is exact only when there are no concurrent operations.
+ */
+template <class ItemT>
+class RingTube : public Tube<ItemT> {
+ public:
+  explicit RingTube(uint64_t capacity)
+    : capacity_(RoundUpCapacity(capacity))
+    , mask_(capacity_ - 1)
+    , cells_(new Cell[capacity_])
+  {
+    for (uint64_t i = 0; i < capacity_; ++i) {
+      cells_[i].sequence = i;
+      cells_[i].item = NULL;
+    }
+    atomic_init64(&enqueue_pos_);
+    atomic_init64(&dequeue_pos_);
+    atomic_init32(&num_waiting_producers_);
+    atomic_init32(&num_waiting_consumers_);
+    atomic_init32(&num_waiting_empty_);
+    spin_limit_ = kMinSpin;
+  }
+  virtual ~RingTube() {
+    delete[] cells_;
+  }
+
+  /**
+   * Push an item to the back of the ring.  Block if the ring is full.
+   */
+  virtual typename Tube<ItemT>::Link *EnqueueBack(ItemT *item) {
+    assert(item != NULL);
+    if (!TryEnqueue(item)) {
+      const int32_t spin_limit = atomic_read32(&spin_limit_);
+      int32_t i = 0;
+      for (; i < spin_limit; ++i) {
+        CpuRelax();
+        if (TryEnqueue(item))
+          break;
+      }
+      AdaptSpinLimit(i < spin_limit);
+      if (i == spin_limit) {
+        MutexLockGuard lock_guard(&this->lock_);
+        atomic_inc32(&num_waiting_producers_);
+        while (!TryEnqueue(item))
+          pthread_cond_wait(&this->cond_capacious_, &this->lock_);
+        atomic_dec32(&num_waiting_producers_);
+      }
+    }
+    WakeUp(&num_waiting_consumers_, &this->cond_populated_);
+    return NULL;
+  }
+
+  virtual typename Tube<ItemT>::Link *EnqueueFront(ItemT * /* item */) {
+    PANIC(NULL);
+  }
+
+  virtual ItemT *Slice(typename Tube<ItemT>::Link * /* link */) {
+    PANIC(NULL);
+  }
+
+  /**
+   * Remove and return the first element from the ring.  Block if the ring is
+   * empty.
+   */
+  virtual ItemT *PopFront() {
+    ItemT *item = TryDequeue();
+    if (item == NULL) {
+      const int32_t spin_limit = atomic_read32(&spin_limit_);
+      for (int32_t i = 0; (i < spin_limit) && (item == NULL); ++i) {
+        CpuRelax();
+        item = TryDequeue();
+      }
+      AdaptSpinLimit(item != NULL);
+      if (item == NULL) {
+        MutexLockGuard lock_guard(&this->lock_);
+        atomic_inc32(&num_waiting_consumers_);
+        while ((item = TryDequeue()) == NULL)
+          pthread_cond_wait(&this->cond_populated_, &this->lock_);
+        atomic_dec32(&num_waiting_consumers_);
+      }
+    }
+    OnDequeued();
+    return item;
+  }
+
+  /**
+   * Remove and return the first element from the ring or NULL if the ring is
+   * empty.
+   */
+  virtual ItemT *TryPopFront() {
+    ItemT *item = TryDequeue();
+    if (item != NULL)
+      OnDequeued();
+    return item;
+  }
+
+  virtual ItemT *PopBack() {
+    PANIC(NULL);
+  }
+
+  /**
+   * Blocks until the ring is empty
+   */
+  virtual void Wait() {
+    MutexLockGuard lock_guard(&this->lock_);
+    atomic_inc32(&num_waiting_empty_);
+    while (!IsEmpty())
+      pthread_cond_wait(&this->cond_empty_, &this->lock_);
+    atomic_dec32(&num_waiting_empty_);
+  }
+
+  virtual bool IsEmpty() { return size() == 0; }
+
+  virtual uint64_t size() {
+    // Read the dequeue position first so that the difference cannot be negative
+    const int64_t dequeue_pos = atomic_read64(&dequeue_pos_);
+    const int64_t enqueue_pos = atomic_read64(&enqueue_pos_);
+    return enqueue_pos - dequeue_pos;
+  }
+
+  uint64_t capacity() const { return capacity_; }
+
+ private:
+  static const int32_t kMinSpin = 16;
+  static const int32_t kMaxSpin = 4096;
+  static const unsigned kCacheLineSize = 64;
+
+  /**
+   * A cell is ready for the producer at position p if its sequence equals p
+   * and ready for the consumer at position p if its sequence equals p + 1.
+   */
+  struct Cell {
+    atomic_int64 sequence;
+    ItemT *item;
+  };
+
+  static uint64_t RoundUpCapacity(uint64_t capacity) {
+    uint64_t result = 2;
+    while (result < capacity)
+      result <<= 1;
+    return result;
+  }
+
+  static inline void CpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __asm__ __volatile__("pause" : : : "memory");
+#else
+    MemoryFence();
+#endif
+  }
+
+  bool TryEnqueue(ItemT *item) {
+    int64_t pos = atomic_read64(&enqueue_pos_);
+    Cell *cell;
+    while (true) {
+      cell = &cells_[pos & mask_];
+      const int64_t diff = atomic_read64(&cell->sequence) - pos;
+      if (diff == 0) {
+        if (atomic_cas64(&enqueue_pos_, pos, pos + 1))
+          break;
+        pos = atomic_read64(&enqueue_pos_);
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = atomic_read64(&enqueue_pos_);
+      }
+    }
+    cell->item = item;
+    // Publishes the item: sequence becomes pos + 1
+    atomic_inc64(&cell->sequence);
+    return true;
+  }
+
+  ItemT *TryDequeue() {
+    int64_t pos = atomic_read64(&dequeue_pos_);
+    Cell *cell;
+    while (true) {
+      cell = &cells_[pos & mask_];
+      const int64_t diff = atomic_read64(&cell->sequence) - (pos + 1);
+      if (diff == 0) {
+        if (atomic_cas64(&dequeue_pos_, pos, pos + 1))
+          break;
+        pos = atomic_read64(&dequeue_pos_);
+      } else if (diff < 0) {
+        return NULL;
+      } else {
+        pos = atomic_read64(&dequeue_pos_);
+      }
+    }
+    ItemT *item = cell->item;
+    // Hands the cell to the producer of the next round: pos + capacity_
+    atomic_xadd64(&cell->sequence, mask_);
+    return item;
+  }
+
+  /**
+   * Parked threads increment the waiting counter before they check the ring
+   * under the lock, so either they see the change or we see them waiting.
+   */
+  void WakeUp(atomic_int32 *num_waiting, pthread_cond_t *cond) {
+    if (atomic_read32(num_waiting) == 0)
+      return;
+    MutexLockGuard lock_guard(&this->lock_);
+    int retval = pthread_cond_signal(cond);
+    assert(retval == 0);
+  }
+
+  void OnDequeued() {
+    WakeUp(&num_waiting_producers_, &this->cond_capacious_);
+    if ((atomic_read32(&num_waiting_empty_) > 0) && IsEmpty()) {
+      MutexLockGuard lock_guard(&this->lock_);
+      int retval = pthread_cond_broadcast(&this->cond_empty_);
+      assert(retval == 0);
+    }
+  }
+
+  void AdaptSpinLimit(bool spin_succeeded) {
+    const int32_t spin_limit = atomic_read32(&spin_limit_);
+    if (spin_succeeded && (spin_limit < kMaxSpin))
+      atomic_cas32(&spin_limit_, spin_limit, spin_limit * 2);
+    else if (!spin_succeeded && (spin_limit > kMinSpin))
+      atomic_cas32(&spin_limit_, spin_limit, spin_limit / 2);
+  }
+
+  const uint64_t capacity_;
+  const uint64_t mask_;
+  Cell *cells_;
+  atomic_int32 num_waiting_producers_;
+  atomic_int32 num_waiting_consumers_;
+  atomic_int32 num_waiting_empty_;
+  atomic_int32 spin_limit_;
+  // Keep the hot position counters on separate cache lines
+  char padding0_[kCacheLineSize];
+  atomic_int64 enqueue_pos_;
+  char padding1_[kCacheLineSize];
+  atomic_int64 dequeue_pos_;
+  char padding2_[kCacheLineSize];
+};
+
+
 /**
  * A tube group manages a fixed set of Tubes and dispatches items among them in
  * such a way that items with the same tag (a positive integer) are all sent
@@ -46,6 +46,7 @@ MemoryKvStore::MemoryKvStore(
   , heap_(NULL)
   , counters_(statistics)
 {
+  atomic_init32(&num_pins_);
   int retval = pthread_rwlock_init(&rwlock_, NULL);
   assert(retval == 0);
   switch (alloc) {
@@ -60,6 +61,9 @@ MemoryKvStore::MemoryKvStore(
 
 
 MemoryKvStore::~MemoryKvStore() {
+  assert(atomic_read32(&num_pins_) == 0);
+  ReapRetired();
+  assert(retired_.empty());
   delete heap_;
   pthread_rwlock_destroy(&rwlock_);
 }
@@ -102,14 +106,16 @@ int MemoryKvStore::DoMalloc(MemoryBuffer *buf) {
 
   tmp.address = NULL;
   if (tmp.size > 0) {
+    a.id = tmp.id;
     switch (allocator_) {
       case kMallocLibc:
-        tmp.address = malloc(tmp.size);
+        tmp.address = malloc(tmp.size + sizeof(a));
         if (!tmp.address) return -errno;
+        memcpy(tmp.address, &a, sizeof(a));
+        tmp.address = static_cast<char *>(tmp.address) + sizeof(a);
         break;
       case kMallocHeap:
         assert(heap_);
-        a.id = tmp.id;
         tmp.address =
           heap_->Allocate(tmp.size + sizeof(a), &a, sizeof(a));
         if (!tmp.address) return -ENOMEM;
@@ -132,7 +138,7 @@ void MemoryKvStore::DoFree(MemoryBuffer *buf) {
   if (!buf->address) return;
   switch (allocator_) {
     case kMallocLibc:
-      free(buf->address);
+      free(static_cast<char *>(buf->address) - sizeof(a));
       return;
     case kMallocHeap:
       heap_->MarkFree(static_cast<char *>(buf->address) - sizeof(a));
@@ -143,6 +149,40 @@ void MemoryKvStore::DoFree(MemoryBuffer *buf) {
 }
 
 
+AllocHeader *MemoryKvStore::GetHeader(const MemoryBuffer &buf) {
+  if (!buf.address) return NULL;
+  return reinterpret_cast<AllocHeader *>(
+    static_cast<char *>(buf.address) - sizeof(AllocHeader));
+}
+
+
+bool MemoryKvStore::IsPinned(const MemoryBuffer &buf) {
+  AllocHeader *a = GetHeader(buf);
+  return a && (atomic_read32(&a->pins) > 0);
+}
+
+
+/**
+ * Frees the retired buffers that are not pinned anymore.  Must be called
+ * under the write lock.
+ */
+void MemoryKvStore::ReapRetired() {
+  std::vector<MemoryBuffer>::iterator i = retired_.begin();
+  while (i != retired_.end()) {
+    if (IsPinned(*i)) {
+      ++i;
+      continue;
+    }
+    LogCvmfs(kLogKvStore, kLogDebug, "free retired memory of %s",
+             i->id.ToString().c_str());
+    used_bytes_ -= i->size;
+    counters_.sz_size->Set(used_bytes_);
+    DoFree(&(*i));
+    i = retired_.erase(i);
+  }
+}
+
+
 bool MemoryKvStore::CompactMemory() {
   double utilization;
   switch (allocator_) {
@@ -151,7 +191,24 @@ bool MemoryKvStore::CompactMemory() {
       LogCvmfs(kLogKvStore, kLogDebug, "compact requested (%f)", utilization);
       if (utilization < kCompactThreshold) {
         LogCvmfs(kLogKvStore, kLogDebug, "compacting heap");
-        heap_->Compact();
+        // Pins only change under the read lock, so the set is stable
+        vector<void *> pinned;
+        if (atomic_read32(&num_pins_) > 0) {
+          shash::Any key;
+          MemoryBuffer buf;
+          entries_.FilterBegin();
+          while (entries_.FilterNext()) {
+            entries_.FilterGet(&key, &buf);
+            if (IsPinned(buf))
+              pinned.push_back(GetHeader(buf));
+          }
+          entries_.FilterEnd();
+          // Unpinned retired buffers have been reaped by the caller
+          for (unsigned i = 0; i < retired_.size(); ++i)
+            pinned.push_back(GetHeader(retired_[i]));
+          sort(pinned.begin(), pinned.end());
+        }
+        heap_->Compact(pinned);
         if (heap_->utilization() > utilization) return true;
       }
       return false;
@@ -260,6 +317,63 @@ int64_t MemoryKvStore::Read(
 }
 
 
+int64_t MemoryKvStore::ReadZeroCopy(
+  const shash::Any &id,
+  size_t size,
+  size_t offset,
+  const void **data
+) {
+  MemoryBuffer mem;
+  perf::Inc(counters_.n_read);
+  ReadLockGuard guard(rwlock_);
+  if (!entries_.Lookup(id, &mem)) {
+    LogCvmfs(kLogKvStore, kLogDebug, "miss %s on ReadZeroCopy",
+             id.ToString().c_str());
+    return -ENOENT;
+  }
+  if (offset >= mem.size) {
+    if (offset > mem.size) {
+      LogCvmfs(kLogKvStore, kLogDebug, "out of bounds read (%u>%u) on %s",
+               offset, mem.size, id.ToString().c_str());
+    }
+    *data = NULL;
+    return 0;
+  }
+  uint64_t pinned_size = std::min(mem.size - offset, size);
+  atomic_inc32(&GetHeader(mem)->pins);
+  atomic_inc32(&num_pins_);
+  *data = static_cast<char *>(mem.address) + offset;
+  perf::Xadd(counters_.sz_read, pinned_size);
+  return pinned_size;
+}
+
+
+void MemoryKvStore::ReleaseZeroCopy(const shash::Any &id, const void *data) {
+  if (data == NULL)
+    return;
+  ReadLockGuard guard(rwlock_);
+  // The pinned memory is either the current entry or a retired one
+  AllocHeader *a = NULL;
+  MemoryBuffer mem;
+  const bool update_lru = false;
+  if (entries_.Lookup(id, &mem, update_lru) &&
+      (data >= mem.address) &&
+      (data < static_cast<char *>(mem.address) + mem.size))
+  {
+    a = GetHeader(mem);
+  }
+  for (unsigned i = 0; (a == NULL) && (i < retired_.size()); ++i) {
+    const MemoryBuffer &r = retired_[i];
+    if ((data >= r.address) && (data < static_cast<char *>(r.address) + r.size))
+      a = GetHeader(r);
+  }
+  assert(a != NULL);
+  assert(atomic_read32(&a->pins) > 0);
+  atomic_dec32(&a->pins);
+  atomic_dec32(&num_pins_);
+}
+
+
 int MemoryKvStore::Commit(const MemoryBuffer &buf) {
   WriteLockGuard guard(rwlock_);
   return DoCommit(buf);
@@ -278,6 +392,7 @@ int MemoryKvStore::DoCommit(const MemoryBuffer &buf) {
   // without a race condition. This is a hint that callers should use the
   // refcount like a lock and not directly modify the numeric value.
 
+  ReapRetired();
   CompactMemory();
 
   MemoryBuffer mem;
@@ -285,10 +400,15 @@ int MemoryKvStore::DoCommit(const MemoryBuffer &buf) {
   LogCvmfs(kLogKvStore, kLogDebug, "commit %s", buf.id.ToString().c_str());
   if (entries_.Lookup(buf.id, &mem)) {
     LogCvmfs(kLogKvStore, kLogDebug, "commit overwrites existing entry");
-    size_t old_size = mem.size;
-    DoFree(&mem);
-    used_bytes_ -= old_size;
-    counters_.sz_size->Set(used_bytes_);
+    // A zero-copy reader may still point into the old memory, which then
+    // keeps being accounted for until it is freed
+    if (IsPinned(mem)) {
+      retired_.push_back(mem);
+    } else {
+      used_bytes_ -= mem.size;
+      counters_.sz_size->Set(used_bytes_);
+      DoFree(&mem);
+    }
     --entry_count_;
   } else {
     // since this is a new entry, the caller can choose the starting
@@ -321,6 +441,7 @@ int MemoryKvStore::DoCommit(const MemoryBuffer &buf) {
 bool MemoryKvStore::Delete(const shash::Any &id) {
   perf::Inc(counters_.n_delete);
   WriteLockGuard guard(rwlock_);
+  ReapRetired();
   return DoDelete(id);
 }
 
@@ -332,7 +453,7 @@ bool MemoryKvStore::DoDelete(const shash::Any &id) {
              id.ToString().c_str());
     return false;
   }
-  if (buf.refcount > 0) {
+  if ((buf.refcount > 0) || IsPinned(buf)) {
     LogCvmfs(kLogKvStore, kLogDebug, "can't delete %s, nonzero refcount",
              id.ToString().c_str());
     return false;
@@ -355,6 +476,7 @@ bool MemoryKvStore::ShrinkTo(size_t size) {
   shash::Any key;
   MemoryBuffer buf;
 
+  ReapRetired();
   if (used_bytes_ <= size) {
     LogCvmfs(kLogKvStore, kLogDebug, "no need to shrink");
     return true;
@@ -365,7 +487,7 @@ bool MemoryKvStore::ShrinkTo(size_t size) {
   while (entries_.FilterNext()) {
     if (used_bytes_ <= size) break;
     entries_.FilterGet(&key, &buf);
-    if (buf.refcount > 0) {
+    if ((buf.refcount > 0) || IsPinned(buf)) {
       LogCvmfs(kLogKvStore, kLogDebug, "skip %s, nonzero refcount",
                key.ToString().c_str());
       continue;
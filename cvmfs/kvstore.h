@@ -16,6 +16,7 @@
 #include "malloc_heap.h"
 #include "statistics.h"
 #include "util/async.h"
+#include "util/atomic.h"
 #include "util/single_copy.h"
 
 using namespace std;  // NOLINT
@@ -24,11 +25,16 @@ using namespace std;  // NOLINT
 /**
  * All objects in memory are prepended by an AllocHeader that allows the
  * Key-Value store to find the pointer when the heap memory manager compacts
- * the allocations.
+ * the allocations.  It also counts the zero-copy readers of the object.
  */
 struct AllocHeader {
-  AllocHeader() : version(0), id() { }
+  AllocHeader() : version(0), pins(0), id() { }
   uint8_t version;
+  /**
+   * Changed atomically under the read lock of the store, inspected only
+   * under the write lock.  Pinned objects are neither freed nor moved.
+   */
+  atomic_int32 pins;
   shash::Any id;
 };
 
@@ -170,6 +176,33 @@ class MemoryKvStore : SingleCopy, public Callbackable<MallocHeap::BlockPtr> {
     size_t size,
     size_t offset);
 
+  /**
+   * Like Read but points *data into the entry instead of copying.  If any
+   * bytes are available, the entry's memory is pinned until ReleaseZeroCopy():
+   * it is not deleted, compaction moves the other blocks around it, and a
+   * commit that overwrites the entry keeps the old memory around.  The store
+   * is not locked in between.
+   * @param id The hash key
+   * @param size The maximum number of bytes
+   * @param offset The offset within the entry
+   * @param data Set to the address of the data at offset, NULL if there is
+   *             no data
+   * @returns The number of bytes available at *data
+   * @retval -ENOENT The entry is absent, nothing is pinned
+   */
+  int64_t ReadZeroCopy(
+    const shash::Any &id,
+    size_t size,
+    size_t offset,
+    const void **data);
+
+  /**
+   * Releases the pin taken by ReadZeroCopy() on the entry at id
+   * @param id The hash key
+   * @param data The address returned by ReadZeroCopy(), NULL is ignored
+   */
+  void ReleaseZeroCopy(const shash::Any &id, const void *data);
+
   /**
    * Insert a new memory buffer. The KvStore copies the referred memory, so
    * callers may free() their buffers after Commit returns
@@ -195,7 +228,8 @@ class MemoryKvStore : SingleCopy, public Callbackable<MallocHeap::BlockPtr> {
   bool ShrinkTo(size_t size);
 
   /**
-   * Get the total space used for data
+   * Get the total space used for data, including the memory of overwritten
+   * entries that is still pinned
    */
   size_t GetUsed() { return used_bytes_; }
 
@@ -209,6 +243,9 @@ class MemoryKvStore : SingleCopy, public Callbackable<MallocHeap::BlockPtr> {
   int DoCommit(const MemoryBuffer &buf);
   void OnBlockMove(const MallocHeap::BlockPtr &ptr);
   bool CompactMemory();
+  void ReapRetired();
+  static AllocHeader *GetHeader(const MemoryBuffer &buf);
+  static bool IsPinned(const MemoryBuffer &buf);
 
   MemoryAllocator allocator_;
   size_t used_bytes_;
@@ -216,6 +253,16 @@ class MemoryKvStore : SingleCopy, public Callbackable<MallocHeap::BlockPtr> {
   unsigned int max_entries_;
   lru::LruCache<shash::Any, MemoryBuffer> entries_;
   MallocHeap *heap_;
+  /**
+   * Number of outstanding ReadZeroCopy() pins in all blocks.  If zero,
+   * compaction does not need to look for pinned blocks.
+   */
+  atomic_int32 num_pins_;
+  /**
+   * Memory of entries overwritten while pinned.  Modified under the write
+   * lock, freed by the first write operation after the last pin is released.
+   */
+  std::vector<MemoryBuffer> retired_;
   pthread_rwlock_t rwlock_;
   Counters counters_;
 };
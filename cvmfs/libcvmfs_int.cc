@@ -193,6 +193,10 @@ bool LibContext::GetDirentForPath(const PathString         &path,
   shash::Md5 md5path(path.GetChars(), path.GetLength());
   if (mount_point_->md5path_cache()->Lookup(md5path, dirent))
     return dirent->GetSpecial() != catalog::kDirentNegative;
+  if (mount_point_->negative_cache()->Lookup(md5path)) {
+    *dirent = catalog::DirectoryEntry(catalog::kDirentNegative);
+    return false;
+  }
 
   // TODO(jblomer): not twice md5 calculation
   if (mount_point_->catalog_mgr()->LookupPath(path, catalog::kLookupDefault,
@@ -205,7 +209,7 @@ bool LibContext::GetDirentForPath(const PathString         &path,
   LogCvmfs(kLogCvmfs, kLogDebug, "GetDirentForPath, no entry");
   // Only cache real ENOENT errors, not catalog load errors
   if (dirent->GetSpecial() == catalog::kDirentNegative)
-    mount_point_->md5path_cache()->InsertNegative(md5path);
+    mount_point_->negative_cache()->Insert(md5path);
 
   return false;
 }
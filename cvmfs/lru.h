@@ -66,6 +66,8 @@ struct Counters {
   perf::Counter *n_miss;
   perf::Counter *n_insert;
   perf::Counter *n_insert_negative;
+  perf::Counter *n_insert_prefetch;
+  perf::Counter *n_hit_prefetch;
   uint64_t num_collisions;
   uint32_t max_collisions;
   perf::Counter *n_update;
@@ -84,6 +86,10 @@ struct Counters {
     n_insert = statistics.RegisterTemplated("n_insert", "Number of inserts");
     n_insert_negative = statistics.RegisterTemplated("n_insert_negative",
         "Number of negative inserts");
+    n_insert_prefetch = statistics.RegisterTemplated("n_insert_prefetch",
+        "Number of prefetched inserts");
+    n_hit_prefetch = statistics.RegisterTemplated("n_hit_prefetch",
+        "Number of first hits on prefetched entries");
     n_update = statistics.RegisterTemplated("n_update",
         "Number of updates");
     n_update_value = statistics.RegisterTemplated("n_update_value",
@@ -121,6 +127,11 @@ class LruCache : SingleCopy {
   typedef struct {
     ListEntryContent<Key> *list_entry;
     Value value;
+    /**
+     * Set for entries that were inserted by InsertPrefetched() and that have
+     * not yet been looked up
+     */
+    bool is_prefetched;
   } CacheEntry;
 
   // static uint64_t GetEntrySize() { return sizeof(Key) + sizeof(Value); }
@@ -533,7 +544,7 @@ class LruCache : SingleCopy {
   }
 
   static double GetEntrySize() {
-    return SmallHashFixed<Key, CacheEntry>::GetEntrySize() +
+    return SmallHashFixed<Key, CacheEntry, true>::GetEntrySize() +
            ConcreteMemoryAllocator::GetEntrySize();
   }
 
@@ -566,6 +577,7 @@ class LruCache : SingleCopy {
     if (this->DoLookup(key, &entry)) {
       perf::Inc(counters_.n_update);
       entry.value = value;
+      entry.is_prefetched = false;
       cache_.Insert(key, entry);
       this->Touch(entry);
       this->Unlock();
@@ -573,15 +585,38 @@ class LruCache : SingleCopy {
     }
 
     perf::Inc(counters_.n_insert);
-    // Check if we have to make some space in the cache a
-    if (this->IsFull())
-      this->DeleteOldest();
+    this->DoInsert(key, value, false);
 
-    entry.list_entry = lru_list_.PushBack(key);
-    entry.value = value;
+    Unlock();
+    return true;
+  }
 
-    cache_.Insert(key, entry);
-    cache_gauge_++;
+
+  /**
+   * Like Insert() but for values that were fetched ahead of a request, e.g.
+   * the entries of a directory listing.  An existing entry gets the new value
+   * but keeps its position in the LRU list.  The first hit on a prefetched
+   * entry is counted in n_hit_prefetch.
+   * @return true on insert, false on update
+   */
+  virtual bool InsertPrefetched(const Key &key, const Value &value) {
+    this->Lock();
+    if (pause_) {
+      Unlock();
+      return false;
+    }
+
+    CacheEntry entry;
+    if (this->DoLookup(key, &entry)) {
+      perf::Inc(counters_.n_update_value);
+      entry.value = value;
+      cache_.Insert(key, entry);
+      this->Unlock();
+      return false;
+    }
+
+    perf::Inc(counters_.n_insert_prefetch);
+    this->DoInsert(key, value, true);
 
     Unlock();
     return true;
@@ -649,6 +684,11 @@ class LruCache : SingleCopy {
     if (DoLookup(key, &entry)) {
       // Hit
       perf::Inc(counters_.n_hit);
+      if (entry.is_prefetched) {
+        perf::Inc(counters_.n_hit_prefetch);
+        entry.is_prefetched = false;
+        cache_.Insert(key, entry);
+      }
       if (update_lru)
         Touch(entry);
       *value = entry.value;
@@ -807,6 +847,26 @@ class LruCache : SingleCopy {
     return cache_.Lookup(key, entry);
   }
 
+  /**
+   * Adds a new entry to the back of the LRU list, possibly evicting the least
+   * recently used entry.  The key must not be in the cache.
+   */
+  inline void DoInsert(const Key &key, const Value &value,
+                       const bool is_prefetched)
+  {
+    // Check if we have to make some space in the cache a
+    if (this->IsFull())
+      this->DeleteOldest();
+
+    CacheEntry entry;
+    entry.list_entry = lru_list_.PushBack(key);
+    entry.value = value;
+    entry.is_prefetched = is_prefetched;
+
+    cache_.Insert(key, entry);
+    cache_gauge_++;
+  }
+
   /**
    * Touch an entry.
    * The entry will be moved to the back of the LRU list to mark it
@@ -863,7 +923,8 @@ class LruCache : SingleCopy {
    * deleted to obtain some space.
    */
   ListEntryHead<Key>              lru_list_;
-  SmallHashFixed<Key, CacheEntry> cache_;
+  // Tagged probing, the table is always filled up to the load factor
+  SmallHashFixed<Key, CacheEntry, true> cache_;
 
   ListEntry<Key> *filter_entry_;
 #ifdef LRU_CACHE_THREAD_SAFE
@@ -158,6 +158,45 @@ class Md5PathCache :
   catalog::DirectoryEntry dirent_negative_;
 };  // Md5PathCache
 
+
+/**
+ * Remembers path hashes that do not exist in the repository.  Negative lookups
+ * are frequent, e.g. when Python probes sys.path or ld.so walks an RPATH.
+ * Keeping them apart from the Md5PathCache prevents them from evicting full
+ * directory entries.  Only the path hash is stored per entry.
+ */
+class NegativeCache : public LruCache<shash::Md5, bool> {
+ public:
+  explicit NegativeCache(unsigned int cache_size, perf::Statistics *statistics)
+    : LruCache<shash::Md5, bool>(
+      cache_size, shash::Md5(shash::AsciiPtr("!")), hasher_md5,
+      perf::StatisticsTemplate("negative_cache", statistics))
+  {
+  }
+
+  bool Insert(const shash::Md5 &hash) {
+    LogCvmfs(kLogLru, kLogDebug, "insert negative md5: %s",
+             hash.ToString().c_str());
+    const bool result = LruCache<shash::Md5, bool>::Insert(hash, true);
+    if (result)
+      perf::Inc(counters_.n_insert_negative);
+    return result;
+  }
+
+  bool Lookup(const shash::Md5 &hash) {
+    bool value;
+    const bool result = LruCache<shash::Md5, bool>::Lookup(hash, &value);
+    LogCvmfs(kLogLru, kLogDebug, "lookup negative md5: %s (%s)",
+             hash.ToString().c_str(), result ? "hit" : "miss");
+    return result;
+  }
+
+  void Drop() {
+    LogCvmfs(kLogLru, kLogDebug, "dropping negative cache");
+    LruCache<shash::Md5, bool>::Drop();
+  }
+};  // NegativeCache
+
 }  // namespace lru
 
 #endif  // CVMFS_LRU_MD_H_
@@ -35,6 +35,7 @@ MagicXattrManager::MagicXattrManager(MountPoint *mountpoint,
   Register("user.nopen", new NOpenMagicXattr());
   Register("user.hitrate", new HitrateMagicXattr());
   Register("user.logbuffer", new LogBufferXattr());
+  Register("user.lookup_cache", new LookupCacheMagicXattr());
   Register("user.proxy", new ProxyMagicXattr());
   Register("user.pubkeys", new PubkeysMagicXattr());
   Register("user.repo_counters", new RepoCountersMagicXattr());
@@ -366,6 +367,22 @@ std::string NClgMagicXattr::GetValue() {
   return StringifyInt(n_catalogs_);
 }
 
+std::string LookupCacheMagicXattr::GetValue() {
+  const char *counters[] = {
+    "negative_cache.n_hit",
+    "negative_cache.n_miss",
+    "negative_cache.n_insert",
+    "catalog_mgr.n_lookup_memo_hit",
+    "catalog_mgr.n_lookup_memo_miss",
+  };
+  std::string res;
+  for (unsigned i = 0; i < sizeof(counters) / sizeof(counters[0]); ++i) {
+    res += std::string(counters[i]) + ": " +
+           mount_point_->statistics()->Lookup(counters[i])->Print() + "\n";
+  }
+  return res;
+}
+
 std::string NDirOpenMagicXattr::GetValue() {
   return mount_point_->file_system()->n_fs_dir_open()->ToString();
 }
@@ -250,6 +250,10 @@ class NCleanup24MagicXattr : public BaseMagicXattr {
   virtual std::string GetValue();
 };
 
+class LookupCacheMagicXattr : public BaseMagicXattr {
+  virtual std::string GetValue();
+};
+
 class NClgMagicXattr : public BaseMagicXattr {
   int n_catalogs_;
 
@@ -5,6 +5,7 @@
 #include "cvmfs_config.h"
 #include "malloc_heap.h"
 
+#include <algorithm>
 #include <cassert>
 #include <cstring>
 #include <new>
@@ -37,6 +38,15 @@ void *MallocHeap::Allocate(
 
 
 void MallocHeap::Compact() {
+  Compact(std::vector<void *>());
+}
+
+
+/**
+ * The blocks in pinned, given in ascending order, are not moved.  The free
+ * space in front of a pinned block remains a hole.
+ */
+void MallocHeap::Compact(const std::vector<void *> &pinned) {
   if (gauge_ == 0)
     return;
 
@@ -52,6 +62,12 @@ void MallocHeap::Compact() {
         // Adjacent free blocks, merge and try again
         current_tag->size -= sizeof(Tag) + next_tag->GetSize();
         next_tag = next_tag->JumpToNext();
+      } else if (std::binary_search(pinned.begin(), pinned.end(),
+                                    static_cast<void *>(next_tag->GetBlock())))
+      {
+        // Free block followed by a pinned block, skip both
+        current_tag = next_tag;
+        next_tag = next_tag->JumpToNext();
       } else {
         // Free block followed by a reserved block, move memory and create a
         // new free tag at the end of the moved block
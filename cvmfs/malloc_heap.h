@@ -9,6 +9,7 @@
 #include <stdint.h>
 
 #include <cstdlib>
+#include <vector>
 
 #include "util/async.h"
 
@@ -24,7 +25,7 @@
  * any block based on the first bytes.  Therefore, allocation requires these
  * first bytes, a user-defined "header" if you will.
  * Note that during a Compact() not even reading from any of the pointers is
- * allowed!
+ * allowed, except for the pinned blocks that Compact() leaves in place!
  *
  * MallocHeap is used by the in-memory object cache.  The header is the
  * object's content hash, so the cache manager can identify any block in its
@@ -53,6 +54,7 @@ class MallocHeap {
   void MarkFree(void *block);
   uint64_t GetSize(void *block);
   void Compact();
+  void Compact(const std::vector<void *> &pinned);
 
   inline uint64_t num_blocks() { return num_blocks_; }
   inline uint64_t used_bytes() { return gauge_; }
@@ -8,6 +8,7 @@
 #include <map>
 
 #include "catalog.h"
+#include "util/logging.h"
 #include "util/posix.h"
 
 using namespace std;  // NOLINT
@@ -146,11 +147,25 @@ Manifest *Manifest::Load(const map<char, string> &content) {
   if ((iter = content.find('Y')) != content.end()) {
     reflog_hash = MkFromHexPtr(shash::HexPtr(iter->second));
   }
+  zlib::Algorithms compression_algorithm = zlib::kZlibDefault;
+  if ((iter = content.find('F')) != content.end()) {
+    if (!zlib::LookupCompressionAlgorithm(iter->second,
+                                          &compression_algorithm))
+    {
+      LogCvmfs(kLogCvmfs, kLogDebug | kLogSyslogErr,
+               "repository uses unsupported compression algorithm %s",
+               iter->second.c_str());
+      return NULL;
+    }
+  }
 
-  return new Manifest(catalog_hash, catalog_size, root_path, ttl, revision,
-                      micro_catalog_hash, repository_name, certificate,
-                      history, publish_timestamp, garbage_collectable,
-                      has_alt_catalog_path, meta_info, reflog_hash);
+  Manifest *manifest =
+    new Manifest(catalog_hash, catalog_size, root_path, ttl, revision,
+                 micro_catalog_hash, repository_name, certificate,
+                 history, publish_timestamp, garbage_collectable,
+                 has_alt_catalog_path, meta_info, reflog_hash);
+  manifest->set_compression_algorithm(compression_algorithm);
+  return manifest;
 }
 
 
@@ -165,6 +180,7 @@ Manifest::Manifest(const shash::Any &catalog_hash,
   , publish_timestamp_(0)
   , garbage_collectable_(false)
   , has_alt_catalog_path_(false)
+  , compression_algorithm_(zlib::kZlibDefault)
 { }
 
 
@@ -196,6 +212,8 @@ string Manifest::ExportString() const {
   if (!reflog_hash_.IsNull()) {
     manifest += "Y" + reflog_hash_.ToString() + "\n";
   }
+  if (compression_algorithm_ != zlib::kZlibDefault)
+    manifest += "F" + zlib::AlgorithmName(compression_algorithm_) + "\n";
   // Reserved: Z -> for identification of channel tips
 
   return manifest;
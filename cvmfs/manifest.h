@@ -10,6 +10,7 @@
 #include <map>
 #include <string>
 
+#include "compression.h"
 #include "crypto/hash.h"
 #include "history.h"
 
@@ -72,7 +73,8 @@ class Manifest {
   , garbage_collectable_(garbage_collectable)
   , has_alt_catalog_path_(has_alt_catalog_path)
   , meta_info_(meta_info)
-  , reflog_hash_(reflog_hash) {}
+  , reflog_hash_(reflog_hash)
+  , compression_algorithm_(zlib::kZlibDefault) {}
 
   std::string ExportString() const;
   bool Export(const std::string &path) const;
@@ -117,6 +119,9 @@ class Manifest {
   void set_reflog_hash(const shash::Any& checksum) {
     reflog_hash_ = checksum;
   }
+  void set_compression_algorithm(const zlib::Algorithms algorithm) {
+    compression_algorithm_ = algorithm;
+  }
 
   uint64_t revision() const { return revision_; }
   std::string repository_name() const { return repository_name_; }
@@ -130,6 +135,9 @@ class Manifest {
   bool has_alt_catalog_path() const { return has_alt_catalog_path_; }
   shash::Any meta_info() const { return meta_info_; }
   shash::Any reflog_hash() const { return reflog_hash_; }
+  zlib::Algorithms compression_algorithm() const {
+    return compression_algorithm_;
+  }
 
   std::string MakeCatalogPath() const {
     return has_alt_catalog_path_ ? catalog_hash_.MakeAlternativePath() :
@@ -172,6 +180,14 @@ class Manifest {
    * Hash of the reflog file
    */
   shash::Any reflog_hash_;
+
+  /**
+   * Compression algorithm other than zlib that clients need to support in
+   * order to read the data objects of the repository.  Once set, it is kept
+   * for all future revisions.  Clients that do not know the algorithm refuse
+   * the manifest.
+   */
+  zlib::Algorithms compression_algorithm_;
 };  // class Manifest
 
 }  // namespace manifest
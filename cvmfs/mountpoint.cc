@@ -37,6 +37,7 @@
 #include "cache_tiered.h"
 #include "catalog.h"
 #include "catalog_mgr_client.h"
+#include "chunk_prefetch.h"
 #include "clientctx.h"
 #include "crypto/signature.h"
 #include "download.h"
@@ -48,6 +49,7 @@
 #include "google/protobuf/stubs/common.h"
 #include "history.h"
 #include "history_sqlite.h"
+#include "hotset.h"
 #include "lru_md.h"
 #include "manifest.h"
 #include "manifest_fetch.h"
@@ -57,6 +59,7 @@
 #include "nfs_maps_sqlite.h"
 #endif
 #include "options.h"
+#include "quota_memory.h"
 #include "quota_posix.h"
 #include "resolv_conf_event_handler.h"
 #include "sqlitemem.h"
@@ -233,6 +236,9 @@ void FileSystem::CreateStatistics() {
   n_fs_read_ = statistics_->Register("cvmfs.n_fs_read", "Number of files read");
   n_fs_readlink_ = statistics_->Register("cvmfs.n_fs_readlink",
                                          "Number of links read");
+  n_fs_readdirplus_entry_ = statistics_->Register(
+    "cvmfs.n_fs_readdirplus_entry",
+    "Number of directory entries returned with attributes by readdirplus");
   n_fs_forget_ = statistics_->Register("cvmfs.n_fs_forget",
                                        "Number of inode forgets");
   n_fs_inode_replace_ = statistics_->Register("cvmfs.n_fs_inode_replace",
@@ -297,6 +303,12 @@ FileSystem::PosixCacheSettings FileSystem::DeterminePosixCacheSettings(
   }
   if (settings.quota_limit > 0)
     settings.is_managed = true;
+  if (options_mgr_->GetValue(MkCacheParm("CVMFS_CACHE_QUOTA_IN_MEMORY",
+                                         instance), &optarg)
+      && options_mgr_->IsOn(optarg))
+  {
+    settings.quota_in_memory = true;
+  }
 
   settings.cache_path = kDefaultCacheBase;
   if (options_mgr_->GetValue(MkCacheParm("CVMFS_CACHE_BASE", instance),
@@ -385,6 +397,7 @@ FileSystem::FileSystem(const FileSystem::FileSystemInfo &fs_info)
   , n_fs_statfs_cached_(NULL)
   , n_fs_read_(NULL)
   , n_fs_readlink_(NULL)
+  , n_fs_readdirplus_entry_(NULL)
   , n_fs_forget_(NULL)
   , n_fs_inode_replace_(NULL)
   , no_open_files_(NULL)
@@ -935,8 +948,13 @@ bool FileSystem::SetupPosixQuotaMgr(
              settings.workspace.c_str(), settings.cache_path.c_str());
     cache_workspace += ":" + settings.workspace;
   }
-  PosixQuotaManager *quota_mgr;
+  QuotaManager *quota_mgr;
 
+  if (settings.quota_in_memory && settings.is_shared) {
+    LogCvmfs(kLogQuota, kLogDebug | kLogSyslogWarn,
+             "in-memory quota management is not available for the shared "
+             "cache, using the shared cache manager");
+  }
   if (settings.is_shared) {
     quota_mgr = PosixQuotaManager::CreateShared(
                   exe_path_,
@@ -949,6 +967,17 @@ bool FileSystem::SetupPosixQuotaMgr(
       boot_status_ = loader::kFailQuota;
       return false;
     }
+  } else if (settings.quota_in_memory) {
+    quota_mgr = MemoryQuotaManager::Create(
+                  cache_workspace,
+                  settings.quota_limit,
+                  quota_threshold,
+                  found_previous_crash_);
+    if (quota_mgr == NULL) {
+      boot_error_ = "Failed to initialize in-memory lru cache";
+      boot_status_ = loader::kFailQuota;
+      return false;
+    }
   } else {
     quota_mgr = PosixQuotaManager::Create(
                   cache_workspace,
@@ -1390,6 +1419,19 @@ void MountPoint::CreateFetchers() {
     backoff_throttle_,
     perf::StatisticsTemplate("fetch-external", statistics_),
     is_external_data);
+
+  string optarg;
+  if (options_mgr_->GetValue("CVMFS_READAHEAD_CHUNKS", &optarg)) {
+    unsigned num_chunks = String2Uint64(optarg);
+    if (num_chunks > 0) {
+      chunk_prefetcher_ = new cvmfs::ChunkPrefetcher(
+        num_chunks,
+        cvmfs::ChunkPrefetcher::kDefaultNumThreads,
+        perf::StatisticsTemplate("readahead", statistics_));
+      LogCvmfs(kLogCvmfs, kLogDebug, "prefetching up to %u chunks ahead",
+               chunk_prefetcher_->num_chunks());
+    }
+  }
 }
 
 
@@ -1472,6 +1514,7 @@ void MountPoint::CreateTables() {
   if (file_system_->type() != FileSystem::kFsFuse) {
     // Libcvmfs simplified tables
     md5path_cache_ = new lru::Md5PathCache(kLibPathCacheSize, statistics_);
+    negative_cache_ = new lru::NegativeCache(kLibPathCacheSize, statistics_);
     simple_chunk_tables_ = new SimpleChunkTables();
     return;
   }
@@ -1485,7 +1528,8 @@ void MountPoint::CreateTables() {
 
   const double memcache_unit_size =
     (static_cast<double>(kInodeCacheFactor) * lru::Md5PathCache::GetEntrySize())
-    + lru::InodeCache::GetEntrySize() + lru::PathCache::GetEntrySize();
+    + lru::InodeCache::GetEntrySize() + lru::PathCache::GetEntrySize()
+    + lru::NegativeCache::GetEntrySize();
   const unsigned memcache_num_units =
     mem_cache_size / static_cast<unsigned>(memcache_unit_size);
   // Number of cache entries must be a multiple of 64
@@ -1494,12 +1538,38 @@ void MountPoint::CreateTables() {
   path_cache_ = new lru::PathCache(memcache_num_units & mask_64, statistics_);
   md5path_cache_ = new lru::Md5PathCache((memcache_num_units * 7) & mask_64,
                                          statistics_);
+  negative_cache_ = new lru::NegativeCache(memcache_num_units & mask_64,
+                                           statistics_);
+
+  if (options_mgr_->GetValue("CVMFS_DIR_PREFETCH_LIMIT", &optarg)) {
+    // A single large directory must not flush the inode and path caches
+    dir_prefetch_limit_ = std::min(String2Uint64(optarg),
+                                   uint64_t((memcache_num_units & mask_64) / 2));
+    LogCvmfs(kLogCvmfs, kLogDebug, "prefetching up to %u directory entries",
+             dir_prefetch_limit_);
+  }
 
   inode_tracker_ = new glue::InodeTracker();
   dentry_tracker_ = new glue::DentryTracker();
   page_cache_tracker_ = new glue::PageCacheTracker();
   if (file_system_->IsNfsSource())
     page_cache_tracker_->Disable();
+
+  // In NFS mode, the inodes come from the NFS maps and the path cache is unused
+  if (options_mgr_->GetValue("CVMFS_HOTSET_SIZE", &optarg) &&
+      !file_system_->IsNfsSource())
+  {
+    const unsigned max_paths = std::min(String2Uint64(optarg),
+                                        uint64_t(memcache_num_units & mask_64));
+    if (max_paths > 0) {
+      hotset_ = new cvmfs::HotsetSnapshot(
+        file_system_->workspace() + "/hotset." + fqrn_,
+        max_paths, catalog_mgr_, inode_tracker_, path_cache_, md5path_cache_,
+        perf::StatisticsTemplate("hotset", statistics_));
+      LogCvmfs(kLogCvmfs, kLogDebug, "keeping a hot-set snapshot of up to "
+               "%u paths in %s", max_paths, hotset_->path().c_str());
+    }
+  }
 }
 
 /**
@@ -1689,6 +1759,7 @@ MountPoint::MountPoint(
   , external_download_mgr_(NULL)
   , fetcher_(NULL)
   , external_fetcher_(NULL)
+  , chunk_prefetcher_(NULL)
   , inode_annotation_(NULL)
   , catalog_mgr_(NULL)
   , chunk_tables_(NULL)
@@ -1696,6 +1767,9 @@ MountPoint::MountPoint(
   , inode_cache_(NULL)
   , path_cache_(NULL)
   , md5path_cache_(NULL)
+  , negative_cache_(NULL)
+  , dir_prefetch_limit_(0)
+  , hotset_(NULL)
   , tracer_(NULL)
   , inode_tracker_(NULL)
   , dentry_tracker_(NULL)
@@ -1719,10 +1793,13 @@ MountPoint::MountPoint(
 MountPoint::~MountPoint() {
   pthread_mutex_destroy(&lock_max_ttl_);
 
+  // The replay thread uses the caches and the catalog manager
+  delete hotset_;
   delete page_cache_tracker_;
   delete dentry_tracker_;
   delete inode_tracker_;
   delete tracer_;
+  delete negative_cache_;
   delete md5path_cache_;
   delete path_cache_;
   delete inode_cache_;
@@ -1731,6 +1808,7 @@ MountPoint::~MountPoint() {
 
   delete catalog_mgr_;
   delete inode_annotation_;
+  delete chunk_prefetcher_;
   delete external_fetcher_;
   delete fetcher_;
   if (external_download_mgr_ != NULL) {
@@ -1981,6 +2059,8 @@ void MountPoint::SetupHttpTuning() {
     download_mgr_->SetProxyGroupResetDelay(String2Uint64(optarg));
   if (options_mgr_->GetValue("CVMFS_HOST_RESET_AFTER", &optarg))
     download_mgr_->SetHostResetDelay(String2Uint64(optarg));
+  if (options_mgr_->GetValue("CVMFS_DOWNLOAD_THREADS", &optarg))
+    download_mgr_->SetNumThreads(String2Uint64(optarg));
 
   if (options_mgr_->GetValue("CVMFS_FOLLOW_REDIRECTS", &optarg) &&
       options_mgr_->IsOn(optarg))
@@ -36,7 +36,9 @@ class InodeAnnotation;
 }
 struct ChunkTables;
 namespace cvmfs {
+class ChunkPrefetcher;
 class Fetcher;
+class HotsetSnapshot;
 class Uuid;
 }
 namespace download {
@@ -50,6 +52,7 @@ class PageCacheTracker;
 namespace lru {
 class InodeCache;
 class Md5PathCache;
+class NegativeCache;
 class PathCache;
 }
 class NfsMaps;
@@ -217,6 +220,7 @@ class FileSystem : SingleCopy, public BootFactory {
   perf::Counter *n_fs_open() { return n_fs_open_; }
   perf::Counter *n_fs_read() { return n_fs_read_; }
   perf::Counter *n_fs_readlink() { return n_fs_readlink_; }
+  perf::Counter *n_fs_readdirplus_entry() { return n_fs_readdirplus_entry_; }
   perf::Counter *n_fs_stat() { return n_fs_stat_; }
   perf::Counter *n_fs_stat_stale() { return n_fs_stat_stale_; }
   perf::Counter *n_fs_statfs() { return n_fs_statfs_; }
@@ -246,7 +250,7 @@ class FileSystem : SingleCopy, public BootFactory {
     PosixCacheSettings() :
       is_shared(false), is_alien(false), is_managed(false),
       avoid_rename(false), cache_base_defined(false), cache_dir_defined(false),
-      quota_limit(0)
+      quota_limit(0), quota_in_memory(false)
       { }
     bool is_shared;
     bool is_alien;
@@ -259,6 +263,11 @@ class FileSystem : SingleCopy, public BootFactory {
      * cache when the limit is exceeded.
      */
     int64_t quota_limit;
+    /**
+     * Use the in-memory LRU instead of the SQlite based command server for
+     * an exclusive cache (CVMFS_CACHE_QUOTA_IN_MEMORY)
+     */
+    bool quota_in_memory;
     std::string cache_path;
     /**
      * Different from cache_path only if CVMFS_WORKSPACE or
@@ -319,6 +328,7 @@ class FileSystem : SingleCopy, public BootFactory {
   perf::Counter *n_fs_statfs_cached_;
   perf::Counter *n_fs_read_;
   perf::Counter *n_fs_readlink_;
+  perf::Counter *n_fs_readdirplus_entry_;
   perf::Counter *n_fs_forget_;
   perf::Counter *n_fs_inode_replace_;
   perf::Counter *no_open_files_;
@@ -479,6 +489,10 @@ class MountPoint : SingleCopy, public BootFactory {
     return resolv_conf_watcher_;
   }
   cvmfs::Fetcher *fetcher() { return fetcher_; }
+  /**
+   * NULL if chunk prefetching is disabled (CVMFS_READAHEAD_CHUNKS)
+   */
+  cvmfs::ChunkPrefetcher *chunk_prefetcher() { return chunk_prefetcher_; }
   bool fixed_catalog() { return fixed_catalog_; }
   std::string fqrn() const { return fqrn_; }
   cvmfs::Fetcher *external_fetcher() { return external_fetcher_; }
@@ -489,11 +503,21 @@ class MountPoint : SingleCopy, public BootFactory {
   catalog::InodeAnnotation *inode_annotation() {
     return inode_annotation_;
   }
+  /**
+   * NULL if the hot-set snapshot is disabled (CVMFS_HOTSET_SIZE)
+   */
+  cvmfs::HotsetSnapshot *hotset() { return hotset_; }
   glue::InodeTracker *inode_tracker() { return inode_tracker_; }
   lru::InodeCache *inode_cache() { return inode_cache_; }
+  /**
+   * Maximum number of directory entries per opendir() that are prefetched into
+   * the meta-data caches, 0 if disabled (CVMFS_DIR_PREFETCH_LIMIT)
+   */
+  unsigned dir_prefetch_limit() { return dir_prefetch_limit_; }
   double kcache_timeout_sec() { return kcache_timeout_sec_; }
   lru::Md5PathCache *md5path_cache() { return md5path_cache_; }
   std::string membership_req() { return membership_req_; }
+  lru::NegativeCache *negative_cache() { return negative_cache_; }
   glue::DentryTracker *dentry_tracker() { return dentry_tracker_; }
   glue::PageCacheTracker *page_cache_tracker() { return page_cache_tracker_; }
   lru::PathCache *path_cache() { return path_cache_; }
@@ -600,6 +624,7 @@ class MountPoint : SingleCopy, public BootFactory {
   download::DownloadManager *external_download_mgr_;
   cvmfs::Fetcher *fetcher_;
   cvmfs::Fetcher *external_fetcher_;
+  cvmfs::ChunkPrefetcher *chunk_prefetcher_;
   catalog::InodeAnnotation *inode_annotation_;
   catalog::ClientCatalogManager *catalog_mgr_;
   ChunkTables *chunk_tables_;
@@ -607,6 +632,9 @@ class MountPoint : SingleCopy, public BootFactory {
   lru::InodeCache *inode_cache_;
   lru::PathCache *path_cache_;
   lru::Md5PathCache *md5path_cache_;
+  lru::NegativeCache *negative_cache_;
+  unsigned dir_prefetch_limit_;
+  cvmfs::HotsetSnapshot *hotset_;
   Tracer *tracer_;
   glue::InodeTracker *inode_tracker_;
   glue::DentryTracker *dentry_tracker_;
@@ -0,0 +1,1076 @@
+/**
+ * This file is part of the CernVM File System.
+ *
+ * In-memory LRU for the local, exclusive cache.  See quota_memory.h.
+ */
+
+#define __STDC_LIMIT_MACROS
+#define __STDC_FORMAT_MACROS
+
+#include "cvmfs_config.h"
+#include "quota_memory.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+
+#include "util/concurrency.h"
+#include "util/exception.h"
+#include "util/logging.h"
+#include "util/platform.h"
+#include "util/posix.h"
+#include "util/string.h"
+
+using namespace std;  // NOLINT
+
+namespace {
+
+static inline uint32_t hasher_any(const shash::Any &key) {
+  // The first byte of the digest selects the shard
+  return (uint32_t) *(reinterpret_cast<const uint32_t *>(key.digest) + 1);
+}
+
+/**
+ * Used to restore the LRU order when rebuilding from the cache directory
+ */
+struct FsEntry {
+  FsEntry() : size(0), atime(0) { }
+  bool operator <(const FsEntry &other) const { return atime < other.atime; }
+  shash::Any hash;
+  uint64_t size;
+  time_t atime;
+};
+
+}  // anonymous namespace
+
+
+MemoryQuotaManager::Shard::Shard() : touch_next(0) {
+  int retval = pthread_mutex_init(&lock, NULL);
+  assert(retval == 0);
+  index.Init(128, shash::Any(), hasher_any);
+}
+
+
+MemoryQuotaManager::Shard::~Shard() {
+  pthread_mutex_destroy(&lock);
+}
+
+
+MemoryQuotaManager::MemoryQuotaManager(
+  const uint64_t limit,
+  const uint64_t cleanup_threshold,
+  const string &cache_workspace)
+  : spawned_(false)
+  , limit_(limit)
+  , cleanup_threshold_(cleanup_threshold)
+  , pinned_(0)
+  , fd_lock_cachedb_(-1)
+  , database_(NULL)
+  , stmt_new_(NULL)
+  , stmt_rm_(NULL)
+{
+  vector<string> dir_tokens(SplitString(cache_workspace, ':'));
+  assert((dir_tokens.size() == 1) || (dir_tokens.size() == 2));
+  cache_dir_ = workspace_dir_ = dir_tokens[0];
+  if (dir_tokens.size() == 2)
+    workspace_dir_ = dir_tokens[1];
+
+  atomic_init64(&gauge_);
+  atomic_init64(&seq_);
+  for (unsigned i = 0; i < kNumShards; ++i)
+    shards_[i] = new Shard();
+  int retval = pthread_mutex_init(&lock_pinned_, NULL);
+  assert(retval == 0);
+  retval = pthread_mutex_init(&lock_cleanup_, NULL);
+  assert(retval == 0);
+  retval = pthread_mutex_init(&lock_trash_, NULL);
+  assert(retval == 0);
+  retval = pthread_mutex_init(&lock_database_, NULL);
+  assert(retval == 0);
+  pipe_ctrl_[0] = pipe_ctrl_[1] = -1;
+
+  // Same resolution as the PosixQuotaManager
+  cleanup_recorder_.AddRecorder(1, 90);
+  cleanup_recorder_.AddRecorder(60, 90*60);
+  cleanup_recorder_.AddRecorder(20*60, 60*60*18);
+  cleanup_recorder_.AddRecorder(60*60, 60*60*24*4);
+  protocol_revision_ = kProtocolRevision;
+}
+
+
+MemoryQuotaManager::~MemoryQuotaManager() {
+  if (spawned_) {
+    char fin = 'T';
+    WritePipe(pipe_ctrl_[1], &fin, 1);
+    pthread_join(thread_background_, NULL);
+    ClosePipe(pipe_ctrl_);
+  }
+  UnlinkTrash();
+  if (database_ != NULL) {
+    Checkpoint();
+    CloseDatabase();
+  }
+
+  for (unsigned i = 0; i < kNumShards; ++i)
+    delete shards_[i];
+  pthread_mutex_destroy(&lock_database_);
+  pthread_mutex_destroy(&lock_trash_);
+  pthread_mutex_destroy(&lock_cleanup_);
+  pthread_mutex_destroy(&lock_pinned_);
+}
+
+
+MemoryQuotaManager *MemoryQuotaManager::Create(
+  const string &cache_workspace,
+  const uint64_t limit,
+  const uint64_t cleanup_threshold,
+  const bool rebuild_database)
+{
+  if (cleanup_threshold >= limit) {
+    LogCvmfs(kLogQuota, kLogDebug, "invalid parameters: limit %" PRIu64 ", "
+             "cleanup_threshold %" PRIu64, limit, cleanup_threshold);
+    return NULL;
+  }
+
+  MemoryQuotaManager *quota_manager =
+    new MemoryQuotaManager(limit, cleanup_threshold, cache_workspace);
+  if (!quota_manager->InitDatabase(rebuild_database)) {
+    delete quota_manager;
+    return NULL;
+  }
+  quota_manager->CheckFreeSpace();
+  LogCvmfs(kLogQuota, kLogDebug, "in-memory lru initialized, "
+           "gauge %" PRIu64 ", sequence %" PRIu64,
+           atomic_read64(&quota_manager->gauge_),
+           atomic_read64(&quota_manager->seq_));
+  return quota_manager;
+}
+
+
+//------------------------------------------------------------------------------
+
+
+bool MemoryQuotaManager::InitDatabase(const bool rebuild_database) {
+  fd_lock_cachedb_ = LockFile(workspace_dir_ + "/lock_cachedb");
+  if (fd_lock_cachedb_ < 0) {
+    LogCvmfs(kLogQuota, kLogDebug, "failed to create cachedb lock");
+    return false;
+  }
+
+  const string db_file = cache_dir_ + "/cachedb";
+  if (rebuild_database) {
+    LogCvmfs(kLogQuota, kLogDebug, "rebuild database, unlinking existing (%s)",
+             db_file.c_str());
+    unlink(db_file.c_str());
+    unlink((db_file + "-journal").c_str());
+  }
+
+  // Same schema as used by the PosixQuotaManager
+  const string sql = "PRAGMA synchronous=0; PRAGMA locking_mode=EXCLUSIVE; "
+    "PRAGMA auto_vacuum=1; "
+    "CREATE TABLE IF NOT EXISTS cache_catalog (sha1 TEXT, size INTEGER, "
+    "  acseq INTEGER, path TEXT, type INTEGER, pinned INTEGER, "
+    "CONSTRAINT pk_cache_catalog PRIMARY KEY (sha1)); "
+    "CREATE UNIQUE INDEX IF NOT EXISTS idx_cache_catalog_acseq "
+    "  ON cache_catalog (acseq); "
+    "CREATE TABLE IF NOT EXISTS properties (key TEXT, value TEXT, "
+    "  CONSTRAINT pk_properties PRIMARY KEY(key)); "
+    "INSERT OR REPLACE INTO properties (key, value) VALUES ('schema', '1.0');";
+  bool retry = false;
+  int err;
+ init_recover:
+  err = sqlite3_open(db_file.c_str(), &database_);
+  if (err == SQLITE_OK)
+    err = sqlite3_exec(database_, sql.c_str(), NULL, NULL, NULL);
+  if (err == SQLITE_OK) {
+    if (!LoadDatabase()) {
+      CloseDatabase();
+      return false;
+    }
+  } else {
+    sqlite3_close(database_);
+    database_ = NULL;
+    if (!retry) {
+      retry = true;
+      unlink(db_file.c_str());
+      unlink((db_file + "-journal").c_str());
+      LogCvmfs(kLogQuota, kLogSyslogWarn,
+               "LRU database corrupted, re-building");
+      goto init_recover;
+    }
+    LogCvmfs(kLogQuota, kLogDebug, "could not init cache database (%d)", err);
+    UnlockFile(fd_lock_cachedb_);
+    return false;
+  }
+
+  sqlite3_prepare_v2(database_,
+                     "INSERT OR REPLACE INTO cache_catalog "
+                     "(sha1, size, acseq, path, type, pinned) "
+                     "VALUES (:sha1, :s, :seq, :p, :t, :pin);",
+                     -1, &stmt_new_, NULL);
+  sqlite3_prepare_v2(database_, "DELETE FROM cache_catalog WHERE sha1=:sha1;",
+                     -1, &stmt_rm_, NULL);
+  return (stmt_new_ != NULL) && (stmt_rm_ != NULL);
+}
+
+
+/**
+ * Reads the cachedb into the shards.  Rows are processed in order of their
+ * access sequence number, so that linking each entry at the front of its LRU
+ * list restores the order.
+ */
+bool MemoryQuotaManager::LoadDatabase() {
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2(database_,
+                     "SELECT sha1, size, acseq, path, type FROM cache_catalog "
+                     "ORDER BY acseq;", -1, &stmt, NULL);
+  uint64_t max_seq = 0;
+  int retval;
+  while ((retval = sqlite3_step(stmt)) == SQLITE_ROW) {
+    const string hash_str(reinterpret_cast<const char *>(
+      sqlite3_column_text(stmt, 0)));
+    const uint64_t acseq = sqlite3_column_int64(stmt, 2);
+    Shard *shard = SelectShard(shash::MkFromHexPtr(shash::HexPtr(hash_str)));
+    const uint32_t idx =
+      AddEntry(shard, shash::MkFromHexPtr(shash::HexPtr(hash_str)));
+    Entry *entry = &shard->entries[idx];
+    entry->size = sqlite3_column_int64(stmt, 1);
+    entry->is_volatile = (acseq & kVolatileFlag) != 0;
+    entry->seq = acseq & ~kVolatileFlag;
+    if (sqlite3_column_type(stmt, 3) != SQLITE_NULL) {
+      entry->description =
+        reinterpret_cast<const char *>(sqlite3_column_text(stmt, 3));
+    }
+    entry->type = (sqlite3_column_int64(stmt, 4) == kFileCatalog)
+                  ? kFileCatalog : kFileRegular;
+    LinkEntry(shard, idx);
+    atomic_xadd64(&gauge_, entry->size);
+    max_seq = std::max(max_seq, entry->seq);
+  }
+  sqlite3_finalize(stmt);
+  if (retval != SQLITE_DONE) {
+    LogCvmfs(kLogQuota, kLogDebug, "could not read cache database (%d)",
+             retval);
+    return false;
+  }
+  atomic_write64(&seq_, max_seq + 1);
+
+  if (atomic_read64(&gauge_) == 0) {
+    LogCvmfs(kLogCvmfs, kLogDebug, "CernVM-FS: building lru cache database...");
+    if (!RebuildFromFilesystem()) {
+      LogCvmfs(kLogQuota, kLogDebug,
+               "could not build cache database from file system");
+      return false;
+    }
+  }
+  return true;
+}
+
+
+/**
+ * Populates the shards from the cache sub-directories 00 - ff.  The access
+ * time of the files determines the initial LRU order.  All entries are dirty
+ * and get written to the cachedb by the next checkpoint.
+ */
+bool MemoryQuotaManager::RebuildFromFilesystem() {
+  LogCvmfs(kLogQuota, kLogSyslog | kLogDebug, "re-building cache database");
+
+  vector<FsEntry> fs_entries;
+  char hex[4];
+  for (int i = 0; i <= 0xff; i++) {
+    snprintf(hex, sizeof(hex), "%02x", i);
+    const string path = cache_dir_ + "/" + string(hex);
+    DIR *dirp = opendir(path.c_str());
+    if (dirp == NULL) {
+      LogCvmfs(kLogQuota, kLogDebug | kLogSyslogErr,
+               "failed to open directory %s (tmpwatch interfering?)",
+               path.c_str());
+      return false;
+    }
+    platform_dirent64 *d;
+    while ((d = platform_readdir(dirp)) != NULL) {
+      const string file_path = path + "/" + string(d->d_name);
+      platform_stat64 info;
+      if (platform_stat(file_path.c_str(), &info) != 0) {
+        LogCvmfs(kLogQuota, kLogDebug, "could not stat %s", file_path.c_str());
+        continue;
+      }
+      if (!S_ISREG(info.st_mode))
+        continue;
+      if (info.st_size == 0) {
+        LogCvmfs(kLogQuota, kLogSyslog | kLogDebug,
+                 "removing empty file %s during automatic cache db rebuild",
+                 file_path.c_str());
+        unlink(file_path.c_str());
+        continue;
+      }
+      FsEntry fs_entry;
+      fs_entry.hash =
+        shash::MkFromHexPtr(shash::HexPtr(string(hex) + string(d->d_name)));
+      fs_entry.size = info.st_size;
+      fs_entry.atime = info.st_atime;
+      fs_entries.push_back(fs_entry);
+    }
+    closedir(dirp);
+  }
+
+  std::sort(fs_entries.begin(), fs_entries.end());
+  for (unsigned i = 0; i < fs_entries.size(); ++i) {
+    Shard *shard = SelectShard(fs_entries[i].hash);
+    const uint32_t idx = AddEntry(shard, fs_entries[i].hash);
+    Entry *entry = &shard->entries[idx];
+    entry->size = fs_entries[i].size;
+    entry->seq = NextSeq();
+    // Might also be a catalog (information is lost)
+    entry->description = "unknown (automatic rebuild)";
+    LinkEntry(shard, idx);
+    MarkDirty(shard, idx);
+    atomic_xadd64(&gauge_, entry->size);
+  }
+  LogCvmfs(kLogQuota, kLogDebug,
+           "rebuilding finished, seqence %" PRIu64 ", gauge %" PRIu64,
+           atomic_read64(&seq_), atomic_read64(&gauge_));
+  return true;
+}
+
+
+void MemoryQuotaManager::CloseDatabase() {
+  if (stmt_new_) sqlite3_finalize(stmt_new_);
+  if (stmt_rm_) sqlite3_finalize(stmt_rm_);
+  if (database_) sqlite3_close(database_);
+  UnlockFile(fd_lock_cachedb_);
+  stmt_new_ = NULL;
+  stmt_rm_ = NULL;
+  database_ = NULL;
+}
+
+
+/**
+ * Writes the entries that changed since the last checkpoint to the cachedb.
+ * Shards are locked one after another and only for copying their dirty
+ * entries.
+ */
+bool MemoryQuotaManager::Checkpoint() {
+  MutexLockGuard m(&lock_database_);
+  int retval = sqlite3_exec(database_, "BEGIN", NULL, NULL, NULL);
+  if (retval != SQLITE_OK) {
+    LogCvmfs(kLogQuota, kLogDebug | kLogSyslogErr,
+             "failed to start cachedb checkpoint (%d)", retval);
+    return false;
+  }
+  for (unsigned i = 0; i < kNumShards; ++i)
+    CheckpointShard(shards_[i]);
+  retval = sqlite3_exec(database_, "COMMIT", NULL, NULL, NULL);
+  if (retval != SQLITE_OK) {
+    LogCvmfs(kLogQuota, kLogDebug | kLogSyslogErr,
+             "failed to commit cachedb checkpoint (%d)", retval);
+    sqlite3_exec(database_, "ROLLBACK", NULL, NULL, NULL);
+    return false;
+  }
+  return true;
+}
+
+
+void MemoryQuotaManager::CheckpointShard(Shard *shard) {
+  vector<Record> records;
+  vector<string> removed;
+  {
+    MutexLockGuard m(&shard->lock);
+    DrainTouchLog(shard);
+    for (unsigned i = 0; i < shard->dirty.size(); ++i) {
+      uint32_t idx;
+      if (!shard->index.Lookup(shard->dirty[i], &idx)) {
+        removed.push_back(shard->dirty[i].ToString());
+        continue;
+      }
+      Entry *entry = &shard->entries[idx];
+      if (!entry->is_dirty)
+        continue;
+      entry->is_dirty = false;
+      Record record;
+      record.hash_str = entry->hash.ToString();
+      record.size = entry->size;
+      record.acseq = entry->seq | (entry->is_volatile ? kVolatileFlag : 0);
+      record.description = entry->description;
+      record.type = entry->type;
+      record.is_pinned = entry->is_pinned;
+      records.push_back(record);
+    }
+    shard->dirty.clear();
+  }
+
+  for (unsigned i = 0; i < removed.size(); ++i) {
+    sqlite3_bind_text(stmt_rm_, 1, removed[i].data(), removed[i].length(),
+                      SQLITE_STATIC);
+    sqlite3_step(stmt_rm_);
+    sqlite3_reset(stmt_rm_);
+  }
+  for (unsigned i = 0; i < records.size(); ++i) {
+    const Record &r = records[i];
+    sqlite3_bind_text(stmt_new_, 1, r.hash_str.data(), r.hash_str.length(),
+                      SQLITE_STATIC);
+    sqlite3_bind_int64(stmt_new_, 2, r.size);
+    sqlite3_bind_int64(stmt_new_, 3, r.acseq);
+    sqlite3_bind_text(stmt_new_, 4, r.description.data(),
+                      r.description.length(), SQLITE_STATIC);
+    sqlite3_bind_int64(stmt_new_, 5, r.type);
+    sqlite3_bind_int64(stmt_new_, 6, r.is_pinned ? 1 : 0);
+    int retval = sqlite3_step(stmt_new_);
+    if ((retval != SQLITE_DONE) && (retval != SQLITE_OK)) {
+      LogCvmfs(kLogQuota, kLogDebug | kLogSyslogErr,
+               "failed to checkpoint %s in cachedb, error %d",
+               r.hash_str.c_str(), retval);
+    }
+    sqlite3_reset(stmt_new_);
+  }
+}
+
+
+void MemoryQuotaManager::CheckFreeSpace() {
+  const uint64_t gauge = atomic_read64(&gauge_);
+  if ((limit_ == 0) || (gauge >= limit_))
+    return;
+
+  struct statvfs vfs_info;
+  int retval = statvfs((cache_dir_ + "/cachedb").c_str(), &vfs_info);
+  if (retval != 0) {
+    LogCvmfs(kLogQuota, kLogDebug | kLogSyslogWarn,
+             "failed to query %s for free space (%d)",
+             cache_dir_.c_str(), errno);
+    return;
+  }
+  int64_t free_space_byte = vfs_info.f_bavail * vfs_info.f_bsize;
+  int64_t required_byte = limit_ - gauge;
+  if (free_space_byte < required_byte) {
+    LogCvmfs(kLogQuota, kLogSyslogWarn,
+             "too little free space on the file system hosting the cache,"
+             " %" PRId64 " MB available",
+             free_space_byte / (1024 * 1024));
+  }
+}
+
+
+void MemoryQuotaManager::CheckHighPinWatermark() {
+  const uint64_t watermark = kHighPinWatermark*cleanup_threshold_/100;
+  if ((cleanup_threshold_ > 0) && (pinned_ > watermark)) {
+    LogCvmfs(kLogQuota, kLogDebug | kLogSyslogWarn,
+             "high watermark of pinned files (%" PRIu64 "M > %" PRIu64 "M)",
+             pinned_/(1024*1024), watermark/(1024*1024));
+    BroadcastBackchannels("R");  // clients: please release pinned catalogs
+  }
+}
+
+
+//------------------------------------------------------------------------------
+
+
+bool MemoryQuotaManager::IsPinned(const shash::Any &hash) {
+  MutexLockGuard m(&lock_pinned_);
+  return pinned_chunks_.find(hash) != pinned_chunks_.end();
+}
+
+
+/**
+ * Puts the entry at the front (most recently used) of its LRU list.
+ */
+void MemoryQuotaManager::LinkEntry(Shard *shard, const uint32_t idx) {
+  LruList *list = GetLruList(shard, shard->entries[idx]);
+  Entry *entry = &shard->entries[idx];
+  entry->prev = kNil;
+  entry->next = list->head;
+  if (list->head != kNil)
+    shard->entries[list->head].prev = idx;
+  list->head = idx;
+  if (list->tail == kNil)
+    list->tail = idx;
+}
+
+
+void MemoryQuotaManager::UnlinkEntry(Shard *shard, const uint32_t idx) {
+  LruList *list = GetLruList(shard, shard->entries[idx]);
+  Entry *entry = &shard->entries[idx];
+  if (entry->prev != kNil)
+    shard->entries[entry->prev].next = entry->next;
+  else
+    list->head = entry->next;
+  if (entry->next != kNil)
+    shard->entries[entry->next].prev = entry->prev;
+  else
+    list->tail = entry->prev;
+  entry->prev = entry->next = kNil;
+}
+
+
+void MemoryQuotaManager::MarkDirty(Shard *shard, const uint32_t idx) {
+  Entry *entry = &shard->entries[idx];
+  if (entry->is_dirty)
+    return;
+  entry->is_dirty = true;
+  shard->dirty.push_back(entry->hash);
+}
+
+
+/**
+ * Creates an unlinked entry for a hash that is not yet in the index.
+ */
+uint32_t MemoryQuotaManager::AddEntry(Shard *shard, const shash::Any &hash) {
+  uint32_t idx;
+  if (shard->free_entries.empty()) {
+    idx = shard->entries.size();
+    shard->entries.push_back(Entry());
+  } else {
+    idx = shard->free_entries.back();
+    shard->free_entries.pop_back();
+    shard->entries[idx] = Entry();
+  }
+  shard->entries[idx].hash = hash;
+  shard->index.Insert(hash, idx);
+  return idx;
+}
+
+
+void MemoryQuotaManager::RemoveEntry(Shard *shard, const uint32_t idx) {
+  Entry *entry = &shard->entries[idx];
+  if (!entry->is_pinned)
+    UnlinkEntry(shard, idx);
+  shard->index.Erase(entry->hash);
+  shard->dirty.push_back(entry->hash);
+  atomic_xadd64(&gauge_, -static_cast<int64_t>(entry->size));
+  entry->is_dirty = false;
+  entry->description.clear();
+  shard->free_entries.push_back(idx);
+}
+
+
+void MemoryQuotaManager::DoTouch(Shard *shard, const shash::Any &hash) {
+  uint32_t idx;
+  if (!shard->index.Lookup(hash, &idx))
+    return;
+  shard->entries[idx].seq = NextSeq();
+  if (!shard->entries[idx].is_pinned) {
+    UnlinkEntry(shard, idx);
+    LinkEntry(shard, idx);
+  }
+  MarkDirty(shard, idx);
+}
+
+
+/**
+ * Applies the buffered touches.  Needs to be called with the shard locked.
+ * The log is closed first so that concurrent Touch() calls fall back to the
+ * locked path while the log is being applied.
+ */
+void MemoryQuotaManager::DrainTouchLog(Shard *shard) {
+  int32_t num_touches;
+  do {
+    num_touches = atomic_read32(&shard->touch_next);
+    if (num_touches == 0)
+      return;
+  } while (!atomic_cas32(&shard->touch_next, num_touches, kTouchLogSize));
+  num_touches = std::min(num_touches, static_cast<int32_t>(kTouchLogSize));
+
+  for (int32_t i = 0; i < num_touches; ++i) {
+    TouchSlot *slot = &shard->touch_log[i];
+    // The slot is reserved; the writer is about to publish the hash
+    while (atomic_read32(&slot->ready) == 0)
+      sched_yield();
+    DoTouch(shard, slot->hash);
+    atomic_write32(&slot->ready, 0);
+  }
+  atomic_write32(&shard->touch_next, 0);
+}
+
+
+//------------------------------------------------------------------------------
+
+
+/**
+ * Updates the position of the file specified by the hash in the LRU.
+ */
+void MemoryQuotaManager::Touch(const shash::Any &hash) {
+  Shard *shard = SelectShard(hash);
+  const int32_t slot_idx = atomic_xadd32(&shard->touch_next, 1);
+  if (slot_idx < static_cast<int32_t>(kTouchLogSize)) {
+    shard->touch_log[slot_idx].hash = hash;
+    atomic_write32(&shard->touch_log[slot_idx].ready, 1);
+    return;
+  }
+
+  // Touch log full or being drained
+  MutexLockGuard m(&shard->lock);
+  DrainTouchLog(shard);
+  DoTouch(shard, hash);
+}
+
+
+void MemoryQuotaManager::Insert(
+  const shash::Any &hash,
+  const uint64_t size,
+  const string &description)
+{
+  DoInsert(hash, size, description, kFileRegular, false);
+}
+
+
+/**
+ * Volatile files are preferred during cache cleanup.
+ */
+void MemoryQuotaManager::InsertVolatile(
+  const shash::Any &hash,
+  const uint64_t size,
+  const string &description)
+{
+  DoInsert(hash, size, description, kFileRegular, true);
+}
+
+
+void MemoryQuotaManager::DoInsert(
+  const shash::Any &hash,
+  const uint64_t size,
+  const string &description,
+  const FileTypes type,
+  const bool is_volatile)
+{
+  LogCvmfs(kLogQuota, kLogDebug, "insert into lru %s, path %s",
+           hash.ToString().c_str(), description.c_str());
+  Shard *shard = SelectShard(hash);
+
+  bool exists;
+  {
+    MutexLockGuard m(&shard->lock);
+    exists = shard->index.Contains(hash);
+  }
+  if (!exists &&
+      (static_cast<uint64_t>(atomic_read64(&gauge_)) + size > limit_))
+  {
+    LogCvmfs(kLogQuota, kLogDebug, "over limit, gauge %" PRIu64 ", "
+             "file size %" PRIu64, atomic_read64(&gauge_), size);
+    DoCleanup(cleanup_threshold_);
+  }
+
+  MutexLockGuard m(&shard->lock);
+  uint32_t idx;
+  if (shard->index.Lookup(hash, &idx)) {
+    if (!shard->entries[idx].is_pinned)
+      UnlinkEntry(shard, idx);
+    atomic_xadd64(&gauge_, -static_cast<int64_t>(shard->entries[idx].size));
+  } else {
+    idx = AddEntry(shard, hash);
+  }
+  Entry *entry = &shard->entries[idx];
+  entry->size = size;
+  entry->seq = NextSeq();
+  entry->description = description;
+  entry->type = type;
+  entry->is_volatile = is_volatile;
+  entry->is_pinned = IsPinned(hash);
+  if (!entry->is_pinned)
+    LinkEntry(shard, idx);
+  MarkDirty(shard, idx);
+  atomic_xadd64(&gauge_, size);
+}
+
+
+/**
+ * Immediately inserts a new pinned file.  Does cache cleanup if necessary.
+ *
+ * \return True on success, false otherwise
+ */
+bool MemoryQuotaManager::Pin(
+  const shash::Any &hash,
+  const uint64_t size,
+  const string &description,
+  const bool is_catalog)
+{
+  assert((size > 0) || !is_catalog);
+  LogCvmfs(kLogQuota, kLogDebug, "pin into lru %s, path %s",
+           hash.ToString().c_str(), description.c_str());
+
+  {
+    MutexLockGuard m(&lock_pinned_);
+    if (pinned_chunks_.find(hash) == pinned_chunks_.end()) {
+      if (pinned_ + size > cleanup_threshold_) {
+        LogCvmfs(kLogQuota, kLogDebug, "failed to insert %s (pinned), no space",
+                 hash.ToString().c_str());
+        return false;
+      }
+      pinned_chunks_[hash] = size;
+      pinned_ += size;
+      CheckHighPinWatermark();
+    }
+  }
+
+  DoInsert(hash, size, description, is_catalog ? kFileCatalog : kFileRegular,
+           false);
+  return true;
+}
+
+
+void MemoryQuotaManager::Unpin(const shash::Any &hash) {
+  LogCvmfs(kLogQuota, kLogDebug, "Unpin %s", hash.ToString().c_str());
+  {
+    MutexLockGuard m(&lock_pinned_);
+    map<shash::Any, uint64_t>::iterator iter = pinned_chunks_.find(hash);
+    if (iter == pinned_chunks_.end()) {
+      LogCvmfs(kLogQuota, kLogDebug, "this chunk was not pinned");
+      return;
+    }
+    pinned_ -= iter->second;
+    pinned_chunks_.erase(iter);
+  }
+
+  Shard *shard = SelectShard(hash);
+  MutexLockGuard m(&shard->lock);
+  uint32_t idx;
+  if (!shard->index.Lookup(hash, &idx) || !shard->entries[idx].is_pinned)
+    return;
+  // It can happen that files get pinned that were removed from the cache
+  // (see cache.cc).  Such entries are removed at this point.
+  if (!FileExists(cache_dir_ + "/" + hash.MakePathWithoutSuffix())) {
+    LogCvmfs(kLogQuota, kLogDebug,
+             "remove orphaned pinned hash %s from cache database",
+             hash.ToString().c_str());
+    RemoveEntry(shard, idx);
+    return;
+  }
+  shard->entries[idx].is_pinned = false;
+  LinkEntry(shard, idx);
+  MarkDirty(shard, idx);
+}
+
+
+/**
+ * Removes a chunk from cache, if it exists.
+ */
+void MemoryQuotaManager::Remove(const shash::Any &hash) {
+  Shard *shard = SelectShard(hash);
+  {
+    MutexLockGuard m(&shard->lock);
+    uint32_t idx;
+    if (shard->index.Lookup(hash, &idx)) {
+      if (shard->entries[idx].is_pinned) {
+        MutexLockGuard m_pinned(&lock_pinned_);
+        map<shash::Any, uint64_t>::iterator iter = pinned_chunks_.find(hash);
+        if (iter != pinned_chunks_.end()) {
+          pinned_ -= iter->second;
+          pinned_chunks_.erase(iter);
+        }
+      }
+      RemoveEntry(shard, idx);
+    }
+  }
+
+  unlink((cache_dir_ + "/" + hash.MakePathWithoutSuffix()).c_str());
+}
+
+
+bool MemoryQuotaManager::Cleanup(const uint64_t leave_size) {
+  return DoCleanup(leave_size);
+}
+
+
+/**
+ * Evicts least recently used entries across all shards until the cache size is
+ * below leave_size.  Volatile entries go first.  The files are unlinked
+ * asynchronously by the background thread, if it is running.
+ */
+bool MemoryQuotaManager::DoCleanup(const uint64_t leave_size) {
+  MutexLockGuard m(&lock_cleanup_);
+  if (static_cast<uint64_t>(atomic_read64(&gauge_)) <= leave_size)
+    return true;
+
+  LogCvmfs(kLogQuota, kLogSyslog,
+           "clean up cache until at most %lu KB is used", leave_size/1024);
+  cleanup_recorder_.Tick();
+
+  for (unsigned i = 0; i < kNumShards; ++i) {
+    pthread_mutex_lock(&shards_[i]->lock);
+    DrainTouchLog(shards_[i]);
+  }
+
+  vector<string> trash;
+  while (static_cast<uint64_t>(atomic_read64(&gauge_)) > leave_size) {
+    Shard *victim_shard = NULL;
+    uint32_t victim_idx = kNil;
+    bool victim_volatile = false;
+    for (unsigned i = 0; i < kNumShards; ++i) {
+      Shard *shard = shards_[i];
+      const bool is_volatile = (shard->lru_volatile.tail != kNil);
+      const uint32_t idx =
+        is_volatile ? shard->lru_volatile.tail : shard->lru_regular.tail;
+      if (idx == kNil)
+        continue;
+      if (victim_idx != kNil) {
+        if (victim_volatile && !is_volatile)
+          continue;
+        if ((victim_volatile == is_volatile) &&
+            (victim_shard->entries[victim_idx].seq < shard->entries[idx].seq))
+        {
+          continue;
+        }
+      }
+      victim_shard = shard;
+      victim_idx = idx;
+      victim_volatile = is_volatile;
+    }
+    if (victim_idx == kNil) {
+      LogCvmfs(kLogQuota, kLogDebug, "could not get lru-entry");
+      break;
+    }
+
+    Entry *victim = &victim_shard->entries[victim_idx];
+    // We must not delete a not yet inserted pinned file as it is already
+    // reserved (but will be inserted later)
+    if (IsPinned(victim->hash)) {
+      UnlinkEntry(victim_shard, victim_idx);
+      victim->is_pinned = true;
+      continue;
+    }
+    trash.push_back(cache_dir_ + "/" + victim->hash.MakePathWithoutSuffix());
+    RemoveEntry(victim_shard, victim_idx);
+  }
+
+  for (unsigned i = 0; i < kNumShards; ++i)
+    pthread_mutex_unlock(&shards_[i]->lock);
+
+  if (!trash.empty()) {
+    MutexLockGuard m_trash(&lock_trash_);
+    trash_.insert(trash_.end(), trash.begin(), trash.end());
+  }
+  if (spawned_) {
+    char unlink_trash = 'U';
+    WritePipe(pipe_ctrl_[1], &unlink_trash, 1);
+  } else {
+    UnlinkTrash();
+  }
+
+  const uint64_t gauge = atomic_read64(&gauge_);
+  if (gauge > leave_size) {
+    LogCvmfs(kLogQuota, kLogDebug | kLogSyslogWarn,
+             "request to clean until %" PRIu64 ", "
+             "but effective gauge is %" PRIu64, leave_size, gauge);
+    return false;
+  }
+  return true;
+}
+
+
+void MemoryQuotaManager::UnlinkTrash() {
+  vector<string> trash;
+  {
+    MutexLockGuard m(&lock_trash_);
+    trash.swap(trash_);
+  }
+  for (unsigned i = 0; i < trash.size(); ++i) {
+    LogCvmfs(kLogQuota, kLogDebug, "unlink %s", trash[i].c_str());
+    unlink(trash[i].c_str());
+  }
+}
+
+
+vector<string> MemoryQuotaManager::DoList(const ListType list_type) {
+  vector<string> result;
+  for (unsigned i = 0; i < kNumShards; ++i) {
+    Shard *shard = shards_[i];
+    MutexLockGuard m(&shard->lock);
+    for (unsigned j = 0; j < shard->entries.size(); ++j) {
+      const Entry &entry = shard->entries[j];
+      uint32_t idx;
+      if (!shard->index.Lookup(entry.hash, &idx) || (idx != j))
+        continue;
+      bool selected = false;
+      switch (list_type) {
+        case kListRegular:
+          selected = (entry.type == kFileRegular);
+          break;
+        case kListPinned:
+          selected = entry.is_pinned;
+          break;
+        case kListCatalogs:
+          selected = (entry.type == kFileCatalog);
+          break;
+        case kListVolatile:
+          selected = entry.is_volatile;
+          break;
+        default:
+          PANIC(NULL);
+      }
+      if (selected)
+        result.push_back(entry.description);
+    }
+  }
+  return result;
+}
+
+
+vector<string> MemoryQuotaManager::List() {
+  return DoList(kListRegular);
+}
+
+
+vector<string> MemoryQuotaManager::ListPinned() {
+  return DoList(kListPinned);
+}
+
+
+vector<string> MemoryQuotaManager::ListCatalogs() {
+  return DoList(kListCatalogs);
+}
+
+
+vector<string> MemoryQuotaManager::ListVolatile() {
+  return DoList(kListVolatile);
+}
+
+
+/**
+ * Since we only cleanup until cleanup_threshold, we can only add
+ * files smaller than limit-cleanup_threshold.
+ */
+uint64_t MemoryQuotaManager::GetMaxFileSize() {
+  return limit_ - cleanup_threshold_;
+}
+
+
+uint64_t MemoryQuotaManager::GetCapacity() {
+  return limit_;
+}
+
+
+uint64_t MemoryQuotaManager::GetSize() {
+  return atomic_read64(&gauge_);
+}
+
+
+uint64_t MemoryQuotaManager::GetSizePinned() {
+  MutexLockGuard m(&lock_pinned_);
+  return pinned_;
+}
+
+
+uint64_t MemoryQuotaManager::GetCleanupRate(uint64_t period_s) {
+  MutexLockGuard m(&lock_cleanup_);
+  return cleanup_recorder_.GetNoTicks(period_s);
+}
+
+
+pid_t MemoryQuotaManager::GetPid() {
+  return getpid();
+}
+
+
+uint32_t MemoryQuotaManager::GetProtocolRevision() {
+  return kProtocolRevision;
+}
+
+
+/**
+ * Back channels of the in-process quota manager are plain pipes.
+ */
+void MemoryQuotaManager::RegisterBackChannel(
+  int back_channel[2],
+  const string &channel_id)
+{
+  shash::Md5 hash = shash::Md5(shash::AsciiPtr(channel_id));
+  MakePipe(back_channel);
+  Block2Nonblock(back_channel[1]);  // back channels are opportunistic
+
+  LockBackChannels();
+  map<shash::Md5, int>::const_iterator iter = back_channels_.find(hash);
+  if (iter != back_channels_.end()) {
+    LogCvmfs(kLogQuota, kLogDebug | kLogSyslogWarn,
+             "closing left-over back channel %s", hash.ToString().c_str());
+    close(iter->second);
+  }
+  back_channels_[hash] = back_channel[1];
+  UnlockBackChannels();
+}
+
+
+void MemoryQuotaManager::UnregisterBackChannel(
+  int back_channel[2],
+  const string &channel_id)
+{
+  shash::Md5 hash = shash::Md5(shash::AsciiPtr(channel_id));
+
+  LockBackChannels();
+  map<shash::Md5, int>::iterator iter = back_channels_.find(hash);
+  if (iter != back_channels_.end()) {
+    close(iter->second);
+    back_channels_.erase(iter);
+  } else {
+    LogCvmfs(kLogQuota, kLogDebug | kLogSyslogWarn,
+             "did not find back channel %s", hash.ToString().c_str());
+  }
+  UnlockBackChannels();
+  close(back_channel[0]);
+}
+
+
+void MemoryQuotaManager::Spawn() {
+  if (spawned_)
+    return;
+
+  MakePipe(pipe_ctrl_);
+  if (pthread_create(&thread_background_, NULL, MainBackground,
+      static_cast<void *>(this)) != 0)
+  {
+    PANIC(kLogDebug, "could not create lru thread");
+  }
+  spawned_ = true;
+}
+
+
+/**
+ * Checkpoints the LRU every kCheckpointIntervalSec and unlinks the files
+ * evicted by cleanups.
+ */
+void *MemoryQuotaManager::MainBackground(void *data) {
+  MemoryQuotaManager *quota_mgr = static_cast<MemoryQuotaManager *>(data);
+  LogCvmfs(kLogQuota, kLogDebug, "starting in-memory lru background thread");
+
+  struct pollfd watch_ctrl;
+  watch_ctrl.fd = quota_mgr->pipe_ctrl_[0];
+  watch_ctrl.events = POLLIN | POLLPRI;
+  uint64_t deadline = platform_monotonic_time() + kCheckpointIntervalSec;
+  while (true) {
+    const uint64_t now = platform_monotonic_time();
+    if (now >= deadline) {
+      quota_mgr->Checkpoint();
+      deadline = platform_monotonic_time() + kCheckpointIntervalSec;
+      continue;
+    }
+
+    watch_ctrl.revents = 0;
+    int retval = poll(&watch_ctrl, 1, (deadline - now) * 1000);
+    if (retval < 0) {
+      if (errno == EINTR)
+        continue;
+      PANIC(kLogSyslogErr, "in-memory lru: poll failed (%d)", errno);
+    }
+    if (retval == 0)
+      continue;
+
+    char c = 0;
+    ReadPipe(quota_mgr->pipe_ctrl_[0], &c, 1);
+    if (c == 'T')
+      break;
+    assert(c == 'U');
+    quota_mgr->UnlinkTrash();
+  }
+
+  LogCvmfs(kLogQuota, kLogDebug, "stopping in-memory lru background thread");
+  return NULL;
+}
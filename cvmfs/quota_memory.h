@@ -0,0 +1,299 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#ifndef CVMFS_QUOTA_MEMORY_H_
+#define CVMFS_QUOTA_MEMORY_H_
+
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "crypto/hash.h"
+#include "duplex_sqlite3.h"
+#include "gtest/gtest_prod.h"
+#include "quota.h"
+#include "smallhash.h"
+#include "statistics.h"
+#include "util/atomic.h"
+
+/**
+ * Alternative to the PosixQuotaManager for an exclusive (non-shared) POSIX
+ * cache.  The LRU is kept in memory instead of being maintained by a single
+ * command server thread on top of SQlite.  Cache entries are distributed over
+ * kNumShards shards according to their content hash.  Each shard has its own
+ * lock, a compact hash-to-entry index, and intrusive LRU lists.
+ *
+ * Touch() does not take a lock.  It appends the hash to the shard's touch log,
+ * which is applied to the LRU lists the next time the shard is locked anyway
+ * (cleanup, checkpoint) or when the log is full.
+ *
+ * The state is periodically checkpointed to the cachedb, using the same schema
+ * as the PosixQuotaManager.  Only entries that changed since the last
+ * checkpoint are written.  Therefore, the cachedb can be used by either of the
+ * two quota managers.
+ */
+class MemoryQuotaManager : public QuotaManager {
+  FRIEND_TEST(T_MemoryQuotaManager, TouchLog);
+
+ public:
+  static const unsigned kNumShards = 16;
+  /**
+   * Number of touches per shard that are buffered without locking
+   */
+  static const unsigned kTouchLogSize = 256;
+  static const unsigned kCheckpointIntervalSec = 60;
+
+  static MemoryQuotaManager *Create(const std::string &cache_workspace,
+    const uint64_t limit, const uint64_t cleanup_threshold,
+    const bool rebuild_database);
+
+  virtual ~MemoryQuotaManager();
+  virtual bool HasCapability(Capabilities capability) { return true; }
+
+  virtual void Insert(const shash::Any &hash, const uint64_t size,
+                      const std::string &description);
+  virtual void InsertVolatile(const shash::Any &hash, const uint64_t size,
+                              const std::string &description);
+  virtual bool Pin(const shash::Any &hash, const uint64_t size,
+                   const std::string &description, const bool is_catalog);
+  virtual void Unpin(const shash::Any &hash);
+  virtual void Touch(const shash::Any &hash);
+  virtual void Remove(const shash::Any &file);
+  virtual bool Cleanup(const uint64_t leave_size);
+
+  virtual void RegisterBackChannel(int back_channel[2],
+                                   const std::string &channel_id);
+  virtual void UnregisterBackChannel(int back_channel[2],
+                                     const std::string &channel_id);
+
+  virtual std::vector<std::string> List();
+  virtual std::vector<std::string> ListPinned();
+  virtual std::vector<std::string> ListCatalogs();
+  virtual std::vector<std::string> ListVolatile();
+  virtual uint64_t GetMaxFileSize();
+  virtual uint64_t GetCapacity();
+  virtual uint64_t GetSize();
+  virtual uint64_t GetSizePinned();
+  virtual uint64_t GetCleanupRate(uint64_t period_s);
+
+  virtual void Spawn();
+  virtual pid_t GetPid();
+  virtual uint32_t GetProtocolRevision();
+
+  bool Checkpoint();
+
+ private:
+  /**
+   * Same values as in the PosixQuotaManager (type column of the cachedb)
+   */
+  enum FileTypes {
+    kFileRegular = 0,
+    kFileCatalog,
+  };
+
+  /**
+   * Selects the entries returned by DoList()
+   */
+  enum ListType {
+    kListRegular = 0,
+    kListPinned,
+    kListCatalogs,
+    kListVolatile,
+  };
+
+  static const uint32_t kNil = uint32_t(-1);
+  /**
+   * Marks volatile entries in the acseq column of the cachedb
+   */
+  static const uint64_t kVolatileFlag = 1ULL << 63;
+  /**
+   * See PosixQuotaManager::kHighPinWatermark
+   */
+  static const unsigned kHighPinWatermark = 75;
+
+  struct Entry {
+    Entry()
+      : size(0)
+      , seq(0)
+      , prev(kNil)
+      , next(kNil)
+      , type(kFileRegular)
+      , is_volatile(false)
+      , is_pinned(false)
+      , is_dirty(false)
+    { }
+    shash::Any hash;
+    uint64_t size;
+    uint64_t seq;
+    uint32_t prev;
+    uint32_t next;
+    std::string description;
+    FileTypes type;
+    bool is_volatile;
+    /**
+     * Pinned entries are not linked into the LRU lists
+     */
+    bool is_pinned;
+    /**
+     * The hash is already in the shard's list of dirty hashes
+     */
+    bool is_dirty;
+  };
+
+  /**
+   * Doubly linked list of entry indexes, from most to least recently used
+   */
+  struct LruList {
+    LruList() : head(kNil), tail(kNil) { }
+    uint32_t head;
+    uint32_t tail;
+  };
+
+  struct TouchSlot {
+    TouchSlot() { atomic_init32(&ready); }
+    shash::Any hash;
+    atomic_int32 ready;
+  };
+
+  struct Shard {
+    Shard();
+    ~Shard();
+    pthread_mutex_t lock;
+    SmallHashDynamic<shash::Any, uint32_t> index;
+    std::vector<Entry> entries;
+    std::vector<uint32_t> free_entries;
+    /**
+     * Volatile entries are evicted before regular entries
+     */
+    LruList lru_regular;
+    LruList lru_volatile;
+    /**
+     * Hashes of entries that were changed or removed since the last checkpoint
+     */
+    std::vector<shash::Any> dirty;
+    /**
+     * Next free slot in the touch log.  Values >= kTouchLogSize indicate that
+     * the touch log is full or being drained.
+     */
+    atomic_int32 touch_next;
+    TouchSlot touch_log[kTouchLogSize];
+  };
+
+  /**
+   * Record of an entry that is written to the cachedb during a checkpoint
+   */
+  struct Record {
+    std::string hash_str;
+    uint64_t size;
+    uint64_t acseq;
+    std::string description;
+    FileTypes type;
+    bool is_pinned;
+  };
+
+  MemoryQuotaManager(const uint64_t limit, const uint64_t cleanup_threshold,
+                     const std::string &cache_workspace);
+
+  bool InitDatabase(const bool rebuild_database);
+  bool RebuildFromFilesystem();
+  bool LoadDatabase();
+  void CloseDatabase();
+  void CheckFreeSpace();
+  void CheckHighPinWatermark();
+
+  Shard *SelectShard(const shash::Any &hash) {
+    return shards_[hash.digest[0] % kNumShards];
+  }
+  uint64_t NextSeq() { return atomic_xadd64(&seq_, 1); }
+  bool IsPinned(const shash::Any &hash);
+  LruList *GetLruList(Shard *shard, const Entry &entry) {
+    return entry.is_volatile ? &shard->lru_volatile : &shard->lru_regular;
+  }
+  void LinkEntry(Shard *shard, const uint32_t idx);
+  void UnlinkEntry(Shard *shard, const uint32_t idx);
+  void MarkDirty(Shard *shard, const uint32_t idx);
+  uint32_t AddEntry(Shard *shard, const shash::Any &hash);
+  void RemoveEntry(Shard *shard, const uint32_t idx);
+  void DoTouch(Shard *shard, const shash::Any &hash);
+  void DrainTouchLog(Shard *shard);
+
+  void DoInsert(const shash::Any &hash, const uint64_t size,
+                const std::string &description, const FileTypes type,
+                const bool is_volatile);
+  bool DoCleanup(const uint64_t leave_size);
+  std::vector<std::string> DoList(const ListType list_type);
+  void CheckpointShard(Shard *shard);
+  void UnlinkTrash();
+
+  static void *MainBackground(void *data);
+
+  bool spawned_;
+
+  /**
+   * Soft limit in bytes, start cleanup when reached.
+   */
+  uint64_t limit_;
+
+  /**
+   * Cleanup until cleanup_threshold_ are left in the cache.
+   */
+  uint64_t cleanup_threshold_;
+
+  /**
+   * Current size of cache, changed under the lock of any of the shards
+   */
+  atomic_int64 gauge_;
+
+  /**
+   * Current access sequence number.
+   */
+  atomic_int64 seq_;
+
+  std::string cache_dir_;
+  std::string workspace_dir_;
+
+  Shard *shards_[kNumShards];
+
+  /**
+   * Pinned content hashes and their size.  Protected by lock_pinned_, which
+   * can be taken while holding a shard lock but not the other way round.
+   */
+  std::map<shash::Any, uint64_t> pinned_chunks_;
+  uint64_t pinned_;
+  pthread_mutex_t lock_pinned_;
+
+  /**
+   * Serializes cleanups and protects cleanup_recorder_
+   */
+  pthread_mutex_t lock_cleanup_;
+  perf::MultiRecorder cleanup_recorder_;
+
+  /**
+   * Files evicted by a cleanup, unlinked by the background thread
+   */
+  std::vector<std::string> trash_;
+  pthread_mutex_t lock_trash_;
+
+  /**
+   * Wakes up the background thread for unlinking ('U') or termination ('T')
+   */
+  int pipe_ctrl_[2];
+  pthread_t thread_background_;
+
+  int fd_lock_cachedb_;
+  /**
+   * Protects database_ and the prepared statements
+   */
+  pthread_mutex_t lock_database_;
+  sqlite3 *database_;
+  sqlite3_stmt *stmt_new_;
+  sqlite3_stmt *stmt_rm_;
+};  // class MemoryQuotaManager
+
+#endif  // CVMFS_QUOTA_MEMORY_H_
@@ -121,6 +121,12 @@ static size_t CallbackCurlHeader(void *ptr, size_t size, size_t nmemb,
     S3FanoutManager::DetectThrottleIndicator(header_line, info);
   }
 
+  if ((info->request == JobInfo::kReqMultipartPart) &&
+      HasPrefix(header_line, "etag:", true))
+  {
+    info->etag = Trim(header_line.substr(5), true /* trim_newline */);
+  }
+
   return num_bytes;
 }
 
@@ -148,12 +154,23 @@ static size_t CallbackCurlData(void *ptr, size_t size, size_t nmemb,
 
 
 /**
- * For the time being, ignore all received information in the HTTP body
+ * Only the XML bodies of multi-object delete and multipart requests are kept.
+ * They list the keys that could not be deleted, the id of a new multipart
+ * upload, or an error that occurred after the HTTP status was sent.
  */
 static size_t CallbackCurlBody(
-  char * /*ptr*/, size_t size, size_t nmemb, void * /*userdata*/)
+  char *ptr, size_t size, size_t nmemb, void *info_link)
 {
-  return size * nmemb;
+  const size_t num_bytes = size * nmemb;
+  JobInfo *info = static_cast<JobInfo *>(info_link);
+  if ((info != NULL) &&
+      ((info->request == JobInfo::kReqDeleteMulti) ||
+       (info->request == JobInfo::kReqMultipartInit) ||
+       (info->request == JobInfo::kReqMultipartComplete)))
+  {
+    info->response.append(ptr, num_bytes);
+  }
+  return num_bytes;
 }
 
 
@@ -581,14 +598,35 @@ bool S3FanoutManager::MkV4Authz(const JobInfo &info, vector<string> *headers)
     "x-amz-date:" + timestamp + "\n";
 
   string scope = date + "/" + config_.region + "/s3/aws4_request";
+  // Sub-resources such as "?delete" or "?partNumber=1&uploadId=..." become
+  // the canonical query string: sorted parameters, each with a value
+  string object_key = info.object_key;
+  string canonical_query;
+  const size_t pos_query = object_key.find('?');
+  if (pos_query != string::npos) {
+    vector<string> params =
+      SplitString(object_key.substr(pos_query + 1), '&');
+    for (unsigned i = 0; i < params.size(); ++i) {
+      const size_t pos_value = params[i].find('=');
+      if (pos_value == string::npos) {
+        params[i] = GetUriEncode(params[i], true) + "=";
+      } else {
+        params[i] = GetUriEncode(params[i].substr(0, pos_value), true) + "=" +
+                    GetUriEncode(params[i].substr(pos_value + 1), true);
+      }
+    }
+    sort(params.begin(), params.end());
+    canonical_query = JoinStrings(params, "&");
+    object_key = object_key.substr(0, pos_query);
+  }
   string uri = config_.dns_buckets ?
-                 (string("/") + info.object_key) :
-                 (string("/") + config_.bucket + "/" + info.object_key);
+                 (string("/") + object_key) :
+                 (string("/") + config_.bucket + "/" + object_key);
 
   string canonical_request =
     GetRequestString(info) + "\n" +
     GetUriEncode(uri, false) + "\n" +
-    "\n" +
+    canonical_query + "\n" +
     canonical_headers + "\n" +
     signed_headers + "\n" +
     payload_hash;
@@ -604,6 +642,18 @@ bool S3FanoutManager::MkV4Authz(const JobInfo &info, vector<string> *headers)
   string signing_key = GetAwsV4SigningKey(date);
   string signature = shash::Hmac256(signing_key, string_to_sign);
 
+  if (info.request == JobInfo::kReqDeleteMulti) {
+    // Mandatory for multi-object delete, in addition to the SHA-256 hash
+    unsigned char *data;
+    unsigned int nbytes = info.origin->Data(
+      reinterpret_cast<void **>(&data), info.origin->GetSize(), 0);
+    assert(nbytes == info.origin->GetSize());
+    shash::Any md5(shash::kMd5);
+    shash::HashMem(data, nbytes, &md5);
+    headers->push_back("Content-MD5: " +
+      Base64(string(reinterpret_cast<char *>(md5.digest),
+                    md5.GetDigestSize())));
+  }
   headers->push_back("X-Amz-Acl: public-read");
   headers->push_back("X-Amz-Content-Sha256: " + payload_hash);
   headers->push_back("X-Amz-Date: " + timestamp);
@@ -761,7 +811,8 @@ bool S3FanoutManager::MkPayloadHash(const JobInfo &info, string *hex_hash)
 {
   if ((info.request == JobInfo::kReqHeadOnly) ||
       (info.request == JobInfo::kReqHeadPut) ||
-      (info.request == JobInfo::kReqDelete))
+      (info.request == JobInfo::kReqDelete) ||
+      (info.request == JobInfo::kReqMultipartAbort))
   {
     switch (config_.authz_method) {
       case kAuthzAwsV2:
@@ -820,9 +871,15 @@ string S3FanoutManager::GetRequestString(const JobInfo &info) const {
     case JobInfo::kReqPutDotCvmfs:
     case JobInfo::kReqPutHtml:
     case JobInfo::kReqPutBucket:
+    case JobInfo::kReqMultipartPart:
       return "PUT";
     case JobInfo::kReqDelete:
+    case JobInfo::kReqMultipartAbort:
       return "DELETE";
+    case JobInfo::kReqDeleteMulti:
+    case JobInfo::kReqMultipartInit:
+    case JobInfo::kReqMultipartComplete:
+      return "POST";
     default:
       PANIC(NULL);
   }
@@ -834,14 +891,19 @@ string S3FanoutManager::GetContentType(const JobInfo &info) const {
     case JobInfo::kReqHeadOnly:
     case JobInfo::kReqHeadPut:
     case JobInfo::kReqDelete:
+    case JobInfo::kReqMultipartAbort:
       return "";
     case JobInfo::kReqPutCas:
+    case JobInfo::kReqMultipartInit:  // Content type of the assembled object
+    case JobInfo::kReqMultipartPart:
       return "application/octet-stream";
     case JobInfo::kReqPutDotCvmfs:
       return "application/x-cvmfs";
     case JobInfo::kReqPutHtml:
       return "text/html";
     case JobInfo::kReqPutBucket:
+    case JobInfo::kReqDeleteMulti:
+    case JobInfo::kReqMultipartComplete:
       return "text/xml";
     default:
       PANIC(NULL);
@@ -863,6 +925,8 @@ Failures S3FanoutManager::InitializeRequest(JobInfo *info, CURL *handle) const {
   info->throttle_ms = 0;
   info->throttle_timestamp = 0;
   info->http_headers = NULL;
+  info->response.clear();
+  info->etag.clear();
   // info->payload_size is needed in S3Uploader::MainCollectResults,
   // where info->origin is already destroyed.
   info->payload_size = info->origin->GetSize();
@@ -872,14 +936,16 @@ Failures S3FanoutManager::InitializeRequest(JobInfo *info, CURL *handle) const {
   CURLcode retval;
   if ((info->request == JobInfo::kReqHeadOnly) ||
       (info->request == JobInfo::kReqHeadPut) ||
-      (info->request == JobInfo::kReqDelete))
+      (info->request == JobInfo::kReqDelete) ||
+      (info->request == JobInfo::kReqMultipartAbort))
   {
     retval = curl_easy_setopt(handle, CURLOPT_UPLOAD, 0);
     assert(retval == CURLE_OK);
     retval = curl_easy_setopt(handle, CURLOPT_NOBODY, 1);
     assert(retval == CURLE_OK);
 
-    if (info->request == JobInfo::kReqDelete)
+    if ((info->request == JobInfo::kReqDelete) ||
+        (info->request == JobInfo::kReqMultipartAbort))
     {
       retval = curl_easy_setopt(handle, CURLOPT_CUSTOMREQUEST,
                                 GetRequestString(*info).c_str());
@@ -889,7 +955,10 @@ Failures S3FanoutManager::InitializeRequest(JobInfo *info, CURL *handle) const {
       assert(retval == CURLE_OK);
     }
   } else {
-    retval = curl_easy_setopt(handle, CURLOPT_CUSTOMREQUEST, NULL);
+    // Uploading with a custom request turns the PUT into a POST
+    const string request = GetRequestString(*info);
+    retval = curl_easy_setopt(handle, CURLOPT_CUSTOMREQUEST,
+      (request == "POST") ? request.c_str() : NULL);
     assert(retval == CURLE_OK);
     retval = curl_easy_setopt(handle, CURLOPT_UPLOAD, 1);
     assert(retval == CURLE_OK);
@@ -902,7 +971,9 @@ Failures S3FanoutManager::InitializeRequest(JobInfo *info, CURL *handle) const {
     if (info->request == JobInfo::kReqPutDotCvmfs) {
       info->http_headers =
           curl_slist_append(info->http_headers, kCacheControlDotCvmfs);
-    } else if (info->request == JobInfo::kReqPutCas) {
+    } else if ((info->request == JobInfo::kReqPutCas) ||
+               (info->request == JobInfo::kReqMultipartInit)) {
+      // Multipart uploads are only used for content-addressed objects
       info->http_headers =
           curl_slist_append(info->http_headers, kCacheControlCas);
     }
@@ -952,6 +1023,9 @@ Failures S3FanoutManager::InitializeRequest(JobInfo *info, CURL *handle) const {
   retval = curl_easy_setopt(handle, CURLOPT_READDATA,
                             static_cast<void *>(info));
   assert(retval == CURLE_OK);
+  retval = curl_easy_setopt(handle, CURLOPT_WRITEDATA,
+                            static_cast<void *>(info));
+  assert(retval == CURLE_OK);
   retval = curl_easy_setopt(handle, CURLOPT_HTTPHEADER, info->http_headers);
   assert(retval == CURLE_OK);
   if (opt_ipv4_only_) {
@@ -1124,6 +1198,18 @@ bool S3FanoutManager::VerifyAndFinalize(const int curl_error, JobInfo *info) {
       break;
   }
 
+  // Multi-object delete reports failed keys in the body of a 200 response,
+  // completing a multipart upload can fail after the 200 status was sent
+  if ((info->error_code == kFailOk) &&
+      ((info->request == JobInfo::kReqDeleteMulti) ||
+       (info->request == JobInfo::kReqMultipartComplete)) &&
+      (info->response.find("<Error>") != string::npos))
+  {
+    LogCvmfs(kLogS3Fanout, kLogStderr, "S3: request for %s failed: %s",
+             info->object_key.c_str(), info->response.c_str());
+    info->error_code = kFailOther;
+  }
+
   // Transform HEAD to PUT request
   if ((info->error_code == kFailNotFound) &&
       (info->request == JobInfo::kReqHeadPut))
@@ -1156,7 +1242,10 @@ bool S3FanoutManager::VerifyAndFinalize(const int curl_error, JobInfo *info) {
   if (try_again) {
     if (info->request == JobInfo::kReqPutCas ||
         info->request == JobInfo::kReqPutDotCvmfs ||
-        info->request == JobInfo::kReqPutHtml) {
+        info->request == JobInfo::kReqPutHtml ||
+        info->request == JobInfo::kReqDeleteMulti ||
+        info->request == JobInfo::kReqMultipartPart ||
+        info->request == JobInfo::kReqMultipartComplete) {
       LogCvmfs(kLogS3Fanout, kLogDebug, "Trying again to upload %s",
                info->object_key.c_str());
       // Reset origin
@@ -1165,6 +1254,8 @@ bool S3FanoutManager::VerifyAndFinalize(const int curl_error, JobInfo *info) {
     Backoff(info);
     info->error_code = kFailOk;
     info->http_error = 0;
+    info->response.clear();
+    info->etag.clear();
     info->throttle_ms = 0;
     info->backoff_ms = 0;
     info->throttle_timestamp = 0;
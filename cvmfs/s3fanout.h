@@ -103,11 +103,19 @@ struct JobInfo : SingleCopy {
     kReqPutHtml,  // HTML file - display instead of downloading
     kReqPutBucket,  // bucket creation
     kReqDelete,
+    kReqDeleteMulti,  // multi-object delete, the keys are listed in origin
+    kReqMultipartInit,  // the upload id is returned in the response body
+    kReqMultipartPart,  // one part of a multipart upload, returns an ETag
+    kReqMultipartComplete,  // the part numbers and ETags are listed in origin
+    kReqMultipartAbort,
   };
 
   const std::string object_key;
   void *callback;  // Callback to be called when job is finished
   UniquePtr<FileBackedBuffer> origin;
+  // Opaque state of the caller, e.g. the multipart upload a part belongs to
+  void *context;
+  unsigned part_number;  // Only for kReqMultipartPart, starts at 1
 
   // One constructor per destination
   JobInfo(
@@ -124,6 +132,8 @@ struct JobInfo : SingleCopy {
     curl_handle = NULL;
     http_headers = NULL;
     callback = NULL;
+    context = NULL;
+    part_number = 0;
     request = kReqPutCas;
     error_code = kFailOk;
     http_error = 0;
@@ -145,6 +155,10 @@ struct JobInfo : SingleCopy {
   RequestType request;
   Failures error_code;
   int http_error;
+  // Response body, only kept for multi-object delete and multipart requests
+  std::string response;
+  // ETag of an uploaded part, needed to complete the multipart upload
+  std::string etag;
   unsigned char num_retries;
   // Exponential backoff with cutoff in case of errors
   unsigned backoff_ms;
@@ -232,6 +232,10 @@ cvmfs_server_publish() {
        -a $CVMFS_AVG_CHUNK_SIZE \
        -h $CVMFS_MAX_CHUNK_SIZE"
     fi
+    if [ "x$CVMFS_USE_FILE_CHUNKING" = "xtrue" ] && \
+       [ "x$CVMFS_CHUNKING_ALGORITHM" != "x" ]; then
+      sync_command="$sync_command -G $CVMFS_CHUNKING_ALGORITHM"
+    fi
     if [ "x$CVMFS_AUTOCATALOGS" = "xtrue" ]; then
       sync_command="$sync_command -A"
     fi
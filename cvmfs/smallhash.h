@@ -15,9 +15,14 @@
 #include <pthread.h>
 #include <stdint.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include <algorithm>
 #include <cassert>
 #include <cstdlib>
+#include <cstring>
 #include <new>
 
 #include "util/atomic.h"
@@ -29,6 +34,15 @@
  * Hash table with linear probing as collision resolution.  Works only for
  * a fixed (maximum) number of elements, i.e. no resizing.  Load factor fixed
  * to 0.7.
+ *
+ * If Derived::kTagged is set, the table keeps one tag byte per bucket behind
+ * the keys, in the same memory block.  A tag is 0 for an empty bucket and
+ * otherwise has the highest bit set plus 7 bits of the key's hash.  Lookups
+ * then compare the tags of 16 buckets at once (SSE2) and touch only the keys
+ * whose tag matches, which keeps long collision chains cheap at high load
+ * factors.  The probe sequence is still linear, so the layout of keys and
+ * values and the enumeration through keys() do not change.  The memory layout
+ * of the object itself is the same for both variants.
  */
 template<class Key, class Value, class Derived>
 class SmallHashBase {
@@ -38,6 +52,7 @@ class SmallHashBase {
   static const double kLoadFactor;  // mainly useless for the dynamic version
   static const double kThresholdGrow;  // only used for resizable version
   static const double kThresholdShrink;  // only used for resizable version
+  static const uint32_t kTagGroup = 16;  // only used for tagged version
 
   SmallHashBase() {
     keys_ = NULL;
@@ -87,16 +102,14 @@ class SmallHashBase {
    * Used to return a glue::InodeEx element when looking for an inode.
    */
   bool LookupEx(Key *key, Value *value) const {
-    uint32_t bucket = ScaleHash(*key);
-    while (!(keys_[bucket] == empty_key_)) {
-      if (keys_[bucket] == *key) {
-        *key = keys_[bucket];
-        *value = values_[bucket];
-        return true;
-      }
-      bucket = (bucket + 1) % capacity_;
+    uint32_t bucket;
+    uint32_t collisions;
+    const bool found = DoLookup(*key, &bucket, &collisions);
+    if (found) {
+      *key = keys_[bucket];
+      *value = values_[bucket];
     }
-    return false;
+    return found;
   }
 
   bool Contains(const Key &key) const {
@@ -118,11 +131,13 @@ class SmallHashBase {
     const bool found = DoLookup(key, &bucket, &collisions);
     if (found) {
       keys_[bucket] = empty_key_;
+      SetTag(bucket, 0);
       size_--;
       bucket = (bucket+1) % capacity_;
       while (!(keys_[bucket] == empty_key_)) {
         Key rehash = keys_[bucket];
         keys_[bucket] = empty_key_;
+        SetTag(bucket, 0);
         DoInsert(rehash, values_[bucket], false);
         bucket = (bucket+1) % capacity_;
       }
@@ -137,7 +152,8 @@ class SmallHashBase {
 
   uint64_t bytes_allocated() const { return bytes_allocated_; }
   static double GetEntrySize() {
-    const double unit = sizeof(Key) + sizeof(Value);
+    const double unit =
+      sizeof(Key) + sizeof(Value) + (Derived::kTagged ? 1 : 0);
     return unit/kLoadFactor;
   }
 
@@ -161,14 +177,37 @@ class SmallHashBase {
 
  protected:
   uint32_t ScaleHash(const Key &key) const {
+    return ScaleHashValue(hasher_(key));
+  }
+
+  uint32_t ScaleHashValue(const uint32_t hash) const {
     double bucket =
-      (static_cast<double>(hasher_(key)) * static_cast<double>(capacity_) /
+      (static_cast<double>(hash) * static_cast<double>(capacity_) /
       static_cast<double>(static_cast<uint32_t>(-1)));
     return static_cast<uint32_t>(bucket) % capacity_;
   }
 
+  // The first kTagGroup - 1 tags are mirrored behind the last bucket so that
+  // a group load never needs to wrap around
+  static uint32_t GetTagBytes(const uint32_t capacity) {
+    return Derived::kTagged ? capacity + kTagGroup : 0;
+  }
+  uint8_t *tags() const {
+    return reinterpret_cast<uint8_t *>(keys_ + capacity_);
+  }
+  static uint8_t MakeTag(const uint32_t hash) { return 0x80 | (hash & 0x7f); }
+
+  void SetTag(const uint32_t bucket, const uint8_t tag) {
+    if (!Derived::kTagged)
+      return;
+    tags()[bucket] = tag;
+    if (bucket < kTagGroup - 1)
+      tags()[capacity_ + bucket] = tag;
+  }
+
   void AllocMemory() {
-    keys_ = static_cast<Key *>(smmap(capacity_ * sizeof(Key)));
+    keys_ = static_cast<Key *>(
+      smmap(capacity_ * sizeof(Key) + GetTagBytes(capacity_)));
     values_ = static_cast<Value *>(smmap(capacity_ * sizeof(Value)));
     for (uint32_t i = 0; i < capacity_; ++i) {
       /*keys_[i] =*/ new (keys_ + i) Key();
@@ -176,7 +215,8 @@ class SmallHashBase {
     for (uint32_t i = 0; i < capacity_; ++i) {
       /*values_[i] =*/ new (values_ + i) Value();
     }
-    bytes_allocated_ = (sizeof(Key) + sizeof(Value)) * capacity_;
+    bytes_allocated_ =
+      (sizeof(Key) + sizeof(Value)) * capacity_ + GetTagBytes(capacity_);
   }
 
   void DeallocMemory(Key *k, Value *v, uint32_t c) {
@@ -198,17 +238,26 @@ class SmallHashBase {
   {
     uint32_t bucket;
     uint32_t collisions;
-    const bool overwritten = DoLookup(key, &bucket, &collisions);
+    uint8_t tag = 0;
+    const bool overwritten = Derived::kTagged ?
+      DoLookupTagged(key, &bucket, &collisions, &tag) :
+      DoLookup(key, &bucket, &collisions);
     if (count_collisions) {
       num_collisions_ += collisions;
       max_collisions_ = std::max(collisions, max_collisions_);
     }
     keys_[bucket] = key;
     values_[bucket] = value;
+    SetTag(bucket, tag);
     return overwritten;
   }
 
   bool DoLookup(const Key &key, uint32_t *bucket, uint32_t *collisions) const {
+    if (Derived::kTagged) {
+      uint8_t tag;
+      return DoLookupTagged(key, bucket, collisions, &tag);
+    }
+
     *bucket = ScaleHash(key);
     *collisions = 0;
     while (!(keys_[*bucket] == empty_key_)) {
@@ -220,11 +269,74 @@ class SmallHashBase {
     return false;
   }
 
+  /**
+   * Same probe sequence as DoLookup but only keys with a matching tag are
+   * compared.  Also returns the tag of the key for DoInsert.
+   */
+  bool DoLookupTagged(const Key &key, uint32_t *bucket, uint32_t *collisions,
+                      uint8_t *tag) const
+  {
+    const uint32_t hash = hasher_(key);
+    *tag = MakeTag(hash);
+    *bucket = ScaleHashValue(hash);
+    *collisions = 0;
+    const uint8_t *t = tags();
+    // The first candidate key is usually in the start bucket; load its cache
+    // line while the tags are compared
+    __builtin_prefetch(keys_ + *bucket);
+#ifdef __SSE2__
+    if (capacity_ >= kTagGroup) {
+      const __m128i tag_group = _mm_set1_epi8(static_cast<char>(*tag));
+      const __m128i empty_group = _mm_setzero_si128();
+      while (true) {
+        const __m128i group =
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(t + *bucket));
+        const uint32_t mask_empty =
+          _mm_movemask_epi8(_mm_cmpeq_epi8(group, empty_group));
+        uint32_t mask_match =
+          _mm_movemask_epi8(_mm_cmpeq_epi8(group, tag_group));
+        // Buckets behind the first empty one are not part of the probe
+        if (mask_empty != 0)
+          mask_match &= (mask_empty & (~mask_empty + 1)) - 1;
+        while (mask_match != 0) {
+          const uint32_t offset = __builtin_ctz(mask_match);
+          uint32_t candidate = *bucket + offset;
+          if (candidate >= capacity_)
+            candidate -= capacity_;
+          if (keys_[candidate] == key) {
+            *bucket = candidate;
+            *collisions += offset;
+            return true;
+          }
+          mask_match &= mask_match - 1;
+        }
+        if (mask_empty != 0) {
+          const uint32_t offset = __builtin_ctz(mask_empty);
+          *bucket = (*bucket + offset) % capacity_;
+          *collisions += offset;
+          return false;
+        }
+        *bucket = (*bucket + kTagGroup) % capacity_;
+        *collisions += kTagGroup;
+      }
+    }
+#endif
+    while (t[*bucket] != 0) {
+      if ((t[*bucket] == *tag) && (keys_[*bucket] == key))
+        return true;
+      *bucket = (*bucket+1) % capacity_;
+      (*collisions)++;
+    }
+    return false;
+  }
+
   void DoClear(const bool reset_capacity) {
     if (reset_capacity)
       static_cast<Derived *>(this)->ResetCapacity();  // No-op if fixed-size
     for (uint32_t i = 0; i < capacity_; ++i)
       keys_[i] = empty_key_;
+    if (Derived::kTagged)
+      memset(tags(), 0, GetTagBytes(capacity_));
     size_ = 0;
   }
 
@@ -248,11 +360,17 @@ class SmallHashBase {
 };
 
 
-template<class Key, class Value>
+/**
+ * With Tagged set, lookups use the tag bytes described in SmallHashBase.
+ */
+template<class Key, class Value, bool Tagged = false>
 class SmallHashFixed :
-  public SmallHashBase< Key, Value, SmallHashFixed<Key, Value> >
+  public SmallHashBase< Key, Value, SmallHashFixed<Key, Value, Tagged> >
 {
-  friend class SmallHashBase< Key, Value, SmallHashFixed<Key, Value> >;
+  friend class SmallHashBase< Key, Value, SmallHashFixed<Key, Value, Tagged> >;
+ public:
+  static const bool kTagged = Tagged;
+
  protected:
   // No-ops
   void SetThresholds() { }
@@ -262,15 +380,21 @@ class SmallHashFixed :
 };
 
 
-template<class Key, class Value>
+/**
+ * With Tagged set, lookups use the tag bytes described in SmallHashBase.
+ */
+template<class Key, class Value, bool Tagged = false>
 class SmallHashDynamic :
-  public SmallHashBase< Key, Value, SmallHashDynamic<Key, Value> >
+  public SmallHashBase< Key, Value, SmallHashDynamic<Key, Value, Tagged> >
 {
-  friend class SmallHashBase< Key, Value, SmallHashDynamic<Key, Value> >;
+  friend class
+    SmallHashBase< Key, Value, SmallHashDynamic<Key, Value, Tagged> >;
  public:
-  typedef SmallHashBase< Key, Value, SmallHashDynamic<Key, Value> > Base;
+  typedef SmallHashBase< Key, Value, SmallHashDynamic<Key, Value, Tagged> >
+    Base;
   static const double kThresholdGrow;
   static const double kThresholdShrink;
+  static const bool kTagged = Tagged;
 
   SmallHashDynamic() : Base() {
     num_migrates_ = 0;
@@ -280,14 +404,14 @@ class SmallHashDynamic :
     threshold_shrink_ = 0;
   }
 
-  SmallHashDynamic(const SmallHashDynamic<Key, Value> &other) : Base()
+  SmallHashDynamic(const SmallHashDynamic<Key, Value, Tagged> &other) : Base()
   {
     num_migrates_ = 0;
     CopyFrom(other);
   }
 
-  SmallHashDynamic<Key, Value> &operator= (
-    const SmallHashDynamic<Key, Value> &other)
+  SmallHashDynamic<Key, Value, Tagged> &operator= (
+    const SmallHashDynamic<Key, Value, Tagged> &other)
   {
     if (&other == this)
       return *this;
@@ -378,7 +502,7 @@ class SmallHashDynamic :
     num_migrates_++;
   }
 
-  void CopyFrom(const SmallHashDynamic<Key, Value> &other) {
+  void CopyFrom(const SmallHashDynamic<Key, Value, Tagged> &other) {
     uint32_t *shuffled_indices = ShuffleIndices(other.capacity_);
     for (uint32_t i = 0; i < other.capacity_; ++i) {
       if (other.keys_[shuffled_indices[i]] != other.empty_key_) {
@@ -508,16 +632,16 @@ class MultiHash {
 
 
 // initialize the static fields
-template<class Key, class Value>
-Prng SmallHashDynamic<Key, Value>::g_prng;
+template<class Key, class Value, bool Tagged>
+Prng SmallHashDynamic<Key, Value, Tagged>::g_prng;
 
 template<class Key, class Value, class Derived>
 const double SmallHashBase<Key, Value, Derived>::kLoadFactor = 0.75;
 
-template<class Key, class Value>
-const double SmallHashDynamic<Key, Value>::kThresholdGrow = 0.75;
+template<class Key, class Value, bool Tagged>
+const double SmallHashDynamic<Key, Value, Tagged>::kThresholdGrow = 0.75;
 
-template<class Key, class Value>
-const double SmallHashDynamic<Key, Value>::kThresholdShrink = 0.25;
+template<class Key, class Value, bool Tagged>
+const double SmallHashDynamic<Key, Value, Tagged>::kThresholdShrink = 0.25;
 
 #endif  // CVMFS_SMALLHASH_H_
@@ -103,6 +103,11 @@ class Database : SingleCopy {
   };
 
   static const float kSchemaEpsilon;  // floats get imprecise in SQlite
+  /**
+   * Upper bound for memory mapped I/O of read-only databases that are opened
+   * through the cvmfs-readonly VFS, i.e. client file catalogs
+   */
+  static const uint64_t kMaxMmapSize;
 
   /**
    * Creates a new database file of the type implemented by DerivedT. During the
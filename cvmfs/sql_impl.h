@@ -14,6 +14,7 @@
 #include "sqlitemem.h"
 #include "util/logging.h"
 #include "util/platform.h"
+#include "util/string.h"
 
 namespace sqlite {
 
@@ -192,6 +193,15 @@ bool Database<DerivedT>::Configure() {
         SqliteMemoryManager::GetInstance()->AssignLookasideBuffer(sqlite_db());
     }
 
+    // Databases given as '@<file descriptor>' are served by the read-only
+    // VFS, which can hand out pages directly from a mapping of the cache
+    if ((filename()[0] == '@') &&
+        !Sql(sqlite_db(), "PRAGMA mmap_size=" +
+                          StringifyUint(kMaxMmapSize) + ";").Execute())
+    {
+      return false;
+    }
+
     return Sql(sqlite_db() , "PRAGMA temp_store=2;").Execute() &&
            Sql(sqlite_db() , "PRAGMA locking_mode=EXCLUSIVE;").Execute();
   }
@@ -433,6 +443,8 @@ void Database<DerivedT>::PrintSqlError(const std::string &error_msg) {
 template <class DerivedT>
 const float Database<DerivedT>::kSchemaEpsilon = 0.0005;
 template <class DerivedT>
+const uint64_t Database<DerivedT>::kMaxMmapSize = 1024 * 1024 * 1024;
+template <class DerivedT>
 const char *Database<DerivedT>::kSchemaVersionKey = "schema";
 template <class DerivedT>
 const char *Database<DerivedT>::kSchemaRevisionKey = "schema_revision";
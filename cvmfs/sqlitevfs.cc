@@ -59,6 +59,7 @@ struct VfsRdOnly {
     , sz_rand(NULL)
     , n_read(NULL)
     , sz_read(NULL)
+    , n_fetch(NULL)
     , n_sleep(NULL)
     , sz_sleep(NULL)
     , n_time(NULL)
@@ -70,6 +71,7 @@ struct VfsRdOnly {
   perf::Counter *sz_rand;
   perf::Counter *n_read;
   perf::Counter *sz_read;
+  perf::Counter *n_fetch;
   perf::Counter *n_sleep;
   perf::Counter *sz_sleep;
   perf::Counter *n_time;
@@ -83,6 +85,11 @@ struct VfsRdOnlyFile {
   VfsRdOnly *vfs_rdonly;
   int fd;
   uint64_t size;
+  /**
+   * Read-only mapping of the entire file if the cache manager supports it,
+   * NULL otherwise.  Independent of fd, so it survives the fd remapping.
+   */
+  void *mapping;
 };
 
 /**
@@ -111,6 +118,8 @@ static void ApplyFdMap(VfsRdOnlyFile *pFile) {
 static int VfsRdOnlyClose(sqlite3_file *pFile) {
   VfsRdOnlyFile *p = reinterpret_cast<VfsRdOnlyFile *>(pFile);
   ApplyFdMap(p);
+  if (p->mapping != NULL)
+    p->vfs_rdonly->cache_mgr->Munmap(p->mapping, p->size);
   int retval = p->vfs_rdonly->cache_mgr->Close(p->fd);
   if (retval == 0) {
     perf::Dec(p->vfs_rdonly->no_open);
@@ -147,6 +156,44 @@ static int VfsRdOnlyRead(
 }
 
 
+/**
+ * Used by SQlite instead of VfsRdOnlyRead if memory mapped I/O is enabled for
+ * the database connection (PRAGMA mmap_size).  Pages are handed out directly
+ * from the mapping of the cached file.  Without a mapping, *pp remains NULL
+ * and SQlite falls back to VfsRdOnlyRead.
+ */
+static int VfsRdOnlyFetch(
+  sqlite3_file *pFile,
+  sqlite_int64 iOfst,
+  int iAmt,
+  void **pp)
+{
+  VfsRdOnlyFile *p = reinterpret_cast<VfsRdOnlyFile *>(pFile);
+  *pp = NULL;
+  if ((p->mapping == NULL) ||
+      (static_cast<uint64_t>(iOfst) + iAmt > p->size))
+  {
+    return SQLITE_OK;
+  }
+  *pp = reinterpret_cast<char *>(p->mapping) + iOfst;
+  perf::Inc(p->vfs_rdonly->n_fetch);
+  return SQLITE_OK;
+}
+
+
+/**
+ * The mapping covers the entire file and lives until VfsRdOnlyClose, so
+ * there is nothing to release per page.
+ */
+static int VfsRdOnlyUnfetch(
+  sqlite3_file *pFile __attribute__((unused)),
+  sqlite_int64 iOfst __attribute__((unused)),
+  void *p __attribute__((unused)))
+{
+  return SQLITE_OK;
+}
+
+
 static int VfsRdOnlyWrite(
   sqlite3_file *pFile __attribute__((unused)),
   const void *zBuf __attribute__((unused)),
@@ -247,7 +294,7 @@ static int VfsRdOnlyOpen(
   int *pOutFlags)
 {
   static const sqlite3_io_methods io_methods = {
-    1,  // iVersion
+    3,  // iVersion
     VfsRdOnlyClose,
     VfsRdOnlyRead,
     VfsRdOnlyWrite,
@@ -259,7 +306,13 @@ static int VfsRdOnlyOpen(
     VfsRdOnlyCheckReservedLock,
     VfsRdOnlyFileControl,
     VfsRdOnlySectorSize,
-    VfsRdOnlyDeviceCharacteristics
+    VfsRdOnlyDeviceCharacteristics,
+    NULL,  // xShmMap, r/o catalogs never use write-ahead logs
+    NULL,  // xShmLock
+    NULL,  // xShmBarrier
+    NULL,  // xShmUnmap
+    VfsRdOnlyFetch,
+    VfsRdOnlyUnfetch
   };
 
   VfsRdOnlyFile *p = reinterpret_cast<VfsRdOnlyFile *>(pFile);
@@ -267,18 +320,22 @@ static int VfsRdOnlyOpen(
     reinterpret_cast<VfsRdOnly *>(vfs->pAppData)->cache_mgr;
   // Prevent xClose from being called in case of errors
   p->base.pMethods = NULL;
+  p->mapping = NULL;
 
-  if (flags & SQLITE_OPEN_READWRITE)
-    return SQLITE_IOERR;
-  if (flags & SQLITE_OPEN_DELETEONCLOSE)
-    return SQLITE_IOERR;
-  if (flags & SQLITE_OPEN_EXCLUSIVE)
-    return SQLITE_IOERR;
-
+  // The file descriptor is owned by the vfs from here on; it is closed on
+  // every error path so that callers never need to clean up after a failed
+  // open
   assert(zName && (zName[0] == '@'));
   p->fd = String2Int64(string(&zName[1]));
   if (p->fd < 0)
     return SQLITE_IOERR;
+  if (flags & (SQLITE_OPEN_READWRITE | SQLITE_OPEN_DELETEONCLOSE |
+               SQLITE_OPEN_EXCLUSIVE))
+  {
+    cache_mgr->Close(p->fd);
+    p->fd = -1;
+    return SQLITE_IOERR;
+  }
   int64_t size = cache_mgr->GetSize(p->fd);
   if (size < 0) {
     cache_mgr->Close(p->fd);
@@ -291,13 +348,15 @@ static int VfsRdOnlyOpen(
     return SQLITE_IOERR;
   }
   p->size = static_cast<uint64_t>(size);
+  p->mapping = cache_mgr->Mmap(p->fd, p->size);
   if (pOutFlags)
     *pOutFlags = flags;
   p->vfs_rdonly = reinterpret_cast<VfsRdOnly *>(vfs->pAppData);
   p->base.pMethods = &io_methods;
   perf::Inc(p->vfs_rdonly->no_open);
-  LogCvmfs(kLogSql, kLogDebug, "open sqlite3 catalog on fd %d, size %" PRIu64,
-           p->fd, p->size);
+  LogCvmfs(kLogSql, kLogDebug,
+           "open sqlite3 catalog on fd %d, size %" PRIu64 ", mapped: %s",
+           p->fd, p->size, (p->mapping != NULL) ? "yes" : "no");
   return SQLITE_OK;
 }
 
@@ -504,6 +563,9 @@ bool RegisterVfsRdOnly(
     statistics->Register("sqlite.n_read", "overall number of read() calls");
   vfs_rdonly->sz_read =
     statistics->Register("sqlite.sz_read", "overall bytes read()");
+  vfs_rdonly->n_fetch =
+    statistics->Register("sqlite.n_fetch",
+                         "overall number of memory mapped page reads");
   vfs_rdonly->n_sleep =
     statistics->Register("sqlite.n_sleep", "overall number of sleep() calls");
   vfs_rdonly->sz_sleep =
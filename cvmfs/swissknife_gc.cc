@@ -24,7 +24,7 @@ namespace swissknife {
 
 typedef HttpObjectFetcher<> ObjectFetcher;
 typedef CatalogTraversalParallel<ObjectFetcher> ReadonlyCatalogTraversal;
-typedef SmallhashFilter HashFilter;
+typedef BloomHashFilter HashFilter;
 typedef GarbageCollector<ReadonlyCatalogTraversal, HashFilter> GC;
 typedef GarbageCollectorAux<ReadonlyCatalogTraversal, HashFilter> GCAux;
 typedef GC::Configuration GcConfig;
@@ -129,7 +129,9 @@ int CommandGc::Main(const ArgumentList &args) {
   reflog = FetchReflog(&object_fetcher, repo_name, reflog_hash);
   assert(reflog.IsValid());
 
-  const upload::SpoolerDefinition spooler_definition(spooler, shash::kAny);
+  upload::SpoolerDefinition spooler_definition(spooler, shash::kAny);
+  // Backends without bulk deletion remove condemned objects in the upload tasks
+  spooler_definition.num_upload_tasks = num_threads;
   UniquePtr<upload::AbstractUploader> uploader(
                        upload::AbstractUploader::Construct(spooler_definition));
 
@@ -18,8 +18,13 @@
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <cerrno>
 #include <cstdlib>
 #include <cstring>
+#include <deque>
+#include <map>
+#include <set>
 #include <string>
 #include <vector>
 
@@ -28,19 +33,29 @@
 #include "crypto/hash.h"
 #include "crypto/signature.h"
 #include "download.h"
+#include "file_chunk.h"
 #include "history_sqlite.h"
+#include "ingestion/ingestion_source.h"
 #include "manifest.h"
 #include "manifest_fetch.h"
 #include "object_fetcher.h"
 #include "path_filters/relaxed_path_filter.h"
 #include "reflog.h"
+#include "sink.h"
+#include "statistics.h"
+#include "swissknife_pull_diff.h"
+#include "swissknife_pull_sink.h"
 #include "upload.h"
 #include "util/atomic.h"
 #include "util/concurrency.h"
 #include "util/exception.h"
 #include "util/logging.h"
+#include "util/platform.h"
+#include "util/pointer.h"
 #include "util/posix.h"
+#include "util/raii_temp_dir.h"
 #include "util/shared_ptr.h"
+#include "util/single_copy.h"
 #include "util/smalloc.h"
 #include "util/string.h"
 
@@ -52,6 +67,21 @@ namespace {
 
 typedef HttpObjectFetcher<> ObjectFetcher;
 
+/**
+ * Tracks the chunks of a catalog that are handed to the workers.  Pull() moves
+ * on to the nested catalogs while the workers are still busy and only waits
+ * for the chunks before it stores the catalog itself, so that a catalog is
+ * never present on the Stratum 1 without its chunks.
+ */
+struct CatalogChunks {
+  CatalogChunks() {
+    atomic_init64(&pending);
+    atomic_init64(&fetched);
+  }
+  atomic_int64 pending;
+  atomic_int64 fetched;
+};
+
 /**
  * This just stores an shash::Any in a predictable way to send it through a
  * POSIX pipe.
@@ -61,12 +91,15 @@ class ChunkJob {
   ChunkJob()
     : suffix(shash::kSuffixNone)
     , hash_algorithm(shash::kAny)
-    , compression_alg(zlib::kZlibDefault) {}
+    , compression_alg(zlib::kZlibDefault)
+    , catalog_chunks(NULL) {}
 
-  ChunkJob(const shash::Any &hash, zlib::Algorithms compression_alg)
+  ChunkJob(const shash::Any &hash, zlib::Algorithms compression_alg,
+           CatalogChunks *catalog_chunks)
     : suffix(hash.suffix)
     , hash_algorithm(hash.algorithm)
     , compression_alg(compression_alg)
+    , catalog_chunks(catalog_chunks)
   {
     memcpy(digest, hash.digest, hash.GetDigestSize());
   }
@@ -85,11 +118,25 @@ class ChunkJob {
   const shash::Suffix      suffix;
   const shash::Algorithms  hash_algorithm;
   const zlib::Algorithms   compression_alg;
+  CatalogChunks * const    catalog_chunks;
   unsigned char            digest[shash::kMaxDigestSize];
 };
 
+/**
+ * Objects uploaded from memory carry this prefix instead of a local path.
+ */
+const char *kMemoryObjectPrefix = "memory:";
+
+/**
+ * Written to the Stratum 1 after a pull that replicated all objects of the
+ * root catalog it contains.  Only such a revision is a safe base for the
+ * catalog diff of the next pull.
+ */
+const char *kFullReplicaMarker = ".cvmfs_full_replica";
+
 static void SpoolerOnUpload(const upload::SpoolerResult &result) {
-  unlink(result.local_path.c_str());
+  if (!HasPrefix(result.local_path, kMemoryObjectPrefix, false))
+    unlink(result.local_path.c_str());
   if (result.return_code != 0) {
     PANIC(kLogStderr, "spooler failure %d (%s, hash: %s)", result.return_code,
           result.local_path.c_str(), result.content_hash.ToString().c_str());
@@ -113,12 +160,257 @@ unsigned             retries = 3;
 catalog::RelaxedPathFilter   *pathfilter = NULL;
 atomic_int64         overall_chunks;
 atomic_int64         overall_new;
-atomic_int64         chunk_queue;
+uint64_t             max_inflight_bytes = 256 * 1024 * 1024;
+ObjectSink::Budget  *inflight_budget = NULL;
 bool                 preload_cache = false;
 string              *preload_cachedir = NULL;
 bool                 inspect_existing_catalogs = false;
 manifest::Reflog    *reflog = NULL;
 
+
+/**
+ * Per-stage counters of the replication.  The time counters sum up the time
+ * that the threads of a stage spent on it.
+ */
+struct PullCounters {
+  explicit PullCounters(perf::StatisticsTemplate statistics) {
+    n_catalogs = statistics.RegisterTemplated("n_catalogs",
+      "Number of downloaded catalogs");
+    n_catalogs_prefetched = statistics.RegisterTemplated(
+      "n_catalogs_prefetched",
+      "Number of catalogs downloaded ahead of the traversal");
+    sz_catalog_bytes = statistics.RegisterTemplated("sz_catalog_bytes",
+      "Number of downloaded catalog bytes");
+    sz_catalog_time_ms = statistics.RegisterTemplated("sz_catalog_time_ms",
+      "Time spent on downloading catalogs");
+    n_chunks_fetched = statistics.RegisterTemplated("n_chunks_fetched",
+      "Number of downloaded chunks");
+    sz_fetched_bytes = statistics.RegisterTemplated("sz_fetched_bytes",
+      "Number of downloaded chunk bytes");
+    sz_fetch_time_ms = statistics.RegisterTemplated("sz_fetch_time_ms",
+      "Time spent on downloading chunks");
+    n_chunks_spilled = statistics.RegisterTemplated("n_chunks_spilled",
+      "Number of chunks staged in a temporary file instead of memory");
+    sz_store_time_ms = statistics.RegisterTemplated("sz_store_time_ms",
+      "Time spent on handing chunks to the spooler");
+  }
+
+  perf::Counter *n_catalogs;
+  perf::Counter *n_catalogs_prefetched;
+  perf::Counter *sz_catalog_bytes;
+  perf::Counter *sz_catalog_time_ms;
+  perf::Counter *n_chunks_fetched;
+  perf::Counter *sz_fetched_bytes;
+  perf::Counter *sz_fetch_time_ms;
+  perf::Counter *n_chunks_spilled;
+  perf::Counter *sz_store_time_ms;
+};
+
+PullCounters        *counters = NULL;
+const unsigned       kMaxCatalogPrefetchers = 4;
+
+
+/**
+ * Downloads nested catalogs ahead of the depth-first traversal in Pull(), so
+ * that the catalog transfers overlap with the chunk transfers of the catalogs
+ * before them.  Prefetching is only an optimization: if a catalog is not yet
+ * being downloaded or if its download failed, Pull() takes the download back
+ * and fetches the catalog itself.  The number of downloaded catalogs that wait
+ * to be picked up is bounded.
+ */
+class CatalogPrefetcher : SingleCopy {
+ public:
+  CatalogPrefetcher(download::DownloadManager *download_manager,
+                    const unsigned num_threads)
+    : download_manager_(download_manager)
+    , max_ready_(2 * num_threads)
+    , num_ready_(0)
+    , terminate_(false)
+  {
+    int retval = pthread_mutex_init(&lock_, NULL);
+    assert(retval == 0);
+    retval = pthread_cond_init(&cond_, NULL);
+    assert(retval == 0);
+    threads_.resize(num_threads);
+    for (unsigned i = 0; i < num_threads; ++i) {
+      retval = pthread_create(&threads_[i], NULL, MainPrefetch, this);
+      assert(retval == 0);
+    }
+  }
+
+  ~CatalogPrefetcher() {
+    {
+      MutexLockGuard guard(&lock_);
+      terminate_ = true;
+      pthread_cond_broadcast(&cond_);
+    }
+    for (unsigned i = 0; i < threads_.size(); ++i)
+      pthread_join(threads_[i], NULL);
+    for (EntryMap::const_iterator i = entries_.begin(), iEnd = entries_.end();
+         i != iEnd; ++i)
+    {
+      if (i->second.state == kStateDone)
+        unlink(i->second.path.c_str());
+    }
+    pthread_cond_destroy(&cond_);
+    pthread_mutex_destroy(&lock_);
+  }
+
+  void Schedule(const shash::Any &catalog_hash) {
+    MutexLockGuard guard(&lock_);
+    if (entries_.find(catalog_hash) != entries_.end())
+      return;
+    entries_[catalog_hash] = Entry();
+    queue_.push_back(catalog_hash);
+    pthread_cond_broadcast(&cond_);
+  }
+
+  /**
+   * Returns true if the catalog has been downloaded into path.  Waits for
+   * downloads that are in progress.  Otherwise the catalog is removed from
+   * the prefetch queue and the caller has to download it.
+   */
+  bool Claim(const shash::Any &catalog_hash, std::string *path) {
+    MutexLockGuard guard(&lock_);
+    EntryMap::iterator entry = entries_.find(catalog_hash);
+    if (entry == entries_.end())
+      return false;
+    while (entry->second.state == kStateRunning)
+      pthread_cond_wait(&cond_, &lock_);
+
+    bool result = false;
+    switch (entry->second.state) {
+      case kStateQueued:
+        queue_.erase(std::find(queue_.begin(), queue_.end(), catalog_hash));
+        break;
+      case kStateDone:
+        *path = entry->second.path;
+        num_ready_--;
+        pthread_cond_broadcast(&cond_);
+        result = true;
+        break;
+      default:
+        break;
+    }
+    entries_.erase(entry);
+    return result;
+  }
+
+ private:
+  enum State {
+    kStateQueued,
+    kStateRunning,
+    kStateDone,
+    kStateFailed
+  };
+
+  struct Entry {
+    Entry() : state(kStateQueued) { }
+    State state;
+    std::string path;
+  };
+  typedef std::map<shash::Any, Entry> EntryMap;
+
+  static void *MainPrefetch(void *data) {
+    CatalogPrefetcher *prefetcher = reinterpret_cast<CatalogPrefetcher *>(data);
+    MutexLockGuard guard(&prefetcher->lock_);
+    while (true) {
+      while (!prefetcher->terminate_ &&
+             (prefetcher->queue_.empty() ||
+              (prefetcher->num_ready_ >= prefetcher->max_ready_)))
+      {
+        pthread_cond_wait(&prefetcher->cond_, &prefetcher->lock_);
+      }
+      if (prefetcher->terminate_)
+        break;
+
+      const shash::Any catalog_hash = prefetcher->queue_.front();
+      prefetcher->queue_.pop_front();
+      prefetcher->entries_[catalog_hash].state = kStateRunning;
+      std::string path;
+      pthread_mutex_unlock(&prefetcher->lock_);
+      const bool retval = prefetcher->Download(catalog_hash, &path);
+      pthread_mutex_lock(&prefetcher->lock_);
+
+      Entry *entry = &prefetcher->entries_[catalog_hash];
+      entry->state = retval ? kStateDone : kStateFailed;
+      entry->path = path;
+      if (retval)
+        prefetcher->num_ready_++;
+      pthread_cond_broadcast(&prefetcher->cond_);
+    }
+    return NULL;
+  }
+
+  bool Download(const shash::Any &catalog_hash, std::string *path) {
+    FILE *fcatalog = CreateTempFile(*temp_dir + "/cvmfs", 0600, "w", path);
+    if (fcatalog == NULL)
+      return false;
+    const std::string url = *stratum0_url + "/data/" + catalog_hash.MakePath();
+    download::JobInfo download_catalog(&url, false, false, fcatalog,
+                                       &catalog_hash);
+    const uint64_t start = platform_monotonic_time_ns();
+    const download::Failures retval =
+      download_manager_->Fetch(&download_catalog);
+    perf::Xadd(counters->sz_catalog_time_ms,
+               (platform_monotonic_time_ns() - start) / (1000 * 1000));
+    fclose(fcatalog);
+    if (retval != download::kFailOk) {
+      LogCvmfs(kLogCvmfs, kLogDebug, "failed to prefetch catalog %s (%d - %s)",
+               catalog_hash.ToString().c_str(), retval,
+               download::Code2Ascii(retval));
+      unlink(path->c_str());
+      return false;
+    }
+    return true;
+  }
+
+  download::DownloadManager *download_manager_;
+  const unsigned max_ready_;
+  unsigned num_ready_;
+  bool terminate_;
+  EntryMap entries_;
+  std::deque<shash::Any> queue_;
+  std::vector<pthread_t> threads_;
+  pthread_mutex_t lock_;
+  pthread_cond_t cond_;
+};
+
+CatalogPrefetcher   *catalog_prefetcher = NULL;
+/**
+ * Compressed catalogs that were downloaded for the catalog diff of an
+ * incremental pull, and the catalogs whose entries were fully covered by it.
+ */
+std::map<shash::Any, std::string> diff_catalog_files;
+std::set<shash::Any> diffed_catalogs;
+
+
+/**
+ * Hands the objects of the changed entries found by the catalog diff of an
+ * incremental pull to the workers
+ */
+class EnqueueDiffTool : public PullDiffTool {
+ public:
+  EnqueueDiffTool(DiffCatalogManager *old_catalog_mgr,
+                  DiffCatalogManager *new_catalog_mgr,
+                  CatalogChunks *catalog_chunks)
+    : PullDiffTool(old_catalog_mgr, new_catalog_mgr)
+    , catalog_chunks_(catalog_chunks)
+  { }
+
+ protected:
+  virtual void ReportObject(const shash::Any &hash,
+                            const zlib::Algorithms compression_alg)
+  {
+    ChunkJob next_chunk(hash, compression_alg, catalog_chunks_);
+    atomic_inc64(&catalog_chunks_->pending);
+    WritePipe(pipe_chunks[1], &next_chunk, sizeof(next_chunk));
+  }
+
+ private:
+  CatalogChunks *catalog_chunks_;
+};
+
 }  // anonymous namespace
 
 
@@ -220,6 +512,26 @@ static void Store(
 }
 
 
+/**
+ * Hands a downloaded chunk to the spooler, or to the preloaded cache, without
+ * going through a temporary file if the chunk is in memory.
+ */
+static void Store(
+  ObjectSink *object,
+  const shash::Any &remote_hash,
+  const bool compressed_src)
+{
+  if (object->IsSpilled()) {
+    Store(object->ReleaseSpillFile(), remote_hash, compressed_src);
+    return;
+  }
+  assert(!preload_cache);
+  const string remote_path = MakePath(remote_hash);
+  spooler->Upload(remote_path, new MemoryIngestionSource(
+    kMemoryObjectPrefix + remote_path, object->data(), object->size()));
+}
+
+
 static void StoreBuffer(const unsigned char *buffer, const unsigned size,
                         const std::string &dest_path, const bool compress) {
   string tmp_file;
@@ -248,6 +560,39 @@ static void WaitForStorage() {
 }
 
 
+static void LogStage(const char *stage, const int64_t num_objects,
+                     const int64_t size, const int64_t busy_ms,
+                     const double elapsed_s)
+{
+  const double size_mb = size / (1024.0 * 1024.0);
+  const double busy_s = (busy_ms > 0) ? busy_ms / 1000.0 : 0.001;
+  LogCvmfs(kLogCvmfs, kLogStdout, "  %-17s %" PRId64 " objects, %.1f MB, "
+           "%.1f MB/s overall, %.1f MB/s per thread", stage, num_objects,
+           size_mb, size_mb / elapsed_s, size_mb / busy_s);
+}
+
+/**
+ * Prints the throughput of the replication stages.  The per-thread throughput
+ * relates the bytes of a stage to the time its threads were busy with it.
+ */
+static void LogStageThroughput(const uint64_t elapsed_ms) {
+  const double elapsed_s = (elapsed_ms > 0) ? elapsed_ms / 1000.0 : 0.001;
+  LogCvmfs(kLogCvmfs, kLogStdout, "Stage throughput over %.1f seconds "
+           "(%" PRId64 " catalogs prefetched, %" PRId64 " chunks spilled to "
+           "disk):", elapsed_s, counters->n_catalogs_prefetched->Get(),
+           counters->n_chunks_spilled->Get());
+  LogStage("catalog download:", counters->n_catalogs->Get(),
+           counters->sz_catalog_bytes->Get(),
+           counters->sz_catalog_time_ms->Get(), elapsed_s);
+  LogStage("chunk download:", counters->n_chunks_fetched->Get(),
+           counters->sz_fetched_bytes->Get(),
+           counters->sz_fetch_time_ms->Get(), elapsed_s);
+  LogStage("chunk storage:", counters->n_chunks_fetched->Get(),
+           counters->sz_fetched_bytes->Get(),
+           counters->sz_store_time_ms->Get(), elapsed_s);
+}
+
+
 struct MainWorkerContext {
   download::DownloadManager *download_manager;
 };
@@ -271,33 +616,65 @@ static void *MainWorker(void *data) {
              chunk_hash.ToString().c_str());
 
     if (!Peek(chunk_hash)) {
-      string tmp_file;
-      FILE *fchunk = CreateTempFile(*temp_dir + "/cvmfs", 0600, "w",
-                                    &tmp_file);
-      assert(fchunk);
+      ObjectSink object(preload_cache ? NULL : inflight_budget, *temp_dir);
       string url_chunk = *stratum0_url + "/data/" + chunk_hash.MakePath();
-      download::JobInfo download_chunk(&url_chunk, false, false, fchunk,
+      download::JobInfo download_chunk(&url_chunk, false, false, &object,
                                        &chunk_hash);
 
+      uint64_t start = platform_monotonic_time_ns();
       const download::Failures download_result =
                                        download_manager->Fetch(&download_chunk);
       if (download_result != download::kFailOk) {
         ReportDownloadError(download_chunk);
         PANIC(kLogStderr, "Download error");
       }
-      fclose(fchunk);
-      Store(tmp_file, chunk_hash,
+      if (!object.Finalize())
+        PANIC(kLogStderr, "Failed to write temporary file");
+      if (!preload_cache && object.IsSpilled())
+        perf::Inc(counters->n_chunks_spilled);
+      perf::Xadd(counters->sz_fetch_time_ms,
+                 (platform_monotonic_time_ns() - start) / (1000 * 1000));
+      perf::Inc(counters->n_chunks_fetched);
+      perf::Xadd(counters->sz_fetched_bytes, object.size());
+
+      start = platform_monotonic_time_ns();
+      Store(&object, chunk_hash,
             (compression_alg == zlib::kZlibDefault) ? true : false);
+      perf::Xadd(counters->sz_store_time_ms,
+                 (platform_monotonic_time_ns() - start) / (1000 * 1000));
       atomic_inc64(&overall_new);
+      atomic_inc64(&next_chunk.catalog_chunks->fetched);
     }
     if (atomic_xadd64(&overall_chunks, 1) % 1000 == 0)
       LogCvmfs(kLogCvmfs, kLogStdout | kLogNoLinebreak, ".");
-    atomic_dec64(&chunk_queue);
+    atomic_dec64(&next_chunk.catalog_chunks->pending);
   }
   return NULL;
 }
 
 
+/**
+ * Schedules the download of the nested catalogs that PullRecursion() is going
+ * to replicate after the chunks of the given catalog.
+ */
+static void PrefetchNestedCatalogs(catalog::Catalog *catalog) {
+  const catalog::Catalog::NestedCatalogList nested_catalogs =
+    catalog->ListOwnNestedCatalogs();
+  for (catalog::Catalog::NestedCatalogList::const_iterator i =
+       nested_catalogs.begin(), iEnd = nested_catalogs.end();
+       i != iEnd; ++i)
+  {
+    if (diff_catalog_files.find(i->hash) != diff_catalog_files.end())
+      continue;
+    if (Peek(i->hash))
+      continue;
+    if (pathfilter && !pathfilter->IsMatching(i->mountpoint.ToString()))
+      continue;
+    catalog_prefetcher->Schedule(i->hash);
+  }
+}
+
+
 bool CommandPull::PullRecursion(catalog::Catalog   *catalog,
                                 const std::string  &path) {
   assert(catalog);
@@ -335,6 +712,93 @@ bool CommandPull::PullRecursion(catalog::Catalog   *catalog,
   return true;
 }
 
+/**
+ * Returns true if the Stratum 1 marks the given root catalog as completely
+ * replicated, including all nested catalogs and all chunks.
+ */
+static bool IsFullReplica(download::DownloadManager *download_manager,
+                          const shash::Any &root_hash)
+{
+  const string url = *stratum1_url + "/" + kFullReplicaMarker;
+  download::JobInfo download_marker(&url, false, false, NULL);
+  const download::Failures retval = download_manager->Fetch(&download_marker);
+  if (retval != download::kFailOk)
+    return false;
+  const string marker(download_marker.destination_mem.data,
+                      download_marker.destination_mem.pos);
+  free(download_marker.destination_mem.data);
+  return Trim(marker, true /* trim_newline */) == root_hash.ToString();
+}
+
+
+/**
+ * Replicates the objects of the entries that changed between the root catalog
+ * served by the Stratum 1 and the new root catalog.  Pull() then only stores
+ * the new catalogs without going through their chunks again.  Returns false
+ * if there is no completely replicated previous revision to compare with or
+ * if the comparison fails, in which case Pull() processes all chunks of the
+ * new catalogs.
+ */
+bool CommandPull::PullChanges(const std::string  &repository_name,
+                              const shash::Any   &catalog_hash) {
+  manifest::ManifestEnsemble ensemble;
+  const manifest::Failures m_retval =
+    FetchRemoteManifestEnsemble(*stratum1_url, repository_name, &ensemble);
+  if (m_retval != manifest::kFailOk) {
+    LogCvmfs(kLogCvmfs, kLogStdout, "No previous revision on the Stratum 1 "
+             "(%d - %s), replicating all new catalogs",
+             m_retval, manifest::Code2Ascii(m_retval));
+    return false;
+  }
+  const shash::Any previous_hash = ensemble.manifest->catalog_hash();
+  if (previous_hash == catalog_hash)
+    return true;
+  // An interrupted or partial pull leaves catalogs without all their chunks
+  if (!IsFullReplica(download_manager(), previous_hash) ||
+      !Peek(previous_hash))
+  {
+    LogCvmfs(kLogCvmfs, kLogStdout, "Previous revision %" PRIu64 " is not "
+             "completely replicated on the Stratum 1, replicating all new "
+             "catalogs", ensemble.manifest->revision());
+    return false;
+  }
+
+  LogCvmfs(kLogCvmfs, kLogStdout, "Replicating changes since revision %" PRIu64,
+           ensemble.manifest->revision());
+  UniquePtr<RaiiTempDir> raii_temp_dir(
+    RaiiTempDir::Create(*temp_dir + "/diff"));
+  perf::Statistics stats_old;
+  perf::Statistics stats_new;
+  DiffCatalogManager *old_catalog_mgr =
+    new DiffCatalogManager(previous_hash, *stratum1_url, raii_temp_dir->dir(),
+                           download_manager(), &stats_old);
+  DiffCatalogManager *new_catalog_mgr =
+    new DiffCatalogManager(catalog_hash, *stratum0_url, raii_temp_dir->dir(),
+                           download_manager(), &stats_new);
+  new_catalog_mgr->KeepCatalogs(*temp_dir, &diff_catalog_files);
+  CatalogChunks catalog_chunks;
+  // The diff tool takes ownership of the catalog managers
+  EnqueueDiffTool diff_tool(old_catalog_mgr, new_catalog_mgr, &catalog_chunks);
+  const bool retval = diff_tool.Diff();
+  while (atomic_read64(&catalog_chunks.pending) != 0) {
+    SafeSleepMs(100);
+  }
+  perf::Xadd(counters->sz_catalog_time_ms, new_catalog_mgr->load_time_ms());
+  if (!retval) {
+    LogCvmfs(kLogCvmfs, kLogStdout, "Failed to compare with the previous "
+             "revision, replicating all new catalogs");
+    return false;
+  }
+
+  diffed_catalogs = diff_tool.diffed_catalogs();
+  diffed_catalogs.insert(catalog_hash);
+  LogCvmfs(kLogCvmfs, kLogStdout, "  Fetched %" PRId64 " new objects out of %"
+           PRIu64 " objects of changed entries",
+           atomic_read64(&catalog_chunks.fetched), diff_tool.num_objects());
+  return true;
+}
+
+
 bool CommandPull::Pull(const shash::Any   &catalog_hash,
                        const std::string  &path) {
   int retval;
@@ -355,6 +819,7 @@ bool CommandPull::Pull(const shash::Any   &catalog_hash,
                  catalog_hash.ToString().c_str());
         return false;
       }
+      PrefetchNestedCatalogs(catalog);
       bool retval = PullRecursion(catalog, path);
       delete catalog;
       return retval;
@@ -373,13 +838,13 @@ bool CommandPull::Pull(const shash::Any   &catalog_hash,
     return true;
   }
 
-  int64_t gauge_chunks = atomic_read64(&overall_chunks);
-  int64_t gauge_new = atomic_read64(&overall_new);
-
   // Download and uncompress catalog
   shash::Any chunk_hash;
   zlib::Algorithms compression_alg;
   catalog::Catalog *catalog = NULL;
+  CatalogChunks catalog_chunks;
+  uint64_t num_chunks = 0;
+  const bool is_diffed = (diffed_catalogs.count(catalog_hash) > 0);
   string file_catalog;
   string file_catalog_vanilla;
   FILE *fcatalog = CreateTempFile(*temp_dir + "/cvmfs", 0600, "w",
@@ -389,29 +854,42 @@ bool CommandPull::Pull(const shash::Any   &catalog_hash,
     return false;
   }
   fclose(fcatalog);
-  FILE *fcatalog_vanilla = CreateTempFile(*temp_dir + "/cvmfs", 0600, "w",
-                                          &file_catalog_vanilla);
-  if (!fcatalog_vanilla) {
-    LogCvmfs(kLogCvmfs, kLogStderr, "I/O error");
-    unlink(file_catalog.c_str());
-    return false;
-  }
-  const string url_catalog = *stratum0_url + "/data/" + catalog_hash.MakePath();
-  download::JobInfo download_catalog(&url_catalog, false, false,
-                                     fcatalog_vanilla, &catalog_hash);
-  dl_retval = download_manager()->Fetch(&download_catalog);
-  fclose(fcatalog_vanilla);
-  if (dl_retval != download::kFailOk) {
-    if (path == "" && is_garbage_collectable) {
-      LogCvmfs(kLogCvmfs, kLogStdout, "skipping missing root catalog %s - "
-                                      "probably sweeped by garbage collection",
-               catalog_hash.ToString().c_str());
-      goto pull_skip;
-    } else {
-      ReportDownloadError(download_catalog);
-      goto pull_cleanup;
+  if (diff_catalog_files.find(catalog_hash) != diff_catalog_files.end()) {
+    file_catalog_vanilla = diff_catalog_files[catalog_hash];
+    diff_catalog_files.erase(catalog_hash);
+  } else if (catalog_prefetcher->Claim(catalog_hash, &file_catalog_vanilla)) {
+    perf::Inc(counters->n_catalogs_prefetched);
+  } else {
+    FILE *fcatalog_vanilla = CreateTempFile(*temp_dir + "/cvmfs", 0600, "w",
+                                            &file_catalog_vanilla);
+    if (!fcatalog_vanilla) {
+      LogCvmfs(kLogCvmfs, kLogStderr, "I/O error");
+      unlink(file_catalog.c_str());
+      return false;
+    }
+    const string url_catalog =
+      *stratum0_url + "/data/" + catalog_hash.MakePath();
+    download::JobInfo download_catalog(&url_catalog, false, false,
+                                       fcatalog_vanilla, &catalog_hash);
+    const uint64_t start = platform_monotonic_time_ns();
+    dl_retval = download_manager()->Fetch(&download_catalog);
+    perf::Xadd(counters->sz_catalog_time_ms,
+               (platform_monotonic_time_ns() - start) / (1000 * 1000));
+    fclose(fcatalog_vanilla);
+    if (dl_retval != download::kFailOk) {
+      if (path == "" && is_garbage_collectable) {
+        LogCvmfs(kLogCvmfs, kLogStdout, "skipping missing root catalog %s - "
+                                       "probably sweeped by garbage collection",
+                 catalog_hash.ToString().c_str());
+        goto pull_skip;
+      } else {
+        ReportDownloadError(download_catalog);
+        goto pull_cleanup;
+      }
     }
   }
+  perf::Inc(counters->n_catalogs);
+  perf::Xadd(counters->sz_catalog_bytes, GetFileSize(file_catalog_vanilla));
   retval = zlib::DecompressPath2Path(file_catalog_vanilla, file_catalog);
   if (!retval) {
     LogCvmfs(kLogCvmfs, kLogStderr, "decompression failure (file %s, hash %s)",
@@ -444,32 +922,43 @@ bool CommandPull::Pull(const shash::Any   &catalog_hash,
     goto pull_skip;
   }
   apply_timestamp_threshold = true;
+  PrefetchNestedCatalogs(catalog);
 
-  // Traverse the chunks
-  LogCvmfs(kLogCvmfs, kLogStdout | kLogNoLinebreak,
-           "  Processing chunks [%" PRIu64 " registered chunks]: ",
-           catalog->GetNumChunks());
-  retval = catalog->AllChunksBegin();
-  if (!retval) {
-    LogCvmfs(kLogCvmfs, kLogStderr, "failed to gather chunks");
-    goto pull_cleanup;
-  }
-  while (catalog->AllChunksNext(&chunk_hash, &compression_alg)) {
-    ChunkJob next_chunk(chunk_hash, compression_alg);
-    WritePipe(pipe_chunks[1], &next_chunk, sizeof(next_chunk));
-    atomic_inc64(&chunk_queue);
-  }
-  catalog->AllChunksEnd();
-  while (atomic_read64(&chunk_queue) != 0) {
-    SafeSleepMs(100);
+  // Traverse the chunks.  The workers process them while the nested catalogs
+  // are replicated.  The chunks of catalogs covered by the catalog diff of an
+  // incremental pull are already replicated.
+  if (is_diffed) {
+    LogCvmfs(kLogCvmfs, kLogStdout, "  Chunks replicated from catalog diff");
+  } else {
+    LogCvmfs(kLogCvmfs, kLogStdout,
+             "  Processing chunks [%" PRIu64 " registered chunks]",
+             catalog->GetNumChunks());
+    retval = catalog->AllChunksBegin();
+    if (!retval) {
+      LogCvmfs(kLogCvmfs, kLogStderr, "failed to gather chunks");
+      goto pull_cleanup;
+    }
+    while (catalog->AllChunksNext(&chunk_hash, &compression_alg)) {
+      ChunkJob next_chunk(chunk_hash, compression_alg, &catalog_chunks);
+      atomic_inc64(&catalog_chunks.pending);
+      WritePipe(pipe_chunks[1], &next_chunk, sizeof(next_chunk));
+      num_chunks++;
+    }
+    catalog->AllChunksEnd();
   }
-  LogCvmfs(kLogCvmfs, kLogStdout, " fetched %" PRId64 " new chunks out of "
-           "%" PRId64 " unique chunks",
-           atomic_read64(&overall_new)-gauge_new,
-           atomic_read64(&overall_chunks)-gauge_chunks);
 
   retval = PullRecursion(catalog, path);
 
+  while (atomic_read64(&catalog_chunks.pending) != 0) {
+    SafeSleepMs(100);
+  }
+  if (!is_diffed) {
+    LogCvmfs(kLogCvmfs, kLogStdout, "  Catalog at '%s': fetched %" PRId64
+             " new chunks out of %" PRIu64 " unique chunks",
+             path.empty() ? "/" : path.c_str(),
+             atomic_read64(&catalog_chunks.fetched), num_chunks);
+  }
+
   delete catalog;
   unlink(file_catalog.c_str());
   WaitForStorage();
@@ -501,6 +990,7 @@ int swissknife::CommandPull::Main(const swissknife::ArgumentList &args) {
   manifest::ManifestEnsemble ensemble;
   shash::Any meta_info_hash;
   string meta_info;
+  uint64_t replication_start = 0;
 
   // Option parsing
   if (args.find('c') != args.end())
@@ -530,6 +1020,8 @@ int swissknife::CommandPull::Main(const swissknife::ArgumentList &args) {
     trusted_certs = *args.find('y')->second;
   if (args.find('n') != args.end())
     num_parallel = String2Uint64(*args.find('n')->second);
+  if (args.find('M') != args.end())
+    max_inflight_bytes = String2Uint64(*args.find('M')->second) * 1024 * 1024;
   if (args.find('t') != args.end())
     timeout = String2Uint64(*args.find('t')->second);
   if (args.find('a') != args.end())
@@ -577,10 +1069,15 @@ int swissknife::CommandPull::Main(const swissknife::ArgumentList &args) {
   // Initialization
   atomic_init64(&overall_chunks);
   atomic_init64(&overall_new);
-  atomic_init64(&chunk_queue);
+  ObjectSink::Budget object_budget(max_inflight_bytes);
+  inflight_budget = &object_budget;
+  PullCounters pull_counters(perf::StatisticsTemplate("pull", statistics()));
+  counters = &pull_counters;
+  const unsigned num_prefetchers =
+    std::min(num_parallel, kMaxCatalogPrefetchers);
 
   const bool     follow_redirects = false;
-  const unsigned max_pool_handles = num_parallel+1;
+  const unsigned max_pool_handles = num_parallel + num_prefetchers + 1;
   const string proxy =
       (args.find('@') != args.end()) ? *args.find('@')->second : "";
 
@@ -786,6 +1283,17 @@ int swissknife::CommandPull::Main(const swissknife::ArgumentList &args) {
                                 static_cast<void*>(&mwc));
     assert(retval == 0);
   }
+  catalog_prefetcher = new CatalogPrefetcher(download_manager(),
+                                             num_prefetchers);
+  replication_start = platform_monotonic_time_ns();
+
+  // Only what changed since the revision on the Stratum 1 needs to be
+  // looked at, unless the replica is partial or includes the history
+  if (!preload_cache && !initial_snapshot && !pull_history &&
+      (pathfilter == NULL))
+  {
+    PullChanges(repository_name, ensemble.manifest->catalog_hash());
+  }
 
   LogCvmfs(kLogCvmfs, kLogStdout, "Replicating from trunk catalog at /");
   retval = Pull(ensemble.manifest->catalog_hash(), "");
@@ -817,6 +1325,17 @@ int swissknife::CommandPull::Main(const swissknife::ArgumentList &args) {
     assert(retval == 0);
   }
   ClosePipe(pipe_chunks);
+  delete catalog_prefetcher;
+  catalog_prefetcher = NULL;
+  for (std::map<shash::Any, std::string>::const_iterator i =
+       diff_catalog_files.begin(), iEnd = diff_catalog_files.end();
+       i != iEnd; ++i)
+  {
+    unlink(i->second.c_str());
+  }
+  diff_catalog_files.clear();
+  LogStageThroughput(
+    (platform_monotonic_time_ns() - replication_start) / (1000 * 1000));
 
   if (!retval)
     goto fini;
@@ -899,6 +1418,11 @@ int swissknife::CommandPull::Main(const swissknife::ArgumentList &args) {
                   ".cvmfswhitelist", false);
       StoreBuffer(ensemble.raw_manifest_buf, ensemble.raw_manifest_size,
                   ".cvmfspublished", false);
+      if (pathfilter == NULL) {
+        const string marker = ensemble.manifest->catalog_hash().ToString();
+        StoreBuffer(reinterpret_cast<const unsigned char *>(marker.data()),
+                    marker.size(), kFullReplicaMarker, false);
+      }
     }
     LogCvmfs(kLogCvmfs, kLogStdout, "Serving revision %u",
              ensemble.manifest->revision());
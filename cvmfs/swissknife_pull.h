@@ -37,6 +37,7 @@ class CommandPull : public Command {
     r.push_back(Parameter::Optional('R', "path to reflog.chksum file"));
     r.push_back(Parameter::Optional('w', "repository stratum1 url"));
     r.push_back(Parameter::Optional('n', "number of download threads"));
+    r.push_back(Parameter::Optional('M', "memory for objects in flight (MB)"));
     r.push_back(Parameter::Optional('l', "log level (0-4, default: 2)"));
     r.push_back(Parameter::Optional('t', "timeout (s)"));
     r.push_back(Parameter::Optional('a', "number of retries"));
@@ -57,6 +58,8 @@ class CommandPull : public Command {
 
  protected:
   bool PullRecursion(catalog::Catalog *catalog, const std::string &path);
+  bool PullChanges(const std::string &repository_name,
+                   const shash::Any &catalog_hash);
   bool Pull(const shash::Any &catalog_hash, const std::string &path);
 };
 
@@ -0,0 +1,201 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#include "cvmfs_config.h"
+#include "swissknife_pull_diff.h"
+
+#include <unistd.h>
+
+#include <cassert>
+#include <cstdio>
+
+#include "download.h"
+#include "util/logging.h"
+#include "util/platform.h"
+#include "util/posix.h"
+
+namespace swissknife {
+
+DiffCatalogManager::DiffCatalogManager(
+  const shash::Any &base_hash,
+  const std::string &base_url,
+  const std::string &dir_temp,
+  download::DownloadManager *download_manager,
+  perf::Statistics *statistics)
+  : catalog::SimpleCatalogManager(base_hash, base_url, dir_temp,
+                                  download_manager, statistics, true)
+  , base_url_(base_url)
+  , download_manager_(download_manager)
+  , kept_files_(NULL)
+  , failed_(false)
+  , load_time_ns_(0)
+{ }
+
+
+/**
+ * The compressed catalogs are stored in dir and registered in files.  The
+ * caller takes care of removing them.
+ */
+void DiffCatalogManager::KeepCatalogs(
+  const std::string &dir,
+  std::map<shash::Any, std::string> *files)
+{
+  keep_dir_ = dir;
+  kept_files_ = files;
+}
+
+
+catalog::LoadError DiffCatalogManager::LoadCatalog(
+  const PathString & /* mountpoint */,
+  const shash::Any &hash,
+  std::string *catalog_path,
+  shash::Any *catalog_hash)
+{
+  // The comparison is void anyway, don't keep on downloading catalogs
+  if (failed_)
+    return catalog::kLoadFail;
+
+  const shash::Any effective_hash = hash.IsNull() ? base_hash() : hash;
+  assert(shash::kSuffixCatalog == effective_hash.suffix);
+  const std::string url = base_url_ + "/data/" + effective_hash.MakePath();
+  const std::string dir_compressed =
+    (kept_files_ == NULL) ? dir_temp() : keep_dir_;
+  std::string path_compressed;
+  FILE *fcatalog = CreateTempFile(dir_compressed + "/cvmfs", 0600, "w",
+                                  &path_compressed);
+  if (fcatalog == NULL) {
+    LogCvmfs(kLogCvmfs, kLogStderr, "failed to create temp file when "
+             "loading %s", url.c_str());
+    failed_ = true;
+    return catalog::kLoadFail;
+  }
+  download::JobInfo download_catalog(&url, false, false, fcatalog,
+                                     &effective_hash);
+  const uint64_t start = platform_monotonic_time_ns();
+  const download::Failures retval =
+    download_manager_->Fetch(&download_catalog);
+  load_time_ns_ += platform_monotonic_time_ns() - start;
+  fclose(fcatalog);
+  if (retval != download::kFailOk) {
+    LogCvmfs(kLogCvmfs, kLogStderr, "failed to load %s (%d - %s)",
+             url.c_str(), retval, download::Code2Ascii(retval));
+    unlink(path_compressed.c_str());
+    failed_ = true;
+    return catalog::kLoadFail;
+  }
+
+  fcatalog = CreateTempFile(dir_temp() + "/catalog", 0666, "w", catalog_path);
+  if (fcatalog == NULL) {
+    LogCvmfs(kLogCvmfs, kLogStderr, "failed to create temp file when "
+             "loading %s", url.c_str());
+    unlink(path_compressed.c_str());
+    failed_ = true;
+    return catalog::kLoadFail;
+  }
+  fclose(fcatalog);
+  if (!zlib::DecompressPath2Path(path_compressed, *catalog_path)) {
+    LogCvmfs(kLogCvmfs, kLogStderr, "decompression failure (file %s, hash %s)",
+             path_compressed.c_str(), effective_hash.ToString().c_str());
+    unlink(path_compressed.c_str());
+    unlink(catalog_path->c_str());
+    failed_ = true;
+    return catalog::kLoadFail;
+  }
+
+  if (kept_files_ == NULL) {
+    unlink(path_compressed.c_str());
+  } else {
+    std::map<shash::Any, std::string>::iterator i =
+      kept_files_->find(effective_hash);
+    if (i != kept_files_->end())
+      unlink(i->second.c_str());
+    (*kept_files_)[effective_hash] = path_compressed;
+  }
+  *catalog_hash = effective_hash;
+  return catalog::kLoadNew;
+}
+
+
+//------------------------------------------------------------------------------
+
+
+PullDiffTool::PullDiffTool(DiffCatalogManager *old_catalog_mgr,
+                           DiffCatalogManager *new_catalog_mgr)
+  : CatalogDiffTool<catalog::SimpleCatalogManager>(old_catalog_mgr,
+                                                   new_catalog_mgr)
+  , old_catalog_mgr_(old_catalog_mgr)
+  , new_catalog_mgr_(new_catalog_mgr)
+  , num_objects_(0)
+{ }
+
+
+/**
+ * Compares the two revisions.  A catalog that fails to load looks like an
+ * empty directory tree to the diff, so any failure of the catalog managers
+ * invalidates the result.
+ */
+bool PullDiffTool::Diff() {
+  if (!old_catalog_mgr_->Init() || !new_catalog_mgr_->Init() || !Init())
+    return false;
+  if (!Run(PathString("")))
+    return false;
+  return !old_catalog_mgr_->failed() && !new_catalog_mgr_->failed();
+}
+
+
+void PullDiffTool::ReportAddition(const PathString &path,
+                                  const catalog::DirectoryEntry &entry,
+                                  const XattrList & /* xattrs */,
+                                  const FileChunkList &chunks)
+{
+  Replicate(path, entry, chunks);
+}
+
+
+void PullDiffTool::ReportRemoval(const PathString & /* path */,
+                                 const catalog::DirectoryEntry & /* entry */)
+{ }
+
+
+bool PullDiffTool::ReportModification(
+  const PathString &path,
+  const catalog::DirectoryEntry & /* old_entry */,
+  const catalog::DirectoryEntry &new_entry,
+  const XattrList & /* xattrs */,
+  const FileChunkList &chunks)
+{
+  Replicate(path, new_entry, chunks);
+  return true;
+}
+
+
+/**
+ * Mirrors the objects that Catalog::AllChunksNext() yields for an entry
+ */
+void PullDiffTool::Replicate(const PathString &path,
+                             const catalog::DirectoryEntry &entry,
+                             const FileChunkList &chunks)
+{
+  if (entry.IsNestedCatalogMountpoint()) {
+    diffed_catalogs_.insert(new_catalog_mgr_->GetNestedCatalogHash(path));
+    return;
+  }
+  if (entry.IsExternalFile())
+    return;
+  if (!entry.checksum().IsNull()) {
+    shash::Any hash = entry.checksum();
+    hash.suffix = entry.IsDirectory() ? shash::kSuffixMicroCatalog
+                                      : shash::kSuffixNone;
+    ReportObject(hash, entry.compression_algorithm());
+    num_objects_++;
+  }
+  for (unsigned i = 0; i < chunks.size(); ++i) {
+    shash::Any hash = chunks.AtPtr(i)->content_hash();
+    hash.suffix = shash::kSuffixPartial;
+    ReportObject(hash, entry.compression_algorithm());
+    num_objects_++;
+  }
+}
+
+}  // namespace swissknife
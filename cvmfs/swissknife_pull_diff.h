@@ -0,0 +1,119 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#ifndef CVMFS_SWISSKNIFE_PULL_DIFF_H_
+#define CVMFS_SWISSKNIFE_PULL_DIFF_H_
+
+#include <stdint.h>
+
+#include <map>
+#include <set>
+#include <string>
+
+#include "catalog_diff_tool.h"
+#include "catalog_mgr_ro.h"
+#include "compression.h"
+#include "crypto/hash.h"
+
+namespace download {
+class DownloadManager;
+}
+
+namespace swissknife {
+
+/**
+ * Catalog manager for the two revisions compared by an incremental pull.
+ * Unlike the SimpleCatalogManager, it does not abort if a catalog cannot be
+ * loaded.  The catalog is reported as missing instead and the manager
+ * remembers the failure, so that the caller can discard the comparison.
+ * Optionally, the compressed catalogs are kept, so that Pull() stores them
+ * without downloading them a second time.
+ */
+class DiffCatalogManager : public catalog::SimpleCatalogManager {
+ public:
+  DiffCatalogManager(const shash::Any &base_hash,
+                     const std::string &base_url,
+                     const std::string &dir_temp,
+                     download::DownloadManager *download_manager,
+                     perf::Statistics *statistics);
+
+  void KeepCatalogs(const std::string &dir,
+                    std::map<shash::Any, std::string> *files);
+
+  bool failed() const { return failed_; }
+  uint64_t load_time_ms() const { return load_time_ns_ / (1000 * 1000); }
+
+ protected:
+  virtual catalog::LoadError LoadCatalog(const PathString &mountpoint,
+                                         const shash::Any &hash,
+                                         std::string *catalog_path,
+                                         shash::Any *catalog_hash);
+
+ private:
+  const std::string base_url_;
+  download::DownloadManager *download_manager_;
+  /**
+   * If set, the compressed catalogs are moved to keep_dir_ and registered
+   * in kept_files_ by their hash
+   */
+  std::string keep_dir_;
+  std::map<shash::Any, std::string> *kept_files_;
+  bool failed_;
+  uint64_t load_time_ns_;
+};
+
+
+/**
+ * Reports the objects of added and modified entries.  Nested catalogs whose
+ * hash did not change are not traversed by the diff.  Nested catalogs that
+ * are new or changed are traversed entirely, their hashes are recorded in
+ * diffed_catalogs().  The result is only meaningful if Diff() succeeds.
+ */
+class PullDiffTool : public CatalogDiffTool<catalog::SimpleCatalogManager> {
+ public:
+  PullDiffTool(DiffCatalogManager *old_catalog_mgr,
+               DiffCatalogManager *new_catalog_mgr);
+  virtual ~PullDiffTool() { }
+
+  bool Diff();
+
+  const std::set<shash::Any> &diffed_catalogs() const {
+    return diffed_catalogs_;
+  }
+  uint64_t num_objects() const { return num_objects_; }
+
+ protected:
+  /**
+   * Called for every object that the new revision needs, in the order of the
+   * traversal.  Objects may be reported more than once.
+   */
+  virtual void ReportObject(const shash::Any &hash,
+                            const zlib::Algorithms compression_alg) = 0;
+
+  virtual void ReportAddition(const PathString &path,
+                              const catalog::DirectoryEntry &entry,
+                              const XattrList &xattrs,
+                              const FileChunkList &chunks);
+  virtual void ReportRemoval(const PathString &path,
+                             const catalog::DirectoryEntry &entry);
+  virtual bool ReportModification(const PathString &path,
+                                  const catalog::DirectoryEntry &old_entry,
+                                  const catalog::DirectoryEntry &new_entry,
+                                  const XattrList &xattrs,
+                                  const FileChunkList &chunks);
+
+ private:
+  void Replicate(const PathString &path,
+                 const catalog::DirectoryEntry &entry,
+                 const FileChunkList &chunks);
+
+  DiffCatalogManager *old_catalog_mgr_;
+  DiffCatalogManager *new_catalog_mgr_;
+  std::set<shash::Any> diffed_catalogs_;
+  uint64_t num_objects_;
+};
+
+}  // namespace swissknife
+
+#endif  // CVMFS_SWISSKNIFE_PULL_DIFF_H_
@@ -0,0 +1,135 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#include "cvmfs_config.h"
+#include "swissknife_pull_sink.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+#include "util/posix.h"
+#include "util/smalloc.h"
+
+namespace swissknife {
+
+bool ObjectSink::Budget::Reserve(const uint64_t size) {
+  const int64_t delta = static_cast<int64_t>(size);
+  if (static_cast<uint64_t>(atomic_xadd64(&used_, delta) + delta) > limit_) {
+    atomic_xadd64(&used_, -delta);
+    return false;
+  }
+  return true;
+}
+
+
+void ObjectSink::Budget::Release(const uint64_t size) {
+  atomic_xadd64(&used_, -static_cast<int64_t>(size));
+}
+
+
+//------------------------------------------------------------------------------
+
+
+ObjectSink::ObjectSink(Budget *budget, const std::string &temp_dir)
+  : budget_(budget)
+  , temp_dir_(temp_dir)
+  , buffer_(NULL)
+  , size_(0)
+  , capacity_(0)
+  , fspill_(NULL)
+{ }
+
+
+ObjectSink::~ObjectSink() {
+  free(buffer_);
+  if (budget_ != NULL)
+    budget_->Release(capacity_);
+  if (fspill_ != NULL)
+    fclose(fspill_);
+  if (!spill_path_.empty())
+    unlink(spill_path_.c_str());
+}
+
+
+/**
+ * Completes the object after the download.  Objects that do not live in
+ * memory are flushed to their temporary file.
+ */
+bool ObjectSink::Finalize() {
+  if ((budget_ == NULL) && (fspill_ == NULL) && !Spill())
+    return false;
+  if (fspill_ == NULL)
+    return true;
+  const bool retval = (fclose(fspill_) == 0);
+  fspill_ = NULL;
+  return retval;
+}
+
+
+/**
+ * The caller takes over the temporary file.
+ */
+std::string ObjectSink::ReleaseSpillFile() {
+  const std::string result = spill_path_;
+  spill_path_.clear();
+  return result;
+}
+
+
+int ObjectSink::Reset() {
+  size_ = 0;
+  if (fspill_ != NULL) {
+    if ((fflush(fspill_) != 0) || (ftruncate(fileno(fspill_), 0) != 0))
+      return -errno;
+    rewind(fspill_);
+  }
+  return 0;
+}
+
+
+bool ObjectSink::Spill() {
+  fspill_ = CreateTempFile(temp_dir_ + "/cvmfs", 0600, "w", &spill_path_);
+  if (fspill_ == NULL)
+    return false;
+  if ((size_ > 0) && (fwrite(buffer_, 1, size_, fspill_) != size_))
+    return false;
+  free(buffer_);
+  buffer_ = NULL;
+  if (budget_ != NULL)
+    budget_->Release(capacity_);
+  capacity_ = 0;
+  return true;
+}
+
+
+int64_t ObjectSink::Write(const void *buf, uint64_t sz) {
+  if ((fspill_ == NULL) && (size_ + sz > capacity_)) {
+    uint64_t new_capacity = std::max(2 * capacity_, size_ + sz);
+    if (new_capacity < kMinCapacity)
+      new_capacity = kMinCapacity;
+    if ((budget_ != NULL) && (new_capacity <= kMaxInMemorySize) &&
+        budget_->Reserve(new_capacity - capacity_))
+    {
+      buffer_ = reinterpret_cast<unsigned char *>(
+        srealloc(buffer_, new_capacity));
+      capacity_ = new_capacity;
+    } else if (!Spill()) {
+      return -EIO;
+    }
+  }
+  if (fspill_ != NULL) {
+    if (fwrite(buf, 1, sz, fspill_) != sz)
+      return -EIO;
+  } else {
+    memcpy(buffer_ + size_, buf, sz);
+  }
+  size_ += sz;
+  return static_cast<int64_t>(sz);
+}
+
+}  // namespace swissknife
@@ -0,0 +1,80 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#ifndef CVMFS_SWISSKNIFE_PULL_SINK_H_
+#define CVMFS_SWISSKNIFE_PULL_SINK_H_
+
+#include <stdint.h>
+
+#include <cstdio>
+#include <string>
+
+#include "sink.h"
+#include "util/atomic.h"
+#include "util/single_copy.h"
+
+namespace swissknife {
+
+/**
+ * Download destination of the chunk workers of swissknife pull.  As long as the
+ * objects of all workers together fit in the memory budget, an object is kept
+ * in memory and goes from the download straight into the spooler.  Otherwise
+ * it is spilled to a temporary file, which is also where all objects go if
+ * there is no budget (preloading a cache).  The download manager restarts
+ * failed transfers from scratch (Reset()), so the object is only handed on
+ * once it is complete.
+ */
+class ObjectSink : public cvmfs::Sink, SingleCopy {
+ public:
+  /**
+   * Memory shared by the in-memory objects of all workers
+   */
+  class Budget : SingleCopy {
+   public:
+    explicit Budget(const uint64_t limit) : limit_(limit) {
+      atomic_init64(&used_);
+    }
+    bool Reserve(const uint64_t size);
+    void Release(const uint64_t size);
+    uint64_t used() { return atomic_read64(&used_); }
+
+   private:
+    const uint64_t limit_;
+    atomic_int64 used_;
+  };
+
+  /**
+   * Larger objects always take the detour through a temporary file
+   */
+  static const uint64_t kMaxInMemorySize = 1024 * 1024 * 1024;
+
+  ObjectSink(Budget *budget, const std::string &temp_dir);
+  virtual ~ObjectSink();
+  virtual int64_t Write(const void *buf, uint64_t sz);
+  virtual int Reset();
+
+  bool Finalize();
+  std::string ReleaseSpillFile();
+
+  bool IsSpilled() const { return !spill_path_.empty(); }
+  const unsigned char *data() const { return buffer_; }
+  uint64_t size() const { return size_; }
+
+ private:
+  static const uint64_t kMinCapacity = 64 * 1024;
+
+  bool Spill();
+
+  Budget *budget_;
+  const std::string temp_dir_;
+  unsigned char *buffer_;
+  uint64_t size_;
+  uint64_t capacity_;
+  FILE *fspill_;
+  std::string spill_path_;
+};
+
+}  // namespace swissknife
+
+#endif  // CVMFS_SWISSKNIFE_PULL_SINK_H_
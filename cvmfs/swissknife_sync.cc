@@ -643,6 +643,14 @@ int swissknife::CommandSync::Main(const swissknife::ArgumentList &args) {
       return 2;
     }
   }
+  if (args.find('G') != args.end()) {
+    params.chunking_algorithm =
+        ParseChunkingAlgorithm(*args.find('G')->second);
+    if (params.chunking_algorithm == kChunkingUnknown) {
+      PrintError("unknown chunking algorithm");
+      return 1;
+    }
+  }
   if (args.find('O') != args.end()) {
     params.generate_legacy_bulk_chunks = true;
   }
@@ -742,6 +750,7 @@ int swissknife::CommandSync::Main(const swissknife::ArgumentList &args) {
         params.max_concurrent_write_jobs;
   }
   spooler_definition.num_upload_tasks = params.num_upload_tasks;
+  spooler_definition.chunking_algorithm = params.chunking_algorithm;
 
   upload::SpoolerDefinition spooler_definition_catalogs(
       spooler_definition.Dup2DefaultCompression());
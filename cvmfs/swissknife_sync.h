@@ -49,6 +49,7 @@ struct SyncParameters {
         min_file_chunk_size(kDefaultMinFileChunkSize),
         avg_file_chunk_size(kDefaultAvgFileChunkSize),
         max_file_chunk_size(kDefaultMaxFileChunkSize),
+        chunking_algorithm(kChunkingXor32),
         manual_revision(0),
         ttl_seconds(0),
         max_concurrent_write_jobs(0),
@@ -99,6 +100,7 @@ struct SyncParameters {
   size_t min_file_chunk_size;
   size_t avg_file_chunk_size;
   size_t max_file_chunk_size;
+  ChunkingAlgorithms chunking_algorithm;
   uint64_t manual_revision;
   uint64_t ttl_seconds;
   uint64_t max_concurrent_write_jobs;
@@ -263,6 +265,9 @@ class CommandSync : public Command {
     r.push_back(Parameter::Optional('a', "desired average chunk size (bytes)"));
     r.push_back(Parameter::Optional('e', "hash algorithm (default: SHA-1)"));
     r.push_back(Parameter::Optional('f', "union filesystem type"));
+    r.push_back(Parameter::Optional('G',
+                                    "chunking algorithm "
+                                    "(xor32, fastcdc; default: xor32)"));
     r.push_back(Parameter::Optional('h', "maximal file chunk size in bytes"));
     r.push_back(Parameter::Optional('l', "minimal file chunk size in bytes"));
     r.push_back(Parameter::Optional('q', "number of concurrent write jobs"));
@@ -37,6 +37,15 @@ AbstractUploader::UploadJob::UploadJob(
   , content_hash(content_hash)
 { }
 
+AbstractUploader::UploadJob::UploadJob(const std::string &file_to_delete)
+  : type(Remove)
+  , stream_handle(NULL)
+  , tag_(0)
+  , buffer()
+  , callback(NULL)
+  , file_to_delete(file_to_delete)
+{ }
+
 void AbstractUploader::RegisterPlugins() {
   RegisterPlugin<LocalUploader>();
   RegisterPlugin<S3Uploader>();
@@ -94,6 +103,15 @@ int AbstractUploader::CreateAndOpenTemporaryChunkFile(std::string *path) const {
   return tmp_fd;
 }
 
+void AbstractUploader::DoRemoveBatchAsync(
+  const std::vector<std::string> &files_to_delete)
+{
+  for (unsigned i = 0; i < files_to_delete.size(); ++i) {
+    ++jobs_in_flight_;
+    tubes_upload_.DispatchAny(new UploadJob(files_to_delete[i]));
+  }
+}
+
 void AbstractUploader::TearDown() {
   tasks_upload_.Terminate();
 }
@@ -155,6 +173,10 @@ void TaskUpload::Process(AbstractUploader::UploadJob *upload_job) {
         upload_job->stream_handle, upload_job->content_hash);
       break;
 
+    case AbstractUploader::UploadJob::Remove:
+      uploader_->DoRemoveAsync(upload_job->file_to_delete);
+      break;
+
     default:
       PANIC(NULL);
   }
@@ -9,6 +9,7 @@
 #include <stdint.h>
 
 #include <string>
+#include <vector>
 
 #include "ingestion/ingestion_source.h"
 #include "ingestion/task.h"
@@ -102,11 +103,12 @@ class AbstractUploader
   };
 
   struct UploadJob {
-    enum Type { Upload, Commit, Terminate };
+    enum Type { Upload, Commit, Remove, Terminate };
 
     UploadJob(UploadStreamHandle *handle, UploadBuffer buffer,
               const CallbackTN *callback = NULL);
     UploadJob(UploadStreamHandle *handle, const shash::Any &content_hash);
+    explicit UploadJob(const std::string &file_to_delete);
 
     UploadJob()
         : type(Terminate)
@@ -133,6 +135,9 @@ class AbstractUploader
 
     // type==Commit specific fields
     shash::Any content_hash;
+
+    // type==Remove specific fields
+    std::string file_to_delete;
   };
 
   virtual ~AbstractUploader() { assert(!tasks_upload_.is_active()); }
@@ -281,6 +286,18 @@ class AbstractUploader
     RemoveAsync("data/" + hash_to_delete.MakePath());
   }
 
+  /**
+   * Removes a batch of files from the backend storage.  Backends that support
+   * bulk deletion remove the batch with few requests, the others remove the
+   * files concurrently in the upload tasks.
+   *
+   * @param files_to_delete  paths to the files to be removed
+   */
+  void RemoveAsync(const std::vector<std::string> &files_to_delete) {
+    if (!files_to_delete.empty())
+      DoRemoveBatchAsync(files_to_delete);
+  }
+
   /**
    * Get object size based on its content hash
    *
@@ -372,6 +389,19 @@ class AbstractUploader
 
   virtual void DoRemoveAsync(const std::string &file_to_delete) = 0;
 
+  /**
+   * Implementation of batched removal
+   * Public interface: AbstractUploader::RemoveAsync()
+   *
+   * Every job started by the implementation needs to be accounted for in
+   * jobs_in_flight_.  The default distributes DoRemoveAsync() calls over the
+   * upload tasks.
+   *
+   * @param files_to_delete  paths to the files to be removed
+   */
+  virtual void DoRemoveBatchAsync(
+    const std::vector<std::string> &files_to_delete);
+
   virtual int64_t DoGetObjectSize(const std::string &file_name) = 0;
 
   /**
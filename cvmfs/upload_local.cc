@@ -204,8 +204,7 @@ void LocalUploader::FinalizeStreamedUpload(UploadStreamHandle *handle,
 }
 
 /**
- * TODO(jblomer): investigate if parallelism increases the GC speed on local
- * disks.
+ * Batched removals call this concurrently from the upload tasks.
  */
 void LocalUploader::DoRemoveAsync(const std::string &file_to_delete) {
   const int retval = unlink((upstream_path_ + "/" + file_to_delete).c_str());
@@ -9,6 +9,7 @@
 #include <inttypes.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <string>
 #include <vector>
 
@@ -40,6 +41,7 @@ S3Uploader::S3Uploader(const SpoolerDefinition &spooler_definition)
   , peek_before_put_(true)
   , use_https_(false)
   , proxy_("")
+  , multipart_part_size_(kDefaultMultipartPartSize)
   , temporary_path_(spooler_definition.temporary_path)
 {
   assert(spooler_definition.IsValid() &&
@@ -191,6 +193,23 @@ bool S3Uploader::ParseSpoolerDefinition(
     options_manager.GetValue("CVMFS_S3_PROXY", &proxy_);
   }
 
+  // Zero disables multipart uploads.  Azure uses block lists instead, which
+  // are not supported.
+  if (options_manager.GetValue("CVMFS_S3_MULTIPART_PART_SIZE", &parameter)) {
+    multipart_part_size_ = String2Uint64(parameter);
+    if ((multipart_part_size_ > 0) &&
+        (multipart_part_size_ < kMinMultipartPartSize))
+    {
+      LogCvmfs(kLogUploadS3, kLogStderr,
+               "CVMFS_S3_MULTIPART_PART_SIZE in '%s' must be 0 (disabled) "
+               "or at least %" PRIu64 " bytes",
+               config_path.c_str(), kMinMultipartPartSize);
+      return false;
+    }
+  }
+  if (authz_method_ == s3fanout::kAuthzAzure)
+    multipart_part_size_ = 0;
+
   return true;
 }
 
@@ -260,7 +279,10 @@ void *S3Uploader::MainCollectResults(void *data) {
         atomic_inc32(&uploader->io_errors_);
       }
     }
-    if (info->request == s3fanout::JobInfo::kReqDelete) {
+    if (info->context != NULL) {
+      uploader->OnMultipartJobComplete(*info);
+    } else if ((info->request == s3fanout::JobInfo::kReqDelete) ||
+        (info->request == s3fanout::JobInfo::kReqDeleteMulti)) {
       uploader->Respond(NULL, UploaderResults());
     } else if (info->request == s3fanout::JobInfo::kReqHeadOnly) {
       if (info->error_code == s3fanout::kFailNotFound) reply_code = 1;
@@ -305,9 +327,17 @@ void S3Uploader::DoUpload(
   rvb = source->GetSize(&size);
   assert(rvb);
 
+  // Only content-addressed objects are split into parts, the top level files
+  // are small
+  const bool is_dot_cvmfs = HasPrefix(remote_path, ".cvmfs", false);
+  const bool is_html = HasSuffix(remote_path, ".html", false);
+  const uint64_t part_size =
+    (is_dot_cvmfs || is_html) ? 0 : multipart_part_size_;
+
   FileBackedBuffer *origin =
     FileBackedBuffer::Create(kInMemoryObjectThreshold,
                              spooler_definition().temporary_path);
+  std::vector<FileBackedBuffer *> parts;
 
   unsigned char buffer[kPageSize];
   ssize_t nbytes;
@@ -317,35 +347,59 @@ void S3Uploader::DoUpload(
     if (nbytes < 0) {
       source->Close();
       delete origin;
+      for (unsigned i = 0; i < parts.size(); ++i)
+        delete parts[i];
       Respond(callback, UploaderResults(100, source->GetPath()));
       return;
     }
+    if ((part_size > 0) && (origin->GetSize() >= part_size)) {
+      origin->Commit();
+      parts.push_back(origin);
+      origin = FileBackedBuffer::Create(kInMemoryObjectThreshold,
+                                        spooler_definition().temporary_path);
+    }
   } while (nbytes == kPageSize);
   source->Close();
   origin->Commit();
 
+  RequestCtrl req_ctrl;
+  MakePipe(req_ctrl.pipe_wait);
+  req_ctrl.callback_forward = callback;
+  req_ctrl.original_path = source->GetPath();
+  const CallbackTN *callback_ctrl = MakeClosure(
+    &S3Uploader::OnReqComplete, this, &req_ctrl);
+
+  if (!parts.empty()) {
+    MultipartUpload *upload = new MultipartUpload();
+    upload->object_key = repository_alias_ + "/" + remote_path;
+    upload->callback = callback_ctrl;
+    if (origin->GetSize() > 0)
+      parts.push_back(origin);
+    else
+      delete origin;
+    upload->parts.swap(parts);
+    StartMultipartUpload(upload);
+    req_ctrl.WaitFor();
+    LogCvmfs(kLogUploadS3, kLogDebug, "Uploading from source finished: %s",
+             source->GetPath().c_str());
+    return;
+  }
+
   s3fanout::JobInfo *info =
     new s3fanout::JobInfo(repository_alias_ + "/" + remote_path,
                           const_cast<void*>(
-                              static_cast<void const*>(callback)),
+                              static_cast<void const*>(callback_ctrl)),
                           origin);
 
-  if (HasPrefix(remote_path, ".cvmfs", false /*ignore_case*/)) {
+  if (is_dot_cvmfs) {
     info->request = s3fanout::JobInfo::kReqPutDotCvmfs;
-  } else if (HasSuffix(remote_path, ".html", false)) {
+  } else if (is_html) {
     info->request = s3fanout::JobInfo::kReqPutHtml;
   } else {
     if (peek_before_put_)
       info->request = s3fanout::JobInfo::kReqHeadPut;
   }
 
-  RequestCtrl req_ctrl;
-  MakePipe(req_ctrl.pipe_wait);
-  req_ctrl.callback_forward = callback;
-  req_ctrl.original_path = source->GetPath();
-  info->callback = const_cast<void*>(static_cast<void const*>(MakeClosure(
-    &S3Uploader::OnReqComplete, this, &req_ctrl)));
-
   UploadJobInfo(info);
   req_ctrl.WaitFor();
   LogCvmfs(kLogUploadS3, kLogDebug, "Uploading from source finished: %s",
@@ -381,6 +435,16 @@ void S3Uploader::StreamedUpload(
   S3StreamHandle *s3_handle = static_cast<S3StreamHandle*>(handle);
 
   s3_handle->buffer->Append(buffer.data, buffer.size);
+  // Start a new part; parts are at least multipart_part_size_ bytes except for
+  // the last one, as required by S3
+  if ((multipart_part_size_ > 0) &&
+      (s3_handle->buffer->GetSize() >= multipart_part_size_))
+  {
+    s3_handle->buffer->Commit();
+    s3_handle->parts.push_back(s3_handle->buffer.Release());
+    s3_handle->buffer = FileBackedBuffer::Create(
+      kInMemoryObjectThreshold, spooler_definition().temporary_path);
+  }
   Respond(callback, UploaderResults(UploaderResults::kBufferUpload, 0));
 }
 
@@ -403,16 +467,29 @@ void S3Uploader::FinalizeStreamedUpload(
 
   size_t bytes_uploaded = s3_handle->buffer->GetSize();
 
-  s3fanout::JobInfo *info =
-      new s3fanout::JobInfo(final_path,
-                            const_cast<void*>(
-                                static_cast<void const*>(
-                                    handle->commit_callback)),
-                            s3_handle->buffer.Release());
+  if (!s3_handle->parts.empty()) {
+    MultipartUpload *upload = new MultipartUpload();
+    upload->object_key = final_path;
+    upload->callback = handle->commit_callback;
+    if (s3_handle->buffer->GetSize() > 0)
+      s3_handle->parts.push_back(s3_handle->buffer.Release());
+    upload->parts.swap(s3_handle->parts);
+    bytes_uploaded = 0;
+    for (unsigned i = 0; i < upload->parts.size(); ++i)
+      bytes_uploaded += upload->parts[i]->GetSize();
+    StartMultipartUpload(upload);
+  } else {
+    s3fanout::JobInfo *info =
+        new s3fanout::JobInfo(final_path,
+                              const_cast<void*>(
+                                  static_cast<void const*>(
+                                      handle->commit_callback)),
+                              s3_handle->buffer.Release());
 
-  if (peek_before_put_)
-      info->request = s3fanout::JobInfo::kReqHeadPut;
-  UploadJobInfo(info);
+    if (peek_before_put_)
+        info->request = s3fanout::JobInfo::kReqHeadPut;
+    UploadJobInfo(info);
+  }
 
   // Remove the temporary file
   delete s3_handle;
@@ -447,6 +524,206 @@ void S3Uploader::DoRemoveAsync(const std::string& file_to_delete) {
 }
 
 
+/**
+ * Uses multi-object delete requests with up to kMaxDeleteBatch keys each.
+ * Azure blob storage has no equivalent, so there the files are removed one by
+ * one.
+ */
+void S3Uploader::DoRemoveBatchAsync(
+  const std::vector<std::string> &files_to_delete)
+{
+  if (authz_method_ == s3fanout::kAuthzAzure) {
+    AbstractUploader::DoRemoveBatchAsync(files_to_delete);
+    return;
+  }
+
+  for (unsigned i = 0; i < files_to_delete.size(); i += kMaxDeleteBatch) {
+    const unsigned end =
+      std::min(i + kMaxDeleteBatch,
+               static_cast<unsigned>(files_to_delete.size()));
+    // Object keys are derived from content hashes and fixed file names, so
+    // they contain no characters that need XML escaping
+    std::string body = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+                       "<Delete><Quiet>true</Quiet>";
+    for (unsigned j = i; j < end; ++j) {
+      body += "<Object><Key>" + repository_alias_ + "/" + files_to_delete[j] +
+              "</Key></Object>";
+    }
+    body += "</Delete>";
+
+    s3fanout::JobInfo *info = CreateJobInfo("?delete");
+    info->origin->Append(body.data(), body.length());
+    info->origin->Commit();
+    info->request = s3fanout::JobInfo::kReqDeleteMulti;
+
+    LogCvmfs(kLogUploadS3, kLogDebug, "Asynchronously removing %u objects "
+             "from %s", end - i, bucket_.c_str());
+    IncJobsInFlight();
+    s3fanout_mgr_->PushNewJob(info);
+  }
+}
+
+
+/**
+ * Starts with a HEAD request if peek_before_put_ is set, like kReqHeadPut for
+ * regular uploads.  Otherwise the upload id is requested right away.
+ */
+void S3Uploader::StartMultipartUpload(MultipartUpload *upload) {
+  upload->size = 0;
+  for (unsigned i = 0; i < upload->parts.size(); ++i)
+    upload->size += upload->parts[i]->GetSize();
+  LogCvmfs(kLogUploadS3, kLogDebug, "Multipart upload of %s in %u parts",
+           upload->object_key.c_str(),
+           static_cast<unsigned>(upload->parts.size()));
+  PushMultipartJob(upload,
+                   peek_before_put_ ? s3fanout::JobInfo::kReqHeadOnly
+                                    : s3fanout::JobInfo::kReqMultipartInit,
+                   peek_before_put_ ? "" : "?uploads", NULL);
+}
+
+
+void S3Uploader::PushMultipartJob(
+  MultipartUpload *upload,
+  s3fanout::JobInfo::RequestType request,
+  const std::string &query,
+  FileBackedBuffer *origin)
+{
+  if (origin == NULL) {
+    origin = FileBackedBuffer::Create(kInMemoryObjectThreshold);
+    origin->Commit();
+  }
+  s3fanout::JobInfo *info =
+    new s3fanout::JobInfo(upload->object_key + query, NULL, origin);
+  info->request = request;
+  info->context = upload;
+  UploadJobInfo(info);
+}
+
+
+/**
+ * Runs in the MainCollectResults thread.  Errors are already logged and
+ * counted.
+ */
+void S3Uploader::OnMultipartJobComplete(const s3fanout::JobInfo &info) {
+  MultipartUpload *upload = static_cast<MultipartUpload *>(info.context);
+  const bool ok = (info.error_code == s3fanout::kFailOk);
+
+  switch (info.request) {
+    case s3fanout::JobInfo::kReqHeadOnly:
+      if (ok) {
+        // Duplicate, see kReqHeadPut in MainCollectResults
+        CountDuplicates();
+        DecUploadedChunks();
+        CountUploadedBytes(-static_cast<int64_t>(upload->size));
+        FinishMultipartUpload(upload, 0);
+      } else if (info.error_code == s3fanout::kFailNotFound) {
+        PushMultipartJob(upload, s3fanout::JobInfo::kReqMultipartInit,
+                         "?uploads", NULL);
+      } else {
+        FinishMultipartUpload(upload, 99);
+      }
+      break;
+
+    case s3fanout::JobInfo::kReqMultipartInit: {
+      const std::string::size_type pos_begin =
+        info.response.find("<UploadId>");
+      const std::string::size_type pos_end =
+        info.response.find("</UploadId>");
+      if (!ok || (pos_begin == std::string::npos) ||
+          (pos_end == std::string::npos))
+      {
+        if (ok) {
+          LogCvmfs(kLogUploadS3, kLogStderr, "No upload id for '%s': %s",
+                   upload->object_key.c_str(), info.response.c_str());
+          atomic_inc32(&io_errors_);
+        }
+        FinishMultipartUpload(upload, 99);
+        break;
+      }
+      upload->upload_id = info.response.substr(
+        pos_begin + 10, pos_end - (pos_begin + 10));
+
+      // The vector of parts may not change anymore while the jobs complete
+      std::vector<FileBackedBuffer *> parts;
+      parts.swap(upload->parts);
+      upload->etags.resize(parts.size());
+      upload->parts_pending = parts.size();
+      for (unsigned i = 0; i < parts.size(); ++i) {
+        s3fanout::JobInfo *part_info = new s3fanout::JobInfo(
+          upload->object_key + "?partNumber=" + StringifyInt(i + 1) +
+            "&uploadId=" + upload->upload_id,
+          NULL, parts[i]);
+        part_info->request = s3fanout::JobInfo::kReqMultipartPart;
+        part_info->context = upload;
+        part_info->part_number = i + 1;
+        UploadJobInfo(part_info);
+      }
+      break;
+    }
+
+    case s3fanout::JobInfo::kReqMultipartPart:
+      assert((info.part_number > 0) &&
+             (info.part_number <= upload->etags.size()));
+      upload->etags[info.part_number - 1] = info.etag;
+      if (ok && info.etag.empty()) {
+        LogCvmfs(kLogUploadS3, kLogStderr, "No ETag for part %u of '%s'",
+                 info.part_number, upload->object_key.c_str());
+        atomic_inc32(&io_errors_);
+      }
+      if (!ok || info.etag.empty())
+        upload->failed = true;
+      if (--upload->parts_pending > 0)
+        break;
+
+      if (upload->failed) {
+        PushMultipartJob(upload, s3fanout::JobInfo::kReqMultipartAbort,
+                         "?uploadId=" + upload->upload_id, NULL);
+      } else {
+        std::string body = "<CompleteMultipartUpload>";
+        for (unsigned i = 0; i < upload->etags.size(); ++i) {
+          body += "<Part><PartNumber>" + StringifyInt(i + 1) +
+                  "</PartNumber><ETag>" + upload->etags[i] + "</ETag></Part>";
+        }
+        body += "</CompleteMultipartUpload>";
+        FileBackedBuffer *origin =
+          FileBackedBuffer::Create(kInMemoryObjectThreshold);
+        origin->Append(body.data(), body.length());
+        origin->Commit();
+        PushMultipartJob(upload, s3fanout::JobInfo::kReqMultipartComplete,
+                         "?uploadId=" + upload->upload_id, origin);
+      }
+      break;
+
+    case s3fanout::JobInfo::kReqMultipartComplete:
+      if (ok) {
+        FinishMultipartUpload(upload, 0);
+      } else {
+        // Release the stored parts; the abort reports the failure
+        PushMultipartJob(upload, s3fanout::JobInfo::kReqMultipartAbort,
+                         "?uploadId=" + upload->upload_id, NULL);
+      }
+      break;
+
+    case s3fanout::JobInfo::kReqMultipartAbort:
+      FinishMultipartUpload(upload, 99);
+      break;
+
+    default:
+      PANIC(kLogStderr, "unexpected request %d in multipart upload",
+            info.request);
+  }
+}
+
+
+void S3Uploader::FinishMultipartUpload(MultipartUpload *upload,
+                                       int return_code)
+{
+  Respond(upload->callback,
+          UploaderResults(UploaderResults::kChunkCommit, return_code));
+  delete upload;
+}
+
+
 void S3Uploader::OnReqComplete(
   const upload::UploaderResults &results,
   RequestCtrl *ctrl)
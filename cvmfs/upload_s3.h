@@ -30,8 +30,15 @@ struct S3StreamHandle : public UploadStreamHandle {
     buffer = FileBackedBuffer::Create(in_memory_threshold, tmp_dir);
   }
 
+  virtual ~S3StreamHandle() {
+    for (unsigned i = 0; i < parts.size(); ++i)
+      delete parts[i];
+  }
+
   // Ownership is later transferred to the S3 fanout
   UniquePtr<FileBackedBuffer> buffer;
+  // Filled parts of a multipart upload, the current part is in buffer
+  std::vector<FileBackedBuffer *> parts;
 };
 
 /**
@@ -69,6 +76,8 @@ class S3Uploader : public AbstractUploader {
                                       const shash::Any &content_hash);
 
   virtual void DoRemoveAsync(const std::string &file_to_delete);
+  virtual void DoRemoveBatchAsync(
+    const std::vector<std::string> &files_to_delete);
   virtual bool Peek(const std::string &path);
   virtual bool Mkdir(const std::string &path);
   virtual bool PlaceBootstrappingShortcut(const shash::Any &object);
@@ -90,6 +99,12 @@ class S3Uploader : public AbstractUploader {
   static const unsigned kDefaultBackoffInitMs = 100;
   static const unsigned kDefaultBackoffMaxMs = 2000;
   static const unsigned kInMemoryObjectThreshold = 500*1024;  // 500KiB
+  // Maximum number of keys in a multi-object delete request
+  static const unsigned kMaxDeleteBatch = 1000;
+  // Objects larger than a part are uploaded in parts of this size
+  static const uint64_t kDefaultMultipartPartSize = 16*1024*1024;  // 16MiB
+  // S3 rejects parts other than the last one below this size
+  static const uint64_t kMinMultipartPartSize = 5*1024*1024;  // 5MiB
 
   // Used to make the async HTTP requests synchronous in Peek() Create(),
   // and Upload() of single bits
@@ -106,8 +121,41 @@ class S3Uploader : public AbstractUploader {
     int pipe_wait[2];
   };
 
+  /**
+   * Objects that are larger than a part are uploaded with S3 multipart
+   * requests.  The parts are spooled while the data arrives and uploaded
+   * concurrently once the object key is known.  The MainCollectResults thread
+   * moves the upload from one request to the next.
+   */
+  struct MultipartUpload : SingleCopy {
+    MultipartUpload() : callback(NULL), size(0), parts_pending(0),
+                        failed(false) { }
+    ~MultipartUpload() {
+      for (unsigned i = 0; i < parts.size(); ++i)
+        delete parts[i];
+    }
+
+    std::string object_key;
+    const CallbackTN *callback;
+    uint64_t size;
+    // Handed over to the part upload requests once the upload id is known
+    std::vector<FileBackedBuffer *> parts;
+    std::string upload_id;
+    std::vector<std::string> etags;
+    unsigned parts_pending;
+    bool failed;
+  };
+
   void OnReqComplete(const upload::UploaderResults &results, RequestCtrl *ctrl);
 
+  void StartMultipartUpload(MultipartUpload *upload);
+  void OnMultipartJobComplete(const s3fanout::JobInfo &info);
+  void PushMultipartJob(MultipartUpload *upload,
+                        s3fanout::JobInfo::RequestType request,
+                        const std::string &query,
+                        FileBackedBuffer *origin);
+  void FinishMultipartUpload(MultipartUpload *upload, int return_code);
+
   static void *MainCollectResults(void *data);
 
   bool ParseSpoolerDefinition(const SpoolerDefinition &spooler_definition);
@@ -132,6 +180,7 @@ class S3Uploader : public AbstractUploader {
   bool peek_before_put_;
   bool use_https_;
   std::string proxy_;
+  uint64_t multipart_part_size_;
 
   const std::string temporary_path_;
   mutable atomic_int32 io_errors_;
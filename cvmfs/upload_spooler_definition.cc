@@ -33,6 +33,7 @@ SpoolerDefinition::SpoolerDefinition(
       min_file_chunk_size(min_file_chunk_size),
       avg_file_chunk_size(avg_file_chunk_size),
       max_file_chunk_size(max_file_chunk_size),
+      chunking_algorithm(kChunkingXor32),
       number_of_concurrent_uploads(kDefaultMaxConcurrentUploads),
       num_upload_tasks(kDefaultNumUploadTasks),
       session_token_file(session_token_file),
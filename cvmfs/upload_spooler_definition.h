@@ -9,6 +9,7 @@
 
 #include "compression.h"
 #include "crypto/hash.h"
+#include "ingestion/chunk_detector.h"
 
 namespace upload {
 
@@ -75,6 +76,11 @@ struct SpoolerDefinition {
   size_t min_file_chunk_size;
   size_t avg_file_chunk_size;
   size_t max_file_chunk_size;
+  /**
+   * The content-defined chunking algorithm, only relevant if file chunking is
+   * enabled.
+   */
+  ChunkingAlgorithms chunking_algorithm;
 
   /**
    * This is the number of concurrently open files to be uploaded. It does not,
@@ -21,6 +21,7 @@
 #include <sys/prctl.h>
 #include <sys/select.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/utsname.h>
 #include <unistd.h>
 
@@ -303,6 +304,20 @@ inline int platform_invalidate_kcache(const int fd, const off_t offset,
   return posix_fadvise(fd, offset, length, POSIX_FADV_DONTNEED);
 }
 
+/**
+ * Creates an anonymous, file-backed memory area that can be handed to another
+ * process as a file descriptor.  Calls the system call directly because older
+ * glibc versions lack the memfd_create() wrapper.
+ */
+inline int platform_memfd(const char *name) {
+#ifdef __NR_memfd_create
+  return syscall(__NR_memfd_create, name, 1U /* MFD_CLOEXEC */);
+#else
+  errno = ENOSYS;
+  return -1;
+#endif
+}
+
 inline std::string platform_libname(const std::string &base_name) {
   return "lib" + base_name + ".so";
 }
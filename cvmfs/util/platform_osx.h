@@ -9,6 +9,7 @@
 
 #include <alloca.h>
 #include <dirent.h>
+#include <errno.h>
 #include <fcntl.h>
 #if defined(__MAC_OS_X_VERSION_MIN_REQUIRED) && \
     __MAC_OS_X_VERSION_MIN_REQUIRED >= 101200
@@ -237,6 +238,11 @@ inline ssize_t platform_readahead(int filedes) {
   return 0;
 }
 
+inline int platform_memfd(const char * /*name*/) {
+  errno = ENOSYS;
+  return -1;
+}
+
 inline bool read_line(FILE *f, std::string *line) {
   char *buffer_line = NULL;
   size_t buffer_size = 0;
@@ -0,0 +1,14 @@
+#!/bin/sh
+
+# Only the static library is needed, build it directly from the sources
+cd lib
+rm -f *.o libzstd.a
+for src in common/*.c compress/*.c decompress/*.c; do
+  cc $CVMFS_BASE_C_FLAGS -O3 -fPIC -DZSTD_DISABLE_ASM \
+    -c $src -o $(basename $src .c).o || exit 1
+done
+ar rcs libzstd.a *.o
+strip -S libzstd.a
+
+cp -v zstd.h zstd_errors.h zdict.h $EXTERNALS_INSTALL_LOCATION/include/
+cp -v libzstd.a $EXTERNALS_INSTALL_LOCATION/lib/
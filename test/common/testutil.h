@@ -592,6 +592,7 @@ class MockCatalogManager : public AbstractCatalogManager<MockCatalog> {
 
   unsigned GetNumAutogeneratedCatalogs() { return autogenerated_catalogs_; }
   unsigned GetNumAddedFiles() { return num_added_files_; }
+  const std::vector<PathString> &prefetched() const { return prefetched_; }
 
   MockCatalog *FindCatalog(const PathString &path) {
     map<PathString, MockCatalog*>::iterator it;
@@ -620,6 +621,13 @@ class MockCatalogManager : public AbstractCatalogManager<MockCatalog> {
     ++autogenerated_catalogs_;
   }
 
+ protected:
+  virtual MockCatalog* PrefetchCatalog(const PathString &mountpoint,
+                                       const shash::Any &hash)
+  {
+    prefetched_.push_back(mountpoint);
+    return NULL;
+  }
 
 
  private:
@@ -634,6 +642,7 @@ class MockCatalogManager : public AbstractCatalogManager<MockCatalog> {
   unsigned balance_weight_;
   unsigned autogenerated_catalogs_;
   unsigned num_added_files_;
+  std::vector<PathString> prefetched_;
 };
 
 }  // namespace catalog
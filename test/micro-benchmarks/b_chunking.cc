@@ -0,0 +1,181 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+#define __STDC_FORMAT_MACROS
+#include <benchmark/benchmark.h>
+
+#include <inttypes.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <set>
+#include <vector>
+
+#include "bm_util.h"
+#include "crypto/hash.h"
+#include "ingestion/chunk_detector.h"
+#include "ingestion/item.h"
+#include "ingestion/item_mem.h"
+#include "util/pointer.h"
+#include "util/prng.h"
+
+/**
+ * Compares the content-defined chunking algorithms.  The throughput is measured
+ * on random data.  The dedup ratio is the fraction of bytes of a modified copy
+ * of the data that is found in chunks of the original data.
+ */
+class BM_Chunking : public benchmark::Fixture {
+ protected:
+  static const unsigned kDataSize = 32 * 1024 * 1024;
+  static const unsigned kBlockSize = 2 * 1024 * 1024;
+  static const unsigned kAvgChunkSize = 64 * 1024;
+  static const unsigned kNumModifications = 16;
+
+  virtual void SetUp(const benchmark::State &st) {
+    prng_.InitSeed(42);
+    original_.resize(kDataSize);
+    for (unsigned i = 0; i < kDataSize; ++i)
+      original_[i] = static_cast<unsigned char>(prng_.Next(256));
+
+    // Insert and delete a few short byte sequences at random positions
+    modified_ = original_;
+    for (unsigned i = 0; i < kNumModifications; ++i) {
+      unsigned pos = prng_.Next(modified_.size() - 128);
+      unsigned len = prng_.Next(64) + 1;
+      if (i % 2 == 0) {
+        modified_.insert(modified_.begin() + pos, len,
+                         static_cast<unsigned char>(prng_.Next(256)));
+      } else {
+        modified_.erase(modified_.begin() + pos,
+                        modified_.begin() + pos + len);
+      }
+    }
+
+    MakeBlocks(original_, &blocks_original_);
+    MakeBlocks(modified_, &blocks_modified_);
+  }
+
+  virtual void TearDown(const benchmark::State &st) {
+    FreeBlocks(&blocks_original_);
+    FreeBlocks(&blocks_modified_);
+    original_.clear();
+    modified_.clear();
+  }
+
+  void MakeBlocks(const std::vector<unsigned char> &data,
+                  std::vector<BlockItem *> *blocks)
+  {
+    for (unsigned offset = 0; offset < data.size(); offset += kBlockSize) {
+      unsigned size = std::min(static_cast<unsigned>(data.size()) - offset,
+                               kBlockSize);
+      BlockItem *block = new BlockItem(&allocator_);
+      block->MakeDataCopy(&data[offset], size);
+      blocks->push_back(block);
+    }
+  }
+
+  static void FreeBlocks(std::vector<BlockItem *> *blocks) {
+    for (unsigned i = 0; i < blocks->size(); ++i)
+      delete (*blocks)[i];
+    blocks->clear();
+  }
+
+  static ChunkDetector *MakeDetector(ChunkingAlgorithms algorithm) {
+    return CreateChunkDetector(algorithm, kAvgChunkSize / 2, kAvgChunkSize,
+                               kAvgChunkSize * 2);
+  }
+
+  /**
+   * Feeds the blocks into a new chunk detector and returns the list of cut
+   * marks, including the end of the data
+   */
+  static std::vector<uint64_t> Chunk(ChunkingAlgorithms algorithm,
+                                     const std::vector<BlockItem *> &blocks,
+                                     const uint64_t size)
+  {
+    UniquePtr<ChunkDetector> detector(MakeDetector(algorithm));
+    std::vector<uint64_t> cut_marks;
+    for (unsigned i = 0; i < blocks.size(); ++i) {
+      uint64_t cut_mark;
+      while ((cut_mark = detector->FindNextCutMark(blocks[i])) != 0) {
+        if (cut_mark < size)
+          cut_marks.push_back(cut_mark);
+      }
+    }
+    cut_marks.push_back(size);
+    return cut_marks;
+  }
+
+  static std::set<shash::Any> HashChunks(
+    const std::vector<unsigned char> &data,
+    const std::vector<uint64_t> &cut_marks)
+  {
+    std::set<shash::Any> result;
+    uint64_t last_cut = 0;
+    for (unsigned i = 0; i < cut_marks.size(); ++i) {
+      shash::Any hash(shash::kMd5);
+      shash::HashMem(&data[last_cut], cut_marks[i] - last_cut, &hash);
+      result.insert(hash);
+      last_cut = cut_marks[i];
+    }
+    return result;
+  }
+
+  void SetDedupLabel(ChunkingAlgorithms algorithm, benchmark::State *st) {
+    std::vector<uint64_t> cuts_original =
+      Chunk(algorithm, blocks_original_, original_.size());
+    std::vector<uint64_t> cuts_modified =
+      Chunk(algorithm, blocks_modified_, modified_.size());
+    std::set<shash::Any> hashes = HashChunks(original_, cuts_original);
+
+    uint64_t deduplicated = 0;
+    uint64_t last_cut = 0;
+    for (unsigned i = 0; i < cuts_modified.size(); ++i) {
+      shash::Any hash(shash::kMd5);
+      uint64_t size = cuts_modified[i] - last_cut;
+      shash::HashMem(&modified_[last_cut], size, &hash);
+      if (hashes.count(hash) > 0)
+        deduplicated += size;
+      last_cut = cuts_modified[i];
+    }
+
+    char label[64];
+    snprintf(label, sizeof(label), "dedup %.1f%%, avg chunk %" PRIu64 " kB",
+             100.0 * static_cast<double>(deduplicated) /
+               static_cast<double>(modified_.size()),
+             static_cast<uint64_t>(modified_.size() / cuts_modified.size()) /
+               1024);
+    st->SetLabel(label);
+  }
+
+  void RunThroughput(ChunkingAlgorithms algorithm, benchmark::State *st) {
+    while (st->KeepRunning()) {
+      std::vector<uint64_t> cut_marks =
+        Chunk(algorithm, blocks_original_, original_.size());
+      Escape(&cut_marks[0]);
+    }
+    st->SetBytesProcessed(int64_t(st->iterations()) * kDataSize);
+    SetDedupLabel(algorithm, st);
+  }
+
+  Prng prng_;
+  ItemAllocator allocator_;
+  std::vector<unsigned char> original_;
+  std::vector<unsigned char> modified_;
+  std::vector<BlockItem *> blocks_original_;
+  std::vector<BlockItem *> blocks_modified_;
+};
+
+
+BENCHMARK_DEFINE_F(BM_Chunking, Xor32)(benchmark::State &st) {
+  RunThroughput(kChunkingXor32, &st);
+}
+BENCHMARK_REGISTER_F(BM_Chunking, Xor32)->Repetitions(3);
+
+
+BENCHMARK_DEFINE_F(BM_Chunking, FastCdc)(benchmark::State &st) {
+  RunThroughput(kChunkingFastCdc, &st);
+}
+BENCHMARK_REGISTER_F(BM_Chunking, FastCdc)->Repetitions(3);
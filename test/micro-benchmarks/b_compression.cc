@@ -5,11 +5,16 @@
 
 #include <inttypes.h>
 
+#include <cassert>
+#include <cstdio>
 #include <cstdlib>
 #include <cstring>
 
 #include "bm_util.h"
 #include "compression.h"
+#include "util/pointer.h"
+#include "util/prng.h"
+#include "util/smalloc.h"
 
 class BM_Compression : public benchmark::Fixture {
  protected:
@@ -18,6 +23,85 @@ class BM_Compression : public benchmark::Fixture {
 
   virtual void TearDown(const benchmark::State &st) {
   }
+
+  /**
+   * Somewhat compressible data: random bytes from a small alphabet
+   */
+  static void FillBuffer(unsigned char *buffer, unsigned size) {
+    Prng prng;
+    prng.InitSeed(42);
+    for (unsigned i = 0; i < size; ++i)
+      buffer[i] = 'a' + prng.Next(16);
+  }
+
+  static void Compress(zlib::Algorithms alg,
+                       unsigned char *buffer, unsigned size,
+                       void **out_buf, uint64_t *out_size)
+  {
+    UniquePtr<zlib::Compressor> compressor(zlib::Compressor::Construct(alg));
+    *out_buf = smalloc(compressor->DeflateBound(size));
+    *out_size = 0;
+    unsigned char *input = buffer;
+    size_t remaining = size;
+    bool done = false;
+    while (!done) {
+      unsigned char *out =
+        static_cast<unsigned char *>(*out_buf) + *out_size;
+      size_t avail = compressor->DeflateBound(size) - *out_size;
+      done = compressor->Deflate(true, &input, &remaining, &out, &avail);
+      *out_size += avail;
+    }
+  }
+
+  void RunCompress(zlib::Algorithms alg, benchmark::State *st) {
+    unsigned size = st->range(0);
+    unsigned char *buffer = static_cast<unsigned char *>(smalloc(size));
+    FillBuffer(buffer, size);
+    uint64_t out_size = 0;
+    while (st->KeepRunning()) {
+      void *out_buf;
+      Compress(alg, buffer, size, &out_buf, &out_size);
+      Escape(out_buf);
+      free(out_buf);
+    }
+    st->SetBytesProcessed(int64_t(st->iterations()) * size);
+    SetRatioLabel(size, out_size, st);
+    free(buffer);
+  }
+
+  void RunDecompress(zlib::Algorithms alg, benchmark::State *st) {
+    unsigned size = st->range(0);
+    unsigned char *buffer = static_cast<unsigned char *>(smalloc(size));
+    FillBuffer(buffer, size);
+    void *compressed;
+    uint64_t compressed_size;
+    Compress(alg, buffer, size, &compressed, &compressed_size);
+    while (st->KeepRunning()) {
+      void *out_buf;
+      uint64_t out_size;
+      bool retval = (alg == zlib::kZstdDefault)
+        ? zlib::DecompressZstdMem2Mem(compressed, compressed_size,
+                                      &out_buf, &out_size)
+        : zlib::DecompressMem2Mem(compressed, compressed_size,
+                                  &out_buf, &out_size);
+      assert(retval && (out_size == size));
+      Escape(out_buf);
+      free(out_buf);
+    }
+    st->SetBytesProcessed(int64_t(st->iterations()) * size);
+    SetRatioLabel(size, compressed_size, st);
+    free(compressed);
+    free(buffer);
+  }
+
+  static void SetRatioLabel(uint64_t size, uint64_t compressed_size,
+                            benchmark::State *st)
+  {
+    char label[32];
+    snprintf(label, sizeof(label), "ratio %.2f",
+             static_cast<double>(size) / static_cast<double>(compressed_size));
+    st->SetLabel(label);
+  }
 };
 
 
@@ -34,3 +118,31 @@ BENCHMARK_DEFINE_F(BM_Compression, Zlib)(benchmark::State &st) {
 }
 BENCHMARK_REGISTER_F(BM_Compression, Zlib)->Repetitions(3)->
   Arg(100)->Arg(4096)->Arg(100*1024);
+
+
+BENCHMARK_DEFINE_F(BM_Compression, CompressZlib)(benchmark::State &st) {
+  RunCompress(zlib::kZlibDefault, &st);
+}
+BENCHMARK_REGISTER_F(BM_Compression, CompressZlib)->Repetitions(3)->
+  Arg(4096)->Arg(1024*1024);
+
+
+BENCHMARK_DEFINE_F(BM_Compression, CompressZstd)(benchmark::State &st) {
+  RunCompress(zlib::kZstdDefault, &st);
+}
+BENCHMARK_REGISTER_F(BM_Compression, CompressZstd)->Repetitions(3)->
+  Arg(4096)->Arg(1024*1024);
+
+
+BENCHMARK_DEFINE_F(BM_Compression, DecompressZlib)(benchmark::State &st) {
+  RunDecompress(zlib::kZlibDefault, &st);
+}
+BENCHMARK_REGISTER_F(BM_Compression, DecompressZlib)->Repetitions(3)->
+  Arg(4096)->Arg(1024*1024);
+
+
+BENCHMARK_DEFINE_F(BM_Compression, DecompressZstd)(benchmark::State &st) {
+  RunDecompress(zlib::kZstdDefault, &st);
+}
+BENCHMARK_REGISTER_F(BM_Compression, DecompressZstd)->Repetitions(3)->
+  Arg(4096)->Arg(1024*1024);
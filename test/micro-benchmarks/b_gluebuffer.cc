@@ -4,6 +4,8 @@
 #define __STDC_FORMAT_MACROS
 #include <benchmark/benchmark.h>
 
+#include <pthread.h>
+
 #include <cassert>
 #include <string>
 #include <vector>
@@ -50,7 +52,9 @@ class BM_InodeTracker : public benchmark::Fixture {
     assert(inodes_.size() == paths_.size());
 
     inode_tracker_ = new glue::InodeTracker();
-    inode_tracker_->VfsGet(kNumInodes + 1, PathString("/", 1));
+    inode_tracker_->VfsGet(
+      glue::InodeEx(kNumInodes + 1, glue::InodeEx::kDirectory),
+      PathString("/", 1));
   }
 
   virtual void TearDown(const benchmark::State &st) {
@@ -59,6 +63,10 @@ class BM_InodeTracker : public benchmark::Fixture {
     paths_.clear();
   }
 
+  glue::InodeEx InodeAt(unsigned idx) {
+    return glue::InodeEx(inodes_[idx], glue::InodeEx::kRegular);
+  }
+
   // Construction of paths_ needs to be changed if this number changes
   static const unsigned kNumInodes = 11111;
 
@@ -72,7 +80,7 @@ BENCHMARK_DEFINE_F(BM_InodeTracker, Get)(benchmark::State &st) {
   unsigned i = 0;
   while (st.KeepRunning()) {
     unsigned idx = i % kNumInodes;
-    inode_tracker_->VfsGet(inodes_[idx], paths_[idx]);
+    inode_tracker_->VfsGet(InodeAt(idx), paths_[idx]);
     ++i;
   }
   st.SetItemsProcessed(st.iterations());
@@ -87,7 +95,7 @@ BENCHMARK_DEFINE_F(BM_InodeTracker, GetPut)(benchmark::State &st) {
   while (st.KeepRunning()) {
     unsigned idx = i % 5000;
     if (((i / 5000) % 2) == 0) {
-      inode_tracker_->VfsGet(inodes_[idx], paths_[idx]);
+      inode_tracker_->VfsGet(InodeAt(idx), paths_[idx]);
     } else {
       inode_tracker_->VfsPut(inodes_[idx], 1);
     }
@@ -101,13 +109,14 @@ BENCHMARK_REGISTER_F(BM_InodeTracker, GetPut)->Repetitions(3);
 BENCHMARK_DEFINE_F(BM_InodeTracker, FindPath)(benchmark::State &st) {
   unsigned size = st.range(0);
   for (unsigned i = 0; i < size; ++i)
-    inode_tracker_->VfsGet(inodes_[i], paths_[i]);
+    inode_tracker_->VfsGet(InodeAt(i), paths_[i]);
 
   unsigned i = 0;
-  PathString path;
   while (st.KeepRunning()) {
     unsigned idx = i % size;
-    bool retval = inode_tracker_->FindPath(inodes_[idx], &path);
+    PathString path;
+    glue::InodeEx inode_ex = InodeAt(idx);
+    bool retval = inode_tracker_->FindPath(&inode_ex, &path);
     assert(retval == true);
     Escape(&path);
     ++i;
@@ -120,7 +129,7 @@ BENCHMARK_REGISTER_F(BM_InodeTracker, FindPath)->Repetitions(3)->Arg(10000);
 BENCHMARK_DEFINE_F(BM_InodeTracker, FindInode)(benchmark::State &st) {
   unsigned size = st.range(0);
   for (unsigned i = 0; i < size; ++i)
-    inode_tracker_->VfsGet(inodes_[i], paths_[i]);
+    inode_tracker_->VfsGet(InodeAt(i), paths_[i]);
 
   unsigned i = 0;
   uint64_t inode;
@@ -138,10 +147,187 @@ BENCHMARK_REGISTER_F(BM_InodeTracker, FindInode)->Repetitions(3)->Arg(10000);
 BENCHMARK_DEFINE_F(BM_InodeTracker, Nadd)(benchmark::State &st) {
   unsigned size = st.range(0);
   while (st.KeepRunning()) {
-    glue::NentryTracker tracker;
+    glue::DentryTracker tracker;
     for (unsigned i = 0; i < size; ++i)
       tracker.Add(0, "libCore.so", 1000);
   }
   st.SetItemsProcessed(st.iterations() * size);
 }
 BENCHMARK_REGISTER_F(BM_InodeTracker, Nadd)->Repetitions(3)->Arg(100000);
+
+
+/**
+ * Lookups and forgets from st.range(0) threads, similar to the fuse worker
+ * threads under metadata churn.  Every thread repeatedly looks up its own
+ * slice of the inodes and forgets them again, one by one or, with st.range(1)
+ * set, in batches of kBatchSize as with the forget_multi callback.
+ */
+class BM_InodeTrackerConcurrent : public benchmark::Fixture {
+ protected:
+  static const unsigned kNumInodes = 16384;
+  static const unsigned kBatchSize = 64;
+  static const unsigned kNumRounds = 4;
+
+  struct WorkerInfo {
+    glue::InodeTracker *inode_tracker;
+    const vector<PathString> *paths;
+    unsigned first_idx;
+    unsigned num_inodes;
+    bool batch;
+  };
+
+  static void *MainWorker(void *data) {
+    WorkerInfo *info = reinterpret_cast<WorkerInfo *>(data);
+    glue::InodeTracker *tracker = info->inode_tracker;
+    const unsigned last_idx = info->first_idx + info->num_inodes;
+    for (unsigned r = 0; r < kNumRounds; ++r) {
+      for (unsigned i = info->first_idx; i < last_idx; ++i) {
+        tracker->VfsGet(glue::InodeEx(i + 2, glue::InodeEx::kRegular),
+                        (*info->paths)[i]);
+      }
+      if (info->batch) {
+        vector<uint64_t> removed;
+        glue::InodeTracker::VfsPutBatch batch(tracker);
+        for (unsigned i = info->first_idx; i < last_idx; ++i) {
+          batch.Add(i + 2, 1);
+          if (((i + 1) % kBatchSize) == 0)
+            batch.Commit(&removed);
+        }
+        batch.Commit(&removed);
+        assert(removed.size() == info->num_inodes);
+      } else {
+        for (unsigned i = info->first_idx; i < last_idx; ++i)
+          tracker->VfsPut(i + 2, 1);
+      }
+    }
+    return NULL;
+  }
+
+  virtual void SetUp(const benchmark::State &st) {
+    for (unsigned i = 0; i < kNumInodes; ++i) {
+      paths_.push_back(PathString("/" + StringifyInt(i / 128) + "/" +
+                                  StringifyInt(i)));
+    }
+    inode_tracker_ = new glue::InodeTracker();
+    inode_tracker_->VfsGet(glue::InodeEx(1, glue::InodeEx::kDirectory),
+                           PathString("", 0));
+  }
+
+  virtual void TearDown(const benchmark::State &st) {
+    delete inode_tracker_;
+    paths_.clear();
+  }
+
+  vector<PathString> paths_;
+  glue::InodeTracker *inode_tracker_;
+};
+
+
+BENCHMARK_DEFINE_F(BM_InodeTrackerConcurrent, GetPut)(benchmark::State &st) {
+  const unsigned num_threads = st.range(0);
+  vector<WorkerInfo> infos(num_threads);
+  vector<pthread_t> threads(num_threads);
+  for (unsigned i = 0; i < num_threads; ++i) {
+    infos[i].inode_tracker = inode_tracker_;
+    infos[i].paths = &paths_;
+    infos[i].num_inodes = kNumInodes / num_threads;
+    infos[i].first_idx = i * infos[i].num_inodes;
+    infos[i].batch = st.range(1);
+  }
+  while (st.KeepRunning()) {
+    for (unsigned i = 0; i < num_threads; ++i) {
+      int retval = pthread_create(&threads[i], NULL, MainWorker, &infos[i]);
+      assert(retval == 0);
+    }
+    for (unsigned i = 0; i < num_threads; ++i)
+      pthread_join(threads[i], NULL);
+  }
+  st.SetItemsProcessed(int64_t(st.iterations()) * kNumRounds *
+                       (kNumInodes / num_threads) * num_threads);
+  st.SetLabel(st.range(1) ? "batch" : "single");
+}
+BENCHMARK_REGISTER_F(BM_InodeTrackerConcurrent, GetPut)->Repetitions(3)->
+  UseRealTime()->
+  ArgPair(1, 0)->ArgPair(1, 1)->
+  ArgPair(2, 0)->ArgPair(2, 1)->
+  ArgPair(4, 0)->ArgPair(4, 1)->
+  ArgPair(8, 0)->ArgPair(8, 1);
+
+
+/**
+ * Path store filled with a layout similar to a software release area: a few
+ * long platform directories, short directory names, and file names of mixed
+ * length.  The label reports the memory taken per stored file.
+ */
+class BM_PathStore : public benchmark::Fixture {
+ protected:
+  virtual void SetUp(const benchmark::State &st) {
+    const char *platforms[] = {"x86_64-el9-gcc13-opt", "aarch64-el9-gcc13-opt"};
+    const char *dirs[] = {"bin", "lib", "include", "share"};
+    for (unsigned r = 0; r < 10; ++r) {
+      for (unsigned p = 0; p < 2; ++p) {
+        for (unsigned d = 0; d < 4; ++d) {
+          for (unsigned f = 0; f < 250; ++f) {
+            string path = "/sw/" + StringifyInt(r) + ".0.0/" + platforms[p] +
+                          "/" + dirs[d] + "/libModule" + StringifyInt(f) +
+                          (((f % 4) == 0) ? "_rdict.pcm" : ".so");
+            paths_.push_back(PathString(path));
+            md5paths_.push_back(shash::Md5(path.data(), path.length()));
+          }
+        }
+      }
+    }
+  }
+
+  virtual void TearDown(const benchmark::State &st) {
+    paths_.clear();
+    md5paths_.clear();
+  }
+
+  void Fill(glue::PathStore *path_store) {
+    for (unsigned i = 0; i < paths_.size(); ++i)
+      path_store->Insert(md5paths_[i], paths_[i]);
+  }
+
+  void SetMemoryLabel(benchmark::State *st,
+                      const glue::PathStore &path_store)
+  {
+    st->SetLabel(StringifyInt(path_store.GetMemoryUsage() / paths_.size()) +
+                 " bytes/path");
+  }
+
+  vector<PathString> paths_;
+  vector<shash::Md5> md5paths_;
+};
+
+
+BENCHMARK_DEFINE_F(BM_PathStore, Insert)(benchmark::State &st) {
+  while (st.KeepRunning()) {
+    glue::PathStore path_store;
+    Fill(&path_store);
+  }
+  st.SetItemsProcessed(int64_t(st.iterations()) * paths_.size());
+
+  glue::PathStore path_store;
+  Fill(&path_store);
+  SetMemoryLabel(&st, path_store);
+}
+BENCHMARK_REGISTER_F(BM_PathStore, Insert)->Repetitions(3);
+
+
+BENCHMARK_DEFINE_F(BM_PathStore, Lookup)(benchmark::State &st) {
+  glue::PathStore path_store;
+  Fill(&path_store);
+  SetMemoryLabel(&st, path_store);
+
+  unsigned i = 0;
+  while (st.KeepRunning()) {
+    PathString path;
+    bool retval = path_store.Lookup(md5paths_[i % md5paths_.size()], &path);
+    assert(retval);
+    Escape(&path);
+    ++i;
+  }
+  st.SetItemsProcessed(st.iterations());
+}
+BENCHMARK_REGISTER_F(BM_PathStore, Lookup)->Repetitions(3);
@@ -3,8 +3,11 @@
  */
 #include <benchmark/benchmark.h>
 
+#include <alloca.h>
+
 #include <cstdlib>
 #include <cstring>
+#include <vector>
 
 #include "bm_util.h"
 #include "crypto/hash.h"
@@ -23,6 +26,21 @@ class BM_Hash : public benchmark::Fixture {
     free(long_path_);
   }
 
+  /**
+   * Hashes a buffer of st.range(0) bytes, reports the throughput
+   */
+  static void RunThroughput(shash::Algorithms algorithm,
+                            benchmark::State *st)
+  {
+    std::vector<unsigned char> buffer(st->range(0), 'x');
+    shash::Any digest(algorithm);
+    while (st->KeepRunning()) {
+      shash::HashMem(&buffer[0], buffer.size(), &digest);
+      Escape(&digest);
+    }
+    st->SetBytesProcessed(int64_t(st->iterations()) * buffer.size());
+  }
+
   char *short_path_;
   char *long_path_;
 };
@@ -63,3 +81,64 @@ BENCHMARK_DEFINE_F(BM_Hash, Sha1)(benchmark::State &st) {
 }
 BENCHMARK_REGISTER_F(BM_Hash, Sha1)->Repetitions(3)->Arg(100)->Arg(4096)->
   Arg(100*1024);
+
+
+BENCHMARK_DEFINE_F(BM_Hash, Md5Throughput)(benchmark::State &st) {
+  RunThroughput(shash::kMd5, &st);
+}
+BENCHMARK_REGISTER_F(BM_Hash, Md5Throughput)->Repetitions(3)->
+  Arg(4096)->Arg(1024*1024);
+
+
+BENCHMARK_DEFINE_F(BM_Hash, Sha1Throughput)(benchmark::State &st) {
+  RunThroughput(shash::kSha1, &st);
+}
+BENCHMARK_REGISTER_F(BM_Hash, Sha1Throughput)->Repetitions(3)->
+  Arg(4096)->Arg(1024*1024);
+
+
+BENCHMARK_DEFINE_F(BM_Hash, Rmd160Throughput)(benchmark::State &st) {
+  RunThroughput(shash::kRmd160, &st);
+}
+BENCHMARK_REGISTER_F(BM_Hash, Rmd160Throughput)->Repetitions(3)->
+  Arg(4096)->Arg(1024*1024);
+
+
+BENCHMARK_DEFINE_F(BM_Hash, Shake128Throughput)(benchmark::State &st) {
+  RunThroughput(shash::kShake128, &st);
+}
+BENCHMARK_REGISTER_F(BM_Hash, Shake128Throughput)->Repetitions(3)->
+  Arg(4096)->Arg(1024*1024);
+
+
+/**
+ * 16 independent SHA-1 streams through shash::UpdateMulti().  Compare to
+ * Sha1Throughput.
+ */
+BENCHMARK_DEFINE_F(BM_Hash, Sha1MultiThroughput)(benchmark::State &st) {
+  const unsigned kNumBuffers = 16;
+  std::vector<unsigned char> buffer(st.range(0), 'x');
+  const unsigned char *buffers[kNumBuffers];
+  unsigned buffer_sizes[kNumBuffers];
+  shash::ContextPtr contexts[kNumBuffers];
+  for (unsigned i = 0; i < kNumBuffers; ++i) {
+    buffers[i] = &buffer[0];
+    buffer_sizes[i] = buffer.size();
+    contexts[i] = shash::ContextPtr(shash::kSha1);
+    contexts[i].buffer = alloca(contexts[i].size);
+  }
+  shash::Any digest(shash::kSha1);
+  while (st.KeepRunning()) {
+    for (unsigned i = 0; i < kNumBuffers; ++i)
+      shash::Init(contexts[i]);
+    shash::UpdateMulti(buffers, buffer_sizes, contexts, kNumBuffers);
+    for (unsigned i = 0; i < kNumBuffers; ++i)
+      shash::Final(contexts[i], &digest);
+    Escape(&digest);
+  }
+  st.SetBytesProcessed(
+    int64_t(st.iterations()) * kNumBuffers * buffer.size());
+  st.SetLabel((StringifyInt(shash::GetMultiBufferLanes()) + " lanes").c_str());
+}
+BENCHMARK_REGISTER_F(BM_Hash, Sha1MultiThroughput)->Repetitions(3)->
+  Arg(4096)->Arg(1024*1024);
@@ -3,12 +3,14 @@
  */
 #include <benchmark/benchmark.h>
 
+#include <sys/mman.h>
 #include <sys/socket.h>
 #include <sys/un.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
 #include <cassert>
+#include <cstring>
 #include <string>
 
 #include "bm_util.h"
@@ -107,3 +109,289 @@ BENCHMARK_DEFINE_F(BM_Messaging, CacheHandshake)(benchmark::State &st) {
 }
 BENCHMARK_REGISTER_F(BM_Messaging, CacheHandshake)->Repetitions(3)->
   Arg(1024)->Arg(128*1024)->UseRealTime();
+
+
+/**
+ * Read throughput of the external cache protocol, payload through the socket
+ * (range(1) == 0) or through a shared memory slot (range(1) == 1).
+ */
+BENCHMARK_DEFINE_F(BM_Messaging, CacheRead)(benchmark::State &st) {
+  const unsigned size = st.range(0);
+  const bool use_shm = st.range(1);
+  string socket_path = "/tmp/cvmfs_benchmark.socket";
+  int fd_socket = MakeSocket(socket_path, 0600);
+  int retval = listen(fd_socket, 1);
+  assert(retval == 0);
+
+  pid_t pid;
+  switch (pid = fork()) {
+    case -1:
+      abort();
+    case 0:
+      struct sockaddr_un remote;
+      socklen_t socket_size = sizeof(remote);
+      int fd_connection = accept(fd_socket,
+                                 (struct sockaddr *)&remote,
+                                 &socket_size);
+      assert(fd_connection >= 0);
+      CacheTransport transport(fd_connection);
+      char buffer[size];
+      memset(buffer, 'x', size);
+      unsigned char *shm_area = NULL;
+      while (true) {
+        CacheTransport::Frame frame_recv;
+        retval = transport.RecvFrame(&frame_recv);
+        assert(retval);
+        google::protobuf::MessageLite *msg_typed = frame_recv.GetMsgTyped();
+        if (msg_typed->GetTypeName() == "cvmfs.MsgHandshake") {
+          if (frame_recv.fd_passed() >= 0) {
+            shm_area = CacheTransport::MapShmArea(frame_recv.fd_passed(), size);
+            assert(shm_area != NULL);
+            close(frame_recv.fd_passed());
+          }
+          cvmfs::MsgHandshakeAck msg;
+          msg.set_status(cvmfs::STATUS_OK);
+          msg.set_name("unit test cache manager");
+          msg.set_protocol_version(1);
+          msg.set_session_id(42);
+          msg.set_max_object_size(size);
+          msg.set_capabilities(0);
+          if (shm_area != NULL)
+            msg.set_shm_slots(1);
+          CacheTransport::Frame frame_send(&msg);
+          transport.SendFrame(&frame_send);
+        } else if (msg_typed->GetTypeName() == "cvmfs.MsgReadReq") {
+          cvmfs::MsgReadReq *msg_req =
+            reinterpret_cast<cvmfs::MsgReadReq *>(msg_typed);
+          cvmfs::MsgReadReply msg;
+          msg.set_req_id(msg_req->req_id());
+          msg.set_status(cvmfs::STATUS_OK);
+          CacheTransport::Frame frame_send(&msg);
+          if (msg_req->has_shm_slot()) {
+            memcpy(shm_area, buffer, size);
+            msg.set_shm_size(size);
+          } else {
+            frame_send.set_attachment(buffer, size);
+          }
+          transport.SendFrame(&frame_send);
+        } else if (msg_typed->GetTypeName() == "cvmfs.MsgQuit") {
+          break;
+        }
+      }
+      shutdown(fd_connection, SHUT_RDWR);
+      close(fd_connection);
+      close(fd_socket);
+      unlink(socket_path.c_str());
+      exit(0);
+  }
+
+  int fd_client = ConnectSocket(socket_path);
+  assert(fd_client >= 0);
+  CacheTransport transport(fd_client);
+
+  cvmfs::MsgHandshake msg_handshake;
+  msg_handshake.set_protocol_version(1);
+  CacheTransport::Frame frame_handshake(&msg_handshake);
+  unsigned char *shm_area = NULL;
+  int fd_shm = -1;
+  if (use_shm) {
+    fd_shm = CacheTransport::CreateShmArea(size);
+    assert(fd_shm >= 0);
+    shm_area = CacheTransport::MapShmArea(fd_shm, size);
+    assert(shm_area != NULL);
+    msg_handshake.set_shm_slots(1);
+    frame_handshake.set_fd_passed(fd_shm);
+  }
+  transport.SendFrame(&frame_handshake);
+  if (fd_shm >= 0)
+    close(fd_shm);
+  CacheTransport::Frame frame_ack;
+  retval = transport.RecvFrame(&frame_ack);
+  assert(retval);
+
+  char buffer[size];
+  uint64_t req_id = 0;
+  while (st.KeepRunning()) {
+    cvmfs::MsgHash object_id;
+    object_id.set_algorithm(cvmfs::HASH_SHA1);
+    object_id.set_digest(string(20, '\0'));
+    cvmfs::MsgReadReq msg_read;
+    msg_read.set_session_id(42);
+    msg_read.set_req_id(req_id++);
+    msg_read.set_allocated_object_id(&object_id);
+    msg_read.set_offset(0);
+    msg_read.set_size(size);
+    if (use_shm)
+      msg_read.set_shm_slot(0);
+    CacheTransport::Frame frame_send(&msg_read);
+    transport.SendFrame(&frame_send);
+    msg_read.release_object_id();
+
+    CacheTransport::Frame frame_recv;
+    frame_recv.set_attachment(buffer, size);
+    retval = transport.RecvFrame(&frame_recv);
+    assert(retval);
+    cvmfs::MsgReadReply *msg_reply =
+      reinterpret_cast<cvmfs::MsgReadReply *>(frame_recv.GetMsgTyped());
+    assert(msg_reply->status() == cvmfs::STATUS_OK);
+    // Like the cache manager, copy from the slot into the caller's buffer
+    if (use_shm)
+      memcpy(buffer, shm_area, msg_reply->shm_size());
+  }
+  st.SetItemsProcessed(st.iterations());
+  st.SetBytesProcessed(int64_t(st.iterations()) * int64_t(size));
+
+  cvmfs::MsgQuit msg_quit;
+  msg_quit.set_session_id(42);
+  CacheTransport::Frame frame(&msg_quit);
+  transport.SendFrame(&frame);
+  close(fd_client);
+  close(fd_socket);
+  if (shm_area != NULL)
+    munmap(shm_area, size);
+  int statloc;
+  waitpid(pid, &statloc, 0);
+}
+BENCHMARK_REGISTER_F(BM_Messaging, CacheRead)->Repetitions(3)->
+  ArgPair(4 * 1024, 0)->ArgPair(4 * 1024, 1)->
+  ArgPair(256 * 1024, 0)->ArgPair(256 * 1024, 1)->UseRealTime();
+
+
+/**
+ * Cold read throughput of the external cache protocol for reads that span
+ * kNumRanges objects, e.g. consecutive chunks of a file that is not in the
+ * page cache.  The ranges are fetched with one request each (range(1) == 0) or
+ * with a single vectored request (range(1) == 1).
+ */
+BENCHMARK_DEFINE_F(BM_Messaging, CacheReadV)(benchmark::State &st) {
+  const unsigned kNumRanges = 4;
+  const unsigned size = st.range(0);
+  const bool use_vector = st.range(1);
+  string socket_path = "/tmp/cvmfs_benchmark.socket";
+  int fd_socket = MakeSocket(socket_path, 0600);
+  int retval = listen(fd_socket, 1);
+  assert(retval == 0);
+
+  pid_t pid;
+  switch (pid = fork()) {
+    case -1:
+      abort();
+    case 0:
+      struct sockaddr_un remote;
+      socklen_t socket_size = sizeof(remote);
+      int fd_connection = accept(fd_socket,
+                                 (struct sockaddr *)&remote,
+                                 &socket_size);
+      assert(fd_connection >= 0);
+      CacheTransport transport(fd_connection);
+      char buffer[kNumRanges * size];
+      memset(buffer, 'x', kNumRanges * size);
+      while (true) {
+        CacheTransport::Frame frame_recv;
+        retval = transport.RecvFrame(&frame_recv);
+        assert(retval);
+        google::protobuf::MessageLite *msg_typed = frame_recv.GetMsgTyped();
+        if (msg_typed->GetTypeName() == "cvmfs.MsgHandshake") {
+          cvmfs::MsgHandshakeAck msg;
+          msg.set_status(cvmfs::STATUS_OK);
+          msg.set_name("unit test cache manager");
+          msg.set_protocol_version(2);
+          msg.set_session_id(42);
+          msg.set_max_object_size(kNumRanges * size);
+          msg.set_capabilities(0);
+          CacheTransport::Frame frame_send(&msg);
+          transport.SendFrame(&frame_send);
+        } else if (msg_typed->GetTypeName() == "cvmfs.MsgReadReq") {
+          cvmfs::MsgReadReq *msg_req =
+            reinterpret_cast<cvmfs::MsgReadReq *>(msg_typed);
+          cvmfs::MsgReadReply msg;
+          msg.set_req_id(msg_req->req_id());
+          msg.set_status(cvmfs::STATUS_OK);
+          uint32_t payload_size = msg_req->size();
+          if (msg_req->ranges_size() > 0) {
+            cvmfs::MsgReadRangeResult *result = msg.add_range_results();
+            result->set_status(cvmfs::STATUS_OK);
+            result->set_size(msg_req->size());
+            for (int i = 0; i < msg_req->ranges_size(); ++i) {
+              result = msg.add_range_results();
+              result->set_status(cvmfs::STATUS_OK);
+              result->set_size(msg_req->ranges(i).size());
+              payload_size += msg_req->ranges(i).size();
+            }
+          }
+          CacheTransport::Frame frame_send(&msg);
+          frame_send.set_attachment(buffer, payload_size);
+          transport.SendFrame(&frame_send);
+        } else if (msg_typed->GetTypeName() == "cvmfs.MsgQuit") {
+          break;
+        }
+      }
+      shutdown(fd_connection, SHUT_RDWR);
+      close(fd_connection);
+      close(fd_socket);
+      unlink(socket_path.c_str());
+      exit(0);
+  }
+
+  int fd_client = ConnectSocket(socket_path);
+  assert(fd_client >= 0);
+  CacheTransport transport(fd_client);
+
+  cvmfs::MsgHandshake msg_handshake;
+  msg_handshake.set_protocol_version(2);
+  CacheTransport::Frame frame_handshake(&msg_handshake);
+  transport.SendFrame(&frame_handshake);
+  CacheTransport::Frame frame_ack;
+  retval = transport.RecvFrame(&frame_ack);
+  assert(retval);
+
+  char buffer[kNumRanges * size];
+  uint64_t req_id = 0;
+  while (st.KeepRunning()) {
+    const unsigned nrequests = use_vector ? 1 : kNumRanges;
+    for (unsigned i = 0; i < nrequests; ++i) {
+      cvmfs::MsgHash object_id;
+      object_id.set_algorithm(cvmfs::HASH_SHA1);
+      object_id.set_digest(string(20, '\0'));
+      cvmfs::MsgReadReq msg_read;
+      msg_read.set_session_id(42);
+      msg_read.set_req_id(req_id++);
+      msg_read.set_allocated_object_id(&object_id);
+      msg_read.set_offset(0);
+      msg_read.set_size(size);
+      if (use_vector) {
+        for (unsigned j = 1; j < kNumRanges; ++j) {
+          cvmfs::MsgReadRange *range = msg_read.add_ranges();
+          range->mutable_object_id()->CopyFrom(object_id);
+          range->set_offset(0);
+          range->set_size(size);
+        }
+      }
+      CacheTransport::Frame frame_send(&msg_read);
+      transport.SendFrame(&frame_send);
+      msg_read.release_object_id();
+
+      CacheTransport::Frame frame_recv;
+      frame_recv.set_attachment(buffer + i * size, (kNumRanges - i) * size);
+      retval = transport.RecvFrame(&frame_recv);
+      assert(retval);
+      cvmfs::MsgReadReply *msg_reply =
+        reinterpret_cast<cvmfs::MsgReadReply *>(frame_recv.GetMsgTyped());
+      assert(msg_reply->status() == cvmfs::STATUS_OK);
+    }
+  }
+  st.SetItemsProcessed(st.iterations());
+  st.SetBytesProcessed(int64_t(st.iterations()) * int64_t(kNumRanges * size));
+
+  cvmfs::MsgQuit msg_quit;
+  msg_quit.set_session_id(42);
+  CacheTransport::Frame frame(&msg_quit);
+  transport.SendFrame(&frame);
+  close(fd_client);
+  close(fd_socket);
+  int statloc;
+  waitpid(pid, &statloc, 0);
+}
+BENCHMARK_REGISTER_F(BM_Messaging, CacheReadV)->Repetitions(3)->
+  ArgPair(4 * 1024, 0)->ArgPair(4 * 1024, 1)->
+  ArgPair(32 * 1024, 0)->ArgPair(32 * 1024, 1)->UseRealTime();
@@ -8,6 +8,7 @@
 #include <stdint.h>
 
 #include <cstdio>
+#include <vector>
 
 #include "bm_util.h"
 #include "crypto/hash.h"
@@ -136,3 +137,99 @@ BENCHMARK_DEFINE_F(BM_SmallHash, InsertMd5Dirent)(benchmark::State &st) {
   SetCollisionLabel(num_collisions, max_collisions, i, &st);
 }
 BENCHMARK_REGISTER_F(BM_SmallHash, InsertMd5Dirent)->Repetitions(3)->Arg(40000);
+
+
+/**
+ * Md5 keys in a table with kLoadCapacity buckets that is filled to
+ * st.range(0) percent, using plain linear probing (st.range(1) == 0) or the
+ * tagged variant (st.range(1) == 1).
+ */
+class BM_SmallHashLoad : public benchmark::Fixture {
+ protected:
+  static const unsigned kLoadCapacity = 1 << 17;
+
+  virtual void SetUp(const benchmark::State &st) {
+    keys_.resize(kLoadCapacity);
+    for (unsigned i = 0; i < kLoadCapacity; ++i)
+      keys_[i].Randomize(i);
+  }
+
+  virtual void TearDown(const benchmark::State &st) {
+    keys_.clear();
+  }
+
+  static inline uint32_t hasher_md5(const shash::Md5 &key) {
+    return (uint32_t) *(reinterpret_cast<const uint32_t *>(key.digest) + 1);
+  }
+
+  template <bool Tagged>
+  unsigned Fill(const benchmark::State &st,
+                SmallHashFixed<shash::Md5, uint64_t, Tagged> *htable)
+  {
+    // Init() divides the expected size by the load factor
+    htable->Init(kLoadCapacity * SmallHashFixed<shash::Md5, uint64_t,
+                   Tagged>::kLoadFactor,
+                 shash::Md5(shash::AsciiPtr("!")), hasher_md5);
+    const unsigned num_keys = htable->capacity() * st.range(0) / 100;
+    for (unsigned i = 0; i < num_keys; ++i)
+      htable->Insert(keys_[i], i);
+    return num_keys;
+  }
+
+  template <bool Tagged>
+  void RunInsert(benchmark::State *st) {
+    unsigned num_keys = 0;
+    while (st->KeepRunning()) {
+      SmallHashFixed<shash::Md5, uint64_t, Tagged> htable;
+      num_keys = Fill(*st, &htable);
+    }
+    st->SetItemsProcessed(int64_t(st->iterations()) * num_keys);
+  }
+
+  // Alternates between a key in the table and a key not in the table
+  template <bool Tagged>
+  void RunLookup(benchmark::State *st) {
+    SmallHashFixed<shash::Md5, uint64_t, Tagged> htable;
+    const unsigned num_keys = Fill(*st, &htable);
+    unsigned i = 0;
+    uint64_t value = 0;
+    while (st->KeepRunning()) {
+      const unsigned idx = (i % 2) ? (i % num_keys)
+                                   : (kLoadCapacity - 1 - (i % 1024));
+      htable.Lookup(keys_[idx], &value);
+      Escape(&value);
+      ++i;
+    }
+    st->SetItemsProcessed(st->iterations());
+  }
+
+  std::vector<shash::Md5> keys_;
+};
+
+
+BENCHMARK_DEFINE_F(BM_SmallHashLoad, Insert)(benchmark::State &st) {
+  if (st.range(1))
+    RunInsert<true>(&st);
+  else
+    RunInsert<false>(&st);
+  st.SetLabel(st.range(1) ? "tagged" : "linear");
+}
+BENCHMARK_REGISTER_F(BM_SmallHashLoad, Insert)->Repetitions(3)->
+  ArgPair(50, 0)->ArgPair(50, 1)->
+  ArgPair(75, 0)->ArgPair(75, 1)->
+  ArgPair(90, 0)->ArgPair(90, 1)->
+  ArgPair(95, 0)->ArgPair(95, 1);
+
+
+BENCHMARK_DEFINE_F(BM_SmallHashLoad, Lookup)(benchmark::State &st) {
+  if (st.range(1))
+    RunLookup<true>(&st);
+  else
+    RunLookup<false>(&st);
+  st.SetLabel(st.range(1) ? "tagged" : "linear");
+}
+BENCHMARK_REGISTER_F(BM_SmallHashLoad, Lookup)->Repetitions(3)->
+  ArgPair(50, 0)->ArgPair(50, 1)->
+  ArgPair(75, 0)->ArgPair(75, 1)->
+  ArgPair(90, 0)->ArgPair(90, 1)->
+  ArgPair(95, 0)->ArgPair(95, 1);
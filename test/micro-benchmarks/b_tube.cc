@@ -0,0 +1,113 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+#include <benchmark/benchmark.h>
+
+#include <pthread.h>
+
+#include <cassert>
+#include <vector>
+
+#include "bm_util.h"
+#include "ingestion/tube.h"
+
+using namespace std;  // NOLINT
+
+/**
+ * Moves items through a chain of tubes, similar to the steps of the ingestion
+ * pipeline.  Every stage has st.range(0) worker threads that take items from
+ * their tube and put them into the tube of the next stage.  With st.range(1)
+ * set, the stages are connected by RingTubes instead of mutex protected Tubes.
+ */
+class BM_Tube : public benchmark::Fixture {
+ protected:
+  static const unsigned kNumStages = 4;
+  static const unsigned kCapacity = 1024;
+  static const unsigned kBatchSize = 256;
+
+  struct Item {
+    Item() : payload(0) { }
+    int payload;
+  };
+
+  struct StageInfo {
+    Tube<Item> *tube_in;
+    Tube<Item> *tube_out;
+    Item *quit_beacon;
+  };
+
+  static void *MainStage(void *data) {
+    StageInfo *info = reinterpret_cast<StageInfo *>(data);
+    while (true) {
+      Item *item = info->tube_in->PopFront();
+      info->tube_out->EnqueueBack(item);
+      if (item == info->quit_beacon)
+        break;
+      item->payload++;
+    }
+    return NULL;
+  }
+
+  virtual void SetUp(const benchmark::State &st) {
+    num_threads_ = st.range(0);
+    for (unsigned i = 0; i <= kNumStages; ++i) {
+      if (st.range(1))
+        tubes_.push_back(new RingTube<Item>(kCapacity));
+      else
+        tubes_.push_back(new Tube<Item>(kCapacity));
+    }
+    items_.resize(kBatchSize);
+    infos_.resize(kNumStages);
+    threads_.resize(kNumStages * num_threads_);
+    for (unsigned i = 0; i < kNumStages; ++i) {
+      infos_[i].tube_in = tubes_[i];
+      infos_[i].tube_out = tubes_[i + 1];
+      infos_[i].quit_beacon = &quit_beacon_;
+      for (unsigned j = 0; j < num_threads_; ++j) {
+        int retval = pthread_create(&threads_[i * num_threads_ + j], NULL,
+                                    MainStage, &infos_[i]);
+        assert(retval == 0);
+      }
+    }
+  }
+
+  virtual void TearDown(const benchmark::State &st) {
+    // Every worker forwards one quit beacon and stops
+    for (unsigned i = 0; i < num_threads_; ++i)
+      tubes_[0]->EnqueueBack(&quit_beacon_);
+    for (unsigned i = 0; i < threads_.size(); ++i)
+      pthread_join(threads_[i], NULL);
+    for (unsigned i = 0; i < num_threads_; ++i)
+      tubes_[kNumStages]->PopFront();
+    for (unsigned i = 0; i < tubes_.size(); ++i)
+      delete tubes_[i];
+    tubes_.clear();
+  }
+
+  unsigned num_threads_;
+  vector<Tube<Item> *> tubes_;
+  vector<Item> items_;
+  vector<StageInfo> infos_;
+  vector<pthread_t> threads_;
+  Item quit_beacon_;
+};
+
+
+BENCHMARK_DEFINE_F(BM_Tube, Pipeline)(benchmark::State &st) {
+  Tube<Item> *tube_first = tubes_[0];
+  Tube<Item> *tube_last = tubes_[kNumStages];
+  while (st.KeepRunning()) {
+    // The batch fits into the last tube, so the feeder never deadlocks
+    for (unsigned i = 0; i < kBatchSize; ++i)
+      tube_first->EnqueueBack(&items_[i]);
+    for (unsigned i = 0; i < kBatchSize; ++i)
+      Escape(tube_last->PopFront());
+  }
+  st.SetItemsProcessed(int64_t(st.iterations()) * kBatchSize);
+  st.SetLabel(st.range(1) ? "ring" : "mutex");
+}
+BENCHMARK_REGISTER_F(BM_Tube, Pipeline)->Repetitions(3)->UseRealTime()->
+  ArgPair(1, 0)->ArgPair(1, 1)->
+  ArgPair(2, 0)->ArgPair(2, 1)->
+  ArgPair(4, 0)->ArgPair(4, 1)->
+  ArgPair(8, 0)->ArgPair(8, 1);
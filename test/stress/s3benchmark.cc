@@ -1,6 +1,7 @@
 /**
  * This file is part of the CernVM File System.
  */
+#include <algorithm>
 #include <climits>
 #include <cmath>
 #include <cstring>
@@ -34,6 +35,7 @@ class S3TestScenario {
     const string &temp_path,
     int num_uploads,
     int avg_file_size,
+    int block_size,
     float duplicate_file_ratio);
   ~S3TestScenario();
 
@@ -46,6 +48,7 @@ class S3TestScenario {
   string tmp_path_;
   int num_uploads_;
   int avg_file_size_;
+  int block_size_;  // files are streamed in blocks of this size
   float duplicate_file_ratio_;
   upload::SpoolerDefinition *spooler_definition_;
   upload::S3Uploader *uploader_;
@@ -65,11 +68,13 @@ S3TestScenario::S3TestScenario(
   const string &temp_path,
   int num_uploads,
   int avg_file_size,
+  int block_size,
   float duplicate_file_ratio)
   : config_path_(config_path)
   , tmp_path_(temp_path)
   , num_uploads_(num_uploads)
   , avg_file_size_(avg_file_size)
+  , block_size_(block_size)
   , duplicate_file_ratio_(duplicate_file_ratio)
   , unique_files_(0)
 {
@@ -136,6 +141,13 @@ int S3TestScenario::Run()
            "HEAD(Found): %f\n"
            "DELETE: %f", num_uploads_/duration_upload,
            num_uploads_/duration_reupload, num_uploads_/duration_delete);
+  uint64_t bytes_uploaded = 0;
+  for (vector<TestDataChunk>::const_iterator chunk = data_chunks_.begin();
+       chunk != data_chunks_.end(); ++chunk) {
+    bytes_uploaded += chunk->size;
+  }
+  LogCvmfs(kLogCvmfs, kLogStdout, "Upload throughput: %f MB/s",
+           bytes_uploaded / duration_upload / (1024 * 1024));
   return 0;
 }
 
@@ -187,9 +199,13 @@ TestDataChunk S3TestScenario::GenerateChunk()
 void S3TestScenario::UploadFile(const TestDataChunk &chunk)
 {
   upload::UploadStreamHandle *handle = uploader_->InitStreamedUpload(NULL);
-  upload::S3Uploader::UploadBuffer buffer =
-    upload::S3Uploader::UploadBuffer(chunk.size, chunk.data);
-  uploader_->ScheduleUpload(handle, buffer, NULL);
+  const int block_size = (block_size_ > 0) ? block_size_ : chunk.size;
+  for (int offset = 0; offset < chunk.size; offset += block_size) {
+    upload::S3Uploader::UploadBuffer buffer = upload::S3Uploader::UploadBuffer(
+      std::min(block_size, chunk.size - offset),
+      reinterpret_cast<char *>(chunk.data) + offset);
+    uploader_->ScheduleUpload(handle, buffer, NULL);
+  }
   uploader_->ScheduleCommit(handle, chunk.hash);
 }
 
@@ -207,11 +223,15 @@ void Usage() {
            "reuploads the same files and finally deletes them.\n"
            "Outputs the time duration of each step.\n\n"
            "Usage: s3benchmark [-n num-files] [-s average-file-size] "
-           "[-t tmp-path] [-d duplicate-ratio] [-h] -c path/to/s3.cfg\n"
+           "[-b block-size] [-t tmp-path] [-d duplicate-ratio] [-h] "
+           "-c path/to/s3.cfg\n"
            "Options:\n"
            "  -c path to cvmfs-format s3 config file\n"
            "  -n number of files to be uploaded\n"
            "  -s average file size (file sizes are normally distributed)\n"
+           "  -b stream files in blocks of this size (default: whole file);\n"
+           "     large files are uploaded in multipart requests according to\n"
+           "     CVMFS_S3_MULTIPART_PART_SIZE in the s3 config file\n"
            "  -t temporary path used by S3Uploader\n"
            "  -d ratio of duplicate files (upload some files multiple times)\n"
            "  -h print this usage message\n");
@@ -220,11 +240,11 @@ void Usage() {
 int main(int argc, char *argv[])
 {
   string s3_config, tmp_path = "/tmp/s3benchmark";
-  int num_files = 1000, file_size = 4096;
+  int num_files = 1000, file_size = 4096, block_size = 0;
   float duplicate_ratio = 0;
 
   int c;
-  while ((c = getopt(argc, argv, "c:n:s:t:d:h")) != -1) {
+  while ((c = getopt(argc, argv, "c:n:s:b:t:d:h")) != -1) {
     switch (c) {
       case 'c':
         s3_config = string(optarg);
@@ -235,6 +255,9 @@ int main(int argc, char *argv[])
       case 's':
         file_size = atoi(optarg);
         break;
+      case 'b':
+        block_size = atoi(optarg);
+        break;
       case 't':
         tmp_path = string(optarg);
         break;
@@ -260,6 +283,7 @@ int main(int argc, char *argv[])
     tmp_path,
     num_files,
     file_size,
+    block_size,
     duplicate_ratio);
 
   int err = scenario->Run();
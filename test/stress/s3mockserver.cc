@@ -64,6 +64,7 @@ int GetValue(std::string body, std::string param,
 
 int main() {
   set<string> existing_files;
+  unsigned num_multipart_uploads = 0;
 
   int listen_sockfd, accept_sockfd;
   socklen_t clilen;
@@ -92,30 +93,69 @@ int main() {
     assert(accept_sockfd >= 0);
 
     // Get header
-    std::string req_header = "";
+    std::string request = "";
     char buf[10001];
-    int nread = read(accept_sockfd, buf, 10000);
-    buf[nread] = 0;
-    char *occ = strstr(buf, "\r\n\r\n");
-    if (!occ) occ = strstr(buf, "\n\n");
-    assert(occ);
-    req_header += std::string(buf, occ-buf);
+    size_t pos_body = string::npos;
+    while (pos_body == string::npos) {
+      int nread = read(accept_sockfd, buf, 10000);
+      assert(nread > 0);
+      request.append(buf, nread);
+      pos_body = request.find("\r\n\r\n");
+    }
+    std::string req_header = request.substr(0, pos_body);
+    std::string req_body = request.substr(pos_body + 4);
 
     // Parse header
     std::string req_type = "";
     std::string req_file = "";  // target name without bucket prefix
+    std::string req_query = "";
     int content_length = 0;
     req_type = GetField(req_header, ' ', 0);
     req_file = GetField(req_header, ' ', 1);
     req_file = req_file.substr(req_file.find("/", 1) + 1);  // no bucket
-    if (req_type == "PUT") {
+    if (req_file.find('?') != string::npos) {
+      req_query = req_file.substr(req_file.find('?') + 1);
+      req_file = req_file.substr(0, req_file.find('?'));
+    }
+    if ((req_type == "PUT") || (req_type == "POST")) {
       content_length = GetValue(req_header, "Content-Length");
       assert(content_length >= 0);
     }
+    // Drain the body so that the client does not see a broken connection
+    while (req_body.length() < static_cast<unsigned>(content_length)) {
+      int nread = read(accept_sockfd, buf, 10000);
+      assert(nread > 0);
+      req_body.append(buf, nread);
+    }
 
     string reply = "HTTP/1.1 200 OK\r\n";
-
-    if (req_type == "PUT") {
+    string reply_body = "";
+
+    if ((req_type == "POST") && (req_query == "uploads")) {
+      reply_body = "<InitiateMultipartUploadResult><UploadId>" +
+                   StringifyInt(++num_multipart_uploads) +
+                   "</UploadId></InitiateMultipartUploadResult>";
+    } else if ((req_type == "PUT") && HasPrefix(req_query, "partNumber=",
+                                                false)) {
+      reply += "ETag: \"" + GetField(GetField(req_query, '&', 0), '=', 1) +
+               "\"\r\n";
+    } else if ((req_type == "POST") && HasPrefix(req_query, "uploadId=",
+                                                 false)) {
+      existing_files.insert(req_file);
+      reply_body = "<CompleteMultipartUploadResult>"
+                   "</CompleteMultipartUploadResult>";
+    } else if ((req_type == "POST") && (req_query == "delete")) {
+      size_t pos = 0;
+      while ((pos = req_body.find("<Key>", pos)) != string::npos) {
+        pos += 5;
+        existing_files.erase(
+          req_body.substr(pos, req_body.find("</Key>", pos) - pos));
+      }
+      reply_body = "<DeleteResult></DeleteResult>";
+    } else if ((req_type == "DELETE") && !req_query.empty()) {
+      // Abort multipart upload
+      reply = "HTTP/1.1 204 No Content\r\n";
+    } else if (req_type == "PUT") {
       existing_files.insert(req_file);
     } else if (req_type == "HEAD") {
       if (existing_files.find(req_file) == existing_files.end()) {
@@ -128,8 +168,9 @@ int main() {
       // "No Content"-reply even if file did not exist
       reply = "HTTP/1.1 204 No Content\r\n";
     }
-    reply += "Content-Length: 0\r\n";
+    reply += "Content-Length: " + StringifyInt(reply_body.length()) + "\r\n";
     reply += "Connection: close\r\n\r\n";
+    reply += reply_body;
 
     int n = write(accept_sockfd, reply.c_str(), reply.length());
     assert(n >= 0);
@@ -683,6 +683,25 @@ TEST_F(T_CacheManager, OpenFromTxn) {
 }
 
 
+TEST_F(T_CacheManager, Mmap) {
+  int fd = cache_mgr_->Open(CacheManager::Bless(hash_null_));
+  EXPECT_GE(fd, 0);
+  EXPECT_EQ(NULL, cache_mgr_->Mmap(fd, 0));
+  EXPECT_EQ(0, cache_mgr_->Close(fd));
+
+  fd = cache_mgr_->Open(CacheManager::Bless(hash_one_));
+  EXPECT_GE(fd, 0);
+  void *mapping = cache_mgr_->Mmap(fd, 1);
+  ASSERT_TRUE(mapping != NULL);
+  EXPECT_EQ(0, cache_mgr_->Close(fd));
+  // The mapping outlives the file descriptor
+  EXPECT_EQ('A', *reinterpret_cast<char *>(mapping));
+  cache_mgr_->Munmap(mapping, 1);
+
+  EXPECT_EQ(NULL, cache_mgr_->Mmap(fd, 1));
+}
+
+
 TEST_F(T_CacheManager, Pread) {
   char buf[1024];
   int fd = cache_mgr_->Open(CacheManager::Bless(hash_one_));
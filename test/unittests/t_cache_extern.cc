@@ -24,6 +24,7 @@
 #include "cache_plugin/channel.h"
 #include "cache_transport.h"
 #include "crypto/hash.h"
+#include "testutil.h"
 #include "util/posix.h"
 #include "util/smalloc.h"
 
@@ -453,6 +454,141 @@ TEST_F(T_ExternalCacheManager, Transaction) {
 }
 
 
+TEST_F(T_ExternalCacheManager, SharedMemory) {
+#ifdef __linux__
+  EXPECT_GT(cache_mgr_->shm_slots(), 0U);
+#endif
+
+  shash::Any id(shash::kSha1);
+  unsigned size = 3 * cache_mgr_->max_object_size() + 17;
+  unsigned char *data = reinterpret_cast<unsigned char *>(smalloc(size));
+  for (unsigned i = 0; i < size; ++i)
+    data[i] = static_cast<unsigned char>(i % 251);
+  shash::HashMem(data, size, &id);
+  EXPECT_TRUE(cache_mgr_->CommitFromMem(id, data, size, "test"));
+
+  int fd = cache_mgr_->Open(CacheManager::Bless(id));
+  EXPECT_GE(fd, 0);
+  unsigned char *buffer = reinterpret_cast<unsigned char *>(smalloc(size));
+  EXPECT_EQ(static_cast<int64_t>(size), cache_mgr_->Pread(fd, buffer, size, 0));
+  EXPECT_EQ(0, memcmp(data, buffer, size));
+  EXPECT_EQ(1, cache_mgr_->Pread(fd, buffer, 2, size - 1));
+  EXPECT_EQ(data[size - 1], buffer[0]);
+  EXPECT_EQ(0, cache_mgr_->Close(fd));
+  free(buffer);
+  free(data);
+}
+
+
+TEST_F(T_ExternalCacheManager, FdFromPlugin) {
+  const unsigned used_fds = GetNoUsedFds();
+  int fd_pair[2];
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fd_pair));
+  CacheTransport transport_plugin(fd_pair[1]);
+
+  // A misbehaving plugin attaches a file descriptor to the handshake reply
+  cvmfs::MsgHandshakeAck msg_ack;
+  msg_ack.set_status(cvmfs::STATUS_OK);
+  msg_ack.set_name("fd leaking plugin");
+  msg_ack.set_protocol_version(ExternalCacheManager::kPbProtocolVersion);
+  msg_ack.set_session_id(1);
+  msg_ack.set_max_object_size(cache_mgr_->max_object_size());
+  msg_ack.set_capabilities(cvmfs::CAP_NONE);
+  CacheTransport::Frame frame_ack(&msg_ack);
+  frame_ack.set_fd_passed(open("/dev/null", O_RDONLY));
+  ASSERT_GE(frame_ack.fd_passed(), 0);
+  transport_plugin.SendFrame(&frame_ack);
+  close(frame_ack.fd_passed());
+
+  ExternalCacheManager *cache_mgr =
+    ExternalCacheManager::Create(fd_pair[0], nfiles, "test:fd");
+  ASSERT_TRUE(cache_mgr != NULL);
+  CacheTransport::Frame frame_handshake;
+  ASSERT_TRUE(transport_plugin.RecvFrame(&frame_handshake));
+  if (frame_handshake.fd_passed() >= 0)
+    close(frame_handshake.fd_passed());
+  delete cache_mgr;
+  close(fd_pair[1]);
+  EXPECT_EQ(used_fds, GetNoUsedFds());
+}
+
+
+TEST_F(T_ExternalCacheManager, PipelinedPread) {
+  shash::Any id(shash::kSha1);
+  unsigned size = 20 * cache_mgr_->max_object_size() + 17;
+  unsigned char *data = reinterpret_cast<unsigned char *>(smalloc(size));
+  for (unsigned i = 0; i < size; ++i)
+    data[i] = static_cast<unsigned char>(i % 253);
+  shash::HashMem(data, size, &id);
+  EXPECT_TRUE(cache_mgr_->CommitFromMem(id, data, size, "test"));
+  int fd = cache_mgr_->Open(CacheManager::Bless(id));
+  EXPECT_GE(fd, 0);
+  cache_mgr_->Spawn();
+
+  unsigned char *buffer = reinterpret_cast<unsigned char *>(smalloc(size));
+  EXPECT_EQ(static_cast<int64_t>(size), cache_mgr_->Pread(fd, buffer, size, 0));
+  EXPECT_EQ(0, memcmp(data, buffer, size));
+  // Short read, the requests beyond the end of the object fail
+  memset(buffer, 0, size);
+  uint64_t offset = 9 * cache_mgr_->max_object_size() + 1;
+  EXPECT_EQ(static_cast<int64_t>(size - offset),
+            cache_mgr_->Pread(fd, buffer, size, offset));
+  EXPECT_EQ(0, memcmp(data + offset, buffer, size - offset));
+  EXPECT_EQ(0, cache_mgr_->Close(fd));
+  free(buffer);
+  free(data);
+}
+
+
+TEST_F(T_ExternalCacheManager, PreadV) {
+  // Object a is "Hello, World"
+  string content_b = "cvmfs";
+  shash::Any id_b(shash::kSha1);
+  HashString(content_b, &id_b);
+  EXPECT_TRUE(cache_mgr_->CommitFromMem(id_b,
+    reinterpret_cast<const unsigned char *>(content_b.data()),
+    content_b.length(), "b"));
+  int fd_a = cache_mgr_->Open(CacheManager::Bless(mock_plugin_->known_object));
+  int fd_b = cache_mgr_->Open(CacheManager::Bless(id_b));
+  EXPECT_GE(fd_a, 0);
+  EXPECT_GE(fd_b, 0);
+  cache_mgr_->Spawn();
+
+  char buf[4][16];
+  ExternalCacheManager::ReadRange ranges[4];
+  ranges[0].fd = fd_a; ranges[0].buf = buf[0];
+  ranges[0].offset = 7; ranges[0].size = 5;
+  ranges[1].fd = fd_b; ranges[1].buf = buf[1];
+  ranges[1].offset = 0; ranges[1].size = 16;
+  ranges[2].fd = fd_a; ranges[2].buf = buf[2];
+  ranges[2].offset = 0; ranges[2].size = 5;
+  ranges[3].fd = fd_b; ranges[3].buf = buf[3];
+  ranges[3].offset = 2; ranges[3].size = 2;
+  EXPECT_EQ(0, cache_mgr_->PreadV(ranges, 4));
+  EXPECT_EQ(5, ranges[0].result);
+  EXPECT_EQ("World", string(buf[0], 5));
+  EXPECT_EQ(5, ranges[1].result);
+  EXPECT_EQ("cvmfs", string(buf[1], 5));
+  EXPECT_EQ(5, ranges[2].result);
+  EXPECT_EQ("Hello", string(buf[2], 5));
+  EXPECT_EQ(2, ranges[3].result);
+  EXPECT_EQ("mf", string(buf[3], 2));
+
+  // Failing ranges do not affect the others
+  ranges[0].fd = -1;
+  ranges[2].offset = 100;
+  EXPECT_EQ(-EBADF, cache_mgr_->PreadV(ranges, 4));
+  EXPECT_EQ(-EBADF, ranges[0].result);
+  EXPECT_EQ(5, ranges[1].result);
+  EXPECT_EQ(-EINVAL, ranges[2].result);
+  EXPECT_EQ(2, ranges[3].result);
+  EXPECT_EQ("mf", string(buf[3], 2));
+
+  EXPECT_EQ(0, cache_mgr_->Close(fd_a));
+  EXPECT_EQ(0, cache_mgr_->Close(fd_b));
+}
+
+
 TEST_F(T_ExternalCacheManager, TransactionAbort) {
   shash::Any id(shash::kSha1);
   uint64_t write_size = cache_mgr_->max_object_size_ * 4;
@@ -91,6 +91,59 @@ TEST_F(T_RamCacheManager, Read) {
   EXPECT_EQ(0, ramcache_.Close(fd));
 }
 
+TEST_F(T_RamCacheManager, ReadZeroCopy) {
+  int fd;
+  char buf[alloc_size];
+  memset(buf, 42, alloc_size);
+  buf[3] = 24;
+  void *txn = alloca(ramcache_.SizeOfTxn());
+  EXPECT_EQ(0, ramcache_.StartTxn(a_, alloc_size, txn));
+  EXPECT_EQ(alloc_size, ramcache_.Write(buf, alloc_size, txn));
+  EXPECT_EQ(0, ramcache_.CommitTxn(txn));
+
+  const void *data = NULL;
+  EXPECT_EQ(-EBADF, ramcache_.PreadZeroCopy(42, alloc_size, 0, &data));
+  EXPECT_GE((fd = ramcache_.Open(CacheManager::Bless(a_))), 0);
+  EXPECT_EQ(alloc_size - 2,
+            ramcache_.PreadZeroCopy(fd, alloc_size, 2, &data));
+  EXPECT_EQ(0, memcmp(buf + 2, data, alloc_size - 2));
+  // The store is not locked while the data is in use
+  char out[alloc_size];
+  EXPECT_EQ(alloc_size, ramcache_.Pread(fd, out, alloc_size, 0));
+  ramcache_.ReleaseZeroCopy(fd, data);
+
+  EXPECT_EQ(0, ramcache_.Close(fd));
+}
+
+TEST_F(T_RamCacheManager, PreadV) {
+  int fd;
+  char buf[alloc_size];
+  memset(buf, 42, alloc_size);
+  buf[3] = 24;
+  void *txn = alloca(ramcache_.SizeOfTxn());
+  EXPECT_EQ(0, ramcache_.StartTxn(a_, alloc_size, txn));
+  EXPECT_EQ(alloc_size, ramcache_.Write(buf, alloc_size, txn));
+  EXPECT_EQ(0, ramcache_.CommitTxn(txn));
+  EXPECT_GE((fd = ramcache_.Open(CacheManager::Bless(a_))), 0);
+
+  char out[2][4];
+  CacheManager::ReadRange ranges[3];
+  ranges[0].fd = fd; ranges[0].buf = out[0];
+  ranges[0].offset = 2; ranges[0].size = 4;
+  ranges[1].fd = 42; ranges[1].buf = out[1];
+  ranges[1].offset = 0; ranges[1].size = 4;
+  ranges[2].fd = fd; ranges[2].buf = out[1];
+  ranges[2].offset = alloc_size - 2; ranges[2].size = 4;
+  EXPECT_EQ(-EBADF, ramcache_.PreadV(ranges, 3));
+  EXPECT_EQ(4, ranges[0].result);
+  EXPECT_EQ(0, memcmp(buf + 2, out[0], 4));
+  EXPECT_EQ(-EBADF, ranges[1].result);
+  EXPECT_EQ(2, ranges[2].result);
+  EXPECT_EQ(0, ramcache_.PreadV(ranges + 2, 1));
+
+  EXPECT_EQ(0, ramcache_.Close(fd));
+}
+
 TEST_F(T_RamCacheManager, OpenFromTxn) {
   int fd;
   char buf[alloc_size];
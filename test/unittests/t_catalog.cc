@@ -12,6 +12,7 @@
 #include "compression.h"
 #include "crypto/hash.h"
 #include "shortstring.h"
+#include "statistics.h"
 #include "testutil.h"
 #include "util/posix.h"
 
@@ -305,6 +306,46 @@ TEST_F(T_Catalog, Lookup) {
   EXPECT_TRUE(dirent.IsHidden());
 }
 
+TEST_F(T_Catalog, LookupMemo) {
+  catalog = catalog::Catalog::AttachFreely("",
+                                           catalog_db_root,
+                                           shash::Any(),
+                                           NULL,
+                                           false);
+  perf::Statistics statistics;
+  perf::Counter *n_hit = statistics.Register("memo.n_hit", "");
+  perf::Counter *n_miss = statistics.Register("memo.n_miss", "");
+  catalog->EnableLookupMemo(n_hit, n_miss);
+
+  PathString fake_path("/fakepath/fakefile");
+  PathString path("/dir/dir");
+  PathString link_path("/dir/dir/link");
+  DirectoryEntry dirent;
+  EXPECT_FALSE(catalog->LookupPath(fake_path, &dirent));
+  EXPECT_FALSE(catalog->LookupPath(fake_path, &dirent));
+  EXPECT_EQ(1, n_hit->Get());
+  EXPECT_EQ(1, n_miss->Get());
+
+  EXPECT_TRUE(catalog->LookupPath(path, NULL));
+  EXPECT_TRUE(catalog->LookupPath(path, &dirent));
+  EXPECT_EQ(2, n_hit->Get());
+  EXPECT_EQ(2, n_miss->Get());
+  EXPECT_TRUE(dirent.IsDirectory());
+  EXPECT_EQ(NameString("dir"), dirent.name());
+
+  // Raw symlink lookups bypass the memo
+  LinkString raw_symlink;
+  EXPECT_TRUE(catalog->LookupRawSymlink(link_path, &raw_symlink));
+  EXPECT_EQ("/foo", raw_symlink.ToString());
+  EXPECT_EQ(2, n_hit->Get());
+  EXPECT_EQ(2, n_miss->Get());
+  EXPECT_TRUE(catalog->LookupPath(link_path, &dirent));
+  EXPECT_TRUE(dirent.IsLink());
+  EXPECT_TRUE(catalog->LookupPath(link_path, &dirent));
+  EXPECT_TRUE(dirent.IsLink());
+  EXPECT_EQ(3, n_hit->Get());
+}
+
 TEST_F(T_Catalog, Listing) {
   StatEntryList stat_entry_list;
   DirectoryEntryList dir_entry_list;
@@ -230,6 +230,23 @@ TEST_F(T_CatalogManager, LongLookup) {
   EXPECT_EQ(3, catalog_mgr_.GetNumCatalogs());
 }
 
+TEST_F(T_CatalogManager, Prefetch) {
+  catalog::DirectoryEntry dirent;
+  ASSERT_TRUE(catalog_mgr_.Init());
+  AddTree();
+  EXPECT_TRUE(catalog_mgr_.LookupPath("/dir/dir/file2", kLookupDefault,
+                                      &dirent));
+  EXPECT_TRUE(catalog_mgr_.prefetched().empty());
+  // the nested catalog is fetched before the write lock is taken
+  EXPECT_TRUE(catalog_mgr_.LookupPath("/dir/dir/dir/file3", kLookupDefault,
+                                      &dirent));
+  ASSERT_EQ(1u, catalog_mgr_.prefetched().size());
+  EXPECT_EQ(PathString("/dir/dir/dir"), catalog_mgr_.prefetched()[0]);
+  EXPECT_EQ(2, catalog_mgr_.GetNumCatalogs());
+  // the mock fails to prefetch, the catalog is mounted regularly
+  EXPECT_EQ(0u, catalog_mgr_.statistics().n_prefetch->Get());
+}
+
 TEST_F(T_CatalogManager, Listing) {
   catalog::DirectoryEntry dirent;
   ASSERT_TRUE(catalog_mgr_.Init());
@@ -0,0 +1,126 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#include <gtest/gtest.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "cache.h"
+#include "catalog.h"
+#include "catalog_mgr_client.h"
+#include "catalog_test_tools.h"
+#include "compression.h"
+#include "crypto/hash.h"
+#include "mountpoint.h"
+#include "options.h"
+#include "quota.h"
+#include "testutil.h"
+#include "util/pointer.h"
+#include "util/posix.h"
+#include "util/uuid.h"
+
+using namespace std;  // NOLINT
+
+namespace catalog {
+
+class T_ClientCatalogManager : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    repo_path_ = "repo";
+    uuid_dummy_ = cvmfs::Uuid::Create("");
+    used_fds_ = GetNoUsedFds();
+    fd_cwd_ = open(".", O_RDONLY);
+    ASSERT_GE(fd_cwd_, 0);
+    tmp_path_ = CreateTempDir("./cvmfs_ut_cache");
+    options_mgr_.SetValue("CVMFS_CACHE_BASE", tmp_path_);
+    options_mgr_.SetValue("CVMFS_SHARED_CACHE", "no");
+    options_mgr_.SetValue("CVMFS_QUOTA_LIMIT", "100");
+    options_mgr_.SetValue("CVMFS_MAX_RETRIES", "0");
+    options_mgr_.SetValue("CVMFS_MOUNT_DIR", "/no/such/dir");
+    fs_info_.name = "unit-test";
+    fs_info_.options_mgr = &options_mgr_;
+    CreateMiniRepository(&options_mgr_, &repo_path_);
+  }
+
+  virtual void TearDown() {
+    delete uuid_dummy_;
+    int retval = fchdir(fd_cwd_);
+    ASSERT_EQ(0, retval);
+    close(fd_cwd_);
+    if (tmp_path_ != "")
+      RemoveTree(tmp_path_);
+    if (repo_path_ != "")
+      RemoveTree(repo_path_);
+    EXPECT_EQ(used_fds_, GetNoUsedFds()) << ShowOpenFiles();
+  }
+
+  /**
+   * Stores a compressed object with catalog suffix in the repository that
+   * is not a valid catalog database
+   */
+  shash::Any AddBrokenCatalog() {
+    string path = tmp_path_ + "/broken_catalog";
+    EXPECT_TRUE(SafeWriteToFile("not a catalog", path, 0600));
+    shash::Any hash(shash::kSha1, shash::kSuffixCatalog);
+    EXPECT_TRUE(zlib::CompressPath2Null(path, &hash));
+    EXPECT_TRUE(zlib::CompressPath2Path(
+      path, repo_path_ + "/data/" + hash.MakePath()));
+    unlink(path.c_str());
+    return hash;
+  }
+
+  FileSystem::FileSystemInfo fs_info_;
+  SimpleOptionsParser options_mgr_;
+  string tmp_path_;
+  string repo_path_;
+  int fd_cwd_;
+  unsigned used_fds_;
+  cvmfs::Uuid *uuid_dummy_;
+};
+
+
+TEST_F(T_ClientCatalogManager, PrefetchCatalog) {
+  shash::Any broken_hash = AddBrokenCatalog();
+  string root_hash;
+  ASSERT_TRUE(options_mgr_.GetValue("CVMFS_ROOT_HASH", &root_hash));
+
+  UniquePtr<FileSystem> fs(FileSystem::Create(fs_info_));
+  ASSERT_EQ(loader::kFailOk, fs->boot_status());
+  UniquePtr<MountPoint> mp(MountPoint::Create("keys.cern.ch", fs.weak_ref()));
+  ASSERT_EQ(loader::kFailOk, mp->boot_status());
+  ClientCatalogManager *catalog_mgr = mp->catalog_mgr();
+  QuotaManager *quota_mgr = fs->cache_mgr()->quota_mgr();
+
+  unsigned used_fds = GetNoUsedFds();
+  uint64_t size_pinned = quota_mgr->GetSizePinned();
+
+  // A valid catalog is opened and releases its file descriptor on deletion
+  Catalog *catalog = catalog_mgr->PrefetchCatalog(
+    PathString("/nested"),
+    shash::MkFromHexPtr(shash::HexPtr(root_hash), shash::kSuffixCatalog));
+  ASSERT_TRUE(catalog != NULL);
+  EXPECT_GT(GetNoUsedFds(), used_fds);
+  delete catalog;
+  EXPECT_EQ(used_fds, GetNoUsedFds()) << ShowOpenFiles();
+  EXPECT_EQ(size_pinned, quota_mgr->GetSizePinned());
+
+  // A broken catalog leaves neither a file descriptor nor a pin behind
+  EXPECT_EQ(NULL, catalog_mgr->PrefetchCatalog(PathString("/nested"),
+                                               broken_hash));
+  EXPECT_EQ(used_fds, GetNoUsedFds()) << ShowOpenFiles();
+  EXPECT_EQ(size_pinned, quota_mgr->GetSizePinned());
+
+  // Same for a catalog that cannot be fetched at all
+  shash::Any missing_hash(shash::kSha1, shash::kSuffixCatalog);
+  missing_hash.Randomize();
+  EXPECT_EQ(NULL, catalog_mgr->PrefetchCatalog(PathString("/nested"),
+                                               missing_hash));
+  EXPECT_EQ(used_fds, GetNoUsedFds()) << ShowOpenFiles();
+  EXPECT_EQ(size_pinned, quota_mgr->GetSizePinned());
+}
+
+}  // namespace catalog
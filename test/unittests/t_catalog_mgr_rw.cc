@@ -9,6 +9,7 @@
 #include "download.h"
 #include "statistics.h"
 #include "upload.h"
+#include "util/string.h"
 
 using namespace std;  // NOLINT
 
@@ -132,6 +133,43 @@ TEST_F(T_CatalogMgrRw, CloneTree) {
 }
 
 
+TEST_F(T_CatalogMgrRw, CommitIndependentSubtrees) {
+  CatalogTestTool tester("commit_independent_subtrees");
+  EXPECT_TRUE(tester.Init());
+
+  // Many sibling subtrees of nested catalogs are finalized concurrently, the
+  // parents only after all of their children have been uploaded
+  const unsigned kNumSubtrees = 8;
+  const unsigned kNumLeafs = 4;
+  DirSpec spec;
+  for (unsigned i = 0; i < kNumSubtrees; ++i) {
+    const string subtree = "sub" + StringifyInt(i);
+    EXPECT_TRUE(spec.AddDirectory(subtree, "", g_file_size));
+    EXPECT_TRUE(spec.AddNestedCatalog(subtree));
+    for (unsigned j = 0; j < kNumLeafs; ++j) {
+      const string leaf = "leaf" + StringifyInt(j);
+      EXPECT_TRUE(spec.AddDirectory(leaf, subtree, g_file_size));
+      EXPECT_TRUE(spec.AddFile("file", subtree + "/" + leaf,
+                               g_hashes[j], g_file_size));
+      EXPECT_TRUE(spec.AddNestedCatalog(subtree + "/" + leaf));
+    }
+  }
+  EXPECT_TRUE(tester.ApplyAtRootHash(tester.manifest()->catalog_hash(), spec));
+
+  // Reload the committed tree through the nested catalog links
+  const shash::Any root_hash = tester.manifest()->catalog_hash();
+  for (unsigned i = 0; i < kNumSubtrees; ++i) {
+    for (unsigned j = 0; j < kNumLeafs; ++j) {
+      const string path =
+        "/sub" + StringifyInt(i) + "/leaf" + StringifyInt(j) + "/file";
+      DirectoryEntry dirent;
+      EXPECT_TRUE(tester.FindEntry(root_hash, path, &dirent)) << path;
+      EXPECT_STREQ(g_hashes[j], dirent.checksum().ToString().c_str());
+    }
+  }
+}
+
+
 TEST_F(T_CatalogMgrRw, SwapNestedCatalog) {
   CatalogTestTool tester("swap_nested_catalog");
   EXPECT_TRUE(tester.Init());
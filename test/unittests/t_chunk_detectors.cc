@@ -309,3 +309,156 @@ TEST_F(T_ChunkDetectors, Xor32ChunkDetectorZerosBufferPowerOfTwo) {
     }
   }
 }
+
+
+TEST_F(T_ChunkDetectors, ParseChunkingAlgorithm) {
+  EXPECT_EQ(kChunkingXor32, ParseChunkingAlgorithm("default"));
+  EXPECT_EQ(kChunkingXor32, ParseChunkingAlgorithm("xor32"));
+  EXPECT_EQ(kChunkingFastCdc, ParseChunkingAlgorithm("fastcdc"));
+  EXPECT_EQ(kChunkingUnknown, ParseChunkingAlgorithm("rabin"));
+  EXPECT_EQ("fastcdc", ChunkingAlgorithmName(kChunkingFastCdc));
+  EXPECT_EQ("xor32",
+            ChunkingAlgorithmName(ParseChunkingAlgorithm("default")));
+}
+
+
+TEST_F(T_ChunkDetectors, FastCdcMasks) {
+  FastCdcDetector detector(1024, 8192, 65536);
+  // 13 bits for 8kB average chunk size, +/- 2 bits normalization
+  EXPECT_EQ(0xFFFE000000000000ULL, detector.mask_small_);
+  EXPECT_EQ(0xFFE0000000000000ULL, detector.mask_large_);
+
+  // Non power of two average chunk sizes are rounded down
+  FastCdcDetector detector_odd(1024, 12000, 65536);
+  EXPECT_EQ(detector.mask_small_, detector_odd.mask_small_);
+  EXPECT_EQ(detector.mask_large_, detector_odd.mask_large_);
+}
+
+
+TEST_F(T_ChunkDetectors, FastCdcChunkDetectorSlow) {
+  const size_t base = 512000;
+  const size_t min_chk_size = base;
+  const size_t avg_chk_size = base * 2;
+  const size_t max_chk_size = base * 4;
+  FastCdcDetector fastcdc_detector(min_chk_size, avg_chk_size, max_chk_size);
+
+  EXPECT_FALSE(fastcdc_detector.MightFindChunks(0));
+  EXPECT_FALSE(fastcdc_detector.MightFindChunks(base));
+  EXPECT_TRUE(fastcdc_detector.MightFindChunks(base + 1));
+
+  // expected cut marks, the first ones
+  const off_t expected[] = {
+     1260236,  2316438,  3377722,  4526785,  5739560,  6968003,  7683817,
+     8970356,  9551704, 10166361, 11257252, 12555769, 13702866, 14769760
+  };
+  const unsigned nexpected = sizeof(expected) / sizeof(expected[0]);
+
+  std::vector<size_t> buffer_sizes;
+  buffer_sizes.push_back(102400);    // 100kB
+  buffer_sizes.push_back(base);      // same as minimal chunk size
+  buffer_sizes.push_back(base * 2);  // same as average chunk size
+  buffer_sizes.push_back(10485760);  // 10MB
+
+  std::vector<off_t> reference;
+  std::vector<size_t>::const_iterator i    = buffer_sizes.begin();
+  std::vector<size_t>::const_iterator iend = buffer_sizes.end();
+  for (; i != iend; ++i) {
+    CreateBuffers(*i);
+
+    FastCdcDetector detector(min_chk_size, avg_chk_size, max_chk_size);
+    std::vector<off_t> cuts;
+    off_t next_cut = 0;
+    off_t last_cut = 0;
+    Buffers::const_iterator j    = buffers_.begin();
+    Buffers::const_iterator jend = buffers_.end();
+    for (; j != jend; ++j) {
+      while ((next_cut = detector.FindNextCutMark(*j)) != 0) {
+        const size_t chunk_size = next_cut - last_cut;
+        ASSERT_GE(max_chk_size, chunk_size)
+          << "too large chunk with buffer size " << *i << " bytes...";
+        ASSERT_LE(min_chk_size, chunk_size)
+          << "too small chunk with buffer size " << *i << " bytes...";
+        cuts.push_back(next_cut);
+        last_cut = next_cut;
+      }
+    }
+
+    // Cut marks must not depend on the buffer size
+    if (reference.empty())
+      reference = cuts;
+    EXPECT_EQ(reference, cuts) << "with buffer size " << *i << " bytes...";
+  }
+
+  ASSERT_LE(nexpected, reference.size());
+  for (unsigned k = 0; k < nexpected; ++k)
+    EXPECT_EQ(expected[k], reference[k]);
+
+  // Normalized chunking keeps the average close to the desired chunk size
+  const size_t avg = data_size() / reference.size();
+  EXPECT_LT(avg_chk_size * 3 / 4, avg);
+  EXPECT_GT(avg_chk_size * 3 / 2, avg);
+}
+
+
+TEST_F(T_ChunkDetectors, FastCdcResync) {
+  // Cut marks are content-defined: after inserting a few bytes at the
+  // beginning of the data, all but the first chunk remain the same
+  const size_t min_chk_size = 8192;
+  const size_t avg_chk_size = 16384;
+  const size_t max_chk_size = 65536;
+  const unsigned shift = 17;
+
+  CreateBuffers(10485760);
+  ItemAllocator allocator;
+  BlockItem *shifted = new BlockItem(&allocator);
+  shifted->MakeData(buffers_[0]->size());
+  memset(shifted->data(), 'x', shift);
+  memcpy(shifted->data() + shift, buffers_[0]->data(),
+         buffers_[0]->size() - shift);
+  shifted->set_size(buffers_[0]->size());
+
+  std::vector<off_t> cuts;
+  FastCdcDetector detector(min_chk_size, avg_chk_size, max_chk_size);
+  off_t next_cut;
+  while ((next_cut = detector.FindNextCutMark(buffers_[0])) != 0)
+    cuts.push_back(next_cut);
+
+  std::vector<off_t> cuts_shifted;
+  FastCdcDetector detector_shifted(min_chk_size, avg_chk_size, max_chk_size);
+  while ((next_cut = detector_shifted.FindNextCutMark(shifted)) != 0)
+    cuts_shifted.push_back(next_cut);
+  delete shifted;
+
+  ASSERT_GT(cuts.size(), 100U);
+  ASSERT_GT(cuts_shifted.size(), 100U);
+  // Both sequences synchronize after the first cut
+  unsigned matches = 0;
+  for (unsigned k = 1; k < cuts_shifted.size(); ++k) {
+    if (std::binary_search(cuts.begin(), cuts.end(), cuts_shifted[k] - shift))
+      matches++;
+  }
+  EXPECT_LE(cuts_shifted.size() - 3, matches);
+}
+
+
+TEST_F(T_ChunkDetectors, FastCdcChunkDetectorZeros) {
+  const size_t min_chk_size = data_size() / 64;
+  const size_t avg_chk_size = data_size() / 32;
+  const size_t max_chk_size = data_size() / 16;
+  FastCdcDetector detector(min_chk_size, avg_chk_size, max_chk_size);
+
+  CreateZeroBuffers(512000);
+
+  unsigned ncuts = 0;
+  off_t next_cut = 0;
+  Buffers::const_iterator j    = buffers_.begin();
+  Buffers::const_iterator jend = buffers_.end();
+  for (; j != jend; ++j) {
+    while ((next_cut = detector.FindNextCutMark(*j)) != 0) {
+      EXPECT_EQ(0u, next_cut % max_chk_size);
+      EXPECT_GE(data_size(), static_cast<size_t>(next_cut));
+      ncuts++;
+    }
+  }
+  EXPECT_EQ(16U, ncuts);
+}
@@ -0,0 +1,160 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#include <gtest/gtest.h>
+
+#include <unistd.h>
+
+#include <string>
+
+#include "backoff.h"
+#include "cache_posix.h"
+#include "chunk_prefetch.h"
+#include "compression.h"
+#include "crypto/hash.h"
+#include "download.h"
+#include "fetch.h"
+#include "file_chunk.h"
+#include "statistics.h"
+#include "testutil.h"
+#include "util/posix.h"
+
+using namespace std;  // NOLINT
+
+namespace cvmfs {
+
+class T_ChunkPrefetcher : public ::testing::Test {
+ protected:
+  static const unsigned kNumChunks = 8;
+
+  virtual void SetUp() {
+    used_fds_ = GetNoUsedFds();
+
+    tmp_path_ =
+      CreateTempDir(GetCurrentWorkingDirectory() + "/cvmfs_ut_prefetch");
+    src_path_ = tmp_path_ + "/data";
+    for (unsigned i = 0; i < kNumChunks; ++i) {
+      unsigned char c = 'a' + i;
+      void *buf;
+      uint64_t buf_size;
+      EXPECT_TRUE(zlib::CompressMem2Mem(&c, 1, &buf, &buf_size));
+      shash::Any hash(shash::kSha1);
+      shash::HashMem(static_cast<unsigned char *>(buf), buf_size, &hash);
+      MkdirDeep(GetParentPath(src_path_ + "/" + hash.MakePath()), 0700);
+      EXPECT_TRUE(CopyMem2Path(static_cast<unsigned char *>(buf), buf_size,
+                               src_path_ + "/" + hash.MakePath()));
+      free(buf);
+      chunk_list_.PushBack(FileChunk(hash, i, 1));
+    }
+
+    cache_mgr_ = PosixCacheManager::Create(tmp_path_, false);
+    ASSERT_TRUE(cache_mgr_ != NULL);
+
+    download_mgr_ = new download::DownloadManager();
+    download_mgr_->Init(8, perf::StatisticsTemplate("test", &statistics_));
+    download_mgr_->SetHostChain("file://" + tmp_path_);
+
+    fetcher_ = new Fetcher(
+      cache_mgr_, download_mgr_, &backoff_throttle_,
+      perf::StatisticsTemplate("fetch", &statistics_));
+  }
+
+  virtual void TearDown() {
+    delete fetcher_;
+    download_mgr_->Fini();
+    delete download_mgr_;
+    delete cache_mgr_;
+    if (tmp_path_ != "")
+      RemoveTree(tmp_path_);
+    EXPECT_EQ(used_fds_, GetNoUsedFds());
+  }
+
+  bool IsCached(unsigned chunk_idx) {
+    int fd = cache_mgr_->Open(
+      CacheManager::Bless(chunk_list_.AtPtr(chunk_idx)->content_hash()));
+    if (fd < 0)
+      return false;
+    EXPECT_EQ(0, cache_mgr_->Close(fd));
+    return true;
+  }
+
+  // Waits until all scheduled chunks are processed
+  void WaitForPrefetcher() {
+    perf::Counter *n_scheduled = statistics_.Lookup("readahead.n_scheduled");
+    perf::Counter *n_fetched = statistics_.Lookup("readahead.n_fetched");
+    perf::Counter *n_failed = statistics_.Lookup("readahead.n_failed");
+    while (n_fetched->Get() + n_failed->Get() < n_scheduled->Get())
+      SafeSleepMs(10);
+  }
+
+  Fetcher *fetcher_;
+  PosixCacheManager *cache_mgr_;
+  perf::Statistics statistics_;
+  download::DownloadManager *download_mgr_;
+  unsigned used_fds_;
+  FileChunkList chunk_list_;
+  string tmp_path_;
+  string src_path_;
+  BackoffThrottle backoff_throttle_;
+};
+
+
+TEST_F(T_ChunkPrefetcher, Prefetch) {
+  ChunkPrefetcher prefetcher(
+    3, 2, perf::StatisticsTemplate("readahead", &statistics_));
+  prefetcher.Spawn();
+  FileChunkReflist chunks(&chunk_list_, PathString("/file"),
+                          zlib::kZlibDefault, false);
+
+  prefetcher.Prefetch(fetcher_, chunks, 0, CacheManager::kTypeRegular);
+  WaitForPrefetcher();
+  EXPECT_EQ(3, statistics_.Lookup("readahead.n_fetched")->Get());
+  EXPECT_FALSE(IsCached(0));
+  EXPECT_TRUE(IsCached(1));
+  EXPECT_TRUE(IsCached(2));
+  EXPECT_TRUE(IsCached(3));
+  EXPECT_FALSE(IsCached(4));
+
+  // Only the chunks that exist are scheduled
+  prefetcher.Prefetch(fetcher_, chunks, kNumChunks - 2,
+                      CacheManager::kTypeRegular);
+  WaitForPrefetcher();
+  EXPECT_EQ(4, statistics_.Lookup("readahead.n_fetched")->Get());
+  EXPECT_TRUE(IsCached(kNumChunks - 1));
+  prefetcher.Prefetch(fetcher_, chunks, kNumChunks - 1,
+                      CacheManager::kTypeRegular);
+  EXPECT_EQ(4, statistics_.Lookup("readahead.n_scheduled")->Get());
+  EXPECT_EQ(0, statistics_.Lookup("readahead.n_failed")->Get());
+}
+
+
+TEST_F(T_ChunkPrefetcher, Failure) {
+  ChunkPrefetcher prefetcher(
+    2, 1, perf::StatisticsTemplate("readahead", &statistics_));
+  prefetcher.Spawn();
+  RemoveTree(src_path_);
+  FileChunkReflist chunks(&chunk_list_, PathString("/file"),
+                          zlib::kZlibDefault, false);
+
+  prefetcher.Prefetch(fetcher_, chunks, 0, CacheManager::kTypeRegular);
+  WaitForPrefetcher();
+  EXPECT_EQ(0, statistics_.Lookup("readahead.n_fetched")->Get());
+  EXPECT_EQ(2, statistics_.Lookup("readahead.n_failed")->Get());
+  EXPECT_FALSE(IsCached(1));
+}
+
+
+TEST_F(T_ChunkPrefetcher, Disabled) {
+  ChunkPrefetcher prefetcher(
+    0, 1, perf::StatisticsTemplate("readahead", &statistics_));
+  prefetcher.Spawn();
+  FileChunkReflist chunks(&chunk_list_, PathString("/file"),
+                          zlib::kZlibDefault, false);
+
+  prefetcher.Prefetch(fetcher_, chunks, 0, CacheManager::kTypeRegular);
+  EXPECT_EQ(0, statistics_.Lookup("readahead.n_scheduled")->Get());
+  EXPECT_FALSE(IsCached(1));
+}
+
+}  // namespace cvmfs
@@ -4,6 +4,8 @@
 
 #include "gtest/gtest.h"
 
+#include <algorithm>
+#include <cstdio>
 
 #include "compression.h"
 #include "util/pointer.h"
@@ -111,6 +113,94 @@ TEST_F(T_Compressor, CompressionLong) {
 }
 
 
+TEST_F(T_Compressor, ZstdCompression) {
+  compressor = zlib::Compressor::Construct(zlib::kZstdDefault);
+
+  unsigned char *input = reinterpret_cast<unsigned char *>(ptr_test_string);
+  bool deflate_finished =
+    compressor->Deflate(true, &input, &size_input, &buf, &buf_size);
+
+  ASSERT_TRUE(deflate_finished);
+  ASSERT_GT(buf_size, 0U);
+  ASSERT_EQ(0U, size_input);
+
+  char *decompress_buf;
+  uint64_t decompress_size;
+  EXPECT_TRUE(DecompressZstdMem2Mem(buf, buf_size,
+    reinterpret_cast<void **>(&decompress_buf), &decompress_size));
+  EXPECT_EQ(strlen(test_string) + 1, decompress_size);
+  ASSERT_EQ(0, strcmp(decompress_buf, test_string));
+  free(decompress_buf);
+
+  // zstd frames are not zlib streams
+  EXPECT_FALSE(DecompressMem2Mem(buf, buf_size,
+    reinterpret_cast<void **>(&decompress_buf), &decompress_size));
+}
+
+
+TEST_F(T_Compressor, ZstdCompressionLong) {
+  for (unsigned i = 0; i < long_size; ++i)
+    long_string[i] = static_cast<unsigned char>(i % 251);
+
+  compressor = zlib::Compressor::Construct(zlib::kZstdDefault);
+  unsigned char *compress_buf =
+    new unsigned char[compressor->DeflateBound(long_size)];
+  unsigned compress_pos = 0;
+  bool deflate_finished = false;
+  unsigned char *input = long_string;
+  size_t remaining = long_size;
+  unsigned rounds = 0;
+
+  while (!deflate_finished) {
+    size_t out_size = 100;
+    deflate_finished =
+      compressor->Deflate(true, &input, &remaining, &buf, &out_size);
+    memcpy(compress_buf + compress_pos, buf, out_size);
+    compress_pos += out_size;
+    rounds++;
+  }
+
+  EXPECT_GT(rounds, 1U);
+  EXPECT_GT(compress_pos, 0U);
+  EXPECT_LT(compress_pos, long_size);
+  ASSERT_EQ(0U, remaining);
+
+  char *decompress_buf;
+  uint64_t decompress_size;
+  bool retval = DecompressZstdMem2Mem(compress_buf, compress_pos,
+    reinterpret_cast<void **>(&decompress_buf), &decompress_size);
+  EXPECT_TRUE(retval);
+  EXPECT_EQ(decompress_size, static_cast<uint64_t>(long_size));
+  EXPECT_EQ(0, memcmp(decompress_buf, long_string, long_size));
+  free(decompress_buf);
+
+  // Feed the compressed data piecewise, as the download manager does
+  FILE *f = tmpfile();
+  ASSERT_TRUE(f != NULL);
+  ZSTD_DStream *strm = ZstdDecompressInit();
+  StreamStates state = kStreamContinue;
+  for (unsigned pos = 0; pos < compress_pos; pos += 4096) {
+    unsigned piece = std::min(4096U, compress_pos - pos);
+    state = DecompressZstdStream2File(compress_buf + pos, piece, strm, f);
+    ASSERT_NE(kStreamDataError, state);
+    ASSERT_NE(kStreamIOError, state);
+  }
+  EXPECT_EQ(kStreamEnd, state);
+  EXPECT_EQ(static_cast<long>(long_size), ftell(f));  // NOLINT
+
+  // After a reset, the stream can be reused and detects corrupted data
+  ZstdDecompressReset(strm);
+  rewind(f);
+  compress_buf[0] ^= 0xFF;
+  EXPECT_EQ(kStreamDataError,
+            DecompressZstdStream2File(compress_buf, compress_pos, strm, f));
+  ZstdDecompressFini(strm);
+  fclose(f);
+
+  delete[] compress_buf;
+}
+
+
 TEST_F(T_Compressor, EchoCompression) {
   compressor = zlib::Compressor::Construct(zlib::kNoCompression);
 
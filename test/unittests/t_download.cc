@@ -18,8 +18,11 @@
 #include "sink.h"
 #include "statistics.h"
 #include "util/file_guard.h"
+#include "util/pointer.h"
 #include "util/posix.h"
 #include "util/prng.h"
+#include "util/smalloc.h"
+#include "util/string.h"
 
 using namespace std;  // NOLINT
 
@@ -190,6 +193,46 @@ TEST_F(T_Download, Multiple) {
 }
 
 
+TEST_F(T_Download, MultiThreaded) {
+  DownloadManager sharded_mgr;
+  sharded_mgr.Init(8, perf::StatisticsTemplate("sharded", &statistics));
+  sharded_mgr.SetNumThreads(4);
+  EXPECT_EQ(4U, sharded_mgr.num_threads());
+  sharded_mgr.Spawn();
+
+  const unsigned kNumFiles = 32;
+  for (unsigned i = 0; i < kNumFiles; ++i) {
+    string dest_path;
+    FILE *fdest = CreateTemporaryFile(&dest_path);
+    ASSERT_TRUE(fdest != NULL);
+    UnlinkGuard unlink_guard(dest_path);
+    string content = StringifyInt(i);
+    fwrite(content.data(), 1, content.length(), fdest);
+    fclose(fdest);
+
+    string url = "file://" + dest_path;
+    JobInfo info(&url, false /* compressed */, false /* probe hosts */, NULL);
+    sharded_mgr.Fetch(&info);
+    ASSERT_EQ(kFailOk, info.error_code);
+    EXPECT_EQ(content,
+              string(info.destination_mem.data, info.destination_mem.pos));
+    free(info.destination_mem.data);
+  }
+
+  int64_t sum_requests = 0;
+  for (unsigned i = 0; i < 4; ++i) {
+    perf::Counter *n_requests = statistics.Lookup(
+      "sharded.shard" + StringifyInt(i) + ".n_requests");
+    ASSERT_TRUE(n_requests != NULL);
+    sum_requests += n_requests->Get();
+  }
+  EXPECT_EQ(static_cast<int64_t>(kNumFiles), sum_requests);
+  EXPECT_EQ(static_cast<int64_t>(kNumFiles),
+            statistics.Lookup("sharded.n_requests")->Get());
+  sharded_mgr.Fini();
+}
+
+
 TEST_F(T_Download, RemoteFile2Mem) {
   string src_path = GetSmallFile();
   string src_content = GetFileContents(src_path);
@@ -411,6 +454,62 @@ TEST_F(T_Download, LocalFile2Sink) {
 }
 
 
+TEST_F(T_Download, LocalZstdFile) {
+  string dest_path;
+  FILE *fdest = CreateTemporaryFile(&dest_path);
+  ASSERT_TRUE(fdest != NULL);
+  UnlinkGuard unlink_guard(dest_path);
+
+  const unsigned size = 512 * 1024;
+  unsigned char *data = static_cast<unsigned char *>(smalloc(size));
+  for (unsigned i = 0; i < size; ++i)
+    data[i] = static_cast<unsigned char>(i % 251);
+  UniquePtr<zlib::Compressor> compressor(
+    zlib::Compressor::Construct(zlib::kZstdDefault));
+  unsigned char *input = data;
+  size_t remaining = size;
+  bool done = false;
+  while (!done) {
+    unsigned char out[4096];
+    unsigned char *out_ptr = out;
+    size_t out_size = sizeof(out);
+    done = compressor->Deflate(true, &input, &remaining, &out_ptr, &out_size);
+    EXPECT_EQ(out_size, fwrite(out, 1, out_size, fdest));
+  }
+  fclose(fdest);
+
+  string url = "file://" + dest_path;
+  TestSink test_sink;
+  JobInfo info(&url, true /* compressed */, false /* probe hosts */,
+               &test_sink, NULL /* expected hash */);
+  info.compression_alg = zlib::kZstdDefault;
+  download_mgr.Fetch(&info);
+  EXPECT_EQ(info.error_code, kFailOk);
+  EXPECT_EQ(size, GetFileSize(test_sink.path));
+  unsigned char *validation = static_cast<unsigned char *>(smalloc(size));
+  EXPECT_EQ(static_cast<int>(size), pread(test_sink.fd, validation, size, 0));
+  EXPECT_EQ(0, memcmp(validation, data, size));
+  free(validation);
+
+  JobInfo info2(&url, true /* compressed */, false /* probe hosts */, NULL);
+  info2.compression_alg = zlib::kZstdDefault;
+  download_mgr.Fetch(&info2);
+  EXPECT_EQ(info2.error_code, kFailOk);
+  ASSERT_EQ(size, info2.destination_mem.pos);
+  EXPECT_EQ(0, memcmp(info2.destination_mem.data, data, size));
+  free(info2.destination_mem.data);
+
+  // zstd data cannot be decompressed as zlib stream
+  TestSink test_sink3;
+  JobInfo info3(&url, true /* compressed */, false /* probe hosts */,
+                &test_sink3, NULL /* expected hash */);
+  download_mgr.Fetch(&info3);
+  EXPECT_NE(info3.error_code, kFailOk);
+
+  free(data);
+}
+
+
 TEST_F(T_Download, StripDirect) {
   string cleaned = "FALSE";
   EXPECT_FALSE(download_mgr.StripDirect("", &cleaned));
@@ -3,16 +3,20 @@
  */
 
 #include <gtest/gtest.h>
+#include <pthread.h>
 
 #include <set>
 #include <string>
+#include <vector>
 
+#include "crypto/hash.h"
 #include "glue_buffer.h"
 #include "shortstring.h"
 #include "smallhash.h"
 #include "util/platform.h"
 #include "util/posix.h"
 #include "util/prng.h"
+#include "util/string.h"
 
 namespace glue {
 
@@ -91,6 +95,119 @@ TEST_F(T_GlueBuffer, InodeTracker) {
 }
 
 
+TEST_F(T_GlueBuffer, InodeTrackerShards) {
+  const unsigned kNumInodes = 1000;
+  inode_tracker_.VfsGet(glue::InodeEx(1, glue::InodeEx::kDirectory),
+                        PathString(""));
+  for (unsigned i = 2; i <= kNumInodes; ++i) {
+    inode_tracker_.VfsGetBy(glue::InodeEx(i, glue::InodeEx::kRegular), 2,
+                            PathString("/" + StringifyInt(i)));
+  }
+
+  std::set<uint64_t> inodes;
+  uint64_t inode;
+  InodeTracker::Cursor cursor = inode_tracker_.BeginEnumerate();
+  while (inode_tracker_.NextInode(&cursor, &inode))
+    inodes.insert(inode);
+  inode_tracker_.EndEnumerate(&cursor);
+  EXPECT_EQ(kNumInodes, inodes.size());
+
+  InodeTracker copy(inode_tracker_);
+  PathString path;
+  glue::InodeEx inode_ex(500, glue::InodeEx::kUnknownType);
+  EXPECT_TRUE(copy.FindPath(&inode_ex, &path));
+  EXPECT_EQ("/500", path.ToString());
+  EXPECT_EQ(glue::InodeEx::kRegular, inode_ex.GetFileType());
+
+  // Every inode has two references, only the second put removes it
+  std::vector<uint64_t> removed;
+  InodeTracker::VfsPutBatch batch(&inode_tracker_);
+  for (unsigned i = 2; i <= kNumInodes; ++i)
+    batch.Add(i, 1);
+  batch.Commit(&removed);
+  EXPECT_TRUE(removed.empty());
+  for (unsigned i = 2; i <= kNumInodes; i += 2)
+    batch.Add(i, 1);
+  batch.Commit(&removed);
+  EXPECT_EQ(kNumInodes / 2, removed.size());
+  EXPECT_EQ(0U, inode_tracker_.FindInode(PathString("/2")));
+  EXPECT_EQ(3U, inode_tracker_.FindInode(PathString("/3")));
+  inode_ex = glue::InodeEx(2, glue::InodeEx::kUnknownType);
+  EXPECT_FALSE(inode_tracker_.FindPath(&inode_ex, &path));
+  EXPECT_TRUE(inode_tracker_.VfsPut(3, 1));
+  EXPECT_EQ(0U, inode_tracker_.FindInode(PathString("/3")));
+
+  // The replacement inode usually ends up in a different shard
+  for (unsigned i = 5; i <= kNumInodes; i += 2) {
+    EXPECT_TRUE(inode_tracker_.ReplaceInode(
+      i, glue::InodeEx(kNumInodes + i, glue::InodeEx::kRegular)));
+    EXPECT_EQ(kNumInodes + i,
+              inode_tracker_.FindInode(PathString("/" + StringifyInt(i))));
+  }
+  EXPECT_FALSE(inode_tracker_.ReplaceInode(
+    5, glue::InodeEx(1, glue::InodeEx::kRegular)));
+  inode_ex = glue::InodeEx(kNumInodes + 5, glue::InodeEx::kUnknownType);
+  PathString replaced_path;
+  EXPECT_TRUE(inode_tracker_.FindPath(&inode_ex, &replaced_path));
+  EXPECT_EQ("/5", replaced_path.ToString());
+  uint64_t inode_parent;
+  NameString name;
+  EXPECT_TRUE(inode_tracker_.FindDentry(kNumInodes + 5, &inode_parent, &name));
+  EXPECT_EQ(1U, inode_parent);
+  EXPECT_EQ("5", name.ToString());
+}
+
+
+struct TrackerThreadInfo {
+  InodeTracker *tracker;
+  uint64_t inode_offset;
+  unsigned num_paths;
+};
+
+static void *MainTrackerGet(void *data) {
+  TrackerThreadInfo *info = reinterpret_cast<TrackerThreadInfo *>(data);
+  for (unsigned i = 0; i < info->num_paths; ++i) {
+    info->tracker->VfsGet(
+      glue::InodeEx(info->inode_offset + i, glue::InodeEx::kRegular),
+      PathString("/" + StringifyInt(i)));
+  }
+  return NULL;
+}
+
+TEST_F(T_GlueBuffer, InodeTrackerConcurrentGet) {
+  // Several generations of inodes for the same paths race for the path map
+  const unsigned kNumThreads = 4;
+  const unsigned kNumPaths = 2000;
+  inode_tracker_.VfsGet(glue::InodeEx(1, glue::InodeEx::kDirectory),
+                        PathString(""));
+  pthread_t threads[kNumThreads];
+  TrackerThreadInfo infos[kNumThreads];
+  for (unsigned t = 0; t < kNumThreads; ++t) {
+    infos[t].tracker = &inode_tracker_;
+    infos[t].inode_offset = 2 + t * kNumPaths;
+    infos[t].num_paths = kNumPaths;
+    EXPECT_EQ(0,
+      pthread_create(&threads[t], NULL, MainTrackerGet, &infos[t]));
+  }
+  for (unsigned t = 0; t < kNumThreads; ++t)
+    pthread_join(threads[t], NULL);
+
+  for (unsigned i = 0; i < kNumPaths; ++i) {
+    const std::string expected_path = "/" + StringifyInt(i);
+    const uint64_t inode = inode_tracker_.FindInode(PathString(expected_path));
+    ASSERT_NE(0U, inode);
+    EXPECT_EQ(i, (inode - 2) % kNumPaths);
+    for (unsigned t = 0; t < kNumThreads; ++t) {
+      PathString path;
+      glue::InodeEx inode_ex(infos[t].inode_offset + i,
+                             glue::InodeEx::kUnknownType);
+      EXPECT_TRUE(inode_tracker_.FindPath(&inode_ex, &path));
+      EXPECT_EQ(expected_path, path.ToString());
+    }
+  }
+}
+
+
 TEST_F(T_GlueBuffer, DentryTracker) {
   DentryTracker tracker;
   const unsigned kTimeoutNever = 100000;
@@ -221,6 +338,45 @@ TEST_F(T_GlueBuffer, StringHeap) {
   }
 }
 
+TEST_F(T_GlueBuffer, PathStore) {
+  PathStore path_store;
+  const std::string long_name(100, 'x');
+  std::vector<std::string> paths;
+  path_store.Insert(shash::Md5("", 0), PathString(""));
+  for (unsigned i = 0; i < 1000; ++i) {
+    // Alternate between inline names and names on the string heap
+    std::string name = (i % 2) ? "f" : long_name;
+    paths.push_back("/" + StringifyInt(i % 10) + "/" + name + StringifyInt(i));
+    path_store.Insert(shash::Md5(paths[i].data(), paths[i].length()),
+                      PathString(paths[i]));
+  }
+
+  PathStore copy;
+  copy = path_store;
+  for (unsigned i = 0; i < 1000; ++i) {
+    shash::Md5 md5path(paths[i].data(), paths[i].length());
+    PathString path;
+    EXPECT_TRUE(path_store.Lookup(md5path, &path));
+    EXPECT_EQ(paths[i], path.ToString());
+    // Erasing half of the paths compacts the string heap
+    if (i % 4 < 2)
+      path_store.Erase(md5path);
+  }
+
+  for (unsigned i = 0; i < 1000; ++i) {
+    shash::Md5 md5path(paths[i].data(), paths[i].length());
+    PathString path;
+    EXPECT_EQ(i % 4 >= 2, path_store.Lookup(md5path, &path));
+    if (i % 4 >= 2) {
+      EXPECT_EQ(paths[i], path.ToString());
+    }
+    PathString path_copy;
+    EXPECT_TRUE(copy.Lookup(md5path, &path_copy));
+    EXPECT_EQ(paths[i], path_copy.ToString());
+  }
+}
+
+
 TEST_F(T_GlueBuffer, StatStore) {
   StatStore store;
   struct stat info;
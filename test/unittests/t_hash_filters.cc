@@ -5,6 +5,7 @@
 #include <gtest/gtest.h>
 
 #include <algorithm>
+#include <vector>
 
 #include "garbage_collection/hash_filter.h"
 
@@ -424,3 +425,101 @@ TYPED_TEST(T_HashFilter, FillManyRandomHashesSlow) {
 
   std::for_each(random_hashes.begin(), random_hashes.end(), check_contains);
 }
+
+
+//------------------------------------------------------------------------------
+
+
+TEST(T_BloomHashFilter, EmptyFilter) {
+  BloomHashFilter filter;
+  filter.Freeze();
+  EXPECT_EQ(0u, filter.Count());
+  EXPECT_EQ(0u, filter.MemoryUsage());
+  EXPECT_FALSE(
+    filter.Contains(sha("ac1ddc9c4283f5bb8db64c2e5771eeb44803399f")));
+  EXPECT_FALSE(filter.Contains(md5("eb8a956c0a1164b84262505a629e8a1f")));
+}
+
+
+TEST(T_BloomHashFilter, AlgorithmAndSuffix) {
+  BloomHashFilter filter;
+  filter.Fill(sha("2e19e3667a617f9381357e580f935ee783a98025"));
+  filter.Fill(sha("2e19e3667a617f9381357e580f935ee783a98025",
+              shash::kSuffixPartial));
+  filter.Fill(md5("d985d0ea551c1253c2305140c583d11f"));
+  filter.Freeze();
+  EXPECT_EQ(2u, filter.Count());
+
+  EXPECT_TRUE(filter.Contains(sha("2e19e3667a617f9381357e580f935ee783a98025",
+              shash::kSuffixCatalog)));
+  EXPECT_TRUE(filter.Contains(md5("d985d0ea551c1253c2305140c583d11f",
+              shash::kSuffixCatalog)));
+  EXPECT_FALSE(
+    filter.Contains(rmd("2e19e3667a617f9381357e580f935ee783a98025")));
+}
+
+
+TEST(T_BloomHashFilter, GrowSlow) {
+  const double fp_rate = 1e-3;
+  BloomHashFilter filter(fp_rate, 1000);
+
+  Prng rng;
+  rng.InitSeed(42);
+  RandomHashGenerator random_hash_generator(rng);
+
+  const unsigned int hash_count = 200000;
+  std::vector<shash::Any> random_hashes(hash_count, shash::Any());
+  std::generate(random_hashes.begin(), random_hashes.end(),
+                random_hash_generator);
+  for (unsigned i = 0; i < hash_count; ++i)
+    filter.Fill(random_hashes[i]);
+  filter.Freeze();
+  EXPECT_LT(1u, filter.GetNumStages());
+  EXPECT_LE(filter.Count(), hash_count);
+  EXPECT_GE(filter.Count(), hash_count * (1.0 - fp_rate));
+
+  // No false negatives
+  for (unsigned i = 0; i < hash_count; ++i)
+    EXPECT_TRUE(filter.Contains(random_hashes[i]));
+
+  unsigned false_positives = 0;
+  for (unsigned i = 0; i < 10 * hash_count; ++i) {
+    if (filter.Contains(random_hash_generator()))
+      false_positives++;
+  }
+  EXPECT_LE(false_positives, 10 * hash_count * fp_rate);
+}
+
+
+TEST(T_BloomHashFilter, MemoryUsageSlow) {
+  BloomHashFilter filter;
+  SmallhashFilter reference;
+
+  Prng rng;
+  rng.InitSeed(78475);
+  RandomHashGenerator random_hash_generator(rng);
+
+  const unsigned int hash_count = 1000000;
+  for (unsigned i = 0; i < hash_count; ++i) {
+    const shash::Any hash = random_hash_generator();
+    filter.Fill(hash);
+    reference.Fill(hash);
+  }
+  filter.Freeze();
+
+  // The SmallhashFilter stores the full hash at a load factor below 0.75
+  const double smallhash_bytes =
+    hash_count * (sizeof(shash::Any) + sizeof(bool)) / 0.75;
+  EXPECT_LT(filter.MemoryUsage(), smallhash_bytes / 10);
+  EXPECT_EQ(1u, filter.GetNumStages());
+
+  unsigned false_positives = 0;
+  for (unsigned i = 0; i < hash_count; ++i) {
+    const shash::Any hash = random_hash_generator();
+    EXPECT_EQ(reference.Contains(hash) || filter.Contains(hash),
+              filter.Contains(hash));
+    if (!reference.Contains(hash) && filter.Contains(hash))
+      false_positives++;
+  }
+  EXPECT_LE(false_positives, hash_count * 1e-4);
+}
@@ -0,0 +1,188 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#include <gtest/gtest.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "catalog_mgr_client.h"
+#include "catalog_test_tools.h"
+#include "crypto/hash.h"
+#include "directory_entry.h"
+#include "fence.h"
+#include "glue_buffer.h"
+#include "hotset.h"
+#include "lru_md.h"
+#include "mountpoint.h"
+#include "options.h"
+#include "shortstring.h"
+#include "testutil.h"
+#include "util/pointer.h"
+#include "util/posix.h"
+#include "util/uuid.h"
+
+using namespace std;  // NOLINT
+
+namespace cvmfs {
+
+class T_Hotset : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    uuid_dummy_ = cvmfs::Uuid::Create("");
+    used_fds_ = GetNoUsedFds();
+    fd_cwd_ = open(".", O_RDONLY);
+    ASSERT_GE(fd_cwd_, 0);
+    tmp_path_ = CreateTempDir("./cvmfs_ut_cache");
+    options_mgr_.SetValue("CVMFS_CACHE_BASE", tmp_path_);
+    options_mgr_.SetValue("CVMFS_SHARED_CACHE", "no");
+    options_mgr_.SetValue("CVMFS_MAX_RETRIES", "0");
+    options_mgr_.SetValue("CVMFS_MOUNT_DIR", "/no/such/dir");
+    options_mgr_.SetValue("CVMFS_HOTSET_SIZE", "16");
+    fs_info_.name = "unit-test";
+    fs_info_.options_mgr = &options_mgr_;
+
+    // /dir, /dir/file, /file
+    CatalogTestTool tester("repo");
+    ASSERT_TRUE(tester.Init());
+    DirSpec spec;
+    EXPECT_TRUE(spec.AddDirectory("dir", "", 4096));
+    EXPECT_TRUE(spec.AddFile("file", "dir",
+                             "26ab0db90d72e28ad0ba1e22ee51051000000000", 4096));
+    EXPECT_TRUE(spec.AddFile("file", "",
+                             "6d7fce9fee471194aa8b5b6e47267f0300000000", 4096));
+    ASSERT_TRUE(tester.Apply("hotset", spec));
+    repo_path_ = tester.repo_name();
+    options_mgr_.SetValue("CVMFS_ROOT_HASH",
+                          tester.manifest()->catalog_hash().ToString());
+    options_mgr_.SetValue("CVMFS_SERVER_URL", "file://" + repo_path_);
+    options_mgr_.SetValue("CVMFS_HTTP_PROXY", "DIRECT");
+    options_mgr_.SetValue("CVMFS_PUBLIC_KEY", tester.public_key());
+  }
+
+  virtual void TearDown() {
+    delete uuid_dummy_;
+    int retval = fchdir(fd_cwd_);
+    ASSERT_EQ(0, retval);
+    close(fd_cwd_);
+    if (tmp_path_ != "")
+      RemoveTree(tmp_path_);
+    if (repo_path_ != "")
+      RemoveTree(repo_path_);
+    EXPECT_EQ(used_fds_, GetNoUsedFds()) << ShowOpenFiles();
+  }
+
+  bool InMd5PathCache(MountPoint *mp, const string &path,
+                      catalog::DirectoryEntry *dirent)
+  {
+    return mp->md5path_cache()->Lookup(
+      shash::Md5(path.data(), path.length()), dirent);
+  }
+
+  FileSystem::FileSystemInfo fs_info_;
+  SimpleOptionsParser options_mgr_;
+  string tmp_path_;
+  string repo_path_;
+  int fd_cwd_;
+  unsigned used_fds_;
+  cvmfs::Uuid *uuid_dummy_;
+};
+
+
+TEST_F(T_Hotset, SaveReplay) {
+  UniquePtr<FileSystem> fs(FileSystem::Create(fs_info_));
+  ASSERT_EQ(loader::kFailOk, fs->boot_status());
+
+  {
+    UniquePtr<MountPoint> mp(MountPoint::Create("keys.cern.ch", fs.weak_ref()));
+    ASSERT_EQ(loader::kFailOk, mp->boot_status());
+    ASSERT_TRUE(mp->hotset() != NULL);
+
+    // An unused mount point leaves no snapshot
+    EXPECT_TRUE(mp->hotset()->Save());
+    EXPECT_FALSE(FileExists(mp->hotset()->path()));
+
+    mp->path_cache()->Insert(300, PathString("/no/such/path"));
+    mp->path_cache()->Insert(301, PathString("/dir/file"));
+    mp->path_cache()->Insert(302, PathString("/file"));
+    mp->path_cache()->Insert(303, PathString("/dir"));
+    EXPECT_TRUE(mp->hotset()->Save());
+    EXPECT_EQ(4, mp->hotset()->n_saved_->Get());
+    string content;
+    int fd = open(mp->hotset()->path().c_str(), O_RDONLY);
+    ASSERT_GE(fd, 0);
+    EXPECT_TRUE(SafeReadToString(fd, &content));
+    close(fd);
+    EXPECT_EQ("/dir\n/file\n/dir/file\n/no/such/path\n", content);
+  }
+
+  UniquePtr<MountPoint> mp(MountPoint::Create("keys.cern.ch", fs.weak_ref()));
+  ASSERT_EQ(loader::kFailOk, mp->boot_status());
+  HotsetSnapshot *hotset = mp->hotset();
+  ASSERT_TRUE(hotset != NULL);
+
+  // The kernel still knows /dir and /dir/file under inodes of an older catalog
+  // generation; /dir/file may be open with different content
+  const uint64_t root_inode = mp->catalog_mgr()->GetRootInode();
+  mp->inode_tracker()->VfsGet(
+    glue::InodeEx(root_inode - 2, glue::InodeEx::kDirectory),
+    PathString("/dir"));
+  mp->inode_tracker()->VfsGet(
+    glue::InodeEx(root_inode - 1, glue::InodeEx::kRegular),
+    PathString("/dir/file"));
+
+  Fence fence;
+  hotset->fence_ = &fence;
+  hotset->Replay();
+  EXPECT_EQ(3, hotset->n_replayed_->Get());
+  EXPECT_EQ(1, hotset->n_missing_->Get());
+
+  catalog::DirectoryEntry dirent;
+  ASSERT_TRUE(InMd5PathCache(mp.weak_ref(), "/dir", &dirent));
+  EXPECT_TRUE(dirent.IsDirectory());
+  EXPECT_EQ(root_inode - 2, dirent.inode());
+  ASSERT_TRUE(InMd5PathCache(mp.weak_ref(), "/file", &dirent));
+  EXPECT_TRUE(dirent.IsRegular());
+  EXPECT_GT(dirent.inode(), root_inode);
+  EXPECT_FALSE(InMd5PathCache(mp.weak_ref(), "/dir/file", &dirent));
+  EXPECT_FALSE(InMd5PathCache(mp.weak_ref(), "/no/such/path", &dirent));
+
+  // The fence is left after every path
+  fence.Drain();
+  fence.Open();
+
+  mp->inode_tracker()->VfsPut(root_inode - 2, 1);
+  mp->inode_tracker()->VfsPut(root_inode - 1, 1);
+}
+
+
+TEST_F(T_Hotset, TerminateBeforeFence) {
+  UniquePtr<FileSystem> fs(FileSystem::Create(fs_info_));
+  ASSERT_EQ(loader::kFailOk, fs->boot_status());
+
+  {
+    UniquePtr<MountPoint> mp(MountPoint::Create("keys.cern.ch", fs.weak_ref()));
+    ASSERT_EQ(loader::kFailOk, mp->boot_status());
+    mp->path_cache()->Insert(301, PathString("/dir/file"));
+    mp->path_cache()->Insert(302, PathString("/file"));
+    EXPECT_TRUE(mp->hotset()->Save());
+  }
+
+  // On unmount, the fence is deleted with the fuse remounter before the mount
+  // point; the replay thread must not be around anymore by then
+  UniquePtr<MountPoint> mp(MountPoint::Create("keys.cern.ch", fs.weak_ref()));
+  ASSERT_EQ(loader::kFailOk, mp->boot_status());
+  Fence *fence = new Fence();
+  mp->hotset()->Spawn(fence);
+  mp->hotset()->Terminate();
+  delete fence;
+  EXPECT_LE(mp->hotset()->n_replayed_->Get() + mp->hotset()->n_missing_->Get(),
+            2);
+  // Safe to call again, also from the destructor
+  mp->hotset()->Terminate();
+}
+
+}  // namespace cvmfs
@@ -4,11 +4,13 @@
 
 #include "gtest/gtest.h"
 
+#include <alloca.h>
 #include <fcntl.h>
 #include <unistd.h>
 
 #include <cstdlib>
 #include <cstring>
+#include <vector>
 
 #include "c_mock_uploader.h"
 #include "compression.h"
@@ -685,6 +687,66 @@ TEST_F(T_Ingestion, TaskHash) {
 }
 
 
+TEST_F(T_Ingestion, TaskHashBatch) {
+  const unsigned kNumChunks = 20;
+  const unsigned kNumBlocks = 3;
+  Tube<BlockItem> tube_in;
+  Tube<BlockItem> *tube_out = new Tube<BlockItem>();
+  TubeGroup<BlockItem> tube_group_out;
+  tube_group_out.TakeTube(tube_out);
+  tube_group_out.Activate();
+
+  unsigned char data[kNumBlocks * 4096];
+  for (unsigned i = 0; i < sizeof(data); ++i)
+    data[i] = i % 253;
+
+  // Interleave the blocks of the chunks, as they arrive from the compressors
+  FileItem file_null(new FileIngestionSource(std::string("/dev/null")));
+  std::vector<ChunkItem *> chunks;
+  std::vector<BlockItem *> blocks;
+  for (unsigned i = 0; i < kNumChunks; ++i)
+    chunks.push_back(new ChunkItem(&file_null, 0));
+  for (unsigned b = 0; b <= kNumBlocks; ++b) {
+    for (unsigned i = 0; i < kNumChunks; ++i) {
+      BlockItem *block = new BlockItem(i + 1, &allocator_);
+      block->SetFileItem(&file_null);
+      block->SetChunkItem(chunks[i]);
+      if (b == kNumBlocks)
+        block->MakeStop();
+      else
+        block->MakeDataCopy(data + b * 4096, 4096 - i);
+      blocks.push_back(block);
+      tube_in.EnqueueBack(block);
+    }
+  }
+
+  // The tube is already filled when the task starts, so it takes batches
+  TubeConsumerGroup<BlockItem> task_group;
+  task_group.TakeConsumer(new TaskHash(&tube_in, &tube_group_out));
+  task_group.Spawn();
+
+  for (unsigned i = 0; i < blocks.size(); ++i) {
+    EXPECT_EQ(blocks[i], tube_out->PopFront());
+  }
+  for (unsigned i = 0; i < kNumChunks; ++i) {
+    shash::Any expected(shash::kSha1);
+    shash::ContextPtr context(shash::kSha1);
+    context.buffer = alloca(context.size);
+    shash::Init(context);
+    for (unsigned b = 0; b < kNumBlocks; ++b)
+      shash::Update(data + b * 4096, 4096 - i, context);
+    shash::Final(context, &expected);
+    EXPECT_EQ(expected, *chunks[i]->hash_ptr());
+  }
+
+  task_group.Terminate();
+  for (unsigned i = 0; i < blocks.size(); ++i)
+    delete blocks[i];
+  for (unsigned i = 0; i < kNumChunks; ++i)
+    delete chunks[i];
+}
+
+
 TEST_F(T_Ingestion, TaskWriteNull) {
   Tube<BlockItem> tube_in;
   Tube<FileItem> *tube_out = new Tube<FileItem>();
@@ -108,6 +108,84 @@ TEST_F(T_MemoryKvStore, Read) {
   EXPECT_EQ(0, (int64_t) store_.GetUsed());
 }
 
+TEST_F(T_MemoryKvStore, ReadZeroCopy) {
+  char correct[malloc_size];
+  char out[malloc_size];
+  const void *data = NULL;
+  memset(buf_.address, 42, malloc_size);
+  memset(correct, 42, malloc_size);
+
+  EXPECT_EQ(-ENOENT, store_.ReadZeroCopy(a1_, malloc_size, 0, &data));
+  buf_.id = a1_;
+  EXPECT_EQ(0, store_.Commit(buf_));
+  EXPECT_EQ((int64_t) malloc_size - 3,
+            store_.ReadZeroCopy(a1_, 1111, 3, &data));
+  EXPECT_EQ(0, memcmp(data, correct, malloc_size - 3));
+
+  // The pinned memory survives deletion attempts and being overwritten
+  EXPECT_EQ(0, store_.GetRefcount(a1_));
+  EXPECT_FALSE(store_.Delete(a1_));
+  EXPECT_FALSE(store_.ShrinkTo(0));
+  memset(buf_.address, 24, malloc_size);
+  EXPECT_EQ(0, store_.Commit(buf_));
+  EXPECT_EQ(0, memcmp(data, correct, malloc_size - 3));
+  EXPECT_EQ((int64_t) malloc_size, store_.Read(a1_, out, malloc_size, 0));
+  EXPECT_EQ(0, memcmp(out, buf_.address, malloc_size));
+  // The retired memory is accounted for until it is freed
+  EXPECT_EQ(2 * malloc_size, store_.GetUsed());
+
+  store_.ReleaseZeroCopy(a1_, data);
+  EXPECT_TRUE(store_.Delete(a1_));
+  EXPECT_EQ(0, (int64_t) store_.GetUsed());
+
+  // Nothing is pinned if there is no data
+  buf_.id = a2_;
+  EXPECT_EQ(0, store_.Commit(buf_));
+  EXPECT_EQ(0, store_.ReadZeroCopy(a2_, 1, malloc_size, &data));
+  EXPECT_TRUE(data == NULL);
+  store_.ReleaseZeroCopy(a2_, data);
+  EXPECT_TRUE(store_.Delete(a2_));
+  free(buf_.address);
+}
+
+TEST_F(T_MemoryKvStore, ReadZeroCopyCompact) {
+  MemoryKvStore store(cache_size, MemoryKvStore::kMallocHeap,
+                      128 * malloc_size,
+                      perf::StatisticsTemplate("heap", &statistics_));
+  char correct[malloc_size];
+  char out[malloc_size];
+  const void *data = NULL;
+  memset(correct, 42, malloc_size);
+
+  memset(buf_.address, 1, malloc_size);
+  buf_.id = a1_;
+  EXPECT_EQ(0, store.Commit(buf_));
+  memset(buf_.address, 42, malloc_size);
+  buf_.id = a2_;
+  EXPECT_EQ(0, store.Commit(buf_));
+  EXPECT_EQ((int64_t) malloc_size,
+            store.ReadZeroCopy(a2_, malloc_size, 0, &data));
+
+  // Fragment the heap in front of the pinned entry; the following commits
+  // compact it while the zero-copy read is outstanding
+  EXPECT_TRUE(store.Delete(a1_));
+  for (unsigned i = 0; i < 64; ++i) {
+    shash::Any id(shash::kMd5);
+    id.Randomize();
+    buf_.id = id;
+    EXPECT_EQ(0, store.Commit(buf_));
+    EXPECT_TRUE(store.Delete(id));
+  }
+  EXPECT_EQ(0, memcmp(data, correct, malloc_size));
+  EXPECT_EQ((int64_t) malloc_size, store.Read(a2_, out, malloc_size, 0));
+  EXPECT_EQ(0, memcmp(out, correct, malloc_size));
+
+  store.ReleaseZeroCopy(a2_, data);
+  EXPECT_TRUE(store.Delete(a2_));
+  EXPECT_EQ(0, (int64_t) store.GetUsed());
+  free(buf_.address);
+}
+
 TEST_F(T_MemoryKvStore, Refcount) {
   EXPECT_FALSE(store_.IncRef(a1_));
   EXPECT_FALSE(store_.Unref(a1_));
@@ -110,6 +110,45 @@ TEST(T_LruCache, UpdateOnly) {
 }
 
 
+TEST(T_LruCache, InsertPrefetched) {
+  perf::Statistics statistics;
+  LruCache<int, std::string> cache(cache_size, -1, hasher_int,
+      perf::StatisticsTemplate(name, &statistics));
+
+  EXPECT_TRUE(cache.Insert(1, "one"));
+  EXPECT_TRUE(cache.InsertPrefetched(2, "two"));
+  EXPECT_TRUE(cache.InsertPrefetched(3, "three"));
+  // Updates the value but does not mark the entry as prefetched
+  EXPECT_FALSE(cache.InsertPrefetched(1, "ONE"));
+  EXPECT_EQ(2U, statistics.Lookup(name + ".n_insert_prefetch")->Get());
+  EXPECT_EQ(1U, statistics.Lookup(name + ".n_insert")->Get());
+
+  // A prefetch does not touch existing entries: 1 stays the oldest entry
+  int key;
+  std::string value;
+  cache.FilterBegin();
+  EXPECT_TRUE(cache.FilterNext());
+  cache.FilterGet(&key, &value);
+  EXPECT_EQ(1, key);
+  cache.FilterEnd();
+
+  EXPECT_TRUE(cache.Lookup(1, &value));
+  EXPECT_EQ("ONE", value);
+  EXPECT_EQ(0U, statistics.Lookup(name + ".n_hit_prefetch")->Get());
+  EXPECT_TRUE(cache.Lookup(2, &value));
+  EXPECT_EQ("two", value);
+  EXPECT_EQ(1U, statistics.Lookup(name + ".n_hit_prefetch")->Get());
+  // Only the first hit counts
+  EXPECT_TRUE(cache.Lookup(2, &value));
+  EXPECT_EQ(1U, statistics.Lookup(name + ".n_hit_prefetch")->Get());
+  // A regular insert resets the prefetch mark
+  EXPECT_FALSE(cache.Insert(3, "THREE"));
+  EXPECT_TRUE(cache.Lookup(3, &value));
+  EXPECT_EQ("THREE", value);
+  EXPECT_EQ(1U, statistics.Lookup(name + ".n_hit_prefetch")->Get());
+}
+
+
 TEST(T_LruCache, Drop) {
   perf::Statistics statistics;
   LruCache<int, std::string> cache(cache_size, -1, hasher_int,
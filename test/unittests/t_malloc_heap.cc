@@ -257,3 +257,34 @@ TEST_F(T_MallocHeap, Expand) {
 
   EXPECT_DEATH(M.Expand(ptr, 4), ".*");
 }
+
+
+TEST_F(T_MallocHeap, CompactPinned) {
+  IntMap int_map;
+  MallocHeap M(kSmallArena,
+               int_map.MakeCallback(&IntMap::OnBlockMove, &int_map));
+  vector<void *> pointers;
+  for (unsigned i = 0; i < 4; ++i) {
+    void *p = M.Allocate(16, &i, sizeof(i));
+    EXPECT_TRUE(p != NULL);
+    pointers.push_back(p);
+  }
+  M.MarkFree(pointers[0]);
+  M.MarkFree(pointers[2]);
+
+  // The hole in front of the pinned block remains, the block behind it moves
+  vector<void *> pinned;
+  pinned.push_back(pointers[1]);
+  M.Compact(pinned);
+  EXPECT_EQ(1U, int_map.num_moves);
+  EXPECT_EQ(pointers[2], int_map.mem_digest[3].ptr);
+  EXPECT_EQ(1U, *reinterpret_cast<unsigned *>(pointers[1]));
+  EXPECT_EQ(3U, *reinterpret_cast<unsigned *>(pointers[2]));
+  EXPECT_EQ(3U * (16 + 8), M.used_bytes());
+
+  M.Compact();
+  EXPECT_EQ(3U, int_map.num_moves);
+  EXPECT_EQ(pointers[0], int_map.mem_digest[1].ptr);
+  EXPECT_EQ(pointers[1], int_map.mem_digest[3].ptr);
+  EXPECT_EQ(2U * (16 + 8), M.used_bytes());
+}
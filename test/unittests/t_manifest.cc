@@ -11,6 +11,7 @@
 
 #include "crypto/hash.h"
 #include "manifest.h"
+#include "util/pointer.h"
 #include "util/posix.h"
 
 using namespace std;  // NOLINT
@@ -87,4 +88,29 @@ TEST_F(T_Manifest, ReadBreadcrumb) {
   fclose(f);
 }
 
+
+TEST_F(T_Manifest, CompressionAlgorithm) {
+  shash::Any rnd_hash(shash::kSha1, shash::kSuffixCatalog);
+  rnd_hash.Randomize();
+  Manifest manifest(rnd_hash, 1, "");
+  EXPECT_EQ(zlib::kZlibDefault, manifest.compression_algorithm());
+  string exported = manifest.ExportString();
+  EXPECT_EQ(string::npos, exported.find("\nF"));
+
+  manifest.set_compression_algorithm(zlib::kZstdDefault);
+  exported = manifest.ExportString();
+  UniquePtr<Manifest> loaded(Manifest::LoadMem(
+    reinterpret_cast<const unsigned char *>(exported.data()),
+    exported.length()));
+  ASSERT_TRUE(loaded.IsValid());
+  EXPECT_EQ(zlib::kZstdDefault, loaded->compression_algorithm());
+
+  // Clients refuse repositories that need an algorithm they do not know
+  exported += "Fbrotli\n";
+  loaded = Manifest::LoadMem(
+    reinterpret_cast<const unsigned char *>(exported.data()),
+    exported.length());
+  EXPECT_FALSE(loaded.IsValid());
+}
+
 }  // namespace manifest
@@ -0,0 +1,320 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#include <gtest/gtest.h>
+
+#include <pthread.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "cache_posix.h"
+#include "crypto/hash.h"
+#include "quota_memory.h"
+#include "testutil.h"
+#include "util/posix.h"
+
+using namespace std;  // NOLINT
+
+class T_MemoryQuotaManager : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    used_fds_ = GetNoUsedFds();
+
+    tmp_path_ = CreateTempDir("./cvmfs_ut_quota_memory");
+    delete PosixCacheManager::Create(tmp_path_, false);
+
+    limit_ = 10*1024*1024;  // 10M
+    threshold_ = 5*1024*1024;  // 5M
+
+    quota_mgr_ =
+      MemoryQuotaManager::Create(tmp_path_, limit_, threshold_, false);
+    ASSERT_TRUE(quota_mgr_ != NULL);
+
+    for (unsigned i = 0; i < 8; ++i) {
+      hashes_.push_back(shash::Any(shash::kSha1));
+      hashes_[i].digest[0] = i;
+      hashes_[i].digest[1] = i;
+    }
+  }
+
+  virtual void TearDown() {
+    delete quota_mgr_;
+    if (tmp_path_ != "")
+      RemoveTree(tmp_path_);
+    EXPECT_EQ(used_fds_, GetNoUsedFds());
+  }
+
+  void CreateCacheFile(const shash::Any &hash, unsigned size) {
+    string content(size, 'x');
+    EXPECT_TRUE(CopyMem2Path(reinterpret_cast<const unsigned char *>(
+      content.data()), size, tmp_path_ + "/" + hash.MakePathWithoutSuffix()));
+  }
+
+  bool HasCacheFile(const shash::Any &hash) {
+    return FileExists(tmp_path_ + "/" + hash.MakePathWithoutSuffix());
+  }
+
+  uint64_t limit_;
+  uint64_t threshold_;
+  MemoryQuotaManager *quota_mgr_;
+  string tmp_path_;
+  unsigned used_fds_;
+  vector<shash::Any> hashes_;
+};
+
+
+TEST_F(T_MemoryQuotaManager, InsertAndList) {
+  EXPECT_EQ(0U, quota_mgr_->GetSize());
+  quota_mgr_->Insert(hashes_[0], 1, "a");
+  quota_mgr_->InsertVolatile(hashes_[1], 2, "b");
+  EXPECT_TRUE(quota_mgr_->Pin(hashes_[2], 4, "c", true));
+  EXPECT_TRUE(quota_mgr_->Pin(hashes_[3], 8, "d", false));
+  EXPECT_EQ(15U, quota_mgr_->GetSize());
+  EXPECT_EQ(12U, quota_mgr_->GetSizePinned());
+
+  // Re-insert does not change the gauge
+  quota_mgr_->Insert(hashes_[0], 1, "a");
+  EXPECT_EQ(15U, quota_mgr_->GetSize());
+
+  vector<string> list = quota_mgr_->List();
+  sort(list.begin(), list.end());
+  ASSERT_EQ(3U, list.size());
+  EXPECT_EQ("a", list[0]);
+  EXPECT_EQ("b", list[1]);
+  EXPECT_EQ("d", list[2]);
+  list = quota_mgr_->ListPinned();
+  sort(list.begin(), list.end());
+  ASSERT_EQ(2U, list.size());
+  EXPECT_EQ("c", list[0]);
+  EXPECT_EQ("d", list[1]);
+  list = quota_mgr_->ListCatalogs();
+  ASSERT_EQ(1U, list.size());
+  EXPECT_EQ("c", list[0]);
+  list = quota_mgr_->ListVolatile();
+  ASSERT_EQ(1U, list.size());
+  EXPECT_EQ("b", list[0]);
+}
+
+
+TEST_F(T_MemoryQuotaManager, Pin) {
+  EXPECT_FALSE(quota_mgr_->Pin(hashes_[0], threshold_ + 1, "a", true));
+  EXPECT_TRUE(quota_mgr_->Pin(hashes_[0], threshold_, "a", true));
+  EXPECT_FALSE(quota_mgr_->Pin(hashes_[1], 1, "b", false));
+  // Already pinned
+  EXPECT_TRUE(quota_mgr_->Pin(hashes_[0], threshold_, "a", true));
+
+  // Orphaned pinned files are removed on unpin
+  quota_mgr_->Unpin(hashes_[0]);
+  EXPECT_EQ(0U, quota_mgr_->GetSizePinned());
+  EXPECT_EQ(0U, quota_mgr_->GetSize());
+
+  CreateCacheFile(hashes_[1], 1);
+  EXPECT_TRUE(quota_mgr_->Pin(hashes_[1], 1, "b", false));
+  quota_mgr_->Unpin(hashes_[1]);
+  EXPECT_EQ(0U, quota_mgr_->GetSizePinned());
+  EXPECT_EQ(1U, quota_mgr_->GetSize());
+  EXPECT_EQ(1U, quota_mgr_->List().size());
+  EXPECT_TRUE(quota_mgr_->ListPinned().empty());
+}
+
+
+TEST_F(T_MemoryQuotaManager, Remove) {
+  CreateCacheFile(hashes_[0], 1);
+  quota_mgr_->Insert(hashes_[0], 1, "a");
+  EXPECT_TRUE(quota_mgr_->Pin(hashes_[1], 2, "b", true));
+  quota_mgr_->Remove(hashes_[0]);
+  quota_mgr_->Remove(hashes_[1]);
+  quota_mgr_->Remove(hashes_[2]);
+  EXPECT_FALSE(HasCacheFile(hashes_[0]));
+  EXPECT_EQ(0U, quota_mgr_->GetSize());
+  EXPECT_EQ(0U, quota_mgr_->GetSizePinned());
+  EXPECT_TRUE(quota_mgr_->List().empty());
+}
+
+
+TEST_F(T_MemoryQuotaManager, Cleanup) {
+  for (unsigned i = 0; i < 5; ++i) {
+    CreateCacheFile(hashes_[i], 1);
+    quota_mgr_->Insert(hashes_[i], 1, StringifyInt(i));
+  }
+  CreateCacheFile(hashes_[5], 1);
+  quota_mgr_->InsertVolatile(hashes_[5], 1, "5");
+  EXPECT_TRUE(quota_mgr_->Pin(hashes_[6], 1, "6", true));
+  quota_mgr_->Touch(hashes_[0]);
+  EXPECT_EQ(7U, quota_mgr_->GetSize());
+  EXPECT_EQ(0U, quota_mgr_->GetCleanupRate(60));
+
+  // Volatile first, then least recently used, pinned files stay
+  EXPECT_TRUE(quota_mgr_->Cleanup(4));
+  EXPECT_EQ(4U, quota_mgr_->GetSize());
+  EXPECT_FALSE(HasCacheFile(hashes_[5]));
+  EXPECT_FALSE(HasCacheFile(hashes_[1]));
+  EXPECT_FALSE(HasCacheFile(hashes_[2]));
+  EXPECT_TRUE(HasCacheFile(hashes_[0]));
+  EXPECT_TRUE(HasCacheFile(hashes_[3]));
+  EXPECT_TRUE(HasCacheFile(hashes_[4]));
+  EXPECT_EQ(1U, quota_mgr_->GetCleanupRate(60));
+
+  EXPECT_FALSE(quota_mgr_->Cleanup(0));
+  EXPECT_EQ(1U, quota_mgr_->GetSize());
+  EXPECT_EQ(1U, quota_mgr_->ListPinned().size());
+}
+
+
+TEST_F(T_MemoryQuotaManager, CleanupOnInsert) {
+  const uint64_t size = 1024*1024;
+  for (unsigned i = 0; i < 8; ++i) {
+    CreateCacheFile(hashes_[i], 1);
+    quota_mgr_->Insert(hashes_[i], size, StringifyInt(i));
+  }
+  EXPECT_EQ(8*size, quota_mgr_->GetSize());
+  shash::Any hash(shash::kSha1);
+  hash.digest[0] = 0xff;
+  quota_mgr_->Insert(hash, 3*size, "large");
+  // Cleaned up to 5M, then the new file was added
+  EXPECT_EQ(8*size, quota_mgr_->GetSize());
+  EXPECT_FALSE(HasCacheFile(hashes_[0]));
+  EXPECT_FALSE(HasCacheFile(hashes_[2]));
+  EXPECT_TRUE(HasCacheFile(hashes_[3]));
+}
+
+
+TEST_F(T_MemoryQuotaManager, TouchLog) {
+  quota_mgr_->Insert(hashes_[0], 1, "a");
+  shash::Any hash(shash::kSha1);
+  hash.digest[0] = hashes_[0].digest[0] + MemoryQuotaManager::kNumShards;
+  quota_mgr_->Insert(hash, 1, "b");
+  MemoryQuotaManager::Shard *shard = quota_mgr_->SelectShard(hash);
+  ASSERT_EQ(shard, quota_mgr_->SelectShard(hashes_[0]));
+
+  // Overflow the touch log, the last touch wins
+  for (unsigned i = 0; i < MemoryQuotaManager::kTouchLogSize; ++i)
+    quota_mgr_->Touch(hashes_[0]);
+  EXPECT_EQ(static_cast<int32_t>(MemoryQuotaManager::kTouchLogSize),
+            atomic_read32(&shard->touch_next));
+  quota_mgr_->Touch(hash);
+  EXPECT_EQ(0, atomic_read32(&shard->touch_next));
+  quota_mgr_->Touch(hashes_[0]);
+  EXPECT_EQ(1, atomic_read32(&shard->touch_next));
+
+  EXPECT_TRUE(quota_mgr_->Cleanup(1));
+  vector<string> list = quota_mgr_->List();
+  ASSERT_EQ(1U, list.size());
+  EXPECT_EQ("a", list[0]);
+}
+
+
+TEST_F(T_MemoryQuotaManager, Checkpoint) {
+  for (unsigned i = 0; i < 4; ++i) {
+    CreateCacheFile(hashes_[i], 1);
+    quota_mgr_->Insert(hashes_[i], 1, StringifyInt(i));
+  }
+  quota_mgr_->InsertVolatile(hashes_[4], 1, "4");
+  EXPECT_TRUE(quota_mgr_->Pin(hashes_[5], 1, "5", true));
+  quota_mgr_->Touch(hashes_[0]);
+  EXPECT_TRUE(quota_mgr_->Checkpoint());
+  quota_mgr_->Remove(hashes_[3]);
+  delete quota_mgr_;
+
+  quota_mgr_ = MemoryQuotaManager::Create(tmp_path_, limit_, threshold_, false);
+  ASSERT_TRUE(quota_mgr_ != NULL);
+  EXPECT_EQ(5U, quota_mgr_->GetSize());
+  EXPECT_EQ(0U, quota_mgr_->GetSizePinned());
+  EXPECT_EQ(1U, quota_mgr_->ListVolatile().size());
+  EXPECT_EQ(1U, quota_mgr_->ListCatalogs().size());
+
+  // The LRU order survives the restart
+  EXPECT_TRUE(quota_mgr_->Cleanup(3));
+  EXPECT_TRUE(quota_mgr_->ListVolatile().empty());
+  EXPECT_FALSE(HasCacheFile(hashes_[1]));
+  EXPECT_TRUE(HasCacheFile(hashes_[0]));
+  EXPECT_TRUE(HasCacheFile(hashes_[2]));
+}
+
+
+TEST_F(T_MemoryQuotaManager, Rebuild) {
+  for (unsigned i = 0; i < 4; ++i)
+    CreateCacheFile(hashes_[i], i + 1);
+  delete quota_mgr_;
+
+  quota_mgr_ = MemoryQuotaManager::Create(tmp_path_, limit_, threshold_, true);
+  ASSERT_TRUE(quota_mgr_ != NULL);
+  EXPECT_EQ(10U, quota_mgr_->GetSize());
+  EXPECT_EQ(4U, quota_mgr_->List().size());
+  delete quota_mgr_;
+
+  quota_mgr_ = MemoryQuotaManager::Create(tmp_path_, limit_, threshold_, false);
+  ASSERT_TRUE(quota_mgr_ != NULL);
+  EXPECT_EQ(10U, quota_mgr_->GetSize());
+}
+
+
+TEST_F(T_MemoryQuotaManager, Spawned) {
+  quota_mgr_->Spawn();
+  for (unsigned i = 0; i < 4; ++i) {
+    CreateCacheFile(hashes_[i], 1);
+    quota_mgr_->Insert(hashes_[i], 1, StringifyInt(i));
+  }
+  EXPECT_TRUE(quota_mgr_->Cleanup(2));
+  // Files are unlinked asynchronously
+  while (HasCacheFile(hashes_[0]) || HasCacheFile(hashes_[1]))
+    SafeSleepMs(10);
+  EXPECT_TRUE(HasCacheFile(hashes_[2]));
+
+  int channel[2];
+  quota_mgr_->RegisterBackChannel(channel, "A");
+  quota_mgr_->BroadcastBackchannels("X");
+  char buf;
+  ReadPipe(channel[0], &buf, 1);
+  EXPECT_EQ('X', buf);
+  quota_mgr_->UnregisterBackChannel(channel, "A");
+}
+
+
+namespace {
+
+struct TouchWorker {
+  MemoryQuotaManager *quota_mgr;
+  vector<shash::Any> *hashes;
+};
+
+void *MainTouch(void *data) {
+  TouchWorker *worker = static_cast<TouchWorker *>(data);
+  for (unsigned i = 0; i < 10000; ++i)
+    worker->quota_mgr->Touch((*worker->hashes)[i % worker->hashes->size()]);
+  return NULL;
+}
+
+}  // anonymous namespace
+
+TEST_F(T_MemoryQuotaManager, ConcurrentTouch) {
+  quota_mgr_->Spawn();
+  vector<shash::Any> hashes;
+  for (unsigned i = 0; i < 256; ++i) {
+    shash::Any hash(shash::kSha1);
+    hash.digest[0] = i;
+    hash.digest[4] = i;
+    hashes.push_back(hash);
+    quota_mgr_->Insert(hash, 1, StringifyInt(i));
+  }
+
+  const unsigned kNumThreads = 4;
+  pthread_t threads[kNumThreads];
+  TouchWorker worker;
+  worker.quota_mgr = quota_mgr_;
+  worker.hashes = &hashes;
+  for (unsigned i = 0; i < kNumThreads; ++i)
+    EXPECT_EQ(0, pthread_create(&threads[i], NULL, MainTouch, &worker));
+  for (unsigned i = 0; i < 10; ++i) {
+    EXPECT_TRUE(quota_mgr_->Checkpoint());
+    EXPECT_EQ(256U, quota_mgr_->List().size());
+  }
+  for (unsigned i = 0; i < kNumThreads; ++i)
+    pthread_join(threads[i], NULL);
+
+  EXPECT_TRUE(quota_mgr_->Cleanup(128));
+  EXPECT_EQ(128U, quota_mgr_->GetSize());
+}
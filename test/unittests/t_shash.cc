@@ -1134,3 +1134,55 @@ TEST(T_Shash, Sha256) {
     hash.c_str());
 #endif
 }
+
+
+TEST(T_Shash, UpdateMulti) {
+  const unsigned kNumContexts = 37;
+  const unsigned kMaxSize = 16 * 1024;
+  Prng prng;
+  prng.InitSeed(42);
+  unsigned char *data = reinterpret_cast<unsigned char *>(smalloc(kMaxSize));
+  for (unsigned i = 0; i < kMaxSize; ++i)
+    data[i] = prng.Next(256);
+
+  shash::ContextPtr contexts[kNumContexts];
+  shash::ContextPtr references[kNumContexts];
+  const unsigned char *buffers[kNumContexts];
+  unsigned buffer_sizes[kNumContexts];
+  for (unsigned i = 0; i < kNumContexts; ++i) {
+    // Mix in a few contexts that are not handled by the SIMD lanes
+    shash::Algorithms algorithm = (i % 7 == 3) ? shash::kRmd160 : shash::kSha1;
+    contexts[i] = shash::ContextPtr(algorithm);
+    contexts[i].buffer = smalloc(contexts[i].size);
+    shash::Init(contexts[i]);
+    references[i] = shash::ContextPtr(algorithm);
+    references[i].buffer = smalloc(references[i].size);
+    shash::Init(references[i]);
+  }
+
+  // Several rounds with differently sized and unaligned buffers, so that
+  // contexts carry partial blocks from one round to the next
+  for (unsigned round = 0; round < 8; ++round) {
+    for (unsigned i = 0; i < kNumContexts; ++i) {
+      unsigned offset = prng.Next(64);
+      buffers[i] = data + offset;
+      buffer_sizes[i] = (i == round) ? 0 : prng.Next(kMaxSize - offset);
+      shash::Update(buffers[i], buffer_sizes[i], references[i]);
+    }
+    shash::UpdateMulti(buffers, buffer_sizes, contexts, kNumContexts);
+  }
+
+  for (unsigned i = 0; i < kNumContexts; ++i) {
+    shash::Any digest(contexts[i].algorithm);
+    shash::Any expected(contexts[i].algorithm);
+    shash::Final(contexts[i], &digest);
+    shash::Final(references[i], &expected);
+    EXPECT_EQ(expected, digest) << "context " << i;
+    free(contexts[i].buffer);
+    free(references[i].buffer);
+  }
+  free(data);
+
+  EXPECT_GE(shash::GetMultiBufferLanes(), 1U);
+  shash::UpdateMulti(NULL, NULL, NULL, 0);
+}
@@ -8,6 +8,7 @@
 #include <pthread.h>
 
 #include <limits>
+#include <map>
 
 #include "crypto/hash.h"
 #include "smallhash.h"
@@ -170,6 +171,81 @@ TEST_F(T_Smallhash, Lookup) {
 }
 
 
+TEST_F(T_Smallhash, TaggedDynamic) {
+  SmallHashDynamic<int, int, true> tagged;
+  tagged.Init(16, -1, hasher_int);
+  std::map<int, int> reference;
+  for (unsigned i = 0; i < kNumElements; ++i) {
+    const int key = rand() % 50000;  // NOLINT(runtime/threadsafe_fn)
+    switch (rand() % 3) {  // NOLINT(runtime/threadsafe_fn)
+      case 0:
+        tagged.Insert(key, i);
+        reference[key] = i;
+        break;
+      case 1:
+        EXPECT_EQ(reference.erase(key) > 0, tagged.Erase(key));
+        break;
+      default:
+        int value = -1;
+        const bool found = tagged.Lookup(key, &value);
+        EXPECT_EQ(reference.count(key) > 0, found);
+        if (found) {
+          EXPECT_EQ(reference[key], value);
+        }
+    }
+  }
+  EXPECT_EQ(reference.size(), tagged.size());
+
+  SmallHashDynamic<int, int, true> copy;
+  copy.Init(16, -1, hasher_int);
+  copy = tagged;
+  for (std::map<int, int>::const_iterator i = reference.begin(),
+       iEnd = reference.end(); i != iEnd; ++i)
+  {
+    int value = -1;
+    EXPECT_TRUE(copy.Lookup(i->first, &value));
+    EXPECT_EQ(i->second, value);
+  }
+
+  tagged.Clear();
+  EXPECT_EQ(0U, tagged.size());
+  EXPECT_FALSE(tagged.Contains(reference.begin()->first));
+}
+
+
+TEST_F(T_Smallhash, TaggedFixedFull) {
+  // Fill to the last few buckets to get long collision chains
+  SmallHashFixed<shash::Md5, int, true> tagged;
+  tagged.Init(1000, shash::Md5(shash::AsciiPtr("!")), hasher_md5);
+  const unsigned N = tagged.capacity() - 3;
+  for (unsigned i = 0; i < N; ++i) {
+    shash::Md5 random_hash;
+    random_hash.Randomize(i);
+    tagged.Insert(random_hash, i);
+  }
+  for (unsigned i = 0; i < N; ++i) {
+    shash::Md5 random_hash;
+    random_hash.Randomize(i);
+    int value = -1;
+    EXPECT_TRUE(tagged.LookupEx(&random_hash, &value));
+    EXPECT_EQ(static_cast<int>(i), value);
+  }
+  shash::Md5 unknown_hash;
+  unknown_hash.Randomize(N);
+  EXPECT_FALSE(tagged.Contains(unknown_hash));
+  for (unsigned i = 0; i < N; i += 2) {
+    shash::Md5 random_hash;
+    random_hash.Randomize(i);
+    EXPECT_TRUE(tagged.Erase(random_hash));
+  }
+  for (unsigned i = 0; i < N; ++i) {
+    shash::Md5 random_hash;
+    random_hash.Randomize(i);
+    EXPECT_EQ((i % 2) == 1, tagged.Contains(random_hash));
+  }
+}
+
+
 TEST_F(T_Smallhash, MultihashCycleSlow) {
   unsigned N = kNumElements;
   for (unsigned i = 0; i < N; ++i) {
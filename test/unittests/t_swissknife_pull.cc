@@ -0,0 +1,398 @@
+/**
+ * This file is part of the CernVM File System.
+ */
+
+#include <gtest/gtest.h>
+
+#include <alloca.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "catalog_test_tools.h"
+#include "crypto/hash.h"
+#include "download.h"
+#include "ingestion/ingestion_source.h"
+#include "statistics.h"
+#include "swissknife_pull_diff.h"
+#include "swissknife_pull_sink.h"
+#include "util/posix.h"
+
+using namespace std;  // NOLINT
+
+namespace swissknife {
+
+static const unsigned kObjectSize = 300 * 1024 + 17;
+
+static const char *kHashes[] = {"b026324c6904b2a9cb4b88d6d61c81d100000000",
+                                "26ab0db90d72e28ad0ba1e22ee51051000000000",
+                                "6d7fce9fee471194aa8b5b6e47267f0300000000",
+                                "48a24b70a0b376535542b996af51739800000000",
+                                "1dcca23355272056f04fe8bf20edfce000000000",
+                                "7c5aba41f53293b712fd86d08ed5b36e00000000",
+                                "31d30eea8d0968d6458e0ad0027c9f8000000000",
+                                "dd6b3c14e4d3e8c1a5c8e5b8b41ab67f00000000",
+                                "8a4b1cd1d7ba0d6cfbd3b2ac0dd1c8c600000000"};
+// Content hash of the .cvmfscatalog files created by DirSpec
+static const char *kNestedMarkerHash =
+  "0000000000000000000000000000000000000001";
+
+/**
+ * Records the objects instead of handing them to the workers
+ */
+class RecordingDiffTool : public PullDiffTool {
+ public:
+  RecordingDiffTool(DiffCatalogManager *old_catalog_mgr,
+                    DiffCatalogManager *new_catalog_mgr)
+    : PullDiffTool(old_catalog_mgr, new_catalog_mgr)
+  { }
+
+  std::set<std::string> objects;
+
+ protected:
+  virtual void ReportObject(const shash::Any &hash,
+                            const zlib::Algorithms /* compression_alg */)
+  {
+    objects.insert(hash.ToStringWithSuffix());
+  }
+};
+
+class T_SwissknifePull : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    temp_dir_ = CreateTempDir("./cvmfs_ut_pull");
+    ASSERT_FALSE(temp_dir_.empty());
+    object_.resize(kObjectSize);
+    for (unsigned i = 0; i < kObjectSize; ++i)
+      object_[i] = static_cast<unsigned char>((i * 7) % 251);
+    object_hash_ = shash::Any(shash::kSha1);
+    shash::HashMem(&object_[0], kObjectSize, &object_hash_);
+  }
+
+  virtual void TearDown() {
+    RemoveTree(temp_dir_);
+    if (!repo_path_.empty())
+      RemoveTree(repo_path_);
+  }
+
+  /**
+   * Revision 1:
+   *   /file1, /file2, /dir/file3
+   *   /nested/file4   (nested catalog)
+   *   /stable/file5   (nested catalog)
+   * Revision 2 removes /file1, modifies /file2, adds /dir/file6, replaces
+   * /nested/file4 by /nested/file7, adds the nested catalog /added/file8 and
+   * leaves /stable untouched.
+   */
+  void CreateRevisions(CatalogTestTool *tester) {
+    ASSERT_TRUE(tester->Init());
+    repo_path_ = tester->repo_name();
+
+    DirSpec spec1;
+    EXPECT_TRUE(spec1.AddFile("file1", "", kHashes[0], 4096));
+    EXPECT_TRUE(spec1.AddFile("file2", "", kHashes[1], 4096));
+    EXPECT_TRUE(spec1.AddDirectory("dir", "", 4096));
+    EXPECT_TRUE(spec1.AddFile("file3", "dir", kHashes[2], 4096));
+    EXPECT_TRUE(spec1.AddDirectory("nested", "", 4096));
+    EXPECT_TRUE(spec1.AddFile("file4", "nested", kHashes[3], 4096));
+    EXPECT_TRUE(spec1.AddNestedCatalog("nested"));
+    EXPECT_TRUE(spec1.AddDirectory("stable", "", 4096));
+    EXPECT_TRUE(spec1.AddFile("file5", "stable", kHashes[4], 4096));
+    EXPECT_TRUE(spec1.AddNestedCatalog("stable"));
+    ASSERT_TRUE(tester->Apply("first", spec1));
+
+    DirSpec spec2;
+    EXPECT_TRUE(spec2.AddFile("file2", "", kHashes[5], 8192));
+    EXPECT_TRUE(spec2.AddDirectory("dir", "", 4096));
+    EXPECT_TRUE(spec2.AddFile("file3", "dir", kHashes[2], 4096));
+    EXPECT_TRUE(spec2.AddFile("file6", "dir", kHashes[6], 4096));
+    EXPECT_TRUE(spec2.AddDirectory("nested", "", 4096));
+    EXPECT_TRUE(spec2.AddFile("file7", "nested", kHashes[7], 4096));
+    EXPECT_TRUE(spec2.AddNestedCatalog("nested"));
+    EXPECT_TRUE(spec2.AddDirectory("stable", "", 4096));
+    EXPECT_TRUE(spec2.AddFile("file5", "stable", kHashes[4], 4096));
+    EXPECT_TRUE(spec2.AddNestedCatalog("stable"));
+    EXPECT_TRUE(spec2.AddDirectory("added", "", 4096));
+    EXPECT_TRUE(spec2.AddFile("file8", "added", kHashes[8], 4096));
+    EXPECT_TRUE(spec2.AddNestedCatalog("added"));
+    ASSERT_TRUE(tester->Apply("second", spec2));
+  }
+
+  shash::Any GetNestedCatalogHash(CatalogTestTool *tester,
+                                  const shash::Any &root_hash,
+                                  const string &path)
+  {
+    char *nc_hash = NULL;
+    EXPECT_TRUE(tester->LookupNestedCatalogHash(root_hash, path, &nc_hash));
+    if (nc_hash == NULL)
+      return shash::Any();
+    const string hex(nc_hash);
+    free(nc_hash);
+    return shash::MkFromHexPtr(shash::HexPtr(hex), shash::kSuffixCatalog);
+  }
+
+  /**
+   * Writes the object in uneven pieces, like the download manager does
+   */
+  void WriteObject(ObjectSink *sink) {
+    const unsigned kPieceSize = 7 * 1024 + 3;
+    for (unsigned pos = 0; pos < kObjectSize; pos += kPieceSize) {
+      const unsigned size = std::min(kPieceSize, kObjectSize - pos);
+      ASSERT_EQ(static_cast<int64_t>(size), sink->Write(&object_[pos], size));
+    }
+  }
+
+  /**
+   * Reads the object back the way the spooler does after a pull
+   */
+  shash::Any HashIngestionSource(IngestionSource *source) {
+    EXPECT_TRUE(source->Open());
+    uint64_t size;
+    EXPECT_TRUE(source->GetSize(&size));
+    EXPECT_EQ(kObjectSize, size);
+    shash::Any hash(shash::kSha1);
+    shash::ContextPtr context(shash::kSha1);
+    context.buffer = alloca(context.size);
+    shash::Init(context);
+    unsigned char buffer[4096];
+    ssize_t nbytes;
+    while ((nbytes = source->Read(buffer, sizeof(buffer))) > 0)
+      shash::Update(buffer, nbytes, context);
+    EXPECT_EQ(0, nbytes);
+    shash::Final(context, &hash);
+    EXPECT_TRUE(source->Close());
+    return hash;
+  }
+
+  string temp_dir_;
+  string repo_path_;
+  vector<unsigned char> object_;
+  shash::Any object_hash_;
+};
+
+
+TEST_F(T_SwissknifePull, ObjectSinkInMemory) {
+  ObjectSink::Budget budget(1024 * 1024);
+  {
+    ObjectSink sink(&budget, temp_dir_);
+    // A failed transfer is restarted from scratch
+    ASSERT_EQ(5, sink.Write("junk!", 5));
+    EXPECT_EQ(0, sink.Reset());
+    WriteObject(&sink);
+    EXPECT_TRUE(sink.Finalize());
+    EXPECT_FALSE(sink.IsSpilled());
+    EXPECT_EQ(kObjectSize, sink.size());
+    EXPECT_GE(budget.used(), kObjectSize);
+
+    MemoryIngestionSource source("mem:object", sink.data(), sink.size());
+    EXPECT_EQ(object_hash_, HashIngestionSource(&source));
+  }
+  EXPECT_EQ(0U, budget.used());
+}
+
+
+TEST_F(T_SwissknifePull, ObjectSinkSpill) {
+  ObjectSink::Budget budget(128 * 1024);
+  ObjectSink other(&budget, temp_dir_);
+  ASSERT_EQ(5, other.Write("other", 5));
+  const uint64_t used_by_other = budget.used();
+
+  string spill_path;
+  {
+    ObjectSink sink(&budget, temp_dir_);
+    ASSERT_EQ(5, sink.Write("junk!", 5));
+    EXPECT_EQ(0, sink.Reset());
+    WriteObject(&sink);
+    EXPECT_TRUE(sink.IsSpilled());
+    EXPECT_EQ(used_by_other, budget.used());
+    EXPECT_TRUE(sink.Finalize());
+    EXPECT_EQ(kObjectSize, sink.size());
+    spill_path = sink.ReleaseSpillFile();
+  }
+  ASSERT_TRUE(FileExists(spill_path));
+  shash::Any hash(shash::kSha1);
+  EXPECT_TRUE(shash::HashFile(spill_path, &hash));
+  EXPECT_EQ(object_hash_, hash);
+  FileIngestionSource source(spill_path);
+  EXPECT_EQ(object_hash_, HashIngestionSource(&source));
+  unlink(spill_path.c_str());
+}
+
+
+TEST_F(T_SwissknifePull, ObjectSinkWithoutBudget) {
+  string spill_path;
+  {
+    ObjectSink sink(NULL, temp_dir_);
+    EXPECT_TRUE(sink.Finalize());
+    EXPECT_TRUE(sink.IsSpilled());
+    EXPECT_EQ(0U, sink.size());
+    spill_path = sink.ReleaseSpillFile();
+  }
+  EXPECT_EQ(0, GetFileSize(spill_path));
+  unlink(spill_path.c_str());
+
+  {
+    ObjectSink sink(NULL, temp_dir_);
+    WriteObject(&sink);
+    EXPECT_TRUE(sink.IsSpilled());
+    EXPECT_TRUE(sink.Finalize());
+    spill_path = sink.ReleaseSpillFile();
+  }
+  shash::Any hash(shash::kSha1);
+  EXPECT_TRUE(shash::HashFile(spill_path, &hash));
+  EXPECT_EQ(object_hash_, hash);
+  unlink(spill_path.c_str());
+
+  // Unless released, the temporary file is removed with the sink
+  {
+    ObjectSink sink(NULL, temp_dir_);
+    WriteObject(&sink);
+    EXPECT_TRUE(sink.Finalize());
+  }
+  EXPECT_TRUE(FindFilesByPrefix(temp_dir_, "cvmfs").empty());
+}
+
+
+
+TEST_F(T_SwissknifePull, DiffRevisions) {
+  CatalogTestTool tester("pull_diff");
+  CreateRevisions(&tester);
+  const CatalogTestTool::History history = tester.history();
+  ASSERT_EQ(3U, history.size());
+  const shash::Any old_root = history[1].second;
+  const shash::Any new_root = history[2].second;
+  const string url = "file://" + repo_path_;
+
+  perf::Statistics stats_old;
+  perf::Statistics stats_new;
+  map<shash::Any, string> kept_files;
+  DiffCatalogManager *old_catalog_mgr = new DiffCatalogManager(
+    old_root, url, temp_dir_, tester.download_manager(), &stats_old);
+  DiffCatalogManager *new_catalog_mgr = new DiffCatalogManager(
+    new_root, url, temp_dir_, tester.download_manager(), &stats_new);
+  new_catalog_mgr->KeepCatalogs(temp_dir_, &kept_files);
+  RecordingDiffTool diff_tool(old_catalog_mgr, new_catalog_mgr);
+  ASSERT_TRUE(diff_tool.Diff());
+  EXPECT_FALSE(old_catalog_mgr->failed());
+  EXPECT_FALSE(new_catalog_mgr->failed());
+
+  // Modified and added files, including the ones of the new nested catalog;
+  // neither removed nor unchanged ones
+  set<string> expected_objects;
+  expected_objects.insert(kHashes[5]);
+  expected_objects.insert(kHashes[6]);
+  expected_objects.insert(kHashes[7]);
+  expected_objects.insert(kHashes[8]);
+  expected_objects.insert(kNestedMarkerHash);
+  EXPECT_EQ(expected_objects, diff_tool.objects);
+  EXPECT_EQ(expected_objects.size(), diff_tool.num_objects());
+
+  // The changed and the new nested catalog are traversed.  The one of /stable
+  // is rebuilt from scratch, too, so whether its hash changed depends on the
+  // timestamps; either way, none of its entries is reported.
+  const set<shash::Any> diffed_catalogs = diff_tool.diffed_catalogs();
+  EXPECT_EQ(1U, diffed_catalogs.count(
+    GetNestedCatalogHash(&tester, new_root, "/nested")));
+  EXPECT_EQ(1U, diffed_catalogs.count(
+    GetNestedCatalogHash(&tester, new_root, "/added")));
+
+  // The compressed catalogs of the new revision are kept as downloaded
+  EXPECT_EQ(diffed_catalogs.size() + 1, kept_files.size());
+  EXPECT_EQ(1U, kept_files.count(new_root));
+  for (map<shash::Any, string>::const_iterator i = kept_files.begin(),
+       iEnd = kept_files.end(); i != iEnd; ++i)
+  {
+    EXPECT_TRUE(i->first == new_root || diffed_catalogs.count(i->first));
+    shash::Any hash(i->first.algorithm);
+    EXPECT_TRUE(shash::HashFile(i->second, &hash));
+    EXPECT_EQ(i->first, hash);
+  }
+}
+
+
+TEST_F(T_SwissknifePull, DiffUnchangedNestedCatalogs) {
+  CatalogTestTool tester("pull_diff");
+  CreateRevisions(&tester);
+  const shash::Any old_root = tester.history()[2].second;
+  // Adds /file9 on top of the second revision, the nested catalogs stay
+  DirSpec spec;
+  EXPECT_TRUE(spec.AddFile("file9", "", kHashes[0], 4096));
+  ASSERT_TRUE(tester.ApplyAtRootHash(old_root, spec));
+  const shash::Any new_root = tester.manifest()->catalog_hash();
+  ASSERT_NE(old_root, new_root);
+  EXPECT_EQ(GetNestedCatalogHash(&tester, old_root, "/nested"),
+            GetNestedCatalogHash(&tester, new_root, "/nested"));
+  const string url = "file://" + repo_path_;
+
+  perf::Statistics stats_old;
+  perf::Statistics stats_new;
+  map<shash::Any, string> kept_files;
+  DiffCatalogManager *old_catalog_mgr = new DiffCatalogManager(
+    old_root, url, temp_dir_, tester.download_manager(), &stats_old);
+  DiffCatalogManager *new_catalog_mgr = new DiffCatalogManager(
+    new_root, url, temp_dir_, tester.download_manager(), &stats_new);
+  new_catalog_mgr->KeepCatalogs(temp_dir_, &kept_files);
+  RecordingDiffTool diff_tool(old_catalog_mgr, new_catalog_mgr);
+  ASSERT_TRUE(diff_tool.Diff());
+
+  set<string> expected_objects;
+  expected_objects.insert(kHashes[0]);
+  EXPECT_EQ(expected_objects, diff_tool.objects);
+  // Identical nested catalogs are neither traversed nor even loaded
+  EXPECT_TRUE(diff_tool.diffed_catalogs().empty());
+  EXPECT_EQ(1U, kept_files.size());
+  EXPECT_EQ(1U, kept_files.count(new_root));
+}
+
+
+TEST_F(T_SwissknifePull, DiffLoadFailure) {
+  CatalogTestTool tester("pull_diff");
+  CreateRevisions(&tester);
+  const CatalogTestTool::History history = tester.history();
+  ASSERT_EQ(3U, history.size());
+  const shash::Any old_root = history[1].second;
+  const shash::Any new_root = history[2].second;
+  const string url = "file://" + repo_path_;
+  tester.download_manager()->SetRetryParameters(0, 0, 0);
+
+  // A missing nested catalog looks like a removed subtree to the diff
+  const shash::Any added_hash =
+    GetNestedCatalogHash(&tester, new_root, "/added");
+  ASSERT_FALSE(added_hash.IsNull());
+  ASSERT_EQ(0, unlink((repo_path_ + "/data/" + added_hash.MakePath()).c_str()));
+  {
+    perf::Statistics stats_old;
+    perf::Statistics stats_new;
+    DiffCatalogManager *old_catalog_mgr = new DiffCatalogManager(
+      old_root, url, temp_dir_, tester.download_manager(), &stats_old);
+    DiffCatalogManager *new_catalog_mgr = new DiffCatalogManager(
+      new_root, url, temp_dir_, tester.download_manager(), &stats_new);
+    RecordingDiffTool diff_tool(old_catalog_mgr, new_catalog_mgr);
+    EXPECT_FALSE(diff_tool.Diff());
+    EXPECT_FALSE(old_catalog_mgr->failed());
+    EXPECT_TRUE(new_catalog_mgr->failed());
+  }
+
+  // A missing root catalog
+  {
+    perf::Statistics stats_old;
+    perf::Statistics stats_new;
+    DiffCatalogManager *old_catalog_mgr = new DiffCatalogManager(
+      new_root, url + "/no/such/dir", temp_dir_, tester.download_manager(),
+      &stats_old);
+    DiffCatalogManager *new_catalog_mgr = new DiffCatalogManager(
+      new_root, url, temp_dir_, tester.download_manager(), &stats_new);
+    RecordingDiffTool diff_tool(old_catalog_mgr, new_catalog_mgr);
+    EXPECT_FALSE(diff_tool.Diff());
+    EXPECT_TRUE(old_catalog_mgr->failed());
+    EXPECT_TRUE(diff_tool.objects.empty());
+  }
+  EXPECT_TRUE(FindFilesByPrefix(temp_dir_, "cvmfs").empty());
+}
+
+}  // namespace swissknife
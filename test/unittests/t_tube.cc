@@ -4,6 +4,10 @@
 
 #include "gtest/gtest.h"
 
+#include <pthread.h>
+
+#include <vector>
+
 #include "ingestion/tube.h"
 
 using namespace std;  // NOLINT
@@ -89,3 +93,141 @@ TEST_F(T_Tube, Group) {
   x = t2->PopFront();  EXPECT_EQ(&c, x);
   x = t3->PopFront();  EXPECT_EQ(&b, x);
 }
+
+
+TEST_F(T_Tube, RingFifo) {
+  DummyItem a, b, c;
+  RingTube<DummyItem> ring(3);
+  EXPECT_EQ(4U, ring.capacity());
+  EXPECT_EQ(0U, ring.size());
+  EXPECT_TRUE(ring.IsEmpty());
+  EXPECT_EQ(NULL, ring.TryPopFront());
+
+  EXPECT_EQ(NULL, ring.EnqueueBack(&a));
+  ring.EnqueueBack(&b);
+  ring.EnqueueBack(&c);
+  EXPECT_EQ(3U, ring.size());
+  EXPECT_FALSE(ring.IsEmpty());
+  EXPECT_EQ(&a, ring.PopFront());
+  EXPECT_EQ(&b, ring.TryPopFront());
+  EXPECT_EQ(&c, ring.PopFront());
+  EXPECT_TRUE(ring.IsEmpty());
+  ring.Wait();
+
+  // Wrap around the ring a few times
+  for (unsigned i = 0; i < 10; ++i) {
+    ring.EnqueueBack(&a);
+    ring.EnqueueBack(&b);
+    EXPECT_EQ(&a, ring.PopFront());
+    EXPECT_EQ(&b, ring.PopFront());
+  }
+  EXPECT_TRUE(ring.IsEmpty());
+}
+
+
+TEST_F(T_Tube, RingGroup) {
+  DummyItem a, b;
+  a.tag_ = 0;
+  b.tag_ = 1;
+
+  TubeGroup<DummyItem> grp;
+  Tube<DummyItem> *t1 = new RingTube<DummyItem>(16);
+  Tube<DummyItem> *t2 = new RingTube<DummyItem>(16);
+  grp.TakeTube(t1);
+  grp.TakeTube(t2);
+  grp.Activate();
+  grp.Dispatch(&a);
+  grp.Dispatch(&b);
+  EXPECT_EQ(1U, t1->size());
+  EXPECT_EQ(1U, t2->size());
+  EXPECT_EQ(&a, t1->PopFront());
+  EXPECT_EQ(&b, t2->PopFront());
+}
+
+
+namespace {
+
+const unsigned kRingNumThreads = 4;
+
+struct RingStressInfo {
+  RingTube<DummyItem> *ring;
+  std::vector<DummyItem> *items;
+  unsigned begin;
+  unsigned end;
+  int64_t sum;
+};
+
+void *MainRingProducer(void *data) {
+  RingStressInfo *info = reinterpret_cast<RingStressInfo *>(data);
+  for (unsigned i = info->begin; i < info->end; ++i)
+    info->ring->EnqueueBack(&(*info->items)[i]);
+  return NULL;
+}
+
+void *MainRingConsumer(void *data) {
+  RingStressInfo *info = reinterpret_cast<RingStressInfo *>(data);
+  int64_t last_tag[kRingNumThreads];
+  for (unsigned i = 0; i < kRingNumThreads; ++i)
+    last_tag[i] = -1;
+  while (true) {
+    DummyItem *item = info->ring->PopFront();
+    if (item->tag_ < 0)
+      break;
+    info->sum += item->tag_;
+    // Items of the same producer leave the ring in order
+    unsigned producer = item->tag_ % kRingNumThreads;
+    EXPECT_LT(last_tag[producer], item->tag_);
+    last_tag[producer] = item->tag_;
+  }
+  return NULL;
+}
+
+}  // anonymous namespace
+
+
+TEST_F(T_Tube, RingMultiThreaded) {
+  const unsigned kNumThreads = kRingNumThreads;
+  const unsigned kNumItems = 100000;
+  RingTube<DummyItem> ring(64);
+  // Every producer gets a range of items with increasing tags such that
+  // tag % kNumThreads names the producer
+  std::vector<DummyItem> items(kNumItems);
+  for (unsigned i = 0; i < kNumItems; ++i) {
+    unsigned producer = i / (kNumItems / kNumThreads);
+    unsigned seq = i % (kNumItems / kNumThreads);
+    items[i].tag_ = seq * kNumThreads + producer;
+  }
+
+  RingStressInfo producers[kNumThreads];
+  RingStressInfo consumers[kNumThreads];
+  pthread_t threads_producer[kNumThreads];
+  pthread_t threads_consumer[kNumThreads];
+  for (unsigned i = 0; i < kNumThreads; ++i) {
+    consumers[i].ring = &ring;
+    consumers[i].sum = 0;
+    EXPECT_EQ(0, pthread_create(&threads_consumer[i], NULL,
+                                MainRingConsumer, &consumers[i]));
+  }
+  for (unsigned i = 0; i < kNumThreads; ++i) {
+    producers[i].ring = &ring;
+    producers[i].items = &items;
+    producers[i].begin = i * (kNumItems / kNumThreads);
+    producers[i].end = (i + 1) * (kNumItems / kNumThreads);
+    EXPECT_EQ(0, pthread_create(&threads_producer[i], NULL,
+                                MainRingProducer, &producers[i]));
+  }
+  for (unsigned i = 0; i < kNumThreads; ++i)
+    pthread_join(threads_producer[i], NULL);
+  ring.Wait();
+
+  DummyItem quit_beacon;  // tag -1
+  for (unsigned i = 0; i < kNumThreads; ++i)
+    ring.EnqueueBack(&quit_beacon);
+  int64_t sum = 0;
+  for (unsigned i = 0; i < kNumThreads; ++i) {
+    pthread_join(threads_consumer[i], NULL);
+    sum += consumers[i].sum;
+  }
+  EXPECT_EQ(static_cast<int64_t>(kNumItems) * (kNumItems - 1) / 2, sum);
+  EXPECT_TRUE(ring.IsEmpty());
+}
@@ -9,6 +9,7 @@
 #include <unistd.h>
 
 #include <string>
+#include <vector>
 
 #include "c_file_sandbox.h"
 #include "c_http_server.h"
@@ -85,6 +86,9 @@ class T_Uploaders : public FileSandbox {
   static const unsigned kTotal429Replies;
   static const unsigned k429ThrottleSec;
   static atomic_int64 gSeed;
+  static atomic_int32 gMultipartUploads;
+  static atomic_int32 gMultipartAborts;
+  static atomic_int32 gFailMultipartComplete;
   struct StreamHandle {
     StreamHandle() : handle(NULL), content_hash(shash::kMd5) {
       content_hash.Randomize(atomic_xadd64(&gSeed, 1));
@@ -331,8 +335,67 @@ class T_Uploaders : public FileSandbox {
     HTTPResponse response;
     // strip bucket name
     std::string req_file = req.path.substr(req.path.find("/", 1) + 1);
+    // Multipart uploads store their parts next to the final object
+    std::string req_query;
+    const size_t pos_query = req_file.find('?');
+    if ((pos_query != std::string::npos) && (pos_query > 0)) {
+      req_query = req_file.substr(pos_query + 1);
+      req_file = req_file.substr(0, pos_query);
+    }
 
-    if ((*n429 > 0) &&
+    if (!req_query.empty()) {
+      const std::string path = T_Uploaders::dest_dir + "/" + req_file;
+      if ((req.method == "POST") && (req_query == "uploads")) {
+        response.body = "<InitiateMultipartUploadResult><UploadId>"
+                        "4711</UploadId></InitiateMultipartUploadResult>";
+      } else if (req.method == "PUT") {
+        assert(HasPrefix(req_query, "partNumber=", false));
+        assert(HasSuffix(req_query, "&uploadId=4711", false));
+        const std::string part =
+          req_query.substr(11, req_query.find('&') - 11);
+        EXPECT_TRUE(SafeWriteToFile(req.body, path + ".part" + part, 0600));
+        response.AddHeader("ETag", "\"etag" + part + "\"");
+      } else if ((req.method == "POST") && (req_query == "uploadId=4711") &&
+                 atomic_read32(&gFailMultipartComplete))
+      {
+        response.code = 403;
+        response.reason = "Forbidden";
+      } else if ((req.method == "POST") && (req_query == "uploadId=4711")) {
+        std::string content;
+        size_t pos = 0;
+        while ((pos = req.body.find("<PartNumber>", pos)) != std::string::npos)
+        {
+          pos += 12;
+          const std::string part =
+            req.body.substr(pos, req.body.find("<", pos) - pos);
+          EXPECT_NE(std::string::npos,
+                    req.body.find("<ETag>\"etag" + part + "\"</ETag>"));
+          std::string part_content;
+          int fd = open((path + ".part" + part).c_str(), O_RDONLY);
+          assert(fd >= 0);
+          EXPECT_TRUE(SafeReadToString(fd, &part_content));
+          close(fd);
+          unlink((path + ".part" + part).c_str());
+          content += part_content;
+        }
+        EXPECT_TRUE(SafeWriteToFile(content, path, 0600));
+        atomic_inc32(&gMultipartUploads);
+        response.body = "<CompleteMultipartUploadResult>"
+                        "</CompleteMultipartUploadResult>";
+      } else if ((req.method == "DELETE") && (req_query == "uploadId=4711")) {
+        for (unsigned part = 1; FileExists(path + ".part" +
+                                           StringifyInt(part)); ++part)
+        {
+          unlink((path + ".part" + StringifyInt(part)).c_str());
+        }
+        atomic_inc32(&gMultipartAborts);
+        response.code = 204;
+        response.reason = "No Content";
+      } else {
+        response.code = 400;
+        response.reason = "Bad Request";
+      }
+    } else if ((*n429 > 0) &&
         (req.path.size() >= 5) &&
         (req.path.compare(req.path.size() - 5, 5, "RETRY") == 0)) {
       (*n429)--;
@@ -365,6 +428,22 @@ class T_Uploaders : public FileSandbox {
       }
       response.code = 204;
       response.reason = "No Content";
+    } else if ((req.method == "POST") && (req_file == "?delete")) {
+      // Multi-object delete, keys are listed as <Key>...</Key>
+      size_t pos = 0;
+      while ((pos = req.body.find("<Key>", pos)) != std::string::npos) {
+        pos += 5;
+        const size_t end = req.body.find("</Key>", pos);
+        assert(end != std::string::npos);
+        std::string path = T_Uploaders::dest_dir + "/" +
+                           req.body.substr(pos, end - pos);
+        if (FileExists(path)) {
+          int retval = remove(path.c_str());
+          assert(retval == 0);
+        }
+      }
+      response.body = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+                      "<DeleteResult></DeleteResult>";
     }
 
     return response;
@@ -396,6 +475,7 @@ class T_Uploaders : public FileSandbox {
         StringifyInt(parallel_connections) + "\n"
         "CVMFS_S3_HOST=127.0.0.1\n"
         "CVMFS_S3_DNS_BUCKETS=false\n"
+        "CVMFS_S3_MULTIPART_PART_SIZE=" + StringifyInt(5 * 1024 * 1024) + "\n"
         "CVMFS_S3_PORT=" + StringifyInt(CVMFS_S3_TEST_MOCKUP_SERVER_PORT);
 
     fprintf(s3_conf, "%s\n", conf_str.c_str());
@@ -458,6 +538,12 @@ bool T_Uploaders<S3Uploader>::IsS3() const {
 
 template <class UploadersT>
 atomic_int64 T_Uploaders<UploadersT>::gSeed = 0;
+template <class UploadersT>
+atomic_int32 T_Uploaders<UploadersT>::gMultipartUploads = 0;
+template <class UploadersT>
+atomic_int32 T_Uploaders<UploadersT>::gMultipartAborts = 0;
+template <class UploadersT>
+atomic_int32 T_Uploaders<UploadersT>::gFailMultipartComplete = 0;
 
 // Shold be larger than the number of regular retries
 template <class UploadersT>
@@ -646,6 +732,47 @@ TYPED_TEST(T_Uploaders, RemoveFromStorage) {
 //
 
 
+TYPED_TEST(T_Uploaders, RemoveBatchFromStorage) {
+  const std::string small_file_path = TestFixture::GetSmallFile();
+  const unsigned kNumFiles = 20;
+
+  std::vector<std::string> dest_names;
+  for (unsigned i = 0; i < kNumFiles; ++i) {
+    dest_names.push_back("small_file_" + StringifyInt(i));
+    this->uploader_->UploadFile(small_file_path, dest_names[i],
+                                AbstractUploader::MakeClosure(
+                                &UploadCallbacks::SimpleUploadClosure,
+                                &this->delegate_,
+                                UploaderResults(0, small_file_path)));
+  }
+  this->uploader_->WaitForUpload();
+  for (unsigned i = 0; i < kNumFiles; ++i) {
+    EXPECT_TRUE(TestFixture::CheckFile(dest_names[i]));
+  }
+
+  // Non-existing files are no error
+  std::vector<std::string> to_delete(dest_names.begin() + kNumFiles / 2,
+                                     dest_names.end());
+  to_delete.push_back("alien");
+  this->uploader_->RemoveAsync(to_delete);
+  this->uploader_->WaitForUpload();
+  EXPECT_EQ(0U, this->uploader_->GetNumberOfErrors());
+
+  for (unsigned i = 0; i < kNumFiles; ++i) {
+    EXPECT_EQ(i < kNumFiles / 2, TestFixture::CheckFile(dest_names[i]));
+  }
+
+  this->uploader_->RemoveAsync(std::vector<std::string>());
+  this->uploader_->WaitForUpload();
+  EXPECT_EQ(0U, this->uploader_->GetNumberOfErrors());
+}
+
+
+//
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+//
+
+
 TYPED_TEST(T_Uploaders, UploadEmptyFile) {
   const std::string empty_file_path = TestFixture::GetEmptyFile();
   const std::string dest_name       = "empty_file";
@@ -804,6 +931,114 @@ TYPED_TEST(T_Uploaders, SingleStreamedUpload) {
 //------------------------------------------------------------------------------
 
 
+TYPED_TEST(T_Uploaders, MultipartStreamedUpload) {
+  // 12 MiB are uploaded in three parts by the S3 uploader
+  const int number_of_buffers = 12;
+  typename TestFixture::Buffers buffers;
+  for (int i = 0; i < number_of_buffers; ++i)
+    buffers.push_back(new std::string(1024 * 1024, 'a' + i));
+  const int multipart_uploads_before =
+    atomic_read32(&TestFixture::gMultipartUploads);
+
+  UploadStreamHandle *handle = this->uploader_->InitStreamedUpload(
+      AbstractUploader::MakeClosure(&UploadCallbacks::StreamedUploadComplete,
+                                    &this->delegate_,
+                                    0));
+  ASSERT_NE(static_cast<UploadStreamHandle*>(NULL), handle);
+  for (int i = 0; i < number_of_buffers; ++i) {
+    this->uploader_->ScheduleUpload(
+      handle,
+      AbstractUploader::UploadBuffer(buffers[i]->length(),
+                                     const_cast<char *>(buffers[i]->data())),
+      AbstractUploader::MakeClosure(
+        &UploadCallbacks::BufferUploadComplete,
+        &this->delegate_,
+        UploaderResults(UploaderResults::kBufferUpload, 0)));
+  }
+  shash::Any content_hash(shash::kSha1);
+  content_hash.Randomize(4711);
+  this->uploader_->ScheduleCommit(handle, content_hash);
+  this->uploader_->WaitForUpload();
+
+  EXPECT_EQ(1,
+    atomic_read32(&(this->delegate_.streamed_upload_complete_invocations)));
+  EXPECT_EQ(0u, this->uploader_->GetNumberOfErrors());
+  if (TestFixture::IsS3()) {
+    EXPECT_EQ(multipart_uploads_before + 1,
+              atomic_read32(&TestFixture::gMultipartUploads));
+  }
+
+  const std::string dest = "data/" + content_hash.MakePath();
+  EXPECT_TRUE(TestFixture::CheckFile(dest));
+  TestFixture::CompareBuffersAndFileContents(
+      buffers,
+      TestFixture::AbsoluteDestinationPath(dest));
+
+  TestFixture::FreeBuffers(&buffers);
+}
+
+
+//------------------------------------------------------------------------------
+
+
+TYPED_TEST(T_Uploaders, MultipartCompleteFailure) {
+  if (!TestFixture::IsS3()) {
+    SUCCEED();  // Only the S3 uploader uses multipart uploads
+    return;
+  }
+
+  // 12 MiB are uploaded in three parts but the server refuses to assemble them
+  const int number_of_buffers = 12;
+  typename TestFixture::Buffers buffers;
+  for (int i = 0; i < number_of_buffers; ++i)
+    buffers.push_back(new std::string(1024 * 1024, 'a' + i));
+  const int multipart_uploads_before =
+    atomic_read32(&TestFixture::gMultipartUploads);
+  const int multipart_aborts_before =
+    atomic_read32(&TestFixture::gMultipartAborts);
+  atomic_write32(&TestFixture::gFailMultipartComplete, 1);
+
+  UploadStreamHandle *handle = this->uploader_->InitStreamedUpload(
+      AbstractUploader::MakeClosure(&UploadCallbacks::StreamedUploadComplete,
+                                    &this->delegate_,
+                                    99));
+  ASSERT_NE(static_cast<UploadStreamHandle*>(NULL), handle);
+  for (int i = 0; i < number_of_buffers; ++i) {
+    this->uploader_->ScheduleUpload(
+      handle,
+      AbstractUploader::UploadBuffer(buffers[i]->length(),
+                                     const_cast<char *>(buffers[i]->data())),
+      AbstractUploader::MakeClosure(
+        &UploadCallbacks::BufferUploadComplete,
+        &this->delegate_,
+        UploaderResults(UploaderResults::kBufferUpload, 0)));
+  }
+  shash::Any content_hash(shash::kSha1);
+  content_hash.Randomize(4712);
+  SetAltLogFunc(LogSupress);
+  this->uploader_->ScheduleCommit(handle, content_hash);
+  this->uploader_->WaitForUpload();
+  SetAltLogFunc(NULL);
+  atomic_write32(&TestFixture::gFailMultipartComplete, 0);
+
+  // The failed upload is reported once and its parts are released
+  EXPECT_EQ(1,
+    atomic_read32(&(this->delegate_.streamed_upload_complete_invocations)));
+  EXPECT_EQ(multipart_uploads_before,
+            atomic_read32(&TestFixture::gMultipartUploads));
+  EXPECT_EQ(multipart_aborts_before + 1,
+            atomic_read32(&TestFixture::gMultipartAborts));
+  const std::string dest = "data/" + content_hash.MakePath();
+  EXPECT_FALSE(TestFixture::CheckFile(dest));
+  EXPECT_FALSE(TestFixture::CheckFile(dest + ".part1"));
+
+  TestFixture::FreeBuffers(&buffers);
+}
+
+
+//------------------------------------------------------------------------------
+
+
 TYPED_TEST(T_Uploaders, MultipleStreamedUploadSlow) {
   const int  number_of_files        = 100;
   const int  max_buffers_per_stream = 15;